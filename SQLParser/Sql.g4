@@ -13,6 +13,12 @@ Max: 'MAX';
 Min: 'MIN';
 Sum: 'SUM';
 Null: 'NULL';
+Dictionary: 'DICTIONARY';
+Pax: 'PAX';
+Clustered: 'CLUSTERED';
+Memory: 'MEMORY';
+Hash: 'HASH';
+ZoneMap: 'ZONEMAP';
 
 WhereNot: 'NOT';
 
@@ -38,10 +44,13 @@ db_statement:
 	| 'SHOW' 'DATABASES'			# show_dbs
 	| 'USE' Identifier						# use_db
 	| 'SHOW' 'TABLES'						# show_tables
-	| 'SHOW' 'INDEXES' 'FROM' Identifier # show_indexes;
+	| 'SHOW' 'INDEXES' 'FROM' Identifier # show_indexes
+	| 'SHOW' 'STATS' 'FROM' Identifier # show_stats;
 
 table_statement:
-	'CREATE' 'TABLE' Identifier '(' field_list ')'			# create_table
+	'CREATE' 'TABLE' Identifier '(' field_list ')' ('LAYOUT' '=' Pax)? Clustered? (
+		'WITH' ZoneMap
+	)? ('ENGINE' '=' Memory)? # create_table
 	| 'DROP' 'TABLE' Identifier								# drop_table
 	| 'DESC' Identifier										# describe_table
 	| 'INSERT' 'INTO' Identifier 'VALUES' insert_value_list	# insert_into_table
@@ -49,6 +58,11 @@ table_statement:
 	| 'UPDATE' Identifier 'SET' set_clause (
 		'WHERE' where_and_clause
 	)? # update_table
+	| 'LOAD' 'DATA' 'INFILE' String 'INTO' 'TABLE' Identifier (
+		'FIELDS' 'TERMINATED' 'BY' String
+	)? # load_data
+	| 'VACUUM' 'TABLE' Identifier ('LIMIT' Integer)?			# vacuum_table
+	| 'ANALYZE' 'TABLE' Identifier							# analyze_table
 	| select_table													# select_table_;
 
 select_table:
@@ -59,7 +73,9 @@ select_table:
 	)?;
 
 alter_statement:
-	'ALTER' 'TABLE' Identifier 'ADD' 'INDEX' '(' identifiers ')'	# alter_add_index
+	'ALTER' 'TABLE' Identifier 'ADD' 'INDEX' '(' identifiers ')' (
+		'USING' Hash
+	)? # alter_add_index
 	| 'ALTER' 'TABLE' Identifier 'DROP' 'INDEX' '(' identifiers ')'	# alter_drop_index
 	| 'ALTER' 'TABLE' Identifier 'DROP' 'PRIMARY' 'KEY' (
 		Identifier
@@ -74,7 +90,7 @@ alter_statement:
 field_list: field (',' field)*;
 
 field:
-	Identifier type_ ('NOT' Null)? ('DEFAULT' value)?								# normal_field
+	Identifier type_ ('NOT' Null)? ('DEFAULT' value)? Dictionary?					# normal_field
 	| 'PRIMARY' 'KEY' '(' Identifier ')'											# primary_key_field
 	| 'FOREIGN' 'KEY' '(' Identifier ')' 'REFERENCES' Identifier '(' Identifier ')'	#
 		foreign_key_field;
@@ -7,6 +7,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <tuple>
 
 #include "internal/IndexedTable.h"
 #include "internal/ParseTreeVisitor.h"
@@ -24,6 +25,7 @@
  *      - /<table-name>: Table
  *  - /index: Index files
  *      - /<db-name>/<table-name>/<column>: index for column
+ *      - /<db-name>/<table-name>/<column>,<column>...: composite index
  */
 
 namespace SimpleDB {
@@ -57,14 +59,26 @@ private:
     Internal::Table systemTablesTable;
     Internal::Table systemIndexesTable;
     Internal::Table systemForeignKeyTable;
+    Internal::Table systemStatisticsTable;
 
     static std::vector<Internal::ColumnMeta> systemDatabaseTableColumns;
     static std::vector<Internal::ColumnMeta> systemTablesTableColumns;
     static std::vector<Internal::ColumnMeta> systemIndexesTableColumns;
     static std::vector<Internal::ColumnMeta> systemForeignKeyTableColumns;
+    static std::vector<Internal::ColumnMeta> systemStatisticsTableColumns;
 
     Internal::ParseTreeVisitor visitor;
     std::map<std::string, Internal::Table *> openedTables;
+    // The indexes opened, by (database, table, index name), kept open across
+    // statements until they are dropped or the database is switched. The
+    // record of the index in the system table is kept along, so that a cached
+    // index is found without scanning the system table.
+    using IndexKey = std::tuple<std::string, std::string, std::string>;
+    struct OpenedIndex {
+        Internal::RecordID id;
+        std::shared_ptr<Internal::Index> index;
+    };
+    std::map<IndexKey, OpenedIndex> openedIndexes;
 
     // === Database management methods ===
     Service::PlainResult createDatabase(const std::string &dbName);
@@ -73,11 +87,15 @@ private:
     Service::ShowDatabasesResult showDatabases();
 
     Service::ShowTableResult showTables();
+    // See `Table::create()` for the options. The zone maps are only kept when
+    // asked for, as they take the tail space of each data page.
     Service::PlainResult createTable(
         const std::string &tableName,
         const std::vector<Internal::ColumnMeta> &columns,
         const std::string &primaryKey = std::string(),
-        const std::vector<Internal::ForeignKey> &foreignKeys = {});
+        const std::vector<Internal::ForeignKey> &foreignKeys = {},
+        bool zoneMap = false, bool pax = false, bool clustered = false,
+        bool memory = false);
     Service::PlainResult dropTable(const std::string &tableName);
     Service::DescribeTableResult describeTable(const std::string &tableName);
 
@@ -90,14 +108,23 @@ private:
                                        const std::string &refColumn);
     Service::PlainResult dropForeignKey(const std::string &tableName,
                                         const std::string &column);
-    Service::PlainResult createIndex(const std::string &tableName,
-                                     const std::string &columnName,
-                                     bool isPrimaryKey = false);
+    // An index on more than one column is a composite one, whose keys are
+    // ordered by the columns in order. A hash index only answers equality
+    // conditions on its column.
+    Service::PlainResult createIndex(
+        const std::string &tableName,
+        const std::vector<std::string> &columnNames,
+        bool isPrimaryKey = false, bool hash = false);
     Service::PlainResult dropIndex(const std::string &tableName,
-                                   const std::string &columnName,
+                                   const std::vector<std::string> &columnNames,
                                    bool isPrimaryKey = false);
     Service::ShowIndexesResult showIndexes(const std::string &tableName);
 
+    // Compute the statistics of each column with a full scan, replacing the
+    // previous ones.
+    Service::PlainResult analyzeTable(const std::string &tableName);
+    Service::QueryResult showStatistics(const std::string &tableName);
+
     // === CURD methods ===
     Service::PlainResult insert(const std::string &tableName,
                                 const std::vector<Internal::Column> &values,
@@ -106,7 +133,20 @@ private:
                                 const std::vector<std::string> &columnNames,
                                 const Internal::Columns &columns);
     Service::PlainResult delete_(Internal::QueryBuilder &builder);
+    // Load rows from a CSV file. Rows are inserted in batches, constraints
+    // are checked in bulk, and the indexes are updated after the rows are
+    // loaded.
+    Service::PlainResult loadData(const std::string &tableName,
+                                  const std::string &path, char delimiter);
     Service::QueryResult select(Internal::QueryBuilder &builder);
+    // Move the records into the holes left by deletions, in batches of
+    // VACUUM_BATCH_SIZE records, and shrink the table file. The indexes are
+    // updated after each batch, then rebuilt to release their empty nodes.
+    // With a non-negative `limit`, at most `limit` records are moved, so that
+    // a large table can be vacuumed by several short statements, each resuming
+    // where the last one stopped; the indexes are rebuilt by the last one.
+    Service::PlainResult vacuumTable(const std::string &tableName,
+                                     int limit = -1);
 
     Internal::QueryBuilder buildQuery(
         const std::vector<std::string> &tables,
@@ -148,6 +188,19 @@ private:
         std::string refTable;
         std::string refColumn;
     };
+    struct IndexInfo {
+        // The name of the columns, joined by ','.
+        std::string name;
+        // The indexes of the columns in the table.
+        std::vector<int> columns;
+
+        // The key of the record in the index.
+        Internal::Columns getKey(const Internal::Columns &record) const;
+    };
+    // The indexes of each table of the current database, looked up once, so
+    // that the statements on a table do not scan the system table. Dropped
+    // when an index of the table is created or dropped, or the table is.
+    std::map<std::string, std::vector<IndexInfo>> tableIndexInfos;
     std::pair<Internal::RecordID, Internal::Columns> findDatabase(
         const std::string &dbName);
     std::pair<Internal::RecordID, Internal::Columns> findTable(
@@ -158,6 +211,10 @@ private:
         const std::string &columnName);
     Internal::QueryBuilder::Result findIndexes(const std::string &database,
                                                const std::string &table);
+    const std::vector<IndexInfo> &findIndexInfos(const Internal::Table *table);
+    // Leave `table` empty to match all the tables in the database.
+    Internal::QueryBuilder::Result findStatistics(const std::string &database,
+                                                  const std::string &table);
     std::vector<ForeignKeyInfo> findForeignKeys(const std::string &database,
                                                 const std::string &table,
                                                 const std::string &column,
@@ -172,6 +229,9 @@ private:
     std::pair<Internal::RecordID, std::shared_ptr<Internal::Index>> getIndex(
         const std::string &database, const std::string &table,
         const std::string &column);
+    // Close and forget the opened indexes of the table, or only `column`'s
+    // if it is not empty.
+    void closeIndexes(const std::string &table, const std::string &column = "");
     std::shared_ptr<Internal::IndexedTable> newIndexedTable(
         Internal::Table *table);
 };
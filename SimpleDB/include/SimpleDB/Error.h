@@ -42,6 +42,7 @@ DECLARE_ERROR(CloseFile, IOErrorBase, "Fail to close file");
 DECLARE_ERROR(ReadFile, IOErrorBase, "Fail to read file");
 DECLARE_ERROR(WriteFile, IOErrorBase, "Fail to write file");
 DECLARE_ERROR(DeleteFile, IOErrorBase, "Fail to delete file");
+DECLARE_ERROR(TruncateFile, IOErrorBase, "Fail to truncate file");
 DECLARE_ERROR(FileExists, IOErrorBase, "File already exists");
 DECLARE_ERROR(InvalidDescriptor, IOErrorBase, "Invalid file descriptor");
 DECLARE_ERROR(InvalidPageNumber, IOErrorBase, "Invalid file descriptor");
@@ -64,6 +65,7 @@ DECLARE_ERROR(InvalidSlot, TableErrorBase, "Invalid page/slot number");
 DECLARE_ERROR(InvalidColumnSize, TableErrorBase, "Invalid column size");
 DECLARE_ERROR(InvalidColumnIndex, TableErrorBase, "Invalid column index");
 DECLARE_ERROR(ColumnFull, TableErrorBase, "The column is full");
+DECLARE_ERROR(TableFull, TableErrorBase, "The table is full");
 DECLARE_ERROR(ColumnExists, TableErrorBase, "The column already exists");
 DECLARE_ERROR(InvalidPageMeta, TableErrorBase, "The page meta is invalid");
 DECLARE_ERROR(TooManyColumns, TableErrorBase, "Too many columns");
@@ -83,6 +85,16 @@ DECLARE_ERROR(IncorrectColumnNum, TableErrorBase,
               "Incorrect number of columns are given");
 DECLARE_ERROR(ForeignKeyViolation, TableErrorBase,
               "Violating foreign key constraints");
+DECLARE_ERROR(InvalidDictionaryColumn, TableErrorBase,
+              "Only VARCHAR columns can be dictionary-encoded");
+DECLARE_ERROR(DictionaryFull, TableErrorBase,
+              "The dictionary of the table is full");
+DECLARE_ERROR(DuplicateKey, TableErrorBase,
+              "The primary key already exists in the table");
+DECLARE_ERROR(ClusterKeyUpdate, TableErrorBase,
+              "The key of a clustered table cannot be updated");
+DECLARE_ERROR(InvalidMemoryTable, TableErrorBase,
+              "The option is not supported by memory tables");
 
 // ==== Iterator Error ====
 DECLARE_ERROR_CLASS(Iterator, InternalErrorBase, "Iterator error");
@@ -106,6 +118,13 @@ DECLARE_ERROR(IndexKeyExists, IndexErrorBase, "Duplicate index key found");
 DECLARE_ERROR(IndexKeyNotExists, IndexErrorBase, "The index does not exist");
 DECLARE_ERROR(WriteOnReadOnlyIndex, IndexErrorBase,
               "Internal: trying to write on a read-only index");
+DECLARE_ERROR(IndexNotEmpty, IndexErrorBase,
+              "Bulk loading into a non-empty index");
+DECLARE_ERROR(SpillIndexRun, IndexErrorBase,
+              "Fail to spill sorted index entries");
+DECLARE_ERROR(HashIndexRange, IndexErrorBase,
+              "Hash indexes only find records by their keys");
+DECLARE_ERROR(VacuumIndex, IndexErrorBase, "Fail to vacuum index");
 
 // ==== QueryBuilder Error ====
 DECLARE_ERROR_CLASS(QueryBuilder, InternalErrorBase, "QueryBuilder error");
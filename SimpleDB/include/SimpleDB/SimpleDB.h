@@ -6,8 +6,10 @@
 
 // The latter is just for code highliging.
 #if TESTING
+#include "internal/CSVReader.h"
 #include "internal/Index.h"
 #include "internal/PageFile.h"
+#include "internal/Statistics.h"
 #endif
 
 // Include at last, as it may include other headers that conflict with existing
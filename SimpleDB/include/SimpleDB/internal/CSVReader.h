@@ -0,0 +1,45 @@
+#ifndef _SIMPLEDB_CSV_READER_H
+#define _SIMPLEDB_CSV_READER_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace SimpleDB {
+namespace Internal {
+
+// A streaming reader of CSV records (RFC 4180). Fields can be enclosed in
+// double quotes, in which case they may contain delimiters, line breaks and
+// escaped quotes ("").
+class CSVReader {
+public:
+    struct Field {
+        std::string value;
+        // Whether the field is enclosed in quotes, so that an empty quoted
+        // field can be told apart from a missing one.
+        bool quoted;
+    };
+
+    CSVReader(std::istream &stream, char delimiter = ',')
+        : stream(stream), delimiter(delimiter) {}
+
+    // Read the next record into `fields`, reusing its storage. Returns false
+    // at the end of the stream. Empty lines are skipped.
+    bool next(std::vector<Field> &fields);
+
+    // The line number (1-based) where the last record starts.
+    int lineNumber() const { return recordLine; }
+
+#if !TESTING
+private:
+#endif
+    std::istream &stream;
+    char delimiter;
+    int line = 1;
+    int recordLine = 0;
+};
+
+}  // namespace Internal
+}  // namespace SimpleDB
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef _SIMPLEDB_CACHE_MANAGER_H
 #define _SIMPLEDB_CACHE_MANAGER_H
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
 
 #include "Error.h"
 #include "internal/FileManager.h"
@@ -36,6 +38,13 @@ public:
     // examined.
     char *loadRaw(const PageHandle &handle);
 
+    // Copy a page (from the cache or the disk) to `dest`. Unlike the other
+    // methods, it can be called by multiple threads at the same time, as long
+    // as no other method is called meanwhile. The lock is only held to look up
+    // and claim the cache slot, while the page is read from the disk, written
+    // back, and copied with the slot pinned.
+    void readPage(FileDescriptor fd, int page, char *dest);
+
     // Mark the page as dirty, should be called after every write to the buffer.
     // The handle must be validated via validate() before calling this function,
     // otherwise InvalidPageHandleError might be thrown.
@@ -50,6 +59,10 @@ public:
     // A handler to do some cleanup before the file manager closes the file.
     void onCloseFile(FileDescriptor fd) noexcept(false);
 
+    // A handler to drop the cached pages beyond the new end of the file before
+    // the file manager truncates it. Dirty pages are discarded, not written.
+    void onTruncateFile(FileDescriptor fd, int numPages) noexcept(false);
+
     // Write back all pages and destroy the cache manager.
     void close();
 
@@ -83,6 +96,12 @@ private:
 
         int generation = 0;
 
+        // The number of readPage() calls using the cache, which must not be
+        // replaced meanwhile.
+        int pins = 0;
+        // Whether the page is being read from the disk by readPage().
+        bool loading = false;
+
         // A reverse pointer to the node in the linked list.
         LinkedList<PageCache>::Node *nodeInActiveCache = nullptr;
 
@@ -90,6 +109,7 @@ private:
         void reset(const PageMeta &meta) {
             this->meta = meta;
             dirty = false;
+            loading = false;
             nodeInActiveCache = nullptr;
             // We don't need to bump the generation number here. It's done
             // during write back.
@@ -104,12 +124,24 @@ private:
     PageCache *cacheBuf;
     bool closed = false;
 
+    // Guards the cache lists and maps, and the pins of the caches, during the
+    // concurrent readPage() calls.
+    std::mutex readMutex;
+    // Notified when a cache is loaded or unpinned.
+    std::condition_variable readCondition;
+
     // Write the cache back to the disk if it is dirty, and remove the cache.
     void writeBack(PageCache *cache);
 
     // Get the cache for certain page. Claim a slot (and load from disk) if it
     // is not cached.
     PageCache *getPageCache(FileDescriptor fd, int page) noexcept(false);
+
+    // Like `getPageCache()`, but pins the cache, and does the I/O without
+    // holding the `lock` on `readMutex`.
+    PageCache *pinPageCache(FileDescriptor fd, int page,
+                            std::unique_lock<std::mutex> &lock) noexcept(false);
+    void unpin(PageCache *cache);
 };
 
 }  // namespace Internal
@@ -17,17 +17,32 @@ enum DataType {
     VARCHAR  // length-variable string
 };
 
+// Fixed-size value buffer, used where a value must be stored inline (e.g. the
+// default value in the on-disk column metadata, or a condition operand).
 union ColumnValue {
     int intValue;
     float floatValue;
     char stringValue[MAX_COLUMN_SIZE];
 };
 
+// In-memory column data. Scalars are stored inline, while a VARCHAR is kept
+// out-of-line in a heap buffer, so that a row of scalars does not pay for
+// MAX_COLUMN_SIZE bytes per column. The buffer is reference counted and
+// shared by the copies of the column, so that copying a row, e.g. into a
+// result set or a joined row, does not copy its strings.
+struct ColumnData {
+    char *stringValue = nullptr;
+    union {
+        int intValue;
+        float floatValue;
+    };
+};
+
 struct Column {
-    DataType type;
-    ColumnSizeType size;
+    ColumnData data;
+    DataType type = INT;
+    uint16_t size = 0;
     bool isNull = false;
-    ColumnValue data;
 
     // Initialize a null column.
     static Column nullColumn(DataType type, ColumnSizeType size);
@@ -41,8 +56,28 @@ struct Column {
     Column(const char *data, int maxLength);
 
     Column() = default;
+    Column(const Column &rhs);
+    Column(Column &&rhs) noexcept;
+    Column &operator=(const Column &rhs);
+    Column &operator=(Column &&rhs) noexcept;
+    ~Column();
+
+    // Replace the string value with the first (at most) `length` bytes of
+    // `data`. The buffer is reused if it is large enough and not shared, as
+    // when a row buffer is read into again, otherwise a new one is taken.
+    void setString(const char *data, size_t length);
+
+    // The raw pointer of the value, in the format expected by the comparers.
+    const char *raw() const {
+        if (type == VARCHAR) {
+            return data.stringValue == nullptr ? "" : data.stringValue;
+        }
+        return (const char *)&data.intValue;
+    }
 };
 
+static_assert(sizeof(Column) <= 24);
+
 using Columns = std::vector<Column>;
 using ColumnBitmap = int16_t;
 
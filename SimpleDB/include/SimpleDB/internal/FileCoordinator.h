@@ -22,6 +22,7 @@ public:
     FileDescriptor openFile(const std::string &fileName);
     void closeFile(FileDescriptor fd);
     void deleteFile(const std::string &fileName);
+    void truncateFile(FileDescriptor fd, int numPages);
     PageHandle getHandle(FileDescriptor fd, int page);
     // A safe method to load a page with a handle (valid/invalid). Note that the
     // handle might be renewed.
@@ -31,6 +32,8 @@ public:
         return cacheManager->loadRaw(handle);
     }
     void markDirty(const PageHandle &handle);
+    // Thread-safe among themselves, see CacheManager::readPage().
+    void readPage(FileDescriptor fd, int page, char *dest);
     PageHandle renew(const PageHandle &handle);
 
 #if !TESTING
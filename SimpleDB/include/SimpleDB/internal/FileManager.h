@@ -25,6 +25,8 @@ public:
     void readPage(FileDescriptor fd, int page, char *data,
                   bool couldFail = false) noexcept(false);
     void writePage(FileDescriptor fd, int page, char *data) noexcept(false);
+    // Shrink the file to `numPages` pages.
+    void truncateFile(FileDescriptor fd, int numPages) noexcept(false);
 
     // Check if the file descriptor is valid.
     bool validate(FileDescriptor fd);
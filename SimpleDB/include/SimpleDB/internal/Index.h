@@ -1,6 +1,7 @@
 #ifndef _SIMPLEDB_INDEX_H
 #define _SIMPLEDB_INDEX_H
 
+#include <climits>
 #include <functional>
 #include <string>
 #include <tuple>
@@ -17,119 +18,316 @@ class Index {
 private:
     using NodeIndex = int;
     using IterateFunc = std::function<bool(RecordID)>;
+    using IterateKeyFunc = std::function<bool(RecordID, const char *key)>;
 
 public:
+    // The keys are encoded as byte strings of a fixed size, which compare (as
+    // unsigned bytes) in the order of the values: INT and FLOAT keys are
+    // big-endian integers with the sign bit flipped (all the bits for
+    // negative FLOATs), VARCHAR keys are the strings padded with zeros, but
+    // truncated to INDEX_MAX_KEY_SIZE bytes.
+    //
+    // The key of a composite index is the keys of its columns in order, each
+    // but the first led by a byte, which is 0 if the value is NULL (then the
+    // key is zeros) and 1 otherwise. The entries whose first value is NULL
+    // are the NULL entries.
+    using Key = std::string;
+    using Range = std::pair<Key, Key>;  // [first, second]
+    using IntRange = std::pair<int, int>;
+
+    struct KeyColumn {
+        DataType type = INT;
+        // The size of the column.
+        int size = sizeof(int);
+        // The size of the key of its values, without the NULL flag.
+        int keySize = sizeof(int);
+    };
+
     Index() = default;
     ~Index();
     void open(const std::string &file);
-    void create(const std::string &file);
+    // Create an index on a column of `type`, whose size is `size`.
+    void create(const std::string &file, DataType type = INT,
+                int size = sizeof(int));
+    // Create a composite index on the columns, in order. The VARCHAR columns
+    // share the bytes of the keys left by the others, and are truncated to
+    // them. With `hash`, the index is a hash table on a single INT or VARCHAR
+    // column instead, which only finds the records by their keys, i.e. in
+    // ranges of a single key.
+    void create(const std::string &file,
+                const std::vector<ColumnMeta> &columns, bool hash = false);
     void close();
 
+    void insert(const Column &key, RecordID id);
+    void remove(const Column &key, RecordID rid);
+    // Of a composite index, with a value of each column.
+    void insert(const Columns &key, RecordID id);
+    void remove(const Columns &key, RecordID rid);
+    // Shorthands for INT keys.
     void insert(int key, bool isNull, RecordID id);
     void remove(int key, bool isNull, RecordID rid);
 
-    using Range = std::pair<int, int>;  // [first, second]
+    using BulkInsertFunc = std::function<void(const Columns &, RecordID)>;
+    // Fill a newly created index bottom-up with the entries that `source`
+    // passes to its argument, in any order. The entries are sorted in runs of
+    // `runSize` (spilled to disk if there are more) and packed into the nodes
+    // up to `fillFactor`.
+    void bulkLoad(std::function<void(const BulkInsertFunc &)> source,
+                  float fillFactor = INDEX_BULK_FILL_FACTOR,
+                  int runSize = INDEX_BULK_RUN_BYTES / sizeof(IndexEntry));
+    // Whether the index is still as created, thus can be bulk loaded.
+    bool canBulkLoad();
+
+    // Whether the nodes are sparse enough after removals to be vacuumed.
+    bool needsVacuum();
+    // Rebuild the tree from its entries, packed into the nodes up to
+    // `fillFactor`, into a new file, which then replaces the index file.
+    // Returns the number of pages freed.
+    int vacuum(float fillFactor = INDEX_BULK_FILL_FACTOR);
 
+    bool has(const Column &key);
+    bool has(const Columns &key);
     bool has(int key, bool isNull);
     void iterateEq(int key, bool isNull, IterateFunc func);
-    void iterateRange(Range, IterateFunc func);
+    // Iterate over the non-NULL entries whose keys are in the range.
+    void iterateRange(const Range &range, IterateFunc func);
+    void iterateRange(IntRange range, IterateFunc func);
+    // Also pass the keys, of getKeySize() bytes, to `func`.
+    void iterateRangeKeys(const Range &range, IterateKeyFunc func);
+    // Count the entries in the range, without touching the records.
+    int countRange(const Range &range);
+    int countRange(IntRange range);
+    std::vector<RecordID> findEq(const Column &key);
+    std::vector<RecordID> findEq(const Columns &key);
     std::vector<RecordID> findEq(int key, bool isNull);
     void setReadOnly();
 
+    bool isHash();
+    int getNumKeyColumn();
+    const KeyColumn &getKeyColumn(int column);
+    DataType getKeyType();
+    // Of the whole keys.
+    int getKeySize();
+    // Whether VARCHAR values of the column can be longer than their keys, in
+    // which case the records found by a key are only candidates of the value.
+    bool isTruncated(int column = 0);
+
+    // The key of a non-NULL value, or values of a composite index whose first
+    // one is not NULL.
+    Key encodeKey(const Column &value);
+    Key encodeKey(const Columns &values);
+    static Key encodeKey(const Column &value, DataType type, int keySize);
+    // The values of a key, a column of each key column. The VARCHAR values
+    // are only prefixes if the column is truncated.
+    void decodeKey(const char *key, Columns &values);
+    static int decodeIntKey(const Key &key);
+    static Key minKey(int keySize);
+    static Key maxKey(int keySize);
+    // The next (or previous) key, returns false if there is none.
+    static bool incrementKey(Key &key);
+    static bool decrementKey(Key &key);
+
 #ifndef TESTING
 private:
 #endif
     struct IndexMeta {
         uint16_t headCanary = INDEX_META_CANARY;
+        uint16_t version = INDEX_FORMAT_VERSION;
         int numNode;
         int numEntry;
         int firstFreeSlot;
         NodeIndex rootNode;
+        int keySize = sizeof(int);
+        int numKeyColumn = 1;
+        KeyColumn keyColumns[INDEX_MAX_KEY_COLUMNS];
         uint16_t tailCanary = INDEX_META_CANARY;
     };
 
     struct IndexEntry {
-        int key;
+        char key[INDEX_MAX_KEY_SIZE];
         bool isNull = false;
         RecordID record;
-
-        bool operator==(const IndexEntry &rhs) const;
-        bool operator>(const IndexEntry &rhs) const;
     };
 
     struct SharedNode {
         bool isLeaf;
         NodeIndex index;
-        IndexEntry entry[MAX_NUM_ENTRY_PER_NODE + 1];
         int numEntry;
-        int parent;
+        NodeIndex parent;
     };
 
-    struct LeafNode {
-        /* Keep first */
-        SharedNode shared;
+    // The offsets of the arrays in a node, following SharedNode, which depend
+    // on the key size:
+    // - prefixes: the first 4 bytes of the keys as int32, in the order of the
+    //   keys, so that they can be searched with SIMD;
+    // - records, then the NULL flags;
+    // - suffixes: the rest of the keys, if longer than 4 bytes;
+    // then the valid bitmap and the links of a leaf node, or the children of
+    // an inner node.
+    struct NodeLayout {
+        // The maximum number of entries, while one more can be held before
+        // the node is split.
+        int capacity;
+        int suffixSize;
+        int prefixes;
+        int records;
+        int nulls;
+        int suffixes;
+        int validBitmap;
+        int next;
+        int previous;
+        int children;
+        int numChildren;
 
-        int32_t validBitmap;
-        NodeIndex next;
-        NodeIndex previous;
+        void init(int keySize);
+    };
 
-        inline bool valid(int index) {
-            return (validBitmap & (1L << index)) != 0;
-        }
+    // A node loaded in the buffer pool.
+    struct Node {
+        SharedNode *shared;
+        int *prefixes;
+        RecordID *records;
+        bool *nulls;
+        char *suffixes;
+        int suffixSize;
+        // Of a leaf node. The entries are only marked invalid by the older
+        // versions, which removed them lazily.
+        uint64_t *validBitmap;
+        NodeIndex *next;
+        NodeIndex *previous;
+        // Of an inner node.
+        NodeIndex *children;
+        int *numChildren;
 
-        static_assert(sizeof(decltype(validBitmap)) * 8 >=
-                      MAX_NUM_ENTRY_PER_NODE);
+        inline bool valid(int index) const {
+            return (validBitmap[index / 64] & (1ULL << (index % 64))) != 0;
+        }
+        inline void setValid(int index, bool valid) {
+            if (valid) {
+                validBitmap[index / 64] |= (1ULL << (index % 64));
+            } else {
+                validBitmap[index / 64] &= ~(1ULL << (index % 64));
+            }
+        }
 
-        // TODO: Pointer to the next leaf node
+        IndexEntry getEntry(int i) const;
+        void setEntry(int i, const IndexEntry &entry);
+        // Compare the key of the non-NULL i-th entry with `key`.
+        int compareKey(int i, const char *key) const;
+        // Compare the i-th entry with `entry`, NULL entries come first.
+        int compare(int i, const IndexEntry &entry) const;
+        // Copy `count` entries of `src` from `srcIndex` to `index`, the ranges
+        // may overlap.
+        void moveEntries(int index, const Node &src, int srcIndex, int count);
+        // The position of the first entry not less than `entry`, or, for
+        // 4-byte keys, of the first one whose key is not less. The entries
+        // before it are all less than `entry`.
+        int lowerBound(const IndexEntry &entry) const;
     };
 
-    struct InnerNode {
-        static const int NULL_NODE = -1;
-
-        /* Keep first */
-        SharedNode shared;
+    static const NodeIndex NULL_NODE_INDEX = -1;
 
-        int children[MAX_NUM_CHILD_PER_NODE + 1];
-        int numChildren;
+    // Of a hash index, stored after IndexMeta. The table is hashed by
+    // extendible hashing: the directory maps the low `globalDepth` bits of
+    // the hashes of the keys to the buckets, which are chains of pages.
+    struct HashMeta {
+        int globalDepth;
+        int numDirectoryPage;
+        // The pages freed from the chains, linked by their `overflow`.
+        NodeIndex firstFreePage;
+        NodeIndex directoryPages[HASH_INDEX_MAX_DIRECTORY_PAGES];
     };
 
-    static const NodeIndex NULL_NODE_INDEX = -1;
+    // The header of a page of a bucket, followed by its entries, each of the
+    // key, the NULL flag and the record, sorted by the keys. The pages of a
+    // chain are full but the last one.
+    struct HashBucket {
+        int localDepth;
+        // In the first page, set once all the entries of the chain are found
+        // to have the same hash, so that a full chain is not walked again on
+        // each insert.
+        bool singleHash;
+        int numEntry;
+        NodeIndex overflow;
+        // The last page of the chain, in the first one.
+        NodeIndex last;
+    };
 
-    static_assert(sizeof(IndexMeta) <= PAGE_SIZE);
-    static_assert(sizeof(LeafNode) <= INDEX_SLOT_SIZE);
-    static_assert(sizeof(InnerNode) <= INDEX_SLOT_SIZE);
+    static_assert(sizeof(IndexMeta) + sizeof(HashMeta) <= PAGE_SIZE);
 
     FileDescriptor fd;
+    std::string path;
     IndexMeta meta;
+    NodeLayout layout;
 
     bool initialized = false;
     bool readOnly = false;
 
+    bool hashed = false;
+    HashMeta hashMeta;
+    // The bucket of each value of the low bits of the hashes.
+    std::vector<NodeIndex> directory;
+    int hashEntrySize;
+    int bucketCapacity;
+
     void flushMeta();
     void checkInit() noexcept(false);
+    void checkWritable() noexcept(false);
+    // Rebuild an index file written in an older format.
+    void migrate();
 
     // === Internal helper methods ===
 
+    // With a value of each column.
+    IndexEntry makeEntry(const Column *key, RecordID id);
+    IndexEntry makeEntry(const Key &key, RecordID id);
+    // Compare the entries, NULL entries come first.
+    int compare(const IndexEntry &lhs, const IndexEntry &rhs);
+
     std::tuple<NodeIndex, int, bool> findEntry(const IndexEntry &entry,
                                                bool skipInvalid);
-    // std::tuple<NodeIndex, int, bool> findLeftmostLeafNode(int key);
     NodeIndex createNewLeafNode(NodeIndex parent);
     NodeIndex createNewInnerNode(NodeIndex parent);
-    SharedNode *getNewNode(NodeIndex parent);
+    NodeIndex getNewNode(NodeIndex parent);
+
+    // Build the tree level by level from `numEntry` sorted entries.
+    void buildFromSorted(std::function<IndexEntry()> next, int numEntry,
+                         float fillFactor);
 
     // Insert the entry WITHOUT checking the constraints.
-    int insertEntry(SharedNode *sharedNode, const IndexEntry &entry);
+    int insertEntry(Node &node, const IndexEntry &entry);
     void checkOverflowFrom(NodeIndex index);
     inline PageHandle getHandle(NodeIndex index) {
-        int page = index / NUM_INDEX_SLOT;
-        return PF::getHandle(fd, page + 1);
-    }
-    template <typename T>
-    T load(NodeIndex index, PageHandle handle) {
-        char *ptr = PF::loadRaw<char *>(handle);
-        ptr += (index % NUM_INDEX_SLOT) * INDEX_SLOT_SIZE;
-        return (T)ptr;
+        return PF::getHandle(fd, index + 1);
     }
+    Node load(NodeIndex index, PageHandle handle);
+
+    // === Hash index methods ===
+
+    void initHashLayout();
+    static uint32_t hashKey(const char *key, int keySize);
+    IndexEntry getHashEntry(const char *page, int i);
+    void setHashEntry(char *page, int i, const IndexEntry &entry);
+    // A page for the chains, reusing the freed ones first.
+    NodeIndex newHashPage();
+    void freeHashPage(NodeIndex index);
+    // The position of the first entry of the page whose key is not less.
+    int hashLowerBound(const char *page, const char *key);
+    void hashInsertInto(char *page, const IndexEntry &entry);
+    void hashInsert(const IndexEntry &entry);
+    void hashRemove(const IndexEntry &entry);
+    void hashIterate(const char *key, IterateKeyFunc func);
+    // Whether all the entries of the bucket have the hash, thus cannot be
+    // split apart. Walks the whole chain, see `HashBucket::singleHash`.
+    bool hasSameHash(NodeIndex bucket, uint32_t hash);
+    // Split the bucket into two by one more bit of the hashes, doubling the
+    // directory first if needed.
+    void splitBucket(NodeIndex bucket);
+    // Write the entries into the chain from `first`, taking the pages from
+    // `spare` before new ones.
+    void writeBucket(NodeIndex first, int localDepth,
+                     const std::vector<IndexEntry> &entries,
+                     std::vector<NodeIndex> &spare);
 
 #if DEBUG
     void dump();
@@ -139,4 +337,4 @@ private:
 }  // namespace Internal
 }  // namespace SimpleDB
 
-#endif
\ No newline at end of file
+#endif
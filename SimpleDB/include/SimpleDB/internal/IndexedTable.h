@@ -1,6 +1,7 @@
 #ifndef _SIMPLEDB_INDEXED_TABLE_H
 #define _SIMPLEDB_INDEXED_TABLE_H
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -17,27 +18,130 @@ class IndexedTable : public QueryDataSource {
 public:
     using GetIndexFunc = std::function<std::shared_ptr<Index>(
         const std::string &table, const std::string &column)>;
-    IndexedTable(Table *table, GetIndexFunc getIndex);
+    // The indexes are got by their names, which are the names of their
+    // columns, see getIndexName. The composite ones must be listed.
+    IndexedTable(Table *table, GetIndexFunc getIndex,
+                 const std::vector<std::string> &compositeIndexes = {});
 
     virtual void iterate(IterateCallback callback) override;
     virtual std::vector<ColumnInfo> getColumnInfo() override;
     virtual bool acceptCondition(
         const CompareValueCondition &condition) override;
+    // Counted from the table metadata, or the index if all the conditions are
+    // taken by it.
+    virtual bool count(int &result) override;
+    // Only full scans can be run in parallel.
+    virtual int numMorsels() override;
+    virtual void iterateMorsel(int morsel, IterateCallback callback) override;
+    // Only full scans can be run in batches.
+    virtual bool iterateBatches(BatchCallback callback) override;
+    // If the index chosen covers all the columns needed, the records are
+    // made from its keys, without reading the table.
+    virtual void setNeededColumns(ColumnBitmap columns) override;
+
+    // Take the condition if it can be answered by an index on the column, or
+    // by the table itself if it is clustered or hashed by the column. The
+    // conditions are on the same index if possible: those on the leading
+    // columns of a composite index, by equality but the last, each taken
+    // after those on the previous columns. Hash indexes only take equality
+    // conditions. The conditions on other indexes are answered by
+    // intersecting the records found by them, see collapseRanges.
+    bool acceptIndexCondition(const CompareValueCondition &condition);
+    // Use the condition, which is checked by the caller, to skip pages in a
+    // full scan.
+    void addScanCondition(const CompareValueCondition &condition);
+    // The index scans expecting at least `numRecords` records are run as
+    // bitmap scans, in chunks of `chunkRecords` records, see
+    // INDEX_BITMAP_SCAN_MIN_RECORDS and INDEX_BITMAP_SCAN_CHUNK_RECORDS.
+    void setBitmapScanThreshold(
+        int numRecords, int chunkRecords = INDEX_BITMAP_SCAN_CHUNK_RECORDS);
+    // See INDEX_INTERSECTION_MIN_RECORDS and INDEX_INTERSECTION_MAX_RECORDS.
+    void setIntersectionBounds(int minRecords, int maxRecords);
 
     Table *getTable();
 
+    // The name of an index on the columns, in order.
+    static std::string getIndexName(const std::vector<std::string> &columns);
+    static std::vector<std::string> getIndexColumns(const std::string &name);
+
 #if !TESTING
 private:
 #endif
+    struct IndexCondition {
+        int columnIndex;
+        CompareValueCondition condition;
+        // Whether the condition is left to the caller.
+        bool checked;
+    };
+
+    // A way to answer the conditions with ranges of keys.
+    struct Candidate {
+        // Of the columns, in order, or null if the ranges are on the primary
+        // key of a clustered or memory table, thus answered by the table.
+        std::shared_ptr<Index> index;
+        std::vector<int> columns;
+    };
+
     Table *table;
     GetIndexFunc getIndex;
+    // The columns of the composite indexes, by their names.
+    std::map<std::string, std::vector<int>> compositeIndexes;
+    // The single-column indexes looked up, null if none.
+    std::map<int, std::shared_ptr<Index>> columnIndexes;
+    std::vector<IndexCondition> indexConditions;
+
+    ColumnBitmap neededColumns = COLUMN_BITMAP_ALL;
+    int bitmapScanThreshold = INDEX_BITMAP_SCAN_MIN_RECORDS;
+    int bitmapScanChunkRecords = INDEX_BITMAP_SCAN_CHUNK_RECORDS;
+    int intersectionMinRecords = INDEX_INTERSECTION_MIN_RECORDS;
+    int intersectionMaxRecords = INDEX_INTERSECTION_MAX_RECORDS;
+
+    // Chosen when the ranges are collapsed.
     std::shared_ptr<Index> index;
-    std::string columnName;
+    // The columns of the index.
+    std::vector<int> indexColumns;
+    bool keyScan = false;
     std::vector<Index::Range> ranges;
     bool emptySet = false;
+    bool collapsed = false;
+    // The ranges of another index, whose records are intersected with those
+    // found in the ranges of the chosen one.
+    struct Intersection {
+        std::shared_ptr<Index> index;
+        std::vector<Index::Range> ranges;
+    };
+    std::vector<Intersection> intersections;
+    // The records found by all of them, sorted by their locations, once
+    // found.
+    std::vector<RecordID> intersectedRecords;
+    bool intersected = false;
+    // The conditions taken but not answered exactly by the ranges, which are
+    // checked on the records found.
+    std::vector<ValueConditionFilter> residualFilters;
+    // The conditions not taken by the index, which are still checked by the
+    // caller, but can be used to skip pages in a full scan.
+    std::vector<CompareValueCondition> scanConditions;
 
-    Index::Range makeRange(const CompareValueCondition &condition);
+    bool canUseIndex(int columnIndex, CompareOp op);
+    std::vector<Candidate> getCandidates();
+    // Choose the candidate answering the conditions with the fewest records,
+    // i.e. on the most columns, and collapse its ranges. The other candidates
+    // with equality conditions are intersected with it if they answer more
+    // conditions, within the bounds of setIntersectionBounds.
     void collapseRanges();
+    const std::vector<RecordID> &getIntersectedRecords();
+    bool checkResidual(Columns &columns);
+    // Whether the needed columns, and those of the residual conditions, can
+    // be decoded from the keys of the index chosen.
+    bool isIndexOnly();
+    // Whether the ranges hold at least bitmapScanThreshold records, which are
+    // only counted up to it.
+    bool expectsManyRecords();
+    // Find the records in the ranges a chunk at a time, sort each chunk by
+    // their locations, then fetch them, so that the pages of a chunk are read
+    // once and in the order of the file, instead of jumping between them in
+    // the order of the keys. Only the intersected records are fetched.
+    void bitmapScan(IterateCallback callback);
 };
 
 }  // namespace Internal
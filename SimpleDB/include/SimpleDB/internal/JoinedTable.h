@@ -20,6 +20,14 @@ public:
     virtual std::vector<ColumnInfo> getColumnInfo() override;
     virtual bool acceptCondition(
         const CompareValueCondition &condition) override;
+    // The size of the cross product, if all the tables can be counted.
+    virtual bool count(int &result) override;
+    // Only a single table can be scanned in parallel or in batches.
+    virtual int numMorsels() override;
+    virtual void iterateMorsel(int morsel, IterateCallback callback) override;
+    virtual bool iterateBatches(BatchCallback callback) override;
+    // Only passed to a single table.
+    virtual void setNeededColumns(ColumnBitmap columns) override;
 
 private:
     std::vector<std::shared_ptr<IndexedTable>> tables;
@@ -50,6 +50,18 @@ public:
         return tail->next->data;
     }
 
+    // Find the element nearest to the tail that satisfies `pred`, nullptr if
+    // there is none.
+    template <typename Pred>
+    T *findFromTail(Pred pred) {
+        for (Node *node = tail->next; node != nullptr; node = node->next) {
+            if (pred(node->data)) {
+                return node->data;
+            }
+        }
+        return nullptr;
+    }
+
     T *remove(Node *node) {
         node->prev->next = node->next;
         if (node != head) {
@@ -20,21 +20,41 @@ const int MAX_DATABASE_NAME_LEN = MAX_VARCHAR_LEN;
 const int MAX_FOREIGN_KEYS = 12;
 
 const int MAX_SLOT_PER_PAGE = 64;
+// Number of entries in the page handle cache of each table, a power of 2.
+const int PAGE_HANDLE_CACHE_SIZE = 256;
+static_assert((PAGE_HANDLE_CACHE_SIZE & (PAGE_HANDLE_CACHE_SIZE - 1)) == 0);
 const int16_t COLUMN_BITMAP_ALL = ~0;
 static_assert(MAX_SLOT_PER_PAGE < NUM_BUFFER_PAGE);
 
-const uint16_t TABLE_META_CANARY = 0xDDBB;
+// Changed with the table file format, see also TABLE_FORMAT_VERSION.
+const uint16_t TABLE_META_CANARY = 0xDDC3;
+// Table files written before the format was versioned have the canaries from
+// this one (version 0) to 0xDDC2 (version 7), one for each version.
+const uint16_t LEGACY_TABLE_META_CANARY = 0xDDBB;
+// 0: free list in page metadata. 1: free-space map. 2: zone maps. 3: record
+// count. 4: dictionary-encoded columns. 5: PAX layout. 6: clustered tables.
+// 7: memory tables. 8: versioned metadata.
+const uint16_t TABLE_FORMAT_VERSION = 8;
 const uint16_t PAGE_META_CANARY = 0xDBDB;
-const uint16_t INDEX_META_CANARY = 0xDADA;
+// Of the directory saved past the data pages of a clustered table.
+const uint16_t CLUSTER_DIRECTORY_CANARY = 0xDBDC;
+// Changed with the index file format, see also INDEX_FORMAT_VERSION.
+const uint16_t INDEX_META_CANARY = 0xDADB;
+// Index files written before the format was versioned (424-byte node slots).
+const uint16_t LEGACY_INDEX_META_CANARY = 0xDADA;
+// 1: a node per page. 2: node entries stored as separate arrays. 3: keys of
+// any type, encoded as byte strings. 4: keys of multiple columns.
+const uint16_t INDEX_FORMAT_VERSION = 4;
 const uint16_t EMPTY_INDEX_PAGE_CANARY = 0xDCDC;
+// Of hash indexes, in the same format version.
+const uint16_t HASH_INDEX_META_CANARY = 0xDAEB;
 
-const int INDEX_SLOT_SIZE = 424;
-const int NUM_INDEX_SLOT = 18;
-const int MAX_NUM_CHILD_PER_NODE = 20;
+// Each index node takes a whole page.
+const int INDEX_NODE_SIZE = PAGE_SIZE;
+const int MAX_NUM_CHILD_PER_NODE = 400;
 const int MIN_NUM_CHILD_PER_NODE = (MAX_NUM_CHILD_PER_NODE + 1) / 2;
 const int MAX_NUM_ENTRY_PER_NODE = MAX_NUM_CHILD_PER_NODE - 1;
 const int MIN_NUM_ENTRY_PER_NODE = MIN_NUM_CHILD_PER_NODE - 1;
-static_assert(NUM_INDEX_SLOT * INDEX_SLOT_SIZE <= PAGE_SIZE);
 static_assert(MAX_NUM_CHILD_PER_NODE + MAX_NUM_ENTRY_PER_NODE + 3 <=
               NUM_BUFFER_PAGE);
 
@@ -42,6 +62,55 @@ const float EQUAL_PRECISION = std::numeric_limits<float>::epsilon();
 
 // ==== Index ====
 const int INDEX_SIZE = 4;
+// Longer VARCHAR values are indexed by their prefixes.
+const int INDEX_MAX_KEY_SIZE = 64;
+// Number of columns of a composite index.
+const int INDEX_MAX_KEY_COLUMNS = 8;
+// Bulk loading packs the nodes up to this fraction of their capacity, leaving
+// room for later inserts.
+const float INDEX_BULK_FILL_FACTOR = 0.9F;
+// Bytes of entries sorted in memory at a time when bulk loading, beyond which
+// the sorted runs are spilled next to the index file and merged.
+const int INDEX_BULK_RUN_BYTES = 64 << 20;
+// An index is vacuumed after the records are deleted or updated once its
+// nodes hold fewer entries than this fraction of their capacity on average.
+const float INDEX_VACUUM_FILL_RATIO = 0.25F;
+// Index scans expecting at least this many records find them all first, then
+// fetch them from the table in the order of their locations (bitmap scans).
+const int INDEX_BITMAP_SCAN_MIN_RECORDS = 64;
+// The records of a bitmap scan are found, sorted and fetched in chunks of this
+// many, so that a scan stopped early, e.g. by a LIMIT, reads at most a chunk
+// of them past the last one taken.
+const int INDEX_BITMAP_SCAN_CHUNK_RECORDS = 4096;
+// The records found by another index are intersected with those found by the
+// chosen one only if the chosen one finds at least the minimum, which are
+// cheaper to check than to intersect otherwise, and the other one finds fewer
+// than the maximum, which are all held in memory.
+const int INDEX_INTERSECTION_MIN_RECORDS = 64;
+const int INDEX_INTERSECTION_MAX_RECORDS = 1 << 16;
+// The directory of a hash index is listed in its metadata page, which limits
+// its pages, thus the number of bits of the hashes it takes. The buckets are
+// chained once it is full.
+const int HASH_INDEX_MAX_DIRECTORY_PAGES = 512;
+const int HASH_INDEX_MAX_DEPTH = 20;
+static_assert((1 << HASH_INDEX_MAX_DEPTH) <=
+              HASH_INDEX_MAX_DIRECTORY_PAGES * (PAGE_SIZE / sizeof(int)));
+
+// ==== Query ====
+// Number of pages in a morsel, the unit of work of a parallel scan.
+const int PARALLEL_SCAN_MORSEL_PAGES = 16;
+// Only the scans of at least this many morsels are run in parallel, the
+// smaller ones are not worth starting the threads.
+const int PARALLEL_SCAN_MIN_MORSELS = 4;
+
+// ==== DBMS ====
+// Number of rows inserted in a batch when loading data from a file.
+const int LOAD_DATA_BATCH_SIZE = 4096;
+// Number of records moved by VACUUM before the indexes are updated and the
+// file is truncated.
+const int VACUUM_BATCH_SIZE = 1024;
+// Number of buckets in the histograms collected by ANALYZE TABLE.
+const int STATISTICS_HISTOGRAM_BUCKETS = 16;
 
 }  // namespace Internal
 }  // namespace SimpleDB
@@ -0,0 +1,94 @@
+#ifndef _SIMPLEDB_MEMORY_TABLE_H
+#define _SIMPLEDB_MEMORY_TABLE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "internal/Column.h"
+#include "internal/Table.h"
+
+namespace SimpleDB {
+namespace Internal {
+
+// A MemoryTable only stores its metadata in the file, while the records are
+// kept in memory, hashed by the primary key, and lost once the table is
+// closed. The records are identified by their rows.
+class MemoryTable : public Table {
+public:
+    MemoryTable() = default;
+
+    static constexpr int MEMORY_RECORD_PAGE = -3;
+
+    // The file must be created by `MemoryTable::create()`. No record is read
+    // from it.
+    virtual void open(const std::string &file,
+                      MoveCallback onMove = nullptr) noexcept(false) override;
+    // A memory table has no pages, thus can neither be in the PAX layout nor
+    // be clustered, and `zoneMap` is ignored.
+    virtual void create(const std::string &file, const std::string &name,
+                        const std::vector<ColumnMeta> &columns,
+                        const std::string &primaryKey = {},
+                        const std::vector<ForeignKey> &foreignKeys = {},
+                        bool zoneMap = false, bool pax = false,
+                        bool clustered = false) noexcept(false) override;
+
+    using Table::get;
+    virtual void get(RecordID id, Columns &columns,
+                     ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL) override;
+    // The records are written to the freed rows first, `stream` is ignored.
+    virtual RecordID insert(const Columns &values,
+                            ColumnBitmap bitmap = COLUMN_BITMAP_ALL,
+                            int stream = 0) override;
+    virtual std::vector<RecordID> insertBatch(
+        const std::vector<Columns> &rows,
+        ColumnBitmap bitmap = COLUMN_BITMAP_ALL) override;
+    virtual void update(RecordID id, const Columns &columns,
+                        ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL) override;
+    virtual void remove(RecordID id) override;
+
+    // Move at most `maxMoves` records from the last rows to the freed rows
+    // before them, then release the freed rows at the end. No page is freed.
+    virtual CompactResult compact(int maxMoves,
+                                  MoveCallback callback) override;
+
+    // Point lookups (`low == high`) are answered by the hash of the keys.
+    virtual void iterateRange(int low, int high,
+                              IterateCallback callback) override;
+    // Find the record by the primary key, returns NULL_RECORD if not found.
+    RecordID findKey(int key);
+
+    virtual void setPrimaryKey(const std::string &field) override;
+    virtual void dropPrimaryKey(const std::string &field) override;
+
+    virtual void close() override;
+
+    // The records are iterated in the order of the rows. A memory table has
+    // neither zone maps nor dictionaries, thus the conditions are not used.
+    using Table::iterate;
+    virtual void iterate(
+        IterateCallback callback,
+        const std::vector<CompareValueCondition> &conditions) override;
+
+#if !TESTING
+private:
+#endif
+    // Each row is laid out as a record in the row layout, i.e. the record
+    // meta followed by the columns. Freed rows are reused by the following
+    // inserts.
+    std::vector<char> rows;
+    std::vector<bool> rowOccupied;
+    std::vector<int> freeRows;
+    // The row of each primary key.
+    std::unordered_map<int, int> keys;
+
+    int rowSize();
+    char *rowData(int row);
+    void clearRows();
+    void validateRow(RecordID id);
+};
+
+}  // namespace Internal
+}  // namespace SimpleDB
+
+#endif
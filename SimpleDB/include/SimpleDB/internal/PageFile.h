@@ -23,6 +23,10 @@ inline void remove(const std::string &fileName) {
     FileCoordinator::shared.deleteFile(fileName);
 }
 
+inline void truncate(FileDescriptor fd, int numPages) {
+    FileCoordinator::shared.truncateFile(fd, numPages);
+}
+
 inline PageHandle getHandle(FileDescriptor fd, int page) {
     return FileCoordinator::shared.getHandle(fd, page);
 }
@@ -49,6 +53,10 @@ inline void markDirty(const PageHandle &handle) {
     FileCoordinator::shared.markDirty(handle);
 }
 
+inline void read(FileDescriptor fd, int page, char *dest) {
+    FileCoordinator::shared.readPage(fd, page, dest);
+}
+
 inline PageHandle renew(const PageHandle &handle) {
     return FileCoordinator::shared.renew(handle);
 }
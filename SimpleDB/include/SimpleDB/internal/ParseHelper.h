@@ -4,10 +4,13 @@
 #include <SQLParser/SqlParser.h>
 
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 
 #include "Error.h"
+#include "internal/CSVReader.h"
 #include "internal/Column.h"
 #include "internal/Macros.h"
 #include "internal/QueryFilter.h"
@@ -78,6 +81,58 @@ public:
         std::strcpy(dest, value.substr(1, value.size() - 2).c_str());
     }
 
+    static std::string parseString(const std::string &value) {
+        // Strip the quotes.
+        return value.substr(1, value.size() - 2);
+    }
+
+    // Parse a field of a CSV file according to the column definition. An
+    // unquoted NULL, or an empty unquoted field of a numeric column, is null.
+    static Column parseCSVField(const CSVReader::Field &field,
+                                const ColumnMeta &columnMeta) {
+        const std::string &value = field.value;
+        bool isNull =
+            !field.quoted && (value == "NULL" ||
+                              (value.empty() && columnMeta.type != VARCHAR));
+        if (isNull) {
+            if (!columnMeta.nullable) {
+                throw Error::IncompatableValueError(
+                    "NULL given for NOT NULL column " +
+                    std::string(columnMeta.name));
+            }
+            return Column::nullColumn(columnMeta.type, columnMeta.size);
+        }
+
+        char *end = nullptr;
+        errno = 0;
+        switch (columnMeta.type) {
+            case INT: {
+                long intValue = std::strtol(value.c_str(), &end, 10);
+                if (*end != '\0' || errno != 0 || intValue > INT32_MAX ||
+                    intValue < INT32_MIN) {
+                    throw Error::IncompatableValueError(
+                        "Invalid integer value " + value);
+                }
+                return Column(int(intValue));
+            }
+            case FLOAT: {
+                float floatValue = std::strtof(value.c_str(), &end);
+                if (*end != '\0' || errno != 0) {
+                    throw Error::IncompatableValueError(
+                        "Invalid float value " + value);
+                }
+                return Column(floatValue);
+            }
+            case VARCHAR:
+                if (value.size() > columnMeta.size) {
+                    throw Error::IncompatableValueError("VARCHAR too long");
+                }
+                return Column(value.c_str(), columnMeta.size);
+        }
+        assert(false);
+        return Column();
+    }
+
     static CompareOp parseCompareOp(const std::string &op) {
         if (op == "=") {
             return EQ;
@@ -104,9 +159,12 @@ public:
             column.data.floatValue = parseFloat(ctx->Float()->getText());
             column.type = FLOAT;
         } else if (ctx->String() != nullptr) {
+            ColumnValue value;
             parseString(ctx->String()->getText(), MAX_VARCHAR_LEN,
-                        column.data.stringValue);
+                        value.stringValue);
             column.type = VARCHAR;
+            column.setString(value.stringValue,
+                             std::strlen(value.stringValue));
         } else if (ctx->Null() != nullptr) {
             column.isNull = true;
             // The data type is unknown here, must be set outside.
@@ -114,6 +172,19 @@ public:
         return column;
     }
 
+    // Parse a value into the fixed-size form used by conditions.
+    static ColumnValue parseConditionValue(
+        SQLParser::SqlParser::ValueContext *ctx) {
+        Column column = parseColumnValue(ctx);
+        ColumnValue value;
+        if (column.type == VARCHAR) {
+            std::strcpy(value.stringValue, column.raw());
+        } else {
+            value.intValue = column.data.intValue;
+        }
+        return value;
+    }
+
     // static CompareValueCondition parseCompareValueCondition(
     //     const std::string &columnName, const std::string operator_,
     //     SQLParser::SqlParser::ValueContext *ctx) {
@@ -58,6 +58,8 @@ public:
         SQLParser::SqlParser::Alter_drop_indexContext *ctx) override;
     virtual antlrcpp::Any visitShow_indexes(
         SQLParser::SqlParser::Show_indexesContext *ctx) override;
+    virtual antlrcpp::Any visitShow_stats(
+        SQLParser::SqlParser::Show_statsContext *ctx) override;
 
     virtual antlrcpp::Any visitWhere_and_clause(
         SQLParser::SqlParser::Where_and_clauseContext *ctx) override;
@@ -76,6 +78,12 @@ public:
         SQLParser::SqlParser::Update_tableContext *ctx) override;
     virtual antlrcpp::Any visitDelete_from_table(
         SQLParser::SqlParser::Delete_from_tableContext *ctx) override;
+    virtual antlrcpp::Any visitLoad_data(
+        SQLParser::SqlParser::Load_dataContext *ctx) override;
+    virtual antlrcpp::Any visitVacuum_table(
+        SQLParser::SqlParser::Vacuum_tableContext *ctx) override;
+    virtual antlrcpp::Any visitAnalyze_table(
+        SQLParser::SqlParser::Analyze_tableContext *ctx) override;
 
 private:
     DBMS *dbms;
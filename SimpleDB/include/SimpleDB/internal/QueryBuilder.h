@@ -38,6 +38,9 @@ public:
     QueryBuilder &select(const ColumnId &id);
     QueryBuilder &limit(int count);
     QueryBuilder &offset(int offset);
+    // Scan the data source with up to `numThreads` threads, if it supports
+    // parallel scans.
+    QueryBuilder &parallel(int numThreads);
 
     [[nodiscard]] Result execute();
 
@@ -60,9 +63,21 @@ private:
     std::shared_ptr<QueryDataSource> dataSourceSharedPtr;
     bool isRaw;
     VirtualTable virtualTable;
+    int numThreads = 1;
 
     void checkDataSource();
+    // Whether the query is a COUNT(*) without any filter left.
+    bool isCountStarOnly() const;
+    // Run the filters on the morsels of the data source by a pool of workers.
+    // Returns false if the data source cannot be scanned in parallel.
+    bool iterateParallel(IterateCallback callback);
+    // Run the filters on the batches of the data source, for an aggregation
+    // with only null conditions and value conditions on INT/FLOAT columns.
+    // Returns false if the query or the data source does not support it.
+    bool aggregateBatches(IterateCallback callback);
     AggregatedFilter aggregateAllFilters();
+    // The columns read by the built filters, or passed on by the builder.
+    ColumnBitmap getNeededColumns() const;
 };
 
 }  // namespace Internal
@@ -1,6 +1,8 @@
 #ifndef _SIMPLEDB_QUERY_DATASOURCE_H
 #define _SIMPLEDB_QUERY_DATASOURCE_H
 
+#include <stdint.h>
+
 #include <functional>
 #include <vector>
 
@@ -9,9 +11,38 @@
 namespace SimpleDB {
 namespace Internal {
 
+// A batch of records stored column by column, e.g. the records in a data page
+// of a PAX table. Record i is in the batch if bit i of `mask` is set.
+struct RecordBatch {
+    using Mask = uint64_t;
+    struct Vector {
+        // The value of record i is at `data + i * stride`, possibly unaligned.
+        // A dictionary-encoded VARCHAR column holds the codes.
+        const char *data;
+        int stride;
+    };
+
+    int size = 0;
+    Mask mask = 0;
+    // The null bitmap of each record.
+    const ColumnBitmap *nullBitmaps = nullptr;
+    Vector columns[MAX_COLUMNS];
+
+    // The records whose value of the column is not null.
+    Mask nonNull(int column) const {
+        Mask result = 0;
+        for (int i = 0; i < size; i++) {
+            result |= Mask(((nullBitmaps[i] >> column) & 1) == 0) << i;
+        }
+        return result;
+    }
+};
+static_assert(MAX_SLOT_PER_PAGE <= sizeof(RecordBatch::Mask) * 8);
+
 class QueryDataSource {
 public:
     using IterateCallback = std::function<bool(RecordID, Columns &columns)>;
+    using BatchCallback = std::function<bool(const RecordBatch &batch)>;
     virtual ~QueryDataSource() = default;
     virtual void iterate(IterateCallback callback) = 0;
     virtual std::vector<ColumnInfo> getColumnInfo() = 0;
@@ -19,6 +50,21 @@ public:
         const struct CompareValueCondition &condition) {
         return false;
     }
+    // Count the records without iterating over them, if the data source knows
+    // it. Returns false if not supported.
+    virtual bool count(int &result) { return false; }
+    // The number of morsels, i.e. disjoint parts of the records in order,
+    // which can be iterated by multiple threads at the same time. Returns 0 if
+    // parallel scans are not supported.
+    virtual int numMorsels() { return 0; }
+    virtual void iterateMorsel(int morsel, IterateCallback callback) {}
+    // Iterate over the records in batches, if the data source stores them
+    // column by column. Returns false without calling the callback if not
+    // supported.
+    virtual bool iterateBatches(BatchCallback callback) { return false; }
+    // Called before iterating with the columns read by the caller, by their
+    // positions in getColumnInfo(). The others may hold any value.
+    virtual void setNeededColumns(ColumnBitmap columns) {}
 };
 
 }  // namespace Internal
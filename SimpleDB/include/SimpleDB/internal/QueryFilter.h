@@ -8,6 +8,7 @@
 #include <utility>
 #include <vector>
 
+#include "internal/QueryDataSource.h"
 #include "internal/Table.h"
 
 namespace SimpleDB {
@@ -121,6 +122,10 @@ struct ValueConditionFilter : public BaseFilter {
     ~ValueConditionFilter() = default;
     virtual void build() override;
     virtual std::pair<bool, bool> apply(Columns &columns) override;
+    // Select the records in `mask` that satisfy the condition. Only INT and
+    // FLOAT columns are supported.
+    RecordBatch::Mask applyBatch(const RecordBatch &batch,
+                                 RecordBatch::Mask mask);
     CompareValueCondition condition;
     VirtualTable *table;
     int columnIndex;
@@ -131,6 +136,8 @@ struct NullConditionFilter : public BaseFilter {
     ~NullConditionFilter() = default;
     virtual void build() override;
     virtual std::pair<bool, bool> apply(Columns &columns) override;
+    RecordBatch::Mask applyBatch(const RecordBatch &batch,
+                                 RecordBatch::Mask mask);
     CompareNullCondition condition;
     VirtualTable *table;
     int columnIndex;
@@ -173,10 +180,16 @@ struct SelectFilter : public BaseFilter {
     virtual std::pair<bool, bool> apply(Columns &columns) override;
     void build() override;
     virtual bool finalize(Columns &columns) override;
+    // Merge the aggregation contexts of another filter with the same
+    // selectors, e.g. of a worker in a parallel scan.
+    void merge(const SelectFilter &other);
+    // Aggregate the records in `mask`. Only aggregated selectors are
+    // supported.
+    void applyBatch(const RecordBatch &batch, RecordBatch::Mask mask);
     std::vector<QuerySelector> selectors;
     std::vector<int> selectIndexes;
     std::vector<Context> selectContexts;
-    bool isAggregated;
+    bool isAggregated = false;
     VirtualTable *table;
 };
 
@@ -0,0 +1,72 @@
+#ifndef _SIMPLEDB_STATISTICS_H
+#define _SIMPLEDB_STATISTICS_H
+
+#include <stdint.h>
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "internal/Column.h"
+
+namespace SimpleDB {
+namespace Internal {
+
+// Statistics of a column, as computed by ANALYZE TABLE.
+struct ColumnStatistics {
+    DataType type = INT;
+    int rowCount = 0;
+    int nullCount = 0;
+    // Null columns if there is no non-null value.
+    Column min, max;
+    // The estimated number of distinct non-null values.
+    int ndv = 0;
+    // The upper bounds of the equi-depth buckets, which hold (almost) the same
+    // number of values. Only collected for INT and FLOAT columns.
+    std::vector<double> histogram;
+
+    float nullFraction() const {
+        return rowCount == 0 ? 0 : float(nullCount) / rowCount;
+    }
+
+    static std::string valueDesc(const Column &column);
+    std::string histogramDesc() const;
+};
+
+// Collect the statistics of a column in a single pass over the values.
+class ColumnStatisticsCollector {
+public:
+    ColumnStatisticsCollector(DataType type, int numBuckets);
+
+    void add(const Column &column);
+    ColumnStatistics finish();
+
+#if !TESTING
+private:
+#endif
+    // The NDV is estimated with a K-minimum-values sketch: it keeps the K
+    // smallest distinct hashes, which is exact below K distinct values.
+    static const int NDV_SKETCH_SIZE = 1024;
+    // The histogram is built from a uniform sample of the values, kept by
+    // reservoir sampling, so that the memory used is bounded.
+    static const int HISTOGRAM_SAMPLE_SIZE = 16384;
+
+    DataType type;
+    int numBuckets;
+    ColumnStatistics stats;
+    std::set<uint64_t> minHashes;
+    // The reservoir of the sampled values.
+    std::vector<double> values;
+    // Fixed seed, so that ANALYZE is repeatable.
+    std::mt19937_64 random{0};
+
+    static uint64_t hash(const Column &column);
+    // Returns negative if lhs < rhs, 0 if equal, positive otherwise.
+    static int compare(const Column &lhs, const Column &rhs);
+};
+
+}  // namespace Internal
+}  // namespace SimpleDB
+
+#endif
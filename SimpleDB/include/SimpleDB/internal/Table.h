@@ -3,8 +3,11 @@
 
 #include <stdint.h>
 
+#include <functional>
+#include <limits>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -18,6 +21,8 @@ class DBMS;
 
 namespace Internal {
 
+struct CompareValueCondition;
+
 struct ForeignKey {
     std::string name;
     std::string table;
@@ -34,13 +39,18 @@ struct ColumnMeta {
     bool hasDefault;
     ColumnValue defaultValue;
 
+    // A dictionary-encoded VARCHAR column stores the code of its value in the
+    // dictionary of the table, instead of the whole string.
+    bool dictionary = false;
+
     std::string typeDesc() const;
     std::string defaultValDesc() const;
 };
 
 // A Table holds the metadata of a certain table, which should be unique
 // thourghout the program, and be stored in memory once created for the sake of
-// metadata reading/writing performance.
+// metadata reading/writing performance. The records are stored in the data
+// pages of the file, see `MemoryTable` for the tables kept in memory.
 class Table : public QueryDataSource {
     friend class QueryBuilder;
     friend class ::SimpleDB::DBMS;
@@ -49,54 +59,130 @@ class Table : public QueryDataSource {
 public:
     // The metadata is not initialized in this constructor.
     Table() = default;
-    ~Table();
+    virtual ~Table();
 
-    // Open the table from a file, which must be created by `create()` before.
-    void open(const std::string &file) noexcept(false);
+    // Called for each record moved by `compact()` or an upgrade, with its old
+    // and new location and its columns.
+    using MoveCallback = std::function<void(RecordID from, RecordID to,
+                                            const Columns &columns)>;
 
-    // Create a new table in a file.
-    void create(
-        const std::string &file, const std::string &name,
-        const std::vector<ColumnMeta> &columns,
-        const std::string &primaryKey = {},
-        const std::vector<ForeignKey> &foreignKeys = {}) noexcept(false);
+    // Open the table from a file, which must be created by `create()` before.
+    // A file written in an older format is upgraded in place, moving the
+    // records in the way of the pages added since, which are passed to
+    // `onMove`.
+    virtual void open(const std::string &file,
+                      MoveCallback onMove = nullptr) noexcept(false);
+
+    // Create a new table in a file. With `zoneMap`, each data page keeps the
+    // range of the values of its INT/FLOAT columns, which allows scans with
+    // conditions to skip pages. With `pax`, each data page stores the values
+    // of a column contiguously (PAX layout) instead of record by record, which
+    // allows the records to be iterated in batches. With `clustered`, the
+    // records are kept ordered by the primary key, each data page holding a
+    // range of the keys.
+    virtual void create(const std::string &file, const std::string &name,
+                        const std::vector<ColumnMeta> &columns,
+                        const std::string &primaryKey = {},
+                        const std::vector<ForeignKey> &foreignKeys = {},
+                        bool zoneMap = false, bool pax = false,
+                        bool clustered = false) noexcept(false);
 
     // Get record.
     [[nodiscard]] Columns get(RecordID id,
                               ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL);
-    void get(RecordID id, Columns &columns,
-             ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL);
-
-    // Insert record, returns (page, slot) of the inserted record.
-    RecordID insert(const Columns &values,
-                    ColumnBitmap bitmap = COLUMN_BITMAP_ALL);
+    virtual void get(RecordID id, Columns &columns,
+                     ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL);
+
+    // Insert record, returns (page, slot) of the inserted record, or the key
+    // of the record in a clustered table (see `clusterRecord()`). Inserts of
+    // a non-zero `stream` (e.g. one per writer) start looking for a free page
+    // at a page chosen by the stream, so that different streams fill
+    // different non-full pages instead of all filling the lowest one.
+    virtual RecordID insert(const Columns &values,
+                            ColumnBitmap bitmap = COLUMN_BITMAP_ALL,
+                            int stream = 0);
+
+    // Insert records in a batch, returns (page, slot) of each inserted record
+    // in order. Slots are allocated a page at a time, so that each touched page
+    // is loaded and marked dirty only once.
+    virtual std::vector<RecordID> insertBatch(
+        const std::vector<Columns> &rows,
+        ColumnBitmap bitmap = COLUMN_BITMAP_ALL);
 
     // Update record.
-    void update(RecordID id, const Columns &columns,
-                ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL);
+    virtual void update(RecordID id, const Columns &columns,
+                        ColumnBitmap columnBitmap = COLUMN_BITMAP_ALL);
 
     // Remove record.
-    void remove(RecordID id);
+    virtual void remove(RecordID id);
+
+    struct CompactResult {
+        int numMovedRecords = 0;
+        int numFreedPages = 0;
+        // Whether the table is fully compacted.
+        bool done = false;
+    };
+
+    // Move at most `maxMoves` records from the last pages to the empty slots
+    // of the leading pages, then release the empty pages at the end of the
+    // file. Call it repeatedly until `done` to compact the whole table. A
+    // clustered table is never compacted, as its pages hold key ranges.
+    virtual CompactResult compact(int maxMoves, MoveCallback callback);
+
+    // The records of a clustered table are moved between pages by splits,
+    // thus identified by their keys instead of their locations.
+    static constexpr int CLUSTER_RECORD_PAGE = -2;
+    static RecordID clusterRecord(int key) {
+        return {CLUSTER_RECORD_PAGE, key};
+    }
+
+    // Iterate over the records of a clustered table whose keys are in
+    // [low, high], in the order of the keys.
+    virtual void iterateRange(int low, int high, IterateCallback callback);
 
     // Set primary key.
-    void setPrimaryKey(const std::string &field);
-    void dropPrimaryKey(const std::string &field);
+    virtual void setPrimaryKey(const std::string &field);
+    virtual void dropPrimaryKey(const std::string &field);
 
-    void close();
+    virtual void close();
 
     int getColumnIndex(const char *name) const;
     std::string getColumnName(int index) const;
 
     // QueryDataSource requirements.
     virtual void iterate(IterateCallback callback) override;
+    // Iterate over the records, skipping the pages in which no record can
+    // satisfy all the `conditions` according to the zone maps, and the records
+    // whose dictionary codes do not match. The records iterated are NOT
+    // guaranteed to satisfy the conditions.
+    virtual void iterate(IterateCallback callback,
+                         const std::vector<CompareValueCondition> &conditions);
     virtual std::vector<ColumnInfo> getColumnInfo() override;
+    // The exact number of records, maintained by the writes.
+    virtual bool count(int &result) override;
+
+    // The data pages are split into morsels of PARALLEL_SCAN_MORSEL_PAGES
+    // pages. Different morsels can be iterated by multiple threads at the same
+    // time, as long as the table is not modified meanwhile.
+    virtual int numMorsels() override;
+    virtual void iterateMorsel(int morsel, IterateCallback callback) override;
+    void iterateMorsel(int morsel, IterateCallback callback,
+                       const std::vector<CompareValueCondition> &conditions);
+
+    // Only supported by the tables in the PAX layout, each batch being the
+    // records in a data page. Pages and records are skipped as `iterate()`
+    // does.
+    virtual bool iterateBatches(BatchCallback callback) override;
+    bool iterateBatches(BatchCallback callback,
+                        const std::vector<CompareValueCondition> &conditions);
 
 #if !TESTING
-private:
+protected:
 #endif
     struct TableMeta {
         // Keep first.
         uint16_t headCanary = TABLE_META_CANARY;
+        uint16_t version = TABLE_FORMAT_VERSION;
 
         char name[MAX_TABLE_NAME_LEN + 1];
 
@@ -105,8 +191,15 @@ private:
         int primaryKeyIndex;
         ForeignKey foreignKeys[MAX_FOREIGN_KEYS];
         uint16_t numUsedPages;
-        uint16_t firstFree;
+        int numRecords;
         int recordSize;
+        bool hasZoneMap;
+        bool pax;
+        bool clustered;
+        // The records are kept by a `MemoryTable` instead of the data pages.
+        bool memory;
+        // Number of bytes used in the dictionary page.
+        int dictionarySize;
 
         // Keep last.
         uint16_t tailCanary = TABLE_META_CANARY;
@@ -121,7 +214,9 @@ private:
 
         static_assert(sizeof(BitmapType) * 8 >= MAX_SLOT_PER_PAGE);
 
-        uint16_t nextFree;
+        // The smallest key that the page holds in a clustered table, the
+        // largest being bounded by the next page in key order.
+        int32_t lowKey = std::numeric_limits<int32_t>::min();
 
         // Keep last.
         uint16_t tailCanary = PAGE_META_CANARY;
@@ -131,39 +226,239 @@ private:
     static_assert(sizeof(TableMeta) < PAGE_SIZE);
     static_assert(sizeof(PageMeta) < PAGE_SIZE);
 
+    // The free space map is a bitmap in a dedicated page, where a set bit
+    // indicates that the page has at least one empty slot. One page is enough
+    // to cover all the pages addressable by `numUsedPages`.
+    using FreeSpaceMapWord = uint64_t;
+    static constexpr int FREE_SPACE_MAP_PAGE = 1;
+    // The dictionary page holds the values of all the dictionary-encoded
+    // columns, each entry being the column index, the length and the string.
+    // The codes of a column are assigned by the order of its entries.
+    static constexpr int DICTIONARY_PAGE = 2;
+    static constexpr int FIRST_DATA_PAGE = 3;
+    using PageCountType = decltype(TableMeta::numUsedPages);
+    static_assert(PAGE_SIZE * 8 > std::numeric_limits<PageCountType>::max());
+
+    // The directory of a clustered table is saved on close in the pages past
+    // the used ones, as this header followed by the entries in key order. It
+    // is only trusted on open if no page has been added since, as the first
+    // new page would overwrite the header.
+    struct ClusterDirectoryHeader {
+        uint16_t canary = CLUSTER_DIRECTORY_CANARY;
+        PageCountType numUsedPages;
+        int32_t numEntry;
+    };
+    struct ClusterDirectoryEntry {
+        int32_t lowKey;
+        int32_t page;
+    };
+
     struct RecordMeta {
         ColumnBitmap nullBitmap;
     };
+    // The null bitmaps of a PAX page are handed out as an array.
+    static_assert(sizeof(RecordMeta) == sizeof(ColumnBitmap));
+
+    // The zone map of a data page holds the range of the non-null values of
+    // each INT/FLOAT column in the page. It is stored in the unused space after
+    // the last slot, or in the leading slots if there is not enough space. The
+    // ranges are only widened by writes (and reset when the page is emptied),
+    // thus might be looser than the actual values.
+    union ZoneMapValue {
+        int intValue;
+        float floatValue;
+    };
+    struct ZoneMap {
+        // Bit i is set if column i has non-null values in the page.
+        ColumnBitmap nonEmpty = 0;
+        struct {
+            ZoneMapValue min, max;
+        } ranges[MAX_COLUMNS];
+    };
+    static_assert(sizeof(PageMeta) + sizeof(ZoneMap) < PAGE_SIZE);
+
+    struct ZoneMapCondition {
+        const CompareValueCondition *condition;
+        int columnIndex;
+    };
+
+    using DictionaryCode = uint16_t;
+    struct DictionaryEntryHeader {
+        uint8_t column;
+        uint8_t length;
+    };
+    static_assert(MAX_COLUMNS <= std::numeric_limits<uint8_t>::max());
+    static_assert(MAX_VARCHAR_LEN <= std::numeric_limits<uint8_t>::max());
+
+    // An EQ/NE condition on a dictionary-encoded column, checked against the
+    // code in a serialized record.
+    struct CodeCondition {
+        int columnIndex;
+        DictionaryCode code;
+        bool equal;
+    };
+
+    // The conditions of a scan, resolved against this table.
+    struct ScanConditions {
+        std::vector<ZoneMapCondition> zoneMap;
+        std::vector<CodeCondition> codes;
+        // No record can satisfy the conditions.
+        bool empty = false;
+    };
+
+    // Where the records are in a data page, computed from the meta. In the
+    // row layout, the columns are at `columnOffsets` from the start of each
+    // record. In the PAX layout, the null bitmaps and the values of each
+    // column are stored in an array (minipage) starting at the offsets, with
+    // an element for each slot from `firstSlot` on.
+    struct Layout {
+        int columnOffsets[MAX_COLUMNS];
+        int nullBitmapOffset;
+        int firstSlot;
+    };
 
     bool initialized = false;
     FileDescriptor fd;
     // TODO: Pin meta page?
     TableMeta meta;
-    std::map<int, PageHandle *> pageHandleMap;
+    Layout layout;
+    // A direct-mapped cache of the page handles, indexed by the page number,
+    // to avoid asking the buffer pool for the recently used pages.
+    struct CachedPageHandle {
+        int page = -1;
+        PageHandle handle;
+    };
+    std::vector<CachedPageHandle> pageHandleCache;
     std::map<std::string, int> columnNameMap;
+    // No page before this one has empty slots.
+    int freePageHint = FIRST_DATA_PAGE;
+    // The page each insert stream is filling, see `findStreamPage()`.
+    std::unordered_map<int, int> streamPageHints;
+    // In-memory copies of the zone maps, indexed by page, so that a skipped
+    // page is not read again.
+    std::vector<ZoneMap> zoneMapCache;
+    std::vector<bool> zoneMapCached;
+    // In-memory copy of the dictionary page: the values of each
+    // dictionary-encoded column indexed by their codes, and the reverse.
+    std::vector<std::string> dictionaryValues[MAX_COLUMNS];
+    std::map<std::string, DictionaryCode> dictionaryCodes[MAX_COLUMNS];
+    // The data pages of a clustered table indexed by their low keys, saved
+    // on close and loaded on open, or rebuilt from the page metas if the
+    // saved one is stale.
+    std::map<int, int> clusterDirectory;
+    // The (key, slot) pairs of the data pages of a clustered table ordered by
+    // the keys, indexed by page, so that a key is located by a binary search.
+    // Built when a page is first read, then kept in step with its records.
+    std::vector<std::vector<std::pair<int, int>>> clusterEntryCache;
+    std::vector<bool> clusterEntryCached;
 
     void checkInit() noexcept(false);
     void flushMeta() noexcept(false);
+    // Upgrade a table file written in an older format.
+    void migrate(MoveCallback onMove);
     void flushPageMeta(int page, const PageMeta &meta);
 
-    PageHandle *getHandle(int page);
+    // The returned handle is invalidated once the page is evicted from the
+    // buffer pool.
+    PageHandle getHandle(int page);
+    void resetPageHandleCache();
 
-    void deserialize(const char *srcData, Columns &destObjects,
+    // (De)serialize the record in a slot of a data page.
+    void deserialize(const char *page, int slot, Columns &destObjects,
                      ColumnBitmap columnBitmap);
-    void serialize(const Columns &srcObjects, char *destData, ColumnBitmap map,
-                   bool all);
+    void serialize(const Columns &srcObjects, char *page, int slot,
+                   ColumnBitmap map, bool all);
+
+    void initLayout();
+    // The offsets in a data page of the record meta and a column of the
+    // record in a slot.
+    int recordMetaOffset(int slot);
+    int columnOffset(int slot, int column);
 
     // Must ensure that the handle is valid.
     bool occupied(const PageHandle &handle, int slot);
 
-    // Side effect: might create a new page, thus modifying meta,
-    // firstFreePagMeta, etc.
-    RecordID getEmptySlot();
+    // Side effect: might create a new page, thus modifying meta, the free
+    // space map, etc.
+    RecordID getEmptySlot(int stream = 0);
+
+    // Find a data page with empty slots from `startPage`, returns -1 if all
+    // the used pages are full.
+    int findFreePage(int startPage);
+    // Find a data page with empty slots for a non-zero insert stream: the page
+    // the stream is filling, or one from a page hashed from the stream, then
+    // wrapping around. Returns -1 if all the used pages are full.
+    int findStreamPage(int stream);
+    // Create a new data page at the end of the file.
+    int createPage();
+    void markPageFree(int page, bool hasFreeSlot);
 
     int slotSize();
     int numSlotPerPage();
+    // The number of bytes taken by the column in a record.
+    int columnStorageSize(int column);
+
+    void loadDictionaries();
+    void clearDictionaries();
+    // Find the code of a value, adding it to the dictionary if not found.
+    DictionaryCode encode(int column, const char *value);
+    bool findCode(int column, const char *value, DictionaryCode &code);
 
     bool isPageFull(PageMeta *pageMeta);
+    bool isPageEmpty(int page);
+
+    // The leading slots of each data page taken by the metadata.
+    int numHeaderSlots();
+    PageMeta::BitmapType headerSlotMask();
+
+    int zoneMapOffset();
+    const ZoneMap &getZoneMap(int page);
+    // Widen the ranges in `zoneMap` with the record in a slot of a data page.
+    void addToZoneMap(ZoneMap &zoneMap, const char *page, int slot);
+    // Widen the zone map of a page with the ranges in `delta`.
+    void mergeZoneMap(int page, const ZoneMap &delta);
+    void resetZoneMap(int page);
+    static void widenZoneMap(ZoneMap &zoneMap, int column, DataType type,
+                             ZoneMapValue value);
+    void cacheZoneMap(int page, const ZoneMap &zoneMap);
+    // Resolve the conditions that can be checked against the zone maps and
+    // the dictionary codes.
+    ScanConditions getScanConditions(
+        const std::vector<CompareValueCondition> &conditions);
+    bool matchCodes(const char *page, int slot,
+                    const std::vector<CodeCondition> &conditions);
+    bool mayMatch(const ZoneMap &zoneMap,
+                  const std::vector<ZoneMapCondition> &conditions);
+
+    void loadClusterDirectory();
+    // Returns false if there is no valid saved directory.
+    bool loadSavedClusterDirectory();
+    void saveClusterDirectory();
+    // The key of a record to be written, taking the default value if the key
+    // is not in the bitmap. Returns false if the key is not given on update.
+    bool getKey(const Columns &columns, ColumnBitmap bitmap, int &key,
+                bool isUpdate);
+    // The page covering the key, or -1 if the table has no page yet.
+    int findClusterPage(int key);
+    // The primary key of the record in a slot of a data page.
+    int readKey(const char *page, int slot);
+    // The (key, slot) pairs of the records in a page, ordered by the keys.
+    std::vector<std::pair<int, int>> &clusterEntries(int page);
+    // Drop the cached entries of the pages from `page` on.
+    void clearClusterEntries(int page = 0);
+    // Resolve the key of a record in a clustered table to its location.
+    RecordID locate(RecordID id);
+    // Like `getEmptySlot()`, but in the page covering the key, which is split
+    // if full.
+    RecordID getClusterSlot(int key);
+    // Move the upper half of the records of a full page to a new page, or
+    // none if the key is beyond all of them, returns the page for the key.
+    int splitClusterPage(int page, int key);
+    void iterateCluster(int low, int high, IterateCallback callback,
+                        const ScanConditions &conditions);
+
+    // Drop the pages from `numPages` on, which must all be empty.
+    void truncatePages(int numPages);
 
     void validateSlot(int page, int slot);
     void validateColumnBitmap(const Columns &columns, ColumnBitmap bitmap,
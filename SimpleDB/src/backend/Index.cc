@@ -1,9 +1,19 @@
 #include "internal/Index.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <queue>
 #include <string>
+#include <vector>
 
 #include "internal/Comparer.h"
 #include "internal/Logger.h"
@@ -11,6 +21,210 @@
 namespace SimpleDB {
 namespace Internal {
 
+namespace {
+
+// The older index formats, only read to migrate such files.
+
+// The unversioned format: nodes are 424-byte slots, 18 per page, with at most
+// 20 children per node.
+namespace Legacy {
+
+const int SLOT_SIZE = 424;
+const int NUM_SLOT = 18;
+const int MAX_NUM_ENTRY_PER_NODE = 19;
+
+struct IndexMeta {
+    uint16_t headCanary;
+    int numNode;
+    int numEntry;
+    int firstFreeSlot;
+    int rootNode;
+    uint16_t tailCanary;
+};
+
+struct IndexEntry {
+    int key;
+    bool isNull;
+    RecordID record;
+};
+
+struct LeafNode {
+    bool isLeaf;
+    int index;
+    IndexEntry entry[MAX_NUM_ENTRY_PER_NODE + 1];
+    int numEntry;
+    int parent;
+    int32_t validBitmap;
+    int next;
+    int previous;
+};
+
+static_assert(sizeof(LeafNode) <= SLOT_SIZE);
+
+}  // namespace Legacy
+
+// Version 1: a node per page, with the entries stored as an array of structs.
+namespace V1 {
+
+const int MAX_NUM_ENTRY_PER_NODE = 399;
+
+struct LeafNode {
+    bool isLeaf;
+    int index;
+    Legacy::IndexEntry entry[MAX_NUM_ENTRY_PER_NODE + 1];
+    int numEntry;
+    int parent;
+    uint64_t validBitmap[(MAX_NUM_ENTRY_PER_NODE + 64) / 64];
+    int next;
+    int previous;
+};
+
+static_assert(sizeof(LeafNode) <= PAGE_SIZE);
+
+}  // namespace V1
+
+// Version 2: the entries stored as separate arrays, with INT keys only. The
+// nodes are laid out as those with 4-byte keys now, thus only the metadata is
+// upgraded.
+namespace V2 {
+
+const int MAX_NUM_ENTRY_PER_NODE = 399;
+
+// Also the metadata of version 1.
+struct IndexMeta {
+    uint16_t headCanary;
+    uint16_t version;
+    int numNode;
+    int numEntry;
+    int firstFreeSlot;
+    int rootNode;
+    uint16_t tailCanary;
+};
+
+struct SharedNode {
+    bool isLeaf;
+    int index;
+    int numEntry;
+    int parent;
+    int keys[MAX_NUM_ENTRY_PER_NODE + 1];
+    RecordID records[MAX_NUM_ENTRY_PER_NODE + 1];
+    bool nulls[MAX_NUM_ENTRY_PER_NODE + 1];
+};
+
+struct LeafNode {
+    SharedNode shared;
+    uint64_t validBitmap[(MAX_NUM_ENTRY_PER_NODE + 64) / 64];
+    int next;
+    int previous;
+};
+
+struct InnerNode {
+    SharedNode shared;
+    int children[MAX_NUM_ENTRY_PER_NODE + 2];
+    int numChildren;
+};
+
+}  // namespace V2
+
+// Version 3: keys of a single column. The nodes are laid out as now, thus only
+// the metadata is upgraded.
+namespace V3 {
+
+struct IndexMeta {
+    uint16_t headCanary;
+    uint16_t version;
+    int numNode;
+    int numEntry;
+    int firstFreeSlot;
+    int rootNode;
+    DataType keyType;
+    int columnSize;
+    int keySize;
+    uint16_t tailCanary;
+};
+
+}  // namespace V3
+
+// The big-endian bytes of `value` with the sign bit flipped, which compare as
+// unsigned bytes in the order of the values.
+void encodeInt(int value, char *key) {
+    uint32_t bits = uint32_t(value) ^ 0x80000000U;
+    for (int i = 0; i < 4; i++) {
+        key[i] = char(bits >> (24 - 8 * i));
+    }
+}
+
+int decodeInt(const char *key) {
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; i++) {
+        bits = (bits << 8) | uint8_t(key[i]);
+    }
+    return int(bits ^ 0x80000000U);
+}
+
+// An INT in the order of the FLOAT: the bits of a negative FLOAT grow with
+// its magnitude, thus are flipped (except the sign bit). -0.0 comes right
+// before 0.0, and the NaNs at both ends.
+int orderedFloat(float value) {
+    int bits;
+    memcpy(&bits, &value, sizeof(int));
+    return bits < 0 ? bits ^ INT_MAX : bits;
+}
+
+void encodeColumn(const Column &value, DataType type, int keySize,
+                  char *key) {
+    memset(key, 0, keySize);
+    switch (type) {
+        case INT:
+            encodeInt(value.data.intValue, key);
+            break;
+        case FLOAT:
+            // INT values are taken by FLOAT columns.
+            encodeInt(orderedFloat(value.type == INT ? value.data.intValue
+                                                     : value.data.floatValue),
+                      key);
+            break;
+        case VARCHAR: {
+            const char *string = value.raw();
+            memcpy(key, string, strnlen(string, keySize));
+            break;
+        }
+    }
+}
+
+// Reads the entries written to a file in order, through a small buffer.
+template <typename Entry>
+struct RunReader {
+    FILE *file;
+    std::vector<Entry> buffer;
+    size_t position = 0;
+
+    bool next(Entry &entry) {
+        if (position == buffer.size()) {
+            buffer.resize(4096);
+            buffer.resize(
+                fread(buffer.data(), sizeof(Entry), buffer.size(), file));
+            position = 0;
+        }
+        if (buffer.empty()) {
+            return false;
+        }
+        entry = buffer[position++];
+        return true;
+    }
+};
+
+std::string describeValue(const Column &value) {
+    if (value.isNull) {
+        return "NULL";
+    }
+    return value.type == VARCHAR ? std::string(value.raw())
+           : value.type == FLOAT ? std::to_string(value.data.floatValue)
+                                 : std::to_string(value.data.intValue);
+}
+
+}  // namespace
+
 Index::~Index() { close(); }
 
 void Index::open(const std::string &file) {
@@ -25,6 +239,7 @@ void Index::open(const std::string &file) {
 
     try {
         fd = PF::open(file);
+        path = file;
         PageHandle handle = PF::getHandle(fd, 0);
         meta = *PF::loadRaw<IndexMeta *>(handle);
     } catch (BaseError) {
@@ -33,8 +248,16 @@ void Index::open(const std::string &file) {
         throw Internal::ReadIndexError();
     }
 
-    if (meta.headCanary != INDEX_META_CANARY ||
-        meta.tailCanary != INDEX_META_CANARY) {
+    // The tail canary of an older format is checked by the migration.
+    if (meta.headCanary == LEGACY_INDEX_META_CANARY ||
+        (meta.headCanary == INDEX_META_CANARY &&
+         meta.version < INDEX_FORMAT_VERSION)) {
+        migrate();
+    }
+
+    hashed = meta.headCanary == HASH_INDEX_META_CANARY;
+    if ((meta.headCanary != INDEX_META_CANARY && !hashed) ||
+        meta.tailCanary != meta.headCanary) {
         Logger::log(ERROR,
                     "Index: fail to read index metadata from file %d: "
                     "invalid canary values\n",
@@ -42,6 +265,42 @@ void Index::open(const std::string &file) {
         throw Internal::ReadIndexError();
     }
 
+    if (meta.version != INDEX_FORMAT_VERSION) {
+        Logger::log(ERROR,
+                    "Index: fail to read index metadata from file %d: "
+                    "unsupported format version %d\n",
+                    fd.value, meta.version);
+        throw Internal::ReadIndexError();
+    }
+
+    if (meta.keySize < int(sizeof(int)) || meta.keySize > INDEX_MAX_KEY_SIZE ||
+        meta.numKeyColumn < 1 || meta.numKeyColumn > INDEX_MAX_KEY_COLUMNS) {
+        Logger::log(ERROR,
+                    "Index: fail to read index metadata from file %d: "
+                    "invalid key size %d of %d columns\n",
+                    fd.value, meta.keySize, meta.numKeyColumn);
+        throw Internal::ReadIndexError();
+    }
+
+    layout.init(meta.keySize);
+
+    if (hashed) {
+        initHashLayout();
+        PageHandle handle = PF::getHandle(fd, 0);
+        memcpy(&hashMeta, PF::loadRaw(handle) + sizeof(IndexMeta),
+               sizeof(HashMeta));
+
+        // Load the directory.
+        const int perPage = PAGE_SIZE / sizeof(NodeIndex);
+        directory.resize(1 << hashMeta.globalDepth);
+        for (int i = 0; i < directory.size(); i += perPage) {
+            handle = getHandle(hashMeta.directoryPages[i / perPage]);
+            memcpy(&directory[i], PF::loadRaw(handle),
+                   sizeof(NodeIndex) *
+                       std::min<size_t>(perPage, directory.size() - i));
+        }
+    }
+
     Logger::log(VERBOSE,
                 "Index: the index uses %d pages, containing %d records\n",
                 meta.numNode, meta.numEntry);
@@ -49,7 +308,45 @@ void Index::open(const std::string &file) {
     initialized = true;
 }
 
-void Index::create(const std::string &file) {
+void Index::create(const std::string &file, DataType type, int size) {
+    ColumnMeta column;
+    column.type = type;
+    column.size = size;
+    create(file, std::vector<ColumnMeta>{column});
+}
+
+void Index::create(const std::string &file,
+                   const std::vector<ColumnMeta> &columns, bool hash) {
+    int numColumn = columns.size();
+
+    if (hash && (numColumn != 1 || columns[0].type == FLOAT)) {
+        Logger::log(ERROR,
+                    "Index: fail to create index to %s: hash indexes are on "
+                    "a single INT or VARCHAR column\n",
+                    file.c_str());
+        throw Internal::CreateIndexError();
+    }
+
+    // The bytes left for the VARCHAR columns, and those they take at least:
+    // 4 for the first column, to have a whole prefix, and 1 for the others.
+    int left = INDEX_MAX_KEY_SIZE - (numColumn - 1);
+    int reserved = 0;
+    for (int i = 0; i < numColumn; i++) {
+        if (columns[i].type == VARCHAR) {
+            reserved += i == 0 ? sizeof(int) : 1;
+        } else {
+            left -= sizeof(int);
+        }
+    }
+
+    if (numColumn < 1 || numColumn > INDEX_MAX_KEY_COLUMNS || left < reserved) {
+        Logger::log(ERROR,
+                    "Index: fail to create index to %s: the keys of %d "
+                    "columns do not fit\n",
+                    file.c_str(), numColumn);
+        throw Internal::CreateIndexError();
+    }
+
     try {
         PF::create(file);
     } catch (Internal::FileExistsError) {
@@ -63,10 +360,49 @@ void Index::create(const std::string &file) {
     }
 
     fd = PF::open(file);
+    path = file;
 
+    meta = IndexMeta();
     meta.numNode = 0;
     meta.numEntry = 0;
     meta.firstFreeSlot = 0;
+    meta.numKeyColumn = numColumn;
+    meta.keySize = numColumn - 1;
+    for (int i = 0; i < numColumn; i++) {
+        KeyColumn &column = meta.keyColumns[i];
+        column.type = columns[i].type;
+        column.size =
+            columns[i].type == VARCHAR ? columns[i].size : sizeof(int);
+        column.keySize = sizeof(int);
+        if (column.type == VARCHAR) {
+            int minSize = i == 0 ? sizeof(int) : 1;
+            reserved -= minSize;
+            column.keySize = std::clamp(column.size, minSize, left - reserved);
+            left -= column.keySize;
+        }
+        meta.keySize += column.keySize;
+    }
+    layout.init(meta.keySize);
+
+    hashed = hash;
+    if (hashed) {
+        meta.headCanary = meta.tailCanary = HASH_INDEX_META_CANARY;
+        meta.rootNode = NULL_NODE_INDEX;
+        initHashLayout();
+
+        // A single bucket, taken by all the hashes.
+        hashMeta.globalDepth = 0;
+        hashMeta.firstFreePage = NULL_NODE_INDEX;
+        hashMeta.numDirectoryPage = 1;
+        hashMeta.directoryPages[0] = newHashPage();
+        NodeIndex bucket = newHashPage();
+        std::vector<NodeIndex> spare;
+        writeBucket(bucket, 0, {}, spare);
+        directory = {bucket};
+
+        initialized = true;
+        return;
+    }
 
     // Create root node.
     NodeIndex index = createNewLeafNode(NULL_NODE_INDEX);
@@ -93,39 +429,58 @@ void Index::close() {
     // TODO: More cleanup
 }
 
-void Index::insert(int key, bool isNull, RecordID id) {
-    Logger::log(VERBOSE,
-                "Index: inserting index (key: %d) at page %d, slot %d\n", key,
+void Index::insert(const Column &key, RecordID id) {
+    assert(meta.numKeyColumn == 1);
+    insert(Columns{key}, id);
+}
+
+void Index::remove(const Column &key, RecordID rid) {
+    assert(meta.numKeyColumn == 1);
+    remove(Columns{key}, rid);
+}
+
+void Index::insert(const Columns &key, RecordID id) {
+    Logger::log(VERBOSE, "Index: inserting index at page %d, slot %d\n",
                 id.page, id.slot);
 
     checkInit();
-    if (readOnly) {
-        Logger::log(ERROR,
-                    "Index: internal error: writing into a read-only index\n");
-        throw Internal::WriteOnReadOnlyIndexError();
+    checkWritable();
+    assert(int(key.size()) == meta.numKeyColumn);
+
+    IndexEntry entry = makeEntry(key.data(), id);
+    if (hashed) {
+        // The entries are not checked for duplicates, which would take a
+        // scan of the bucket.
+        hashInsert(entry);
+        meta.numEntry++;
+        return;
     }
 
-    auto result = findEntry({key, isNull, id}, /*skipInvalid=*/false);
+    auto result = findEntry(entry, /*skipInvalid=*/false);
     NodeIndex nodeIndex = std::get<0>(result);
     int index = std::get<1>(result);
     bool found = std::get<2>(result);
 
     PageHandle handle = getHandle(nodeIndex);
-    LeafNode *node = load<LeafNode *>(nodeIndex, handle);
+    Node node = load(nodeIndex, handle);
 
-    assert(node->shared.isLeaf);
+    assert(node.shared->isLeaf);
 
     if (found) {
         // The record already exists.
-        if (!node->valid(index)) {
+        if (!node.valid(index)) {
             // The record was deleted, simply mark as valid.
-            node->validBitmap |= (1L << index);
+            node.setValid(index, true);
         } else {
-            throw Internal::IndexKeyExistsError(std::to_string(key));
+            std::string desc;
+            for (const auto &value : key) {
+                desc += (desc.empty() ? "" : ", ") + describeValue(value);
+            }
+            throw Internal::IndexKeyExistsError(desc);
         }
     } else {
         // Insert the record into the node.
-        insertEntry(&node->shared, {key, isNull, id});
+        insertEntry(node, entry);
         checkOverflowFrom(nodeIndex);
     }
 
@@ -136,30 +491,39 @@ void Index::insert(int key, bool isNull, RecordID id) {
     meta.numEntry++;
 }
 
-void Index::remove(int key, bool isNull, RecordID rid) {
-    Logger::log(VERBOSE, "Index: removing record %d\n", key);
+void Index::remove(const Columns &key, RecordID rid) {
+    Logger::log(VERBOSE, "Index: removing record at page %d, slot %d\n",
+                rid.page, rid.slot);
     checkInit();
+    checkWritable();
+    assert(int(key.size()) == meta.numKeyColumn);
 
-    if (readOnly) {
-        Logger::log(ERROR,
-                    "Index: internal error: writing into a read-only index\n");
-        throw Internal::WriteOnReadOnlyIndexError();
+    if (hashed) {
+        hashRemove(makeEntry(key.data(), rid));
+        meta.numEntry--;
+        return;
     }
 
     auto [nodeIndex, index, found] =
-        findEntry({key, isNull, rid}, /*skipInvalid=*/true);
+        findEntry(makeEntry(key.data(), rid), /*skipInvalid=*/true);
 
     if (!found) {
         throw Internal::IndexKeyNotExistsError();
     }
 
     PageHandle handle = getHandle(nodeIndex);
-    LeafNode *node = load<LeafNode *>(nodeIndex, handle);
+    Node node = load(nodeIndex, handle);
 
-    assert(node->shared.isLeaf);
+    assert(node.shared->isLeaf);
 
-    // Remove the entry (simply mark invalid here).
-    node->validBitmap &= ~(1L << index);
+    // Remove the entry from the leaf, whose space is reclaimed by vacuum()
+    // once the nodes are sparse.
+    int numEntry = node.shared->numEntry;
+    node.moveEntries(index, node, index + 1, numEntry - index - 1);
+    for (int i = index; i < numEntry - 1; i++) {
+        node.setValid(i, node.valid(i + 1));
+    }
+    node.shared->numEntry--;
 
     // Mark dirty.
     PF::markDirty(handle);
@@ -167,78 +531,548 @@ void Index::remove(int key, bool isNull, RecordID rid) {
     meta.numEntry--;
 }
 
-bool Index::has(int key, bool isNull) {
+void Index::insert(int key, bool isNull, RecordID id) {
+    insert(isNull ? Column::nullIntColumn() : Column(key), id);
+}
+
+void Index::remove(int key, bool isNull, RecordID rid) {
+    remove(isNull ? Column::nullIntColumn() : Column(key), rid);
+}
+
+void Index::bulkLoad(std::function<void(const BulkInsertFunc &)> source,
+                     float fillFactor, int runSize) {
     checkInit();
+    checkWritable();
 
-    bool ret = false;
-    iterateEq(key, isNull, [&](RecordID id) {
-        ret = true;
-        return false;
+    if (!canBulkLoad()) {
+        Logger::log(ERROR, "Index: bulk loading into a non-empty index\n");
+        throw Internal::IndexNotEmptyError();
+    }
+
+    // The buckets are split as they fill up anyway.
+    if (hashed) {
+        source([&](const Columns &key, RecordID id) {
+            assert(int(key.size()) == meta.numKeyColumn);
+            hashInsert(makeEntry(key.data(), id));
+            meta.numEntry++;
+        });
+        return;
+    }
+
+    std::vector<IndexEntry> run;
+    std::vector<std::string> runFiles;
+    int numEntry = 0;
+
+    auto removeRuns = [&]() {
+        for (const auto &runFile : runFiles) {
+            std::error_code error;
+            std::filesystem::remove(runFile, error);
+        }
+    };
+
+    auto sortRun = [&]() {
+        std::sort(run.begin(), run.end(),
+                  [&](const IndexEntry &lhs, const IndexEntry &rhs) {
+                      return compare(lhs, rhs) < 0;
+                  });
+    };
+
+    auto spillRun = [&]() {
+        sortRun();
+        std::string runFile = path + ".run" + std::to_string(runFiles.size());
+        runFiles.push_back(runFile);
+
+        FILE *file = fopen(runFile.c_str(), "wb");
+        bool failed = file == nullptr ||
+                      fwrite(run.data(), sizeof(IndexEntry), run.size(),
+                             file) != run.size();
+        if (file != nullptr && fclose(file) != 0) {
+            failed = true;
+        }
+        if (failed) {
+            Logger::log(ERROR, "Index: fail to spill sorted entries to %s\n",
+                        runFile.c_str());
+            removeRuns();
+            throw Internal::SpillIndexRunError();
+        }
+        run.clear();
+    };
+
+    run.reserve(runSize);
+    source([&](const Columns &key, RecordID id) {
+        assert(int(key.size()) == meta.numKeyColumn);
+        run.push_back(makeEntry(key.data(), id));
+        numEntry++;
+        if (int(run.size()) == runSize) {
+            spillRun();
+        }
     });
 
+    Logger::log(VERBOSE, "Index: bulk loading %d entries from %lu runs\n",
+                numEntry, runFiles.size() + (run.empty() ? 0 : 1));
+
+    if (runFiles.empty()) {
+        sortRun();
+        int position = 0;
+        buildFromSorted([&]() { return run[position++]; }, numEntry,
+                        fillFactor);
+        return;
+    }
+
+    if (!run.empty()) {
+        spillRun();
+    }
+    run.clear();
+    run.shrink_to_fit();
+
+    // Merge the sorted runs, each read through a small buffer.
+    std::vector<RunReader<IndexEntry>> readers(runFiles.size());
+    for (int i = 0; i < runFiles.size(); i++) {
+        readers[i].file = fopen(runFiles[i].c_str(), "rb");
+        if (readers[i].file == nullptr) {
+            Logger::log(ERROR, "Index: fail to read sorted entries from %s\n",
+                        runFiles[i].c_str());
+            for (int j = 0; j < i; j++) {
+                fclose(readers[j].file);
+            }
+            removeRuns();
+            throw Internal::SpillIndexRunError();
+        }
+    }
+
+    using HeapItem = std::pair<IndexEntry, int>;
+    auto greater = [&](const HeapItem &lhs, const HeapItem &rhs) {
+        return compare(lhs.first, rhs.first) > 0;
+    };
+    std::priority_queue<HeapItem, std::vector<HeapItem>, decltype(greater)>
+        heap(greater);
+
+    for (int i = 0; i < readers.size(); i++) {
+        IndexEntry entry;
+        if (readers[i].next(entry)) {
+            heap.push({entry, i});
+        }
+    }
+
+    buildFromSorted(
+        [&]() {
+            auto [entry, i] = heap.top();
+            heap.pop();
+            IndexEntry nextEntry;
+            if (readers[i].next(nextEntry)) {
+                heap.push({nextEntry, i});
+            }
+            return entry;
+        },
+        numEntry, fillFactor);
+
+    for (auto &reader : readers) {
+        fclose(reader.file);
+    }
+    removeRuns();
+}
+
+bool Index::canBulkLoad() {
+    checkInit();
+    return meta.numEntry == 0 && (hashed || meta.numNode == 1);
+}
+
+bool Index::needsVacuum() {
+    checkInit();
+    // The pages freed from the chains of a hash index are reused.
+    return !hashed && meta.numNode > 1 &&
+           meta.numEntry <
+               meta.numNode * layout.capacity * INDEX_VACUUM_FILL_RATIO;
+}
+
+int Index::vacuum(float fillFactor) {
+    checkInit();
+    checkWritable();
+
+    if (hashed) {
+        return 0;
+    }
+
+    int numPages = meta.firstFreeSlot;
+
+    // Find the first leaf.
+    NodeIndex firstIndex = meta.rootNode;
+    for (;;) {
+        Node node = load(firstIndex, getHandle(firstIndex));
+        if (node.shared->isLeaf) {
+            break;
+        }
+        firstIndex = node.children[0];
+    }
+
+    // Count the valid entries, which are then read again, already sorted,
+    // in the order of the leaves.
+    int numEntry = 0;
+    NodeIndex nodeIndex = firstIndex;
+    do {
+        Node node = load(nodeIndex, getHandle(nodeIndex));
+        for (int i = 0; i < node.shared->numEntry; i++) {
+            numEntry += node.valid(i);
+        }
+        nodeIndex = *node.next;
+    } while (nodeIndex != firstIndex);
+
+    // The tree is rebuilt into a new file next to the index, which then
+    // replaces it, so that the index is left intact if the rebuild fails.
+    std::string vacuumFile = path + ".vacuum";
+    std::vector<ColumnMeta> columns(meta.numKeyColumn);
+    for (int i = 0; i < meta.numKeyColumn; i++) {
+        columns[i].type = meta.keyColumns[i].type;
+        columns[i].size = meta.keyColumns[i].size;
+    }
+
+    int numNewPages;
+    try {
+        Index packed;
+        packed.create(vacuumFile, columns);
+        assert(packed.meta.keySize == meta.keySize);
+
+        // The leaves are loaded again for each entry, as their pages may be
+        // evicted by those of the new file.
+        int position = 0;
+        packed.buildFromSorted(
+            [&]() {
+                for (;;) {
+                    Node node = load(nodeIndex, getHandle(nodeIndex));
+                    if (position == node.shared->numEntry) {
+                        nodeIndex = *node.next;
+                        position = 0;
+                    } else if (node.valid(position)) {
+                        return node.getEntry(position++);
+                    } else {
+                        position++;
+                    }
+                }
+            },
+            numEntry, fillFactor);
+        numNewPages = packed.meta.firstFreeSlot;
+        packed.close();
+    } catch (BaseError) {
+        Logger::log(ERROR, "Index: fail to rebuild the index into %s\n",
+                    vacuumFile.c_str());
+        std::error_code error;
+        std::filesystem::remove(vacuumFile, error);
+        throw Internal::VacuumIndexError();
+    }
+
+    close();
+    std::error_code error;
+    std::filesystem::rename(vacuumFile, path, error);
+    if (error) {
+        Logger::log(ERROR, "Index: fail to replace %s with %s\n",
+                    path.c_str(), vacuumFile.c_str());
+        std::filesystem::remove(vacuumFile, error);
+        open(path);
+        throw Internal::VacuumIndexError();
+    }
+    open(path);
+
+    Logger::log(VERBOSE, "Index: vacuumed %d entries, freed %d pages\n",
+                numEntry, numPages - numNewPages);
+
+    return numPages - numNewPages;
+}
+
+bool Index::has(const Column &key) { return has(Columns{key}); }
+
+bool Index::has(const Columns &key) {
+    checkInit();
+
+    bool ret = false;
+    bool hasNull =
+        std::any_of(key.begin(), key.end(),
+                    [](const Column &value) { return value.isNull; });
+    if (!hasNull) {
+        Key encoded = encodeKey(key);
+        iterateRange({encoded, encoded}, [&](RecordID id) {
+            ret = true;
+            return false;
+        });
+    }
+
     return ret;
 }
 
-std::vector<RecordID> Index::findEq(int key, bool isNull) {
+bool Index::has(int key, bool isNull) {
+    return has(isNull ? Column::nullIntColumn() : Column(key));
+}
+
+std::vector<RecordID> Index::findEq(const Column &key) {
+    return findEq(Columns{key});
+}
+
+std::vector<RecordID> Index::findEq(const Columns &key) {
     std::vector<RecordID> ret;
 
-    iterateEq(key, isNull, [&](RecordID id) {
-        ret.push_back(id);
-        return true;
-    });
+    bool hasNull =
+        std::any_of(key.begin(), key.end(),
+                    [](const Column &value) { return value.isNull; });
+    if (!hasNull) {
+        Key encoded = encodeKey(key);
+        iterateRange({encoded, encoded}, [&](RecordID id) {
+            ret.push_back(id);
+            return true;
+        });
+    }
 
     return ret;
 }
 
+std::vector<RecordID> Index::findEq(int key, bool isNull) {
+    return findEq(isNull ? Column::nullIntColumn() : Column(key));
+}
+
 void Index::iterateEq(int key, bool isNull, IterateFunc func) {
-    iterateRange({key, key}, func);
+    if (!isNull) {
+        iterateRange(IntRange{key, key}, func);
+    }
 }
 
-void Index::iterateRange(Range range, IterateFunc func) {
-    auto [lo, hi] = range;
+void Index::iterateRange(IntRange range, IterateFunc func) {
+    iterateRange({encodeKey(Column(range.first)),
+                  encodeKey(Column(range.second))},
+                 func);
+}
+
+void Index::iterateRange(const Range &range, IterateFunc func) {
+    iterateRangeKeys(range,
+                     [&](RecordID id, const char *) { return func(id); });
+}
 
-    Logger::log(VERBOSE, "Index: finding record in [%d, %d]\n", lo, hi);
+void Index::iterateRangeKeys(const Range &range, IterateKeyFunc func) {
+    Logger::log(VERBOSE, "Index: finding records in a range\n");
     checkInit();
 
-    // Just "find" the {INT_MIN, INT_MIN} record, which must be the start of the
-    // sequenece, if the key matches the target key.
-    auto [nodeIndex, index, _] = findEntry(
-        {lo, /*isNull=*/false, {INT_MIN, INT_MIN}}, /*skipInvalid=*/true);
+    if (hashed) {
+        if (range.first != range.second) {
+            Logger::log(ERROR,
+                        "Index: internal error: iterating a hash index over "
+                        "a range of keys\n");
+            throw Internal::HashIndexRangeError();
+        }
+        return hashIterate(makeEntry(range.first, RecordID::NULL_RECORD).key,
+                           func);
+    }
+
+    // Just "find" the {lo, {INT_MIN, INT_MIN}} record, which must be the start
+    // of the sequenece, if the key matches the target key.
+    IndexEntry lo = makeEntry(range.first, {INT_MIN, INT_MIN});
+    IndexEntry hi = makeEntry(range.second, {INT_MIN, INT_MIN});
+    auto [nodeIndex, index, _] = findEntry(lo, /*skipInvalid=*/true);
 
     // Iterate from the start of the sequence.
     PageHandle handle = getHandle(nodeIndex);
-    LeafNode *node = load<LeafNode *>(nodeIndex, handle);
-    NodeIndex startIndex = node->shared.index;
+    Node node = load(nodeIndex, handle);
+    NodeIndex startIndex = node.shared->index;
+    IndexEntry lastEntry;
+    bool hasLastEntry = false;
+    char key[INDEX_MAX_KEY_SIZE];
 
-    assert(node->shared.isLeaf);
+    assert(node.shared->isLeaf);
 
     for (;;) {
-        for (int i = index; i < node->shared.numEntry; i++) {
-            int key = node->shared.entry[i].key;
-            if (key < lo) {
+        for (int i = index; i < node.shared->numEntry; i++) {
+            if (node.nulls[i] || node.compareKey(i, lo.key) < 0 ||
+                node.compareKey(i, hi.key) > 0) {
                 return;
             }
-            if (node->valid(i) && key >= lo && key <= hi) {
-                bool continue_ = func(node->shared.entry[i].record);
+            if (node.valid(i)) {
+                encodeInt(node.prefixes[i], key);
+                memcpy(key + sizeof(int), node.suffixes + i * node.suffixSize,
+                       node.suffixSize);
+                bool continue_ = func(node.records[i], key);
                 if (!continue_) {
                     return;
                 }
             }
-            if (node->shared.entry[i].key > hi) {
-                return;
-            }
         }
 
-        if (node->next == startIndex) {
+        if (*node.next == startIndex) {
             return;
         }
 
-        handle = getHandle(node->next);
-        node = load<LeafNode *>(node->next, handle);
+        // The leaves are linked circularly, stop when wrapping around to the
+        // first one, which happens before reaching the start if the iteration
+        // did not start from the first leaf (e.g. after the NULL entries).
+        // Leaves emptied by removals are skipped.
+        if (node.shared->numEntry > 0) {
+            lastEntry = node.getEntry(node.shared->numEntry - 1);
+            hasLastEntry = true;
+        }
+        NodeIndex nextIndex = *node.next;
+        handle = getHandle(nextIndex);
+        node = load(nextIndex, handle);
         index = 0;
+
+        if (hasLastEntry && node.shared->numEntry > 0 &&
+            compare(lastEntry, node.getEntry(0)) > 0) {
+            return;
+        }
     }
 }
 
+int Index::countRange(const Range &range) {
+    int count = 0;
+    iterateRange(range, [&](RecordID) {
+        count++;
+        return true;
+    });
+    return count;
+}
+
+int Index::countRange(IntRange range) {
+    return countRange(
+        Range{encodeKey(Column(range.first)), encodeKey(Column(range.second))});
+}
+
+bool Index::isHash() { return hashed; }
+
+int Index::getNumKeyColumn() { return meta.numKeyColumn; }
+
+const Index::KeyColumn &Index::getKeyColumn(int column) {
+    assert(column >= 0 && column < meta.numKeyColumn);
+    return meta.keyColumns[column];
+}
+
+DataType Index::getKeyType() { return meta.keyColumns[0].type; }
+
+int Index::getKeySize() { return meta.keySize; }
+
+bool Index::isTruncated(int column) {
+    const KeyColumn &keyColumn = getKeyColumn(column);
+    return keyColumn.type == VARCHAR && keyColumn.size > keyColumn.keySize;
+}
+
+Index::Key Index::encodeKey(const Column &value) {
+    assert(meta.numKeyColumn == 1);
+    return encodeKey(Columns{value});
+}
+
+Index::Key Index::encodeKey(const Columns &values) {
+    assert(int(values.size()) == meta.numKeyColumn && !values[0].isNull);
+    IndexEntry entry = makeEntry(values.data(), RecordID::NULL_RECORD);
+    return Key(entry.key, meta.keySize);
+}
+
+Index::Key Index::encodeKey(const Column &value, DataType type, int keySize) {
+    Key key(keySize, '\0');
+    encodeColumn(value, type, keySize, key.data());
+    return key;
+}
+
+void Index::decodeKey(const char *key, Columns &values) {
+    values.resize(meta.numKeyColumn);
+
+    for (int i = 0; i < meta.numKeyColumn; i++) {
+        const KeyColumn &keyColumn = meta.keyColumns[i];
+        Column &value = values[i];
+        value.type = keyColumn.type;
+        value.size = keyColumn.size;
+        value.isNull = i > 0 && *key++ == 0;
+
+        if (!value.isNull) {
+            switch (keyColumn.type) {
+                case INT:
+                    value.data.intValue = decodeInt(key);
+                    break;
+                case FLOAT: {
+                    // orderedFloat() is its own inverse.
+                    int bits = decodeInt(key);
+                    bits = bits < 0 ? bits ^ INT_MAX : bits;
+                    memcpy(&value.data.floatValue, &bits, sizeof(float));
+                    break;
+                }
+                case VARCHAR:
+                    value.setString(key, strnlen(key, keyColumn.keySize));
+                    break;
+            }
+        }
+        key += keyColumn.keySize;
+    }
+}
+
+int Index::decodeIntKey(const Key &key) { return decodeInt(key.data()); }
+
+Index::Key Index::minKey(int keySize) { return Key(keySize, '\0'); }
+
+Index::Key Index::maxKey(int keySize) { return Key(keySize, '\xff'); }
+
+bool Index::incrementKey(Key &key) {
+    // Add one to the key as a big-endian integer.
+    for (int i = int(key.size()) - 1; i >= 0; i--) {
+        if (key[i] != '\xff') {
+            key[i]++;
+            return true;
+        }
+        key[i] = '\0';
+    }
+    key = maxKey(key.size());
+    return false;
+}
+
+bool Index::decrementKey(Key &key) {
+    for (int i = int(key.size()) - 1; i >= 0; i--) {
+        if (key[i] != '\0') {
+            key[i]--;
+            return true;
+        }
+        key[i] = '\xff';
+    }
+    key = minKey(key.size());
+    return false;
+}
+
+Index::IndexEntry Index::makeEntry(const Column *key, RecordID id) {
+    IndexEntry entry;
+    memset(entry.key, 0, meta.keySize);
+    if (!key[0].isNull) {
+        char *part = entry.key;
+        for (int i = 0; i < meta.numKeyColumn; i++) {
+            const KeyColumn &column = meta.keyColumns[i];
+            if (i > 0) {
+                *part++ = key[i].isNull ? 0 : 1;
+            }
+            if (!key[i].isNull) {
+                encodeColumn(key[i], column.type, column.keySize, part);
+            }
+            part += column.keySize;
+        }
+    }
+    entry.isNull = key[0].isNull;
+    entry.record = id;
+    return entry;
+}
+
+Index::IndexEntry Index::makeEntry(const Key &key, RecordID id) {
+    IndexEntry entry;
+    memset(entry.key, 0, meta.keySize);
+    memcpy(entry.key, key.data(), std::min<size_t>(key.size(), meta.keySize));
+    entry.isNull = false;
+    entry.record = id;
+    return entry;
+}
+
+int Index::compare(const IndexEntry &lhs, const IndexEntry &rhs) {
+    if (lhs.isNull != rhs.isNull) {
+        return lhs.isNull ? -1 : 1;
+    }
+    if (!lhs.isNull) {
+        int result = memcmp(lhs.key, rhs.key, meta.keySize);
+        if (result != 0) {
+            return result;
+        }
+    }
+    if (lhs.record == rhs.record) {
+        return 0;
+    }
+    return lhs.record > rhs.record ? 1 : -1;
+}
+
 std::tuple<Index::NodeIndex, int, bool> Index::findEntry(
     const IndexEntry &entry, bool skipInvalid) {
     // Start from the root node.
@@ -246,17 +1080,18 @@ std::tuple<Index::NodeIndex, int, bool> Index::findEntry(
 
     for (;;) {
         PageHandle handle = getHandle(currentNode);
-        SharedNode *sharedNode = load<SharedNode *>(currentNode, handle);
-        if (sharedNode->isLeaf) {
-            LeafNode *node = (LeafNode *)sharedNode;
-            int candidate = sharedNode->numEntry;
-            for (int i = 0; i < sharedNode->numEntry; i++) {
-                if (sharedNode->entry[i] == entry) {
-                    if (!skipInvalid || node->valid(i)) {
+        Node node = load(currentNode, handle);
+        if (node.shared->isLeaf) {
+            int candidate = node.shared->numEntry;
+            for (int i = node.lowerBound(entry); i < node.shared->numEntry;
+                 i++) {
+                int result = node.compare(i, entry);
+                if (result == 0) {
+                    if (!skipInvalid || node.valid(i)) {
                         return {currentNode, i, true};
                     }
                 }
-                if (sharedNode->entry[i] > entry) {
+                if (result > 0) {
                     candidate = i;
                     break;
                 }
@@ -264,13 +1099,11 @@ std::tuple<Index::NodeIndex, int, bool> Index::findEntry(
             return {currentNode, candidate, false};
         }
 
-        InnerNode *node = (InnerNode *)(sharedNode);
-
-        currentNode = node->children[node->numChildren - 1];
+        currentNode = node.children[*node.numChildren - 1];
 
-        for (int i = 0; i < sharedNode->numEntry; i++) {
-            if (sharedNode->entry[i] > entry) {
-                currentNode = node->children[i];
+        for (int i = node.lowerBound(entry); i < node.shared->numEntry; i++) {
+            if (node.compare(i, entry) > 0) {
+                currentNode = node.children[i];
                 break;
             }
         }
@@ -280,34 +1113,134 @@ std::tuple<Index::NodeIndex, int, bool> Index::findEntry(
     return {-1, -1, false};
 }
 
+void Index::buildFromSorted(std::function<IndexEntry()> next, int numEntry,
+                            float fillFactor) {
+    if (numEntry == 0) {
+        return;
+    }
+
+    fillFactor = std::min(fillFactor, 1.0F);
+
+    // The number of nodes to hold `n` entries (or children).
+    auto numNodesFor = [&](int n, int capacity, int minimum) {
+        int perNode = std::max(minimum, int(capacity * fillFactor));
+        return (n + perNode - 1) / perNode;
+    };
+    // The items are spread evenly over the nodes of a level, the i-th node
+    // starting from the returned position.
+    auto start = [](int n, int numNodes, int i) {
+        return int((long long)n * i / numNodes);
+    };
+
+    // The number of nodes of each level, from the leaves up to the root.
+    // The nodes are allocated level by level, with the root leaf created
+    // along with the index as the first leaf.
+    std::vector<int> sizes = {numNodesFor(numEntry, layout.capacity, 1)};
+    std::vector<NodeIndex> bases = {meta.rootNode};
+    assert(meta.rootNode == 0 && meta.firstFreeSlot == 1);
+
+    while (sizes.back() > 1) {
+        // At least 4 children per node keep every inner node with 2 or more.
+        bases.push_back(bases.back() + sizes.back());
+        sizes.push_back(numNodesFor(sizes.back(), layout.capacity + 1, 4));
+    }
+
+    auto parentOf = [&](int level, int position) {
+        if (level + 1 == sizes.size()) {
+            return NULL_NODE_INDEX;
+        }
+        // The last parent starting no later than the position.
+        int n = sizes[level], numParents = sizes[level + 1];
+        return bases[level + 1] +
+               int(((long long)(position + 1) * numParents + n - 1) / n) - 1;
+    };
+
+    // The smallest entry under each node of the last level built.
+    std::vector<IndexEntry> lows(sizes[0]);
+
+    for (int i = 0; i < sizes[0]; i++) {
+        NodeIndex nodeIndex =
+            i == 0 ? meta.rootNode : createNewLeafNode(parentOf(0, i));
+        assert(nodeIndex == bases[0] + i);
+
+        PageHandle handle = getHandle(nodeIndex);
+        Node node = load(nodeIndex, handle);
+
+        int count = start(numEntry, sizes[0], i + 1) -
+                    start(numEntry, sizes[0], i);
+        for (int j = 0; j < count; j++) {
+            node.setEntry(j, next());
+        }
+        node.shared->numEntry = count;
+        node.shared->parent = parentOf(0, i);
+        *node.next = bases[0] + (i + 1) % sizes[0];
+        *node.previous = bases[0] + (i + sizes[0] - 1) % sizes[0];
+        lows[i] = node.getEntry(0);
+
+        PF::markDirty(handle);
+    }
+
+    for (int level = 1; level < sizes.size(); level++) {
+        int numChildren = sizes[level - 1];
+        std::vector<IndexEntry> levelLows(sizes[level]);
+
+        for (int i = 0; i < sizes[level]; i++) {
+            NodeIndex nodeIndex = createNewInnerNode(parentOf(level, i));
+            assert(nodeIndex == bases[level] + i);
+
+            PageHandle handle = getHandle(nodeIndex);
+            Node node = load(nodeIndex, handle);
+
+            int first = start(numChildren, sizes[level], i);
+            int last = start(numChildren, sizes[level], i + 1);
+            for (int j = first; j < last; j++) {
+                node.children[j - first] = bases[level - 1] + j;
+                if (j > first) {
+                    node.setEntry(j - first - 1, lows[j]);
+                }
+            }
+            *node.numChildren = last - first;
+            node.shared->numEntry = last - first - 1;
+            levelLows[i] = lows[first];
+
+            PF::markDirty(handle);
+        }
+
+        lows.swap(levelLows);
+    }
+
+    meta.rootNode = bases.back();
+    meta.numEntry = numEntry;
+}
+
 Index::NodeIndex Index::createNewLeafNode(NodeIndex parent) {
-    SharedNode *sharedNode = getNewNode(parent);
-    sharedNode->isLeaf = true;
+    NodeIndex index = getNewNode(parent);
+    Node node = load(index, getHandle(index));
+    node.shared->isLeaf = true;
 
-    LeafNode *leafNode = (LeafNode *)(sharedNode);
-    leafNode->validBitmap = ~0;
-    leafNode->next = sharedNode->index;
-    leafNode->previous = sharedNode->index;
+    memset(node.validBitmap, ~0, layout.next - layout.validBitmap);
+    *node.next = index;
+    *node.previous = index;
 
-    return sharedNode->index;
+    return index;
 }
 
 Index::NodeIndex Index::createNewInnerNode(NodeIndex parent) {
-    SharedNode *sharedNode = getNewNode(parent);
-    InnerNode *node = (InnerNode *)sharedNode;
+    NodeIndex index = getNewNode(parent);
+    Node node = load(index, getHandle(index));
 
-    node->numChildren = 0;
-    sharedNode->isLeaf = false;
+    *node.numChildren = 0;
+    node.shared->isLeaf = false;
 
-    return sharedNode->index;
+    return index;
 }
 
-Index::SharedNode *Index::getNewNode(NodeIndex parent) {
+Index::NodeIndex Index::getNewNode(NodeIndex parent) {
     // Get and update the free slot.
     NodeIndex index = meta.firstFreeSlot;
     PageHandle handle = getHandle(meta.firstFreeSlot);
 
-    SharedNode *node = load<SharedNode *>(index, handle);
+    SharedNode *node = PF::loadRaw<SharedNode *>(handle);
 
     node->numEntry = 0;
     node->index = index;
@@ -318,131 +1251,121 @@ Index::SharedNode *Index::getNewNode(NodeIndex parent) {
     meta.numNode++;
     meta.firstFreeSlot++;
 
-    return node;
+    return index;
 }
 
-int Index::insertEntry(SharedNode *sharedNode, const IndexEntry &entry) {
+int Index::insertEntry(Node &node, const IndexEntry &entry) {
     // Find the insert position.
-    int index = sharedNode->numEntry;
-    for (int i = 0; i < sharedNode->numEntry; i++) {
-        if (sharedNode->entry[i] > entry) {
+    int index = node.shared->numEntry;
+    for (int i = node.lowerBound(entry); i < node.shared->numEntry; i++) {
+        if (node.compare(i, entry) > 0) {
             index = i;
             break;
         }
     }
 
     // Shift the entries.
-    for (int i = sharedNode->numEntry; i > index; i--) {
-        sharedNode->entry[i] = sharedNode->entry[i - 1];
-    }
+    node.moveEntries(index + 1, node, index, node.shared->numEntry - index);
 
     // Also, shift the valid bitmap!
-    if (sharedNode->isLeaf) {
-        LeafNode *node = (LeafNode *)sharedNode;
-        for (int i = sharedNode->numEntry; i > index; i--) {
-            if (node->valid(i - 1)) {
-                node->validBitmap |= (1L << i);
-            } else {
-                node->validBitmap &= ~(1L << i);
-            }
+    if (node.shared->isLeaf) {
+        for (int i = node.shared->numEntry; i > index; i--) {
+            node.setValid(i, node.valid(i - 1));
         }
-        node->validBitmap |= (1L << index);
+        node.setValid(index, true);
     }
 
-    sharedNode->entry[index] = entry;
-    sharedNode->numEntry++;
+    node.setEntry(index, entry);
+    node.shared->numEntry++;
 
     return index;
 }
 
 void Index::checkOverflowFrom(Index::NodeIndex index) {
     PageHandle nodeHandle = getHandle(index);
-    SharedNode *sharedNode = load<SharedNode *>(index, nodeHandle);
+    Node node = load(index, nodeHandle);
 
-    if (sharedNode->numEntry <= MAX_NUM_ENTRY_PER_NODE) {
+    if (node.shared->numEntry <= layout.capacity) {
         return;
     }
 
 #if DEBUG
-    if (!sharedNode->isLeaf) {
-        assert(((InnerNode *)sharedNode)->numChildren ==
-               sharedNode->numEntry + 1);
+    if (!node.shared->isLeaf) {
+        assert(*node.numChildren == node.shared->numEntry + 1);
     }
 #endif
 
+    bool isLeaf = node.shared->isLeaf;
+
     // Select a victim entry at the middle.
-    int victimIndex = sharedNode->numEntry / 2;
-    IndexEntry victimEntry = sharedNode->entry[victimIndex];
+    int victimIndex = node.shared->numEntry / 2;
+    IndexEntry victimEntry = node.getEntry(victimIndex);
     // Split the node.
-    NodeIndex siblingIndex = sharedNode->isLeaf
-                                 ? createNewLeafNode(sharedNode->parent)
-                                 : createNewInnerNode(sharedNode->parent);
+    NodeIndex siblingIndex = isLeaf ? createNewLeafNode(node.shared->parent)
+                                    : createNewInnerNode(node.shared->parent);
     PageHandle siblingHandle = getHandle(siblingIndex);
-    SharedNode *siblingSharedNode =
-        load<SharedNode *>(siblingIndex, siblingHandle);
+    Node siblingNode = load(siblingIndex, siblingHandle);
 
     // Move the "right" (+victim) entries to the sibling node.
-    siblingSharedNode->numEntry =
-        sharedNode->numEntry - victimIndex - (sharedNode->isLeaf ? 0 : 1);
-    memcpy(siblingSharedNode->entry,
-           &sharedNode->entry[victimIndex + (sharedNode->isLeaf ? 0 : 1)],
-           sizeof(IndexEntry) * siblingSharedNode->numEntry);
-    sharedNode->numEntry = victimIndex;
-
-    // Set the "next" and "previous" pointer in the leaf node.
-    if (sharedNode->isLeaf) {
-        LeafNode *leafNode = (LeafNode *)sharedNode;
-        LeafNode *siblingLeafNode = (LeafNode *)siblingSharedNode;
-        if (leafNode->previous == sharedNode->index) {
-            leafNode->previous = siblingIndex;
+    siblingNode.shared->numEntry =
+        node.shared->numEntry - victimIndex - (isLeaf ? 0 : 1);
+    siblingNode.moveEntries(0, node, victimIndex + (isLeaf ? 0 : 1),
+                            siblingNode.shared->numEntry);
+    node.shared->numEntry = victimIndex;
+
+    // Set the "next" and "previous" pointer in the leaf node, and keep the
+    // entries marked deleted (by older versions) invalid.
+    if (isLeaf) {
+        for (int i = 0; i < siblingNode.shared->numEntry; i++) {
+            siblingNode.setValid(i, node.valid(victimIndex + i));
         }
-        siblingLeafNode->next = leafNode->next;
-        leafNode->next = siblingIndex;
-        siblingLeafNode->previous = sharedNode->index;
+        if (*node.previous == index) {
+            *node.previous = siblingIndex;
+        }
+        *siblingNode.next = *node.next;
+        *node.next = siblingIndex;
+        *siblingNode.previous = index;
     }
 
     // Move the children.
-    if (!sharedNode->isLeaf) {
-        InnerNode *siblingNode = (InnerNode *)siblingSharedNode;
-        InnerNode *node = (InnerNode *)sharedNode;
-
-        siblingNode->numChildren = node->numChildren - victimIndex - 1;
-        memcpy(siblingNode->children, &node->children[victimIndex + 1],
-               sizeof(NodeIndex) * siblingNode->numChildren);
-        node->numChildren = victimIndex + 1;
+    if (!isLeaf) {
+        *siblingNode.numChildren = *node.numChildren - victimIndex - 1;
+        memcpy(siblingNode.children, &node.children[victimIndex + 1],
+               sizeof(NodeIndex) * *siblingNode.numChildren);
+        *node.numChildren = victimIndex + 1;
 
         // Update the parent of the children.
         // FIXME: This requires lots of IO.
-        for (int i = 0; i < siblingNode->numChildren; i++) {
-            NodeIndex childIndex = siblingNode->children[i];
+        for (int i = 0; i < *siblingNode.numChildren; i++) {
+            NodeIndex childIndex = siblingNode.children[i];
             PageHandle childHandle = getHandle(childIndex);
-            SharedNode *childNode = load<SharedNode *>(childIndex, childHandle);
+            SharedNode *childNode = PF::loadRaw<SharedNode *>(childHandle);
             childNode->parent = siblingIndex;
             PF::markDirty(childHandle);
         }
 
 #if DEBUG
-        assert(node->numChildren == sharedNode->numEntry + 1);
-        assert(siblingNode->numChildren == siblingSharedNode->numEntry + 1);
+        assert(*node.numChildren == node.shared->numEntry + 1);
+        assert(*siblingNode.numChildren == siblingNode.shared->numEntry + 1);
 #endif
     }
 
     // Insert the victim entry into the parent node.
 
     // The victim entry is all the root node.
-    if (sharedNode->parent == NULL_NODE_INDEX) {
+    if (node.shared->parent == NULL_NODE_INDEX) {
         NodeIndex newRootIndex = createNewInnerNode(NULL_NODE_INDEX);
         PageHandle newRootHandle = getHandle(newRootIndex);
-        InnerNode *newRootNode = load<InnerNode *>(newRootIndex, newRootHandle);
-        newRootNode->shared.numEntry = 1;
-        newRootNode->numChildren = 2;
-        newRootNode->shared.entry[0] = victimEntry;
-        newRootNode->children[0] = index;
-        newRootNode->children[1] = siblingIndex;
+        Node newRootNode = load(newRootIndex, newRootHandle);
+        newRootNode.shared->numEntry = 1;
+        *newRootNode.numChildren = 2;
+        newRootNode.setEntry(0, victimEntry);
+        newRootNode.children[0] = index;
+        newRootNode.children[1] = siblingIndex;
 
         // Don't forget to update the parent of the children.
-        sharedNode->parent = newRootIndex;
-        siblingSharedNode->parent = newRootIndex;
+        node.shared->parent = newRootIndex;
+        siblingNode.shared->parent = newRootIndex;
 
         // Mark dirty.
         PF::markDirty(siblingHandle);
@@ -456,16 +1379,17 @@ void Index::checkOverflowFrom(Index::NodeIndex index) {
     }
 
     // The parent node exists.
-    PageHandle parentHandle = getHandle(sharedNode->parent);
-    InnerNode *parentNode = load<InnerNode *>(sharedNode->parent, parentHandle);
-    int insertIndex = insertEntry(&parentNode->shared, victimEntry);
+    NodeIndex parentIndex = node.shared->parent;
+    PageHandle parentHandle = getHandle(parentIndex);
+    Node parentNode = load(parentIndex, parentHandle);
+    int insertIndex = insertEntry(parentNode, victimEntry);
 
     // Update the children of the parent node.
-    for (int i = parentNode->numChildren; i > insertIndex + 1; i--) {
-        parentNode->children[i] = parentNode->children[i - 1];
+    for (int i = *parentNode.numChildren; i > insertIndex + 1; i--) {
+        parentNode.children[i] = parentNode.children[i - 1];
     }
-    parentNode->children[insertIndex + 1] = siblingSharedNode->index;
-    parentNode->numChildren++;
+    parentNode.children[insertIndex + 1] = siblingIndex;
+    (*parentNode.numChildren)++;
 
     // Mark dirty.
     PF::markDirty(siblingHandle);
@@ -473,13 +1397,166 @@ void Index::checkOverflowFrom(Index::NodeIndex index) {
     PF::markDirty(parentHandle);
 
     // Check recursively if the parent node overflows.
-    checkOverflowFrom(sharedNode->parent);
+    checkOverflowFrom(parentIndex);
+}
+
+void Index::migrate() {
+    if (meta.headCanary == INDEX_META_CANARY && meta.version == 3) {
+        V3::IndexMeta oldMeta =
+            *PF::loadRaw<V3::IndexMeta *>(PF::getHandle(fd, 0));
+        if (oldMeta.tailCanary != INDEX_META_CANARY) {
+            // Leave it to the canary check.
+            return;
+        }
+
+        Logger::log(NOTICE,
+                    "Index: upgrading the metadata of index file %d of "
+                    "version 3\n",
+                    fd.value);
+
+        meta = IndexMeta();
+        meta.numNode = oldMeta.numNode;
+        meta.numEntry = oldMeta.numEntry;
+        meta.firstFreeSlot = oldMeta.firstFreeSlot;
+        meta.rootNode = oldMeta.rootNode;
+        meta.keySize = oldMeta.keySize;
+        meta.keyColumns[0] = {oldMeta.keyType, oldMeta.columnSize,
+                              oldMeta.keySize};
+
+        flushMeta();
+        return;
+    }
+
+    if (meta.headCanary == INDEX_META_CANARY && meta.version == 2) {
+        V2::IndexMeta oldMeta =
+            *PF::loadRaw<V2::IndexMeta *>(PF::getHandle(fd, 0));
+        if (oldMeta.tailCanary != INDEX_META_CANARY) {
+            // Leave it to the canary check.
+            return;
+        }
+
+        Logger::log(NOTICE,
+                    "Index: upgrading the metadata of index file %d of "
+                    "version 2\n",
+                    fd.value);
+
+        meta = IndexMeta();
+        meta.numNode = oldMeta.numNode;
+        meta.numEntry = oldMeta.numEntry;
+        meta.firstFreeSlot = oldMeta.firstFreeSlot;
+        meta.rootNode = oldMeta.rootNode;
+
+        layout.init(meta.keySize);
+        assert(layout.capacity == V2::MAX_NUM_ENTRY_PER_NODE);
+        assert(layout.records == offsetof(V2::SharedNode, records));
+        assert(layout.nulls == offsetof(V2::SharedNode, nulls));
+        assert(layout.next == offsetof(V2::LeafNode, next));
+        assert(layout.previous == offsetof(V2::LeafNode, previous));
+        assert(layout.children == offsetof(V2::InnerNode, children));
+        assert(layout.numChildren == offsetof(V2::InnerNode, numChildren));
+
+        flushMeta();
+        return;
+    }
+
+    // Collect the valid entries of all the leaf nodes. Nodes are never freed,
+    // so every slot before the first free one holds a node.
+    std::vector<Legacy::IndexEntry> entries;
+
+    if (meta.headCanary == LEGACY_INDEX_META_CANARY) {
+        Legacy::IndexMeta legacyMeta =
+            *PF::loadRaw<Legacy::IndexMeta *>(PF::getHandle(fd, 0));
+        if (legacyMeta.tailCanary != LEGACY_INDEX_META_CANARY) {
+            // Leave it to the canary check.
+            return;
+        }
+
+        Logger::log(NOTICE,
+                    "Index: migrating %d records from a legacy index file %d\n",
+                    legacyMeta.numEntry, fd.value);
+
+        entries.reserve(legacyMeta.numEntry);
+        for (int slot = 0; slot < legacyMeta.firstFreeSlot; slot++) {
+            PageHandle handle =
+                PF::getHandle(fd, slot / Legacy::NUM_SLOT + 1);
+            const Legacy::LeafNode *node =
+                (const Legacy::LeafNode *)(PF::loadRaw(handle) +
+                                           (slot % Legacy::NUM_SLOT) *
+                                               Legacy::SLOT_SIZE);
+            if (!node->isLeaf) {
+                continue;
+            }
+            for (int i = 0; i < node->numEntry; i++) {
+                if (node->validBitmap & (1L << i)) {
+                    entries.push_back(node->entry[i]);
+                }
+            }
+        }
+    } else {
+        V2::IndexMeta oldMeta =
+            *PF::loadRaw<V2::IndexMeta *>(PF::getHandle(fd, 0));
+        if (oldMeta.tailCanary != INDEX_META_CANARY) {
+            return;
+        }
+
+        Logger::log(NOTICE,
+                    "Index: migrating %d records from index file %d of "
+                    "version %d\n",
+                    oldMeta.numEntry, fd.value, oldMeta.version);
+
+        entries.reserve(oldMeta.numEntry);
+        for (int slot = 0; slot < oldMeta.firstFreeSlot; slot++) {
+            const V1::LeafNode *node =
+                PF::loadRaw<const V1::LeafNode *>(PF::getHandle(fd, slot + 1));
+            if (!node->isLeaf) {
+                continue;
+            }
+            for (int i = 0; i < node->numEntry; i++) {
+                if (node->validBitmap[i / 64] & (1ULL << (i % 64))) {
+                    entries.push_back(node->entry[i]);
+                }
+            }
+        }
+    }
+
+    // Rebuild the tree in place.
+    PF::truncate(fd, 1);
+
+    meta = IndexMeta();
+    meta.numNode = 0;
+    meta.numEntry = 0;
+    meta.firstFreeSlot = 0;
+    layout.init(meta.keySize);
+    meta.rootNode = createNewLeafNode(NULL_NODE_INDEX);
+
+    initialized = true;
+    for (const auto &entry : entries) {
+        insert(entry.key, entry.isNull, entry.record);
+    }
+
+    // Persist even if the index is then set read-only.
+    flushMeta();
 }
 
 void Index::flushMeta() {
     PageHandle handle = PF::getHandle(fd, 0);
     memcpy(PF::loadRaw(handle), &meta, sizeof(IndexMeta));
+    if (hashed) {
+        memcpy(PF::loadRaw(handle) + sizeof(IndexMeta), &hashMeta,
+               sizeof(HashMeta));
+    }
     PF::markDirty(handle);
+
+    if (hashed) {
+        const int perPage = PAGE_SIZE / sizeof(NodeIndex);
+        for (int i = 0; i < directory.size(); i += perPage) {
+            handle = getHandle(hashMeta.directoryPages[i / perPage]);
+            memcpy(PF::loadRaw(handle), &directory[i],
+                   sizeof(NodeIndex) *
+                       std::min<size_t>(perPage, directory.size() - i));
+            PF::markDirty(handle);
+        }
+    }
 }
 
 void Index::checkInit() {
@@ -489,6 +1566,404 @@ void Index::checkInit() {
     }
 }
 
+void Index::checkWritable() {
+    if (readOnly) {
+        Logger::log(ERROR,
+                    "Index: internal error: writing into a read-only index\n");
+        throw Internal::WriteOnReadOnlyIndexError();
+    }
+}
+
+Index::Node Index::load(NodeIndex index, PageHandle handle) {
+    char *data = PF::loadRaw(handle);
+
+    Node node;
+    node.shared = (SharedNode *)data;
+    node.prefixes = (int *)(data + layout.prefixes);
+    node.records = (RecordID *)(data + layout.records);
+    node.nulls = (bool *)(data + layout.nulls);
+    node.suffixes = data + layout.suffixes;
+    node.suffixSize = layout.suffixSize;
+    node.validBitmap = (uint64_t *)(data + layout.validBitmap);
+    node.next = (NodeIndex *)(data + layout.next);
+    node.previous = (NodeIndex *)(data + layout.previous);
+    node.children = (NodeIndex *)(data + layout.children);
+    node.numChildren = (int *)(data + layout.numChildren);
+    return node;
+}
+
+// ==== Hash index ====
+void Index::initHashLayout() {
+    hashEntrySize = meta.keySize + sizeof(bool) + sizeof(RecordID);
+    bucketCapacity = (PAGE_SIZE - sizeof(HashBucket)) / hashEntrySize;
+}
+
+uint32_t Index::hashKey(const char *key, int keySize) {
+    // FNV-1a, then mixed as its low bits are taken first.
+    uint32_t hash = 2166136261U;
+    for (int i = 0; i < keySize; i++) {
+        hash = (hash ^ uint8_t(key[i])) * 16777619U;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+Index::IndexEntry Index::getHashEntry(const char *page, int i) {
+    const char *data = page + sizeof(HashBucket) + i * hashEntrySize;
+    IndexEntry entry;
+    memcpy(entry.key, data, meta.keySize);
+    memcpy(&entry.isNull, data + meta.keySize, sizeof(bool));
+    memcpy(&entry.record, data + meta.keySize + sizeof(bool),
+           sizeof(RecordID));
+    return entry;
+}
+
+void Index::setHashEntry(char *page, int i, const IndexEntry &entry) {
+    char *data = page + sizeof(HashBucket) + i * hashEntrySize;
+    memcpy(data, entry.key, meta.keySize);
+    memcpy(data + meta.keySize, &entry.isNull, sizeof(bool));
+    memcpy(data + meta.keySize + sizeof(bool), &entry.record,
+           sizeof(RecordID));
+}
+
+Index::NodeIndex Index::newHashPage() {
+    NodeIndex index = hashMeta.firstFreePage;
+    if (index != NULL_NODE_INDEX) {
+        PageHandle handle = getHandle(index);
+        hashMeta.firstFreePage = PF::loadRaw<HashBucket *>(handle)->overflow;
+    } else {
+        index = meta.firstFreeSlot++;
+    }
+    meta.numNode++;
+    return index;
+}
+
+void Index::freeHashPage(NodeIndex index) {
+    PageHandle handle = getHandle(index);
+    HashBucket *page = PF::loadRaw<HashBucket *>(handle);
+    page->numEntry = 0;
+    page->overflow = hashMeta.firstFreePage;
+    PF::markDirty(handle);
+
+    hashMeta.firstFreePage = index;
+    meta.numNode--;
+}
+
+int Index::hashLowerBound(const char *page, const char *key) {
+    int low = 0, high = ((const HashBucket *)page)->numEntry;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        const char *data = page + sizeof(HashBucket) + middle * hashEntrySize;
+        if (memcmp(data, key, meta.keySize) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void Index::hashInsertInto(char *page, const IndexEntry &entry) {
+    HashBucket *header = (HashBucket *)page;
+    int position = hashLowerBound(page, entry.key);
+    char *data = page + sizeof(HashBucket) + position * hashEntrySize;
+    memmove(data + hashEntrySize, data,
+            (header->numEntry - position) * hashEntrySize);
+    setHashEntry(page, position, entry);
+    header->numEntry++;
+}
+
+void Index::hashInsert(const IndexEntry &entry) {
+    uint32_t hash = hashKey(entry.key, meta.keySize);
+
+    for (;;) {
+        NodeIndex bucket =
+            directory[hash & ((1U << hashMeta.globalDepth) - 1)];
+        PageHandle handle = getHandle(bucket);
+        HashBucket first = *PF::loadRaw<HashBucket *>(handle);
+        if (first.singleHash &&
+            (first.numEntry == 0 ||
+             hashKey(PF::loadRaw(handle) + sizeof(HashBucket),
+                     meta.keySize) != hash)) {
+            // The entry will break the single hash of the chain.
+            PF::loadRaw<HashBucket *>(handle)->singleHash = false;
+            PF::markDirty(handle);
+            first.singleHash = false;
+        }
+
+        // Only the last page of the chain may have room.
+        handle = getHandle(first.last);
+        char *page = PF::loadRaw(handle);
+        if (((HashBucket *)page)->numEntry < bucketCapacity) {
+            hashInsertInto(page, entry);
+            PF::markDirty(handle);
+            return;
+        }
+
+        if (first.localDepth < HASH_INDEX_MAX_DEPTH && !first.singleHash) {
+            if (!hasSameHash(bucket, hash)) {
+                splitBucket(bucket);
+                continue;
+            }
+            handle = getHandle(bucket);
+            PF::loadRaw<HashBucket *>(handle)->singleHash = true;
+            PF::markDirty(handle);
+        }
+
+        // Chain a new page.
+        NodeIndex overflow = newHashPage();
+        handle = getHandle(overflow);
+        page = PF::loadRaw(handle);
+        *(HashBucket *)page = {first.localDepth, false, 1, NULL_NODE_INDEX,
+                               NULL_NODE_INDEX};
+        setHashEntry(page, 0, entry);
+        PF::markDirty(handle);
+
+        handle = getHandle(first.last);
+        PF::loadRaw<HashBucket *>(handle)->overflow = overflow;
+        PF::markDirty(handle);
+
+        handle = getHandle(bucket);
+        PF::loadRaw<HashBucket *>(handle)->last = overflow;
+        PF::markDirty(handle);
+        return;
+    }
+}
+
+void Index::hashRemove(const IndexEntry &entry) {
+    uint32_t hash = hashKey(entry.key, meta.keySize);
+    NodeIndex bucket = directory[hash & ((1U << hashMeta.globalDepth) - 1)];
+
+    // Find the entry along the chain.
+    std::vector<NodeIndex> pages;
+    NodeIndex foundPage = NULL_NODE_INDEX;
+    for (NodeIndex index = bucket; index != NULL_NODE_INDEX;) {
+        pages.push_back(index);
+        PageHandle handle = getHandle(index);
+        char *page = PF::loadRaw(handle);
+        HashBucket *header = (HashBucket *)page;
+        for (int i = hashLowerBound(page, entry.key); i < header->numEntry;
+             i++) {
+            IndexEntry candidate = getHashEntry(page, i);
+            if (memcmp(candidate.key, entry.key, meta.keySize) != 0) {
+                break;
+            }
+            if (candidate.isNull == entry.isNull &&
+                candidate.record == entry.record) {
+                char *data = page + sizeof(HashBucket) + i * hashEntrySize;
+                memmove(data, data + hashEntrySize,
+                        (header->numEntry - i - 1) * hashEntrySize);
+                header->numEntry--;
+                PF::markDirty(handle);
+                foundPage = index;
+                break;
+            }
+        }
+        if (foundPage >= 0) {
+            break;
+        }
+        index = header->overflow;
+    }
+
+    if (foundPage < 0) {
+        throw Internal::IndexKeyNotExistsError();
+    }
+
+    // Keep the pages but the last full, by moving an entry of the last one.
+    PageHandle handle = getHandle(bucket);
+    NodeIndex lastIndex = PF::loadRaw<HashBucket *>(handle)->last;
+    if (foundPage != lastIndex) {
+        handle = getHandle(lastIndex);
+        char *page = PF::loadRaw(handle);
+        HashBucket *last = (HashBucket *)page;
+        IndexEntry moved = getHashEntry(page, --last->numEntry);
+        PF::markDirty(handle);
+
+        handle = getHandle(foundPage);
+        hashInsertInto(PF::loadRaw(handle), moved);
+        PF::markDirty(handle);
+    }
+
+    // Release the emptied page, but the first one.
+    handle = getHandle(lastIndex);
+    if (lastIndex != bucket &&
+        PF::loadRaw<HashBucket *>(handle)->numEntry == 0) {
+        NodeIndex previous = bucket;
+        for (;;) {
+            handle = getHandle(previous);
+            HashBucket *header = PF::loadRaw<HashBucket *>(handle);
+            if (header->overflow == lastIndex) {
+                header->overflow = NULL_NODE_INDEX;
+                PF::markDirty(handle);
+                break;
+            }
+            previous = header->overflow;
+        }
+
+        handle = getHandle(bucket);
+        PF::loadRaw<HashBucket *>(handle)->last = previous;
+        PF::markDirty(handle);
+
+        freeHashPage(lastIndex);
+    }
+}
+
+void Index::hashIterate(const char *key, IterateKeyFunc func) {
+    uint32_t hash = hashKey(key, meta.keySize);
+    NodeIndex index = directory[hash & ((1U << hashMeta.globalDepth) - 1)];
+
+    std::vector<RecordID> records;
+    while (index != NULL_NODE_INDEX) {
+        // The records of a page are collected first, as the callback may
+        // evict it.
+        PageHandle handle = getHandle(index);
+        const char *page = PF::loadRaw(handle);
+        const HashBucket *header = (const HashBucket *)page;
+        for (int i = hashLowerBound(page, key); i < header->numEntry; i++) {
+            const char *data = page + sizeof(HashBucket) + i * hashEntrySize;
+            if (memcmp(data, key, meta.keySize) != 0) {
+                break;
+            }
+            if (!data[meta.keySize]) {
+                RecordID record;
+                memcpy(&record, data + meta.keySize + sizeof(bool),
+                       sizeof(RecordID));
+                records.push_back(record);
+            }
+        }
+        index = header->overflow;
+
+        for (RecordID record : records) {
+            if (!func(record, key)) {
+                return;
+            }
+        }
+        records.clear();
+    }
+}
+
+bool Index::hasSameHash(NodeIndex bucket, uint32_t hash) {
+    for (NodeIndex index = bucket; index != NULL_NODE_INDEX;) {
+        PageHandle handle = getHandle(index);
+        const char *page = PF::loadRaw(handle);
+        const HashBucket *header = (const HashBucket *)page;
+        for (int i = 0; i < header->numEntry; i++) {
+            const char *key = page + sizeof(HashBucket) + i * hashEntrySize;
+            if (hashKey(key, meta.keySize) != hash) {
+                return false;
+            }
+        }
+        index = header->overflow;
+    }
+    return true;
+}
+
+void Index::splitBucket(NodeIndex bucket) {
+    PageHandle handle = getHandle(bucket);
+    int localDepth = PF::loadRaw<HashBucket *>(handle)->localDepth;
+
+    if (localDepth == hashMeta.globalDepth) {
+        // Double the directory, the new half pointing to the same buckets.
+        const int perPage = PAGE_SIZE / sizeof(NodeIndex);
+        int size = directory.size();
+        directory.resize(size * 2);
+        std::copy(directory.begin(), directory.begin() + size,
+                  directory.begin() + size);
+        hashMeta.globalDepth++;
+        while (hashMeta.numDirectoryPage * perPage < int(directory.size())) {
+            hashMeta.directoryPages[hashMeta.numDirectoryPage++] =
+                newHashPage();
+        }
+    }
+
+    // Take the entries and pages of the chain.
+    std::vector<IndexEntry> entries[2];
+    std::vector<NodeIndex> spare;
+    for (NodeIndex index = bucket; index != NULL_NODE_INDEX;) {
+        if (index != bucket) {
+            spare.push_back(index);
+        }
+        handle = getHandle(index);
+        const char *page = PF::loadRaw(handle);
+        const HashBucket *header = (const HashBucket *)page;
+        for (int i = 0; i < header->numEntry; i++) {
+            IndexEntry entry = getHashEntry(page, i);
+            uint32_t hash = hashKey(entry.key, meta.keySize);
+            entries[(hash >> localDepth) & 1].push_back(entry);
+        }
+        index = header->overflow;
+    }
+
+    // Those with the bit set move to the new bucket. The pages are sorted by
+    // the keys.
+    for (auto &half : entries) {
+        std::sort(half.begin(), half.end(),
+                  [&](const IndexEntry &lhs, const IndexEntry &rhs) {
+                      return memcmp(lhs.key, rhs.key, meta.keySize) < 0;
+                  });
+    }
+    NodeIndex newBucket;
+    if (spare.empty()) {
+        newBucket = newHashPage();
+    } else {
+        newBucket = spare.back();
+        spare.pop_back();
+    }
+    writeBucket(bucket, localDepth + 1, entries[0], spare);
+    writeBucket(newBucket, localDepth + 1, entries[1], spare);
+    for (NodeIndex index : spare) {
+        freeHashPage(index);
+    }
+
+    for (int i = 0; i < directory.size(); i++) {
+        if (directory[i] == bucket && ((i >> localDepth) & 1)) {
+            directory[i] = newBucket;
+        }
+    }
+}
+
+void Index::writeBucket(NodeIndex first, int localDepth,
+                        const std::vector<IndexEntry> &entries,
+                        std::vector<NodeIndex> &spare) {
+    NodeIndex index = first;
+    int position = 0;
+
+    for (;;) {
+        int numEntry =
+            std::min<int>(bucketCapacity, entries.size() - position);
+        NodeIndex next = NULL_NODE_INDEX;
+        if (position + numEntry < int(entries.size())) {
+            if (spare.empty()) {
+                next = newHashPage();
+            } else {
+                next = spare.back();
+                spare.pop_back();
+            }
+        }
+
+        PageHandle handle = getHandle(index);
+        char *page = PF::loadRaw(handle);
+        *(HashBucket *)page = {localDepth, false, numEntry, next,
+                               NULL_NODE_INDEX};
+        for (int i = 0; i < numEntry; i++) {
+            setHashEntry(page, i, entries[position + i]);
+        }
+        PF::markDirty(handle);
+        position += numEntry;
+
+        if (next == NULL_NODE_INDEX) {
+            break;
+        }
+        index = next;
+    }
+
+    PageHandle handle = getHandle(first);
+    PF::loadRaw<HashBucket *>(handle)->last = index;
+    PF::markDirty(handle);
+}
+
 #if DEBUG
 void Index::dump() {
     std::queue<NodeIndex> q;
@@ -499,24 +1974,22 @@ void Index::dump() {
         q.pop();
 
         PageHandle handle = getHandle(index);
-        SharedNode *node = load<SharedNode *>(index, handle);
-
-        printf("Node %d (is leaf: %d): ", index, node->isLeaf);
-        if (node->isLeaf) {
-            for (int i = 0; i < node->numEntry; i++) {
-                printf("[%s%d, %d-%d] ",
-                       ((LeafNode *)node)->valid(i) ? "" : "X: ",
-                       node->entry[i].key, node->entry[i].record.page,
-                       node->entry[i].record.slot);
+        Node node = load(index, handle);
+
+        printf("Node %d (is leaf: %d): ", index, node.shared->isLeaf);
+        if (node.shared->isLeaf) {
+            for (int i = 0; i < node.shared->numEntry; i++) {
+                printf("[%s%d, %d-%d] ", node.valid(i) ? "" : "X: ",
+                       node.prefixes[i], node.records[i].page,
+                       node.records[i].slot);
             }
         }
-        printf("( %d : ", node->parent);
+        printf("( %d : ", node.shared->parent);
 
-        if (!node->isLeaf) {
-            InnerNode *innerNode = (InnerNode *)node;
-            for (int i = 0; i < innerNode->numChildren; i++) {
-                q.push(innerNode->children[i]);
-                printf("%d ", innerNode->children[i]);
+        if (!node.shared->isLeaf) {
+            for (int i = 0; i < *node.numChildren; i++) {
+                q.push(node.children[i]);
+                printf("%d ", node.children[i]);
             }
         }
 
@@ -525,27 +1998,144 @@ void Index::dump() {
 }
 #endif
 
-// ==== IndexEntry ====
-bool Index::IndexEntry::operator>(const IndexEntry &rhs) const {
-    if (!isNull) {
-        if (rhs.isNull) {
-            return true;
-        } else {
-            return key > rhs.key || (key == rhs.key && record > rhs.record);
+// ==== NodeLayout ====
+void Index::NodeLayout::init(int keySize) {
+    suffixSize = keySize - sizeof(int);
+
+    auto align = [](int offset, int alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    };
+
+    // Take as many entries as fit in a node. With 4-byte keys, the nodes are
+    // laid out as those of version 2.
+    for (capacity = MAX_NUM_ENTRY_PER_NODE;; capacity--) {
+        // One more entry is held before the node is split.
+        int n = capacity + 1;
+        prefixes = sizeof(SharedNode);
+        records = align(prefixes + sizeof(int) * n, alignof(RecordID));
+        nulls = records + sizeof(RecordID) * n;
+        suffixes = nulls + sizeof(bool) * n;
+        int end = align(suffixes + suffixSize * n, alignof(int));
+
+        validBitmap = align(end, alignof(uint64_t));
+        next = validBitmap + sizeof(uint64_t) * ((capacity + 64) / 64);
+        previous = next + sizeof(NodeIndex);
+
+        children = end;
+        numChildren = children + sizeof(NodeIndex) * (n + 1);
+
+        if (previous + int(sizeof(NodeIndex)) <= INDEX_NODE_SIZE &&
+            numChildren + int(sizeof(int)) <= INDEX_NODE_SIZE) {
+            return;
         }
-    } else {
-        if (!rhs.isNull) {
-            return false;
-        } else {
-            return record > rhs.record;
+    }
+}
+
+// ==== Node ====
+Index::IndexEntry Index::Node::getEntry(int i) const {
+    IndexEntry entry;
+    encodeInt(prefixes[i], entry.key);
+    memcpy(entry.key + sizeof(int), suffixes + i * suffixSize, suffixSize);
+    entry.isNull = nulls[i];
+    entry.record = records[i];
+    return entry;
+}
+
+void Index::Node::setEntry(int i, const IndexEntry &entry) {
+    // NULL entries have zero keys, thus INT_MIN as their prefixes.
+    prefixes[i] = decodeInt(entry.key);
+    memcpy(suffixes + i * suffixSize, entry.key + sizeof(int), suffixSize);
+    nulls[i] = entry.isNull;
+    records[i] = entry.record;
+}
+
+int Index::Node::compareKey(int i, const char *key) const {
+    int prefix = decodeInt(key);
+    if (prefixes[i] != prefix) {
+        return prefixes[i] < prefix ? -1 : 1;
+    }
+    return memcmp(suffixes + i * suffixSize, key + sizeof(int), suffixSize);
+}
+
+int Index::Node::compare(int i, const IndexEntry &entry) const {
+    if (nulls[i] != entry.isNull) {
+        return nulls[i] ? -1 : 1;
+    }
+    if (!nulls[i]) {
+        int result = compareKey(i, entry.key);
+        if (result != 0) {
+            return result;
         }
     }
+    if (records[i] == entry.record) {
+        return 0;
+    }
+    return records[i] > entry.record ? 1 : -1;
+}
+
+void Index::Node::moveEntries(int index, const Node &src, int srcIndex,
+                              int count) {
+    memmove(&prefixes[index], &src.prefixes[srcIndex], sizeof(int) * count);
+    memmove(&records[index], &src.records[srcIndex], sizeof(RecordID) * count);
+    memmove(&nulls[index], &src.nulls[srcIndex], sizeof(bool) * count);
+    memmove(suffixes + index * suffixSize, src.suffixes + srcIndex * suffixSize,
+            suffixSize * count);
 }
 
-bool Index::IndexEntry::operator==(const IndexEntry &rhs) const {
-    return ((isNull && rhs.isNull) || (key == rhs.key)) &&
-           isNull == rhs.isNull && record == rhs.record;
+int Index::Node::lowerBound(const IndexEntry &entry) const {
+    int key = entry.isNull ? INT_MIN : decodeInt(entry.key);
+    int numEntry = shared->numEntry;
+
+    // As the prefixes are sorted, the position is the number of prefixes less
+    // than `key`. Compare a vector of prefixes at a time, until some is not
+    // less.
+    int i = 0;
+    int position = -1;
+#if defined(__AVX2__)
+    const __m256i target = _mm256_set1_epi32(key);
+    for (; i + 8 <= numEntry; i += 8) {
+        __m256i less = _mm256_cmpgt_epi32(
+            target, _mm256_loadu_si256((const __m256i *)&prefixes[i]));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(less));
+        if (mask != 0xFF) {
+            position = i + __builtin_popcount(mask);
+            break;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i target = _mm_set1_epi32(key);
+    for (; i + 4 <= numEntry; i += 4) {
+        __m128i less = _mm_cmpgt_epi32(
+            target, _mm_loadu_si128((const __m128i *)&prefixes[i]));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(less));
+        if (mask != 0xF) {
+            position = i + __builtin_popcount(mask);
+            break;
+        }
+    }
+#endif
+    if (position < 0) {
+        position = i;
+        for (; i < numEntry; i++) {
+            position += prefixes[i] < key;
+        }
+    }
+
+    // Longer keys may share their prefixes, e.g. strings, thus are searched
+    // further by the whole entries.
+    if (suffixSize > 0) {
+        int last = numEntry;
+        while (position < last) {
+            int middle = (position + last) / 2;
+            if (compare(middle, entry) < 0) {
+                position = middle + 1;
+            } else {
+                last = middle;
+            }
+        }
+    }
+    return position;
 }
 
 }  // namespace Internal
-}  // namespace SimpleDB
\ No newline at end of file
+}  // namespace SimpleDB
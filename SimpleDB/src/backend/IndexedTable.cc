@@ -3,14 +3,213 @@
 #include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <sstream>
 #include <vector>
 
+#include "internal/Logger.h"
+
 namespace SimpleDB {
 namespace Internal {
 
-IndexedTable::IndexedTable(Table *table, GetIndexFunc getIndex)
-    : table(table), getIndex(getIndex) {}
+namespace {
+
+// The ranges of the keys of a column meeting some conditions.
+struct KeyRanges {
+    DataType type;
+    int keySize;
+    bool truncated;
+
+    std::vector<Index::Range> ranges;
+    // The keys of NE conditions, split out of the ranges when collapsed.
+    std::vector<Index::Key> excludedKeys;
+
+    // Add the range of the keys of the values meeting the condition. Returns
+    // false if the range is wider, e.g. for FLOAT values, which are equal
+    // within EQUAL_PRECISION, or truncated VARCHAR keys.
+    bool add(const CompareValueCondition &condition);
+    // Intersect the ranges into disjoint ones in order, none if no key meets
+    // all the conditions.
+    void collapse();
+};
+
+bool KeyRanges::add(const CompareValueCondition &condition) {
+    auto encode = [&](const Column &value) {
+        return Index::encodeKey(value, type, keySize);
+    };
+
+    // The key of the value, and those of the smallest and largest values
+    // equal to it.
+    Index::Key key, low, high;
+    bool exact = true;
+
+    switch (type) {
+        case INT:
+            key = low = high = encode(Column(condition.value.intValue));
+            break;
+        case FLOAT: {
+            // Widened by a step for the rounding of the bounds.
+            float value = condition.value.floatValue;
+            key = encode(Column(value));
+            low = encode(Column(
+                std::nextafter(value - EQUAL_PRECISION, -INFINITY)));
+            high = encode(
+                Column(std::nextafter(value + EQUAL_PRECISION, INFINITY)));
+            exact = false;
+            break;
+        }
+        case VARCHAR: {
+            const char *value = condition.value.stringValue;
+            key = low = high = encode(Column(value, MAX_VARCHAR_LEN));
+            exact = !truncated && int(strlen(value)) <= keySize;
+            break;
+        }
+    }
+
+    Index::Key min = Index::minKey(keySize);
+    Index::Key max = Index::maxKey(keySize);
+    Index::Range range;
+
+    switch (condition.op) {
+        case EQ:
+            range = {low, high};
+            break;
+        case NE:
+            if (!exact) {
+                return false;
+            }
+            excludedKeys.push_back(key);
+            return true;
+        case LT:
+            range = {min, key};
+            if (exact && !Index::decrementKey(range.second)) {
+                range = {max, min};
+            }
+            break;
+        case LE:
+            range = {min, high};
+            break;
+        case GT:
+            range = {key, max};
+            if (exact && !Index::incrementKey(range.first)) {
+                range = {max, min};
+            }
+            break;
+        case GE:
+            range = {low, max};
+            break;
+    }
+
+    ranges.push_back(range);
+    return exact;
+}
+
+void KeyRanges::collapse() {
+    Index::Range collapsedRange = {Index::minKey(keySize),
+                                   Index::maxKey(keySize)};
+
+    for (const auto &range : ranges) {
+        collapsedRange.first = std::max(collapsedRange.first, range.first);
+        collapsedRange.second = std::min(collapsedRange.second, range.second);
+    }
+
+    ranges.clear();
+    if (collapsedRange.first > collapsedRange.second) {
+        return;
+    }
+
+    std::sort(excludedKeys.begin(), excludedKeys.end());
+
+    for (const auto &key : excludedKeys) {
+        if (key < collapsedRange.first || key > collapsedRange.second) {
+            continue;
+        }
+
+        if (key == collapsedRange.first) {
+            if (!Index::incrementKey(collapsedRange.first)) {
+                return;
+            }
+        } else if (key == collapsedRange.second) {
+            Index::decrementKey(collapsedRange.second);
+        } else {
+            Index::Range range = {collapsedRange.first, key};
+            Index::decrementKey(range.second);
+            ranges.push_back(range);
+            collapsedRange.first = key;
+            Index::incrementKey(collapsedRange.first);
+        }
+
+        if (collapsedRange.first > collapsedRange.second) {
+            ranges.clear();
+            return;
+        }
+    }
+
+    ranges.push_back(collapsedRange);
+}
+
+bool lessRecord(RecordID lhs, RecordID rhs) {
+    return lhs.page != rhs.page ? lhs.page < rhs.page : lhs.slot < rhs.slot;
+}
+
+// The union of the records in the ranges of the index, sorted by their
+// locations. The records of a clustered table are sorted by their keys, thus
+// also by their pages.
+std::vector<RecordID> findRecords(Index &index,
+                                  const std::vector<Index::Range> &ranges) {
+    std::vector<RecordID> records;
+    for (const auto &range : ranges) {
+        index.iterateRange(range, [&](RecordID id) {
+            records.push_back(id);
+            return true;
+        });
+    }
+    // The ranges are disjoint, so are their records.
+    std::sort(records.begin(), records.end(), lessRecord);
+    return records;
+}
+
+// The number of records in the ranges of the index, only counted up to
+// `limit`.
+int countRecords(Index &index, const std::vector<Index::Range> &ranges,
+                 int limit) {
+    int count = 0;
+    for (const auto &range : ranges) {
+        if (count >= limit) {
+            break;
+        }
+        index.iterateRange(range, [&](RecordID) { return ++count < limit; });
+    }
+    return count;
+}
+
+// Of the sorted records.
+std::vector<RecordID> intersect(const std::vector<RecordID> &lhs,
+                                const std::vector<RecordID> &rhs) {
+    std::vector<RecordID> records;
+    std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                          std::back_inserter(records), lessRecord);
+    return records;
+}
+
+}  // namespace
+
+IndexedTable::IndexedTable(Table *table, GetIndexFunc getIndex,
+                           const std::vector<std::string> &compositeIndexes)
+    : table(table), getIndex(getIndex) {
+    for (const auto &name : compositeIndexes) {
+        std::vector<int> columns;
+        for (const auto &column : getIndexColumns(name)) {
+            columns.push_back(table->getColumnIndex(column.c_str()));
+        }
+        if (std::find(columns.begin(), columns.end(), -1) == columns.end()) {
+            this->compositeIndexes[name] = columns;
+        }
+    }
+}
 
 void IndexedTable::iterate(IterateCallback callback) {
     collapseRanges();
@@ -19,51 +218,225 @@ void IndexedTable::iterate(IterateCallback callback) {
         return;
     }
 
+    if (!intersections.empty() && getIntersectedRecords().empty()) {
+        return;
+    }
+
+    bool stop = false;
+    auto check = [&](RecordID id, Columns &columns) {
+        if (checkResidual(columns)) {
+            stop = !callback(id, columns);
+        }
+        return !stop;
+    };
+    // For the records not found by the bitmap scans.
+    auto checkIntersected = [&](RecordID id, Columns &columns) {
+        if (!intersections.empty() &&
+            !std::binary_search(intersectedRecords.begin(),
+                                intersectedRecords.end(), id, lessRecord)) {
+            return true;
+        }
+        return check(id, columns);
+    };
+
+    if (keyScan) {
+        for (auto &range : ranges) {
+            table->iterateRange(Index::decodeIntKey(range.first),
+                                Index::decodeIntKey(range.second),
+                                checkIntersected);
+            if (stop) {
+                return;
+            }
+        }
+        return;
+    }
+
     if (index == nullptr) {
-        return table->iterate(callback);
+        return table->iterate(check, scanConditions);
     }
 
     Columns columns;
 
+    if (isIndexOnly()) {
+        Logger::log(VERBOSE, "IndexedTable: scanning the index only\n");
+
+        Columns values;
+        for (auto &range : ranges) {
+            index->iterateRangeKeys(range, [&](RecordID id, const char *key) {
+                // The callback may have taken the columns.
+                columns.resize(table->meta.numColumn);
+                index->decodeKey(key, values);
+                for (int i = 0; i < indexColumns.size(); i++) {
+                    columns[indexColumns[i]] = std::move(values[i]);
+                }
+                return checkIntersected(id, columns);
+            });
+            if (stop) {
+                return;
+            }
+        }
+        return;
+    }
+
+    if (!intersections.empty() || expectsManyRecords()) {
+        return bitmapScan(check);
+    }
+
     for (auto &range : ranges) {
         index->iterateRange(range, [&](RecordID id) {
             table->get(id, columns);
-            return callback(id, columns);
+            return check(id, columns);
         });
+        if (stop) {
+            return;
+        }
+    }
+}
+
+int IndexedTable::numMorsels() {
+    collapseRanges();
+
+    if (emptySet || index != nullptr || keyScan || !residualFilters.empty()) {
+        return 0;
+    }
+    return table->numMorsels();
+}
+
+void IndexedTable::iterateMorsel(int morsel, IterateCallback callback) {
+    table->iterateMorsel(morsel, callback, scanConditions);
+}
+
+bool IndexedTable::iterateBatches(BatchCallback callback) {
+    collapseRanges();
+
+    if (emptySet) {
+        return true;
+    }
+    if (index != nullptr || keyScan || !residualFilters.empty()) {
+        return false;
+    }
+    return table->iterateBatches(callback, scanConditions);
+}
+
+bool IndexedTable::count(int &result) {
+    if (!scanConditions.empty()) {
+        return false;
+    }
+
+    collapseRanges();
+
+    if (emptySet) {
+        result = 0;
+        return true;
+    }
+
+    if (keyScan || !residualFilters.empty()) {
+        return false;
+    }
+
+    if (index == nullptr) {
+        return table->count(result);
+    }
+
+    if (!intersections.empty()) {
+        const std::vector<RecordID> &records = getIntersectedRecords();
+        result = 0;
+        for (auto &range : ranges) {
+            index->iterateRange(range, [&](RecordID id) {
+                result += std::binary_search(records.begin(), records.end(),
+                                             id, lessRecord);
+                return true;
+            });
+        }
+        return true;
     }
+
+    result = 0;
+    for (auto &range : ranges) {
+        result += index->countRange(range);
+    }
+    return true;
 }
 
 bool IndexedTable::acceptCondition(const CompareValueCondition &condition) {
+    if (acceptIndexCondition(condition)) {
+        return true;
+    }
+    addScanCondition(condition);
+    return false;
+}
+
+void IndexedTable::addScanCondition(const CompareValueCondition &condition) {
+    scanConditions.push_back(condition);
+}
+
+void IndexedTable::setBitmapScanThreshold(int numRecords, int chunkRecords) {
+    bitmapScanThreshold = numRecords;
+    bitmapScanChunkRecords = chunkRecords;
+}
+
+void IndexedTable::setIntersectionBounds(int minRecords, int maxRecords) {
+    intersectionMinRecords = minRecords;
+    intersectionMaxRecords = maxRecords;
+}
+
+bool IndexedTable::acceptIndexCondition(
+    const CompareValueCondition &condition) {
     if (!condition.columnId.tableName.empty() &&
         condition.columnId.tableName != table->meta.name) {
         return false;
     }
     int columnIndex =
         table->getColumnIndex(condition.columnId.columnName.c_str());
-    if (columnIndex < 0) {
+    if (columnIndex < 0 || collapsed ||
+        !canUseIndex(columnIndex, condition.op)) {
         return false;
     }
-    const ColumnMeta &column = table->meta.columns[columnIndex];
 
-    if (column.type != INT) {
-        return false;
+    // FLOAT values are equal within EQUAL_PRECISION, thus never answered
+    // exactly by the keys.
+    bool checked = table->meta.columns[columnIndex].type == FLOAT;
+    indexConditions.push_back({columnIndex, condition, checked});
+    return !checked;
+}
+
+bool IndexedTable::canUseIndex(int columnIndex, CompareOp op) {
+    if ((table->meta.clustered || table->meta.memory) &&
+        columnIndex == table->meta.primaryKeyIndex) {
+        return true;
     }
 
-    if (index == nullptr) {
-        index = getIndex(table->meta.name, condition.columnId.columnName);
-        columnName = condition.columnId.columnName;
+    auto it = columnIndexes.find(columnIndex);
+    if (it == columnIndexes.end()) {
+        it = columnIndexes
+                 .insert({columnIndex,
+                          getIndex(table->meta.name,
+                                   table->meta.columns[columnIndex].name)})
+                 .first;
+    }
+    // Hash indexes only find the records of a key.
+    if (it->second != nullptr && (!it->second->isHash() || op == EQ)) {
+        return true;
+    }
 
-        if (index == nullptr) {
-            return false;
+    auto hasEqCondition = [&](int column) {
+        for (const auto &indexCondition : indexConditions) {
+            if (indexCondition.columnIndex == column &&
+                indexCondition.condition.op == EQ) {
+                return true;
+            }
         }
-    } else if (columnName != condition.columnId.columnName) {
-        // Only taking the first (indexed) column from the conditions.
         return false;
-    }
-
-    ranges.push_back(makeRange(condition));
+    };
 
-    return true;
+    for (const auto &[_, columns] : compositeIndexes) {
+        auto position = std::find(columns.begin(), columns.end(), columnIndex);
+        if (position != columns.end() &&
+            std::all_of(columns.begin(), position, hasEqCondition)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 std::vector<ColumnInfo> IndexedTable::getColumnInfo() {
@@ -72,71 +445,336 @@ std::vector<ColumnInfo> IndexedTable::getColumnInfo() {
 
 Table *IndexedTable::getTable() { return table; }
 
-Index::Range IndexedTable::makeRange(const CompareValueCondition &condition) {
-    int value = condition.value.intValue;
+std::string IndexedTable::getIndexName(
+    const std::vector<std::string> &columns) {
+    std::string name;
+    for (const auto &column : columns) {
+        name += (name.empty() ? "" : ",") + column;
+    }
+    return name;
+}
 
-    switch (condition.op) {
-        case EQ:
-            return {value, value};
-        case NE:
-            return {value + 1, value - 1};
-        case LT:
-            return {INT_MIN, value - 1};
-        case LE:
-            return {INT_MIN, value};
-        case GT:
-            return {value + 1, INT_MAX};
-        case GE:
-            return {value, INT_MAX};
+std::vector<std::string> IndexedTable::getIndexColumns(
+    const std::string &name) {
+    std::vector<std::string> columns;
+    std::stringstream stream(name);
+    std::string column;
+    while (std::getline(stream, column, ',')) {
+        columns.push_back(column);
     }
+    return columns;
+}
+
+std::vector<IndexedTable::Candidate> IndexedTable::getCandidates() {
+    auto hasCondition = [&](int columnIndex) {
+        for (const auto &indexCondition : indexConditions) {
+            if (indexCondition.columnIndex == columnIndex) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<Candidate> candidates;
+
+    int primaryKeyIndex = table->meta.primaryKeyIndex;
+    if ((table->meta.clustered || table->meta.memory) &&
+        hasCondition(primaryKeyIndex)) {
+        candidates.push_back({nullptr, {primaryKeyIndex}});
+    }
+
+    for (const auto &[columnIndex, index] : columnIndexes) {
+        if (index != nullptr && hasCondition(columnIndex)) {
+            candidates.push_back({index, {columnIndex}});
+        }
+    }
+
+    for (const auto &[name, columns] : compositeIndexes) {
+        if (!hasCondition(columns[0])) {
+            continue;
+        }
+        auto index = getIndex(table->meta.name, name);
+        if (index != nullptr &&
+            index->getNumKeyColumn() == int(columns.size())) {
+            candidates.push_back({index, columns});
+        }
+    }
+
+    return candidates;
 }
 
 void IndexedTable::collapseRanges() {
-    Index::Range collapsedRange = {INT_MIN, INT_MAX};
-    std::vector<int> neValues;
+    // The ranges are split by NE conditions, thus can only be collapsed once.
+    if (collapsed) {
+        return;
+    }
+    collapsed = true;
 
-    for (const auto &range : ranges) {
-        if (range.first > range.second) {
-            assert(range.first == range.second + 2);
-            neValues.push_back(range.first - 1);
+    // The ranges of a candidate, and the conditions answered exactly by them.
+    struct Plan {
+        Candidate candidate;
+        std::vector<Index::Range> ranges;
+        std::vector<bool> answered;
+        int numEq;
+        bool hasRange;
+        bool empty;
+    };
+    std::vector<Plan> plans;
+
+    for (const auto &candidate : getCandidates()) {
+        int keySize = candidate.index == nullptr
+                          ? int(sizeof(int))
+                          : candidate.index->getKeySize();
+        std::vector<bool> candidateAnswered(indexConditions.size(), false);
+
+        // The keys of the equality conditions on the leading columns, then
+        // the ranges of those on the next one.
+        Index::Key prefix;
+        KeyRanges lastRanges;
+        int numEq = 0;
+        bool hasRange = false;
+        bool empty = false;
+
+        for (int i = 0; i < candidate.columns.size(); i++) {
+            int columnIndex = candidate.columns[i];
+            KeyRanges keyRanges;
+            if (candidate.index == nullptr) {
+                keyRanges = {INT, sizeof(int), false};
+            } else {
+                const Index::KeyColumn &keyColumn =
+                    candidate.index->getKeyColumn(i);
+                keyRanges = {keyColumn.type, keyColumn.keySize,
+                             candidate.index->isTruncated(i)};
+            }
+
+            std::vector<int> exact;
+            for (int j = 0; j < indexConditions.size(); j++) {
+                if (indexConditions[j].columnIndex == columnIndex &&
+                    keyRanges.add(indexConditions[j].condition)) {
+                    exact.push_back(j);
+                }
+            }
+            if (keyRanges.ranges.empty() && keyRanges.excludedKeys.empty()) {
+                break;
+            }
+            for (int j : exact) {
+                candidateAnswered[j] = true;
+            }
+
+            keyRanges.collapse();
+            if (keyRanges.ranges.empty()) {
+                empty = true;
+                break;
+            }
+
+            // The values of the columns but the first are led by their NULL
+            // flags.
+            std::string flag = i > 0 ? "\1" : "";
+            const Index::Range &range = keyRanges.ranges[0];
+            if (keyRanges.ranges.size() == 1 && range.first == range.second) {
+                prefix += flag + range.first;
+                numEq++;
+                continue;
+            }
+
+            for (auto &range : keyRanges.ranges) {
+                range.first = prefix + flag + range.first;
+                range.second = prefix + flag + range.second;
+            }
+            lastRanges = std::move(keyRanges);
+            hasRange = true;
+            break;
+        }
+
+        if (!empty && numEq == 0 && !hasRange) {
+            continue;
+        }
+        if (hasRange && candidate.index != nullptr &&
+            candidate.index->isHash()) {
             continue;
         }
 
-        collapsedRange.first = std::max(collapsedRange.first, range.first);
-        collapsedRange.second = std::min(collapsedRange.second, range.second);
+        Plan plan = {candidate, {}, candidateAnswered, numEq, hasRange, empty};
+        if (!empty) {
+            if (!hasRange) {
+                lastRanges.ranges = {{prefix, prefix}};
+            }
+            // The later columns may take any value.
+            for (auto &range : lastRanges.ranges) {
+                range.first.resize(keySize, '\0');
+                range.second.resize(keySize, '\xff');
+                plan.ranges.push_back(range);
+            }
+        }
+        plans.push_back(std::move(plan));
+    }
 
-        if (collapsedRange.first > collapsedRange.second) {
-            emptySet = true;
-            return;
+    // An empty set needs no scan at all, otherwise the more columns the fewer
+    // records. The earlier candidates, on fewer columns, are kept on ties.
+    auto score = [](const Plan &plan) {
+        return plan.empty ? INT_MAX : plan.numEq * 2 + plan.hasRange;
+    };
+    int best = -1;
+    for (int i = 0; i < plans.size(); i++) {
+        if (best < 0 || score(plans[i]) > score(plans[best])) {
+            best = i;
         }
     }
 
-    ranges.clear();
+    std::vector<bool> answered(indexConditions.size(), false);
+    if (best >= 0) {
+        Plan &plan = plans[best];
+        index = plan.candidate.index;
+        indexColumns = plan.candidate.columns;
+        keyScan = plan.candidate.index == nullptr;
+        answered = plan.answered;
+        emptySet = plan.empty;
+        ranges = std::move(plan.ranges);
 
-    std::sort(neValues.begin(), neValues.end());
+        // The records found by the other indexes answering more conditions
+        // are intersected with those found by the chosen one, before reading
+        // the table. Only those with equality conditions on their leading
+        // columns are used, whose records are likely few, and only if both
+        // are within the bounds, which are probed by counting the records up
+        // to them. The records in the ranges of the table are not counted.
+        int numRecords = -1;
+        for (int i = 0; i < plans.size() && !emptySet; i++) {
+            const Plan &other = plans[i];
+            if (i == best || other.numEq == 0 ||
+                other.candidate.index == nullptr) {
+                continue;
+            }
+            bool answersMore = false;
+            for (int j = 0; j < indexConditions.size(); j++) {
+                answersMore |= other.answered[j] && !answered[j];
+            }
+            if (!answersMore) {
+                continue;
+            }
+            if (numRecords < 0) {
+                numRecords = index == nullptr
+                                 ? INT_MAX
+                                 : countRecords(*index, ranges,
+                                                intersectionMinRecords);
+            }
+            if (numRecords < intersectionMinRecords ||
+                countRecords(*other.candidate.index, other.ranges,
+                             intersectionMaxRecords) >=
+                    intersectionMaxRecords) {
+                Logger::log(VERBOSE,
+                            "IndexedTable: skipping an intersection\n");
+                continue;
+            }
+            for (int j = 0; j < indexConditions.size(); j++) {
+                answered[j] = answered[j] || other.answered[j];
+            }
+            intersections.push_back({other.candidate.index, other.ranges});
+        }
+    }
 
-    for (auto neVal : neValues) {
-        if (neVal < collapsedRange.first || neVal > collapsedRange.second) {
+    for (int i = 0; i < indexConditions.size(); i++) {
+        const IndexCondition &indexCondition = indexConditions[i];
+        if (answered[i] || indexCondition.checked) {
             continue;
         }
+        ValueConditionFilter filter;
+        filter.condition = indexCondition.condition;
+        filter.columnIndex = indexCondition.columnIndex;
+        residualFilters.push_back(filter);
+    }
+}
 
-        if (neVal == collapsedRange.first) {
-            collapsedRange.first++;
-        } else if (neVal == collapsedRange.second) {
-            collapsedRange.second--;
-        } else {
-            ranges.push_back({collapsedRange.first, neVal - 1});
-            collapsedRange.first = neVal + 1;
+void IndexedTable::setNeededColumns(ColumnBitmap columns) {
+    neededColumns = columns;
+}
+
+bool IndexedTable::isIndexOnly() {
+    if (index == nullptr) {
+        return false;
+    }
+
+    ColumnBitmap columns = neededColumns;
+    for (const auto &filter : residualFilters) {
+        columns |= ColumnBitmap(1) << filter.columnIndex;
+    }
+    for (int i = 0; i < indexColumns.size(); i++) {
+        if (!index->isTruncated(i)) {
+            columns &= ~(ColumnBitmap(1) << indexColumns[i]);
         }
+    }
 
-        if (collapsedRange.first > collapsedRange.second) {
-            emptySet = true;
+    for (int i = 0; i < table->meta.numColumn; i++) {
+        if (columns & (ColumnBitmap(1) << i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IndexedTable::expectsManyRecords() {
+    return countRecords(*index, ranges, bitmapScanThreshold) >=
+           bitmapScanThreshold;
+}
+
+void IndexedTable::bitmapScan(IterateCallback callback) {
+    Logger::log(VERBOSE, "IndexedTable: bitmap scan\n");
+
+    std::vector<RecordID> chunk;
+    Columns columns;
+    bool stop = false;
+    auto fetch = [&]() {
+        std::sort(chunk.begin(), chunk.end(), lessRecord);
+        for (RecordID id : chunk) {
+            table->get(id, columns);
+            if (!callback(id, columns)) {
+                stop = true;
+                break;
+            }
+        }
+        chunk.clear();
+        return !stop;
+    };
+
+    for (auto &range : ranges) {
+        index->iterateRange(range, [&](RecordID id) {
+            if (!intersections.empty() &&
+                !std::binary_search(intersectedRecords.begin(),
+                                    intersectedRecords.end(), id,
+                                    lessRecord)) {
+                return true;
+            }
+            chunk.push_back(id);
+            return int(chunk.size()) < bitmapScanChunkRecords || fetch();
+        });
+        if (stop) {
             return;
         }
     }
+    fetch();
+}
 
-    ranges.push_back(collapsedRange);
+const std::vector<RecordID> &IndexedTable::getIntersectedRecords() {
+    if (!intersected) {
+        intersected = true;
+        for (int i = 0; i < intersections.size(); i++) {
+            std::vector<RecordID> records =
+                findRecords(*intersections[i].index, intersections[i].ranges);
+            intersectedRecords =
+                i == 0 ? std::move(records)
+                       : intersect(intersectedRecords, records);
+        }
+    }
+    return intersectedRecords;
+}
+
+bool IndexedTable::checkResidual(Columns &columns) {
+    for (auto &filter : residualFilters) {
+        if (!filter.apply(columns).first) {
+            return false;
+        }
+    }
+    return true;
 }
 
 }  // namespace Internal
-}  // namespace SimpleDB
\ No newline at end of file
+}  // namespace SimpleDB
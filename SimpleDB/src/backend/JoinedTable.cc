@@ -1,6 +1,7 @@
 #include "internal/JoinedTable.h"
 
 #include <cassert>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -14,13 +15,54 @@ void JoinedTable::append(std::shared_ptr<IndexedTable> table) {
 
 bool JoinedTable::acceptCondition(const CompareValueCondition &condition) {
     for (auto table : tables) {
-        if (table->acceptCondition(condition)) {
+        if (table->acceptIndexCondition(condition)) {
             return true;
         }
     }
+    // Only when the condition is filtered after the join can the tables use it
+    // to skip pages.
+    for (auto table : tables) {
+        table->addScanCondition(condition);
+    }
     return false;
 }
 
+bool JoinedTable::count(int &result) {
+    int64_t product = 1;
+    for (auto table : tables) {
+        int tableCount;
+        if (!table->count(tableCount)) {
+            return false;
+        }
+        product *= tableCount;
+        if (product > std::numeric_limits<int>::max()) {
+            // Too many rows to be counted, leave it to the scan.
+            return false;
+        }
+    }
+    result = product;
+    return true;
+}
+
+int JoinedTable::numMorsels() {
+    return tables.size() == 1 ? tables[0]->numMorsels() : 0;
+}
+
+void JoinedTable::iterateMorsel(int morsel, IterateCallback callback) {
+    assert(tables.size() == 1);
+    tables[0]->iterateMorsel(morsel, callback);
+}
+
+bool JoinedTable::iterateBatches(BatchCallback callback) {
+    return tables.size() == 1 && tables[0]->iterateBatches(callback);
+}
+
+void JoinedTable::setNeededColumns(ColumnBitmap columns) {
+    if (tables.size() == 1) {
+        tables[0]->setNeededColumns(columns);
+    }
+}
+
 std::vector<ColumnInfo> JoinedTable::getColumnInfo() {
     std::vector<ColumnInfo> result;
     for (auto table : tables) {
@@ -37,11 +79,12 @@ void JoinedTable::iterate(IterateCallback callback) {
     } else if (tables.size() == 2) {
         // A simple nested, pipelined loop join.
         // TODO: Decide join order based on table sizes, indexes...
+        // The joined row is reused across iterations to avoid reallocation.
+        Columns columns;
         tables[0]->iterate([&](RecordID id, const Columns &columns1) {
             bool continue_ = true;
             tables[1]->iterate([&](RecordID id, const Columns &columns2) {
-                Columns columns;
-                columns.insert(columns.end(), columns1.begin(), columns1.end());
+                columns.assign(columns1.begin(), columns1.end());
                 columns.insert(columns.end(), columns2.begin(), columns2.end());
                 continue_ = callback(id, columns);
                 return continue_;
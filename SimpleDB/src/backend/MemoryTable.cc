@@ -0,0 +1,314 @@
+#include "internal/MemoryTable.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "Error.h"
+#include "internal/Logger.h"
+
+namespace SimpleDB {
+namespace Internal {
+
+void MemoryTable::open(const std::string &file, MoveCallback onMove) {
+    Table::open(file, onMove);
+
+    if (!meta.memory) {
+        Logger::log(ERROR,
+                    "MemoryTable: fail to open %s: not a memory table\n",
+                    file.c_str());
+        Table::close();
+        throw Internal::ReadTableError();
+    }
+
+    // The records are not kept across opens.
+    clearRows();
+    meta.numRecords = 0;
+}
+
+void MemoryTable::create(const std::string &file, const std::string &name,
+                         const std::vector<ColumnMeta> &columns,
+                         const std::string &primaryKey,
+                         const std::vector<ForeignKey> &foreignKeys,
+                         bool zoneMap, bool pax, bool clustered) {
+    if (pax || clustered) {
+        Logger::log(ERROR,
+                    "MemoryTable: fail to create table: a memory table has "
+                    "no pages, thus cannot be in the PAX layout or "
+                    "clustered\n");
+        throw Internal::InvalidMemoryTableError("page layout");
+    }
+
+    for (const auto &column : columns) {
+        if (column.dictionary) {
+            Logger::log(ERROR,
+                        "MemoryTable: fail to create table: column %s cannot "
+                        "be dictionary-encoded\n",
+                        column.name);
+            throw Internal::InvalidMemoryTableError("dictionary encoding");
+        }
+    }
+
+    Table::create(file, name, columns, primaryKey, foreignKeys,
+                  /*zoneMap=*/false);
+    meta.memory = true;
+    clearRows();
+}
+
+void MemoryTable::get(RecordID id, Columns &columns,
+                      ColumnBitmap columnBitmap) {
+    checkInit();
+    validateRow(id);
+    deserialize(rowData(id.slot), 0, columns, columnBitmap);
+}
+
+RecordID MemoryTable::insert(const Columns &columns, ColumnBitmap bitmap,
+                             int stream) {
+    checkInit();
+    validateColumnBitmap(columns, bitmap, /*isUpdate=*/false);
+
+    int key = 0;
+    bool hasKey = meta.primaryKeyIndex >= 0;
+    if (hasKey) {
+        getKey(columns, bitmap, key, /*isUpdate=*/false);
+        if (keys.find(key) != keys.end()) {
+            Logger::log(ERROR,
+                        "MemoryTable: key %d exists in memory table %s\n", key,
+                        meta.name);
+            throw Internal::DuplicateKeyError();
+        }
+    }
+
+    int row;
+    if (!freeRows.empty()) {
+        row = freeRows.back();
+        freeRows.pop_back();
+    } else {
+        row = rowOccupied.size();
+        rowOccupied.push_back(false);
+        rows.resize(rows.size() + rowSize());
+    }
+
+    // The null bitmap is only written for the given columns.
+    memset(rowData(row), 0, rowSize());
+    try {
+        serialize(columns, rowData(row), 0, bitmap, /*all=*/true);
+    } catch (BaseError &) {
+        freeRows.push_back(row);
+        throw;
+    }
+
+    rowOccupied[row] = true;
+    if (hasKey) {
+        keys[key] = row;
+    }
+    meta.numRecords++;
+    return {MEMORY_RECORD_PAGE, row};
+}
+
+std::vector<RecordID> MemoryTable::insertBatch(
+    const std::vector<Columns> &rows, ColumnBitmap bitmap) {
+    std::vector<RecordID> ids;
+    ids.reserve(rows.size());
+    for (const auto &columns : rows) {
+        ids.push_back(insert(columns, bitmap));
+    }
+    return ids;
+}
+
+void MemoryTable::update(RecordID id, const Columns &columns,
+                         ColumnBitmap bitmap) {
+    checkInit();
+    validateColumnBitmap(columns, bitmap, /*isUpdate=*/true);
+    validateRow(id);
+
+    int key, oldKey;
+    bool keyChanged = meta.primaryKeyIndex >= 0 &&
+                      getKey(columns, bitmap, key, /*isUpdate=*/true) &&
+                      key != (oldKey = readKey(rowData(id.slot), 0));
+    if (keyChanged && keys.find(key) != keys.end()) {
+        Logger::log(ERROR, "MemoryTable: key %d exists in memory table %s\n",
+                    key, meta.name);
+        throw Internal::DuplicateKeyError();
+    }
+
+    serialize(columns, rowData(id.slot), 0, bitmap, /*all=*/false);
+
+    if (keyChanged) {
+        keys.erase(oldKey);
+        keys[key] = id.slot;
+    }
+}
+
+void MemoryTable::remove(RecordID id) {
+    checkInit();
+    validateRow(id);
+
+    if (meta.primaryKeyIndex >= 0) {
+        keys.erase(readKey(rowData(id.slot), 0));
+    }
+    rowOccupied[id.slot] = false;
+    freeRows.push_back(id.slot);
+    meta.numRecords--;
+}
+
+Table::CompactResult MemoryTable::compact(int maxMoves,
+                                          MoveCallback callback) {
+    checkInit();
+
+    Logger::log(VERBOSE, "MemoryTable: compacting table %s, at most %d moves\n",
+                meta.name, maxMoves);
+
+    CompactResult result;
+    Columns columns;
+    // The lowest freed rows are filled first.
+    std::sort(freeRows.begin(), freeRows.end());
+    size_t nextFree = 0;
+    int lastRow = int(rowOccupied.size()) - 1;
+
+    while (true) {
+        while (lastRow >= 0 && !rowOccupied[lastRow]) {
+            lastRow--;
+        }
+        if (nextFree == freeRows.size() || freeRows[nextFree] > lastRow) {
+            // No freed row is left before the last record.
+            result.done = true;
+            break;
+        }
+        if (result.numMovedRecords >= maxMoves) {
+            break;
+        }
+
+        int to = freeRows[nextFree++];
+        memcpy(rowData(to), rowData(lastRow), rowSize());
+        rowOccupied[to] = true;
+        rowOccupied[lastRow] = false;
+        if (meta.primaryKeyIndex >= 0) {
+            keys[readKey(rowData(to), 0)] = to;
+        }
+
+        deserialize(rowData(to), 0, columns, COLUMN_BITMAP_ALL);
+        result.numMovedRecords++;
+        callback({MEMORY_RECORD_PAGE, lastRow}, {MEMORY_RECORD_PAGE, to},
+                 columns);
+    }
+
+    // The rows moved from are all after the last record, and released with
+    // the other freed rows there.
+    while (lastRow >= 0 && !rowOccupied[lastRow]) {
+        lastRow--;
+    }
+    freeRows.erase(freeRows.begin(), freeRows.begin() + nextFree);
+    freeRows.erase(std::remove_if(freeRows.begin(), freeRows.end(),
+                                  [&](int row) { return row > lastRow; }),
+                   freeRows.end());
+    rowOccupied.resize(lastRow + 1);
+    rows.resize(size_t(lastRow + 1) * rowSize());
+    rows.shrink_to_fit();
+
+    Logger::log(VERBOSE, "MemoryTable: moved %d records of %s\n",
+                result.numMovedRecords, meta.name);
+
+    return result;
+}
+
+void MemoryTable::iterateRange(int low, int high, IterateCallback callback) {
+    checkInit();
+
+    Columns bufColumns;
+
+    if (low == high) {
+        RecordID id = findKey(low);
+        if (id != RecordID::NULL_RECORD) {
+            deserialize(rowData(id.slot), 0, bufColumns, COLUMN_BITMAP_ALL);
+            callback(id, bufColumns);
+        }
+        return;
+    }
+
+    bool all = low == std::numeric_limits<int>::min() &&
+               high == std::numeric_limits<int>::max();
+    for (int row = 0; row < rowOccupied.size(); row++) {
+        if (!rowOccupied[row]) {
+            continue;
+        }
+        if (!all) {
+            int key = readKey(rowData(row), 0);
+            if (key < low || key > high) {
+                continue;
+            }
+        }
+        deserialize(rowData(row), 0, bufColumns, COLUMN_BITMAP_ALL);
+        if (!callback({MEMORY_RECORD_PAGE, row}, bufColumns)) {
+            return;
+        }
+    }
+}
+
+RecordID MemoryTable::findKey(int key) {
+    checkInit();
+    auto iter = keys.find(key);
+    if (iter == keys.end()) {
+        return RecordID::NULL_RECORD;
+    }
+    return {MEMORY_RECORD_PAGE, iter->second};
+}
+
+void MemoryTable::setPrimaryKey(const std::string &field) {
+    Table::setPrimaryKey(field);
+
+    for (int row = 0; row < rowOccupied.size(); row++) {
+        if (rowOccupied[row]) {
+            keys[readKey(rowData(row), 0)] = row;
+        }
+    }
+}
+
+void MemoryTable::dropPrimaryKey(const std::string &field) {
+    Table::dropPrimaryKey(field);
+    keys.clear();
+}
+
+void MemoryTable::close() {
+    Table::close();
+    clearRows();
+}
+
+void MemoryTable::iterate(
+    IterateCallback callback,
+    const std::vector<CompareValueCondition> &conditions) {
+    iterateRange(std::numeric_limits<int>::min(),
+                 std::numeric_limits<int>::max(), callback);
+}
+
+int MemoryTable::rowSize() { return sizeof(RecordMeta) + meta.recordSize; }
+
+char *MemoryTable::rowData(int row) {
+    // A row is addressed as the first slot of a page in the row layout.
+    return rows.data() + size_t(row) * rowSize();
+}
+
+void MemoryTable::clearRows() {
+    rows.clear();
+    rowOccupied.clear();
+    freeRows.clear();
+    keys.clear();
+}
+
+void MemoryTable::validateRow(RecordID id) {
+    bool valid = id.page == MEMORY_RECORD_PAGE && id.slot >= 0 &&
+                 id.slot < rowOccupied.size() && rowOccupied[id.slot];
+    if (!valid) {
+        Logger::log(ERROR,
+                    "MemoryTable: record (%d, %d) not found in memory table "
+                    "%s\n",
+                    id.page, id.slot, meta.name);
+        throw Internal::InvalidSlotError();
+    }
+}
+
+}  // namespace Internal
+}  // namespace SimpleDB
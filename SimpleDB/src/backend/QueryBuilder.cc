@@ -1,5 +1,12 @@
 #include "internal/QueryBuilder.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #include "Error.h"
@@ -112,6 +119,11 @@ QueryBuilder &QueryBuilder::offset(int offset) {
     return *this;
 }
 
+QueryBuilder &QueryBuilder::parallel(int numThreads) {
+    this->numThreads = numThreads;
+    return *this;
+}
+
 QueryBuilder::Result QueryBuilder::execute() {
     Result result;
 
@@ -127,9 +139,25 @@ QueryBuilder::Result QueryBuilder::execute() {
 void QueryBuilder::iterate(IterateCallback callback) {
     checkDataSource();
 
-    // TODO: Check if is all about COUNT(*)
+    // Answer COUNT(*) from the data source if it knows the number of records,
+    // without iterating over them.
+    int count;
+    if (isCountStarOnly() && getDataSource()->count(count)) {
+        Columns columns = {Column(count)};
+        callback(RecordID::NULL_RECORD, columns);
+        return;
+    }
+
+    if (aggregateBatches(callback)) {
+        return;
+    }
+
+    if (numThreads > 1 && iterateParallel(callback)) {
+        return;
+    }
 
     AggregatedFilter filter = aggregateAllFilters();
+    getDataSource()->setNeededColumns(getNeededColumns());
 
     getDataSource()->iterate([&](RecordID rid, Columns &columns) {
         auto [accept, continue_] = filter.apply(columns);
@@ -207,6 +235,254 @@ bool QueryBuilder::validForUpdateOrDelete() const {
            offsetFilter.offset == 0;
 }
 
+bool QueryBuilder::iterateParallel(IterateCallback callback) {
+    QueryDataSource *dataSource = getDataSource();
+    int numMorsels = dataSource->numMorsels();
+    int numWorkers = std::min(numThreads, numMorsels);
+    if (numWorkers <= 1 || numMorsels < PARALLEL_SCAN_MIN_MORSELS) {
+        return false;
+    }
+
+    Logger::log(VERBOSE, "QueryBuilder: scanning %d morsels with %d workers\n",
+                numMorsels, numWorkers);
+
+    // Each worker runs its own copy of the condition and select filters. The
+    // offset and limit are applied when merging the results in order. Copy
+    // the filters before they are built.
+    std::vector<QueryBuilder> workers(numWorkers, *this);
+    AggregatedFilter filter = aggregateAllFilters();
+
+    std::vector<AggregatedFilter> workerFilters(numWorkers);
+    for (int i = 0; i < numWorkers; i++) {
+        workers[i].offsetFilter = OffsetFilter();
+        workers[i].limitFilter = LimitFilter();
+        workerFilters[i] = workers[i].aggregateAllFilters();
+    }
+
+    bool aggregated = selectFilter.isAggregated;
+    // Rows accepted in each morsel, if not aggregated, which are passed to
+    // the callback in the order of the morsels by this thread, as soon as
+    // the morsel is done. The workers only run ahead by a few morsels, so
+    // that at most those are held in memory.
+    std::vector<Result> morselResults(numMorsels);
+    std::vector<char> morselDone(numMorsels, false);
+    int numConsumed = 0;
+    const int maxAhead = 2 * numWorkers;
+    int numWanted = aggregated || limitFilter.limit < 0
+                        ? -1
+                        : offsetFilter.offset + limitFilter.limit;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    int nextMorsel = 0;
+    std::atomic<bool> stop = false;
+    std::vector<std::exception_ptr> errors(numWorkers);
+
+    auto work = [&](int worker) {
+        try {
+            for (;;) {
+                int morsel;
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait(lock, [&]() {
+                        return stop || aggregated ||
+                               nextMorsel < numConsumed + maxAhead;
+                    });
+                    if (stop || nextMorsel >= numMorsels) {
+                        break;
+                    }
+                    morsel = nextMorsel++;
+                }
+
+                Result result;
+                dataSource->iterateMorsel(
+                    morsel, [&](RecordID rid, Columns &columns) {
+                        auto [accept, _] = workerFilters[worker].apply(columns);
+                        if (accept && !aggregated) {
+                            result.emplace_back(rid, columns);
+                        }
+                        // No morsel gives more rows than wanted.
+                        return !stop && (numWanted < 0 ||
+                                         int(result.size()) < numWanted);
+                    });
+
+                if (!aggregated) {
+                    std::lock_guard lock(mutex);
+                    morselResults[morsel] = std::move(result);
+                    morselDone[morsel] = true;
+                }
+                condition.notify_all();
+            }
+        } catch (...) {
+            errors[worker] = std::current_exception();
+            {
+                std::lock_guard lock(mutex);
+                stop = true;
+            }
+            condition.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = aggregated ? 1 : 0; i < numWorkers; i++) {
+        threads.emplace_back(work, i);
+    }
+
+    std::exception_ptr callbackError;
+    if (aggregated) {
+        work(0);
+    } else {
+        try {
+            for (int morsel = 0; morsel < numMorsels && !stop; morsel++) {
+                Result result;
+                {
+                    std::unique_lock lock(mutex);
+                    condition.wait(
+                        lock, [&]() { return stop || morselDone[morsel]; });
+                    if (!morselDone[morsel]) {
+                        break;
+                    }
+                    result = std::move(morselResults[morsel]);
+                    numConsumed++;
+                }
+                condition.notify_all();
+
+                for (auto &[rid, columns] : result) {
+                    auto [accept, continue_] = offsetFilter.apply(columns);
+                    if (accept) {
+                        std::tie(accept, continue_) =
+                            limitFilter.apply(columns);
+                    }
+                    if ((accept && !callback(rid, columns)) || !continue_) {
+                        stop = true;
+                        break;
+                    }
+                }
+            }
+        } catch (...) {
+            callbackError = std::current_exception();
+        }
+        {
+            std::lock_guard lock(mutex);
+            stop = true;
+        }
+        condition.notify_all();
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (callbackError) {
+        std::rethrow_exception(callbackError);
+    }
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    if (aggregated) {
+        for (auto &worker : workers) {
+            selectFilter.merge(worker.selectFilter);
+        }
+        Columns columns;
+        if (filter.finalize(columns)) {
+            callback(RecordID::NULL_RECORD, columns);
+        }
+    }
+    return true;
+}
+
+bool QueryBuilder::aggregateBatches(IterateCallback callback) {
+    if (selectFilter.selectors.empty() || !columnConditionFilters.empty()) {
+        return false;
+    }
+    for (const auto &selector : selectFilter.selectors) {
+        if (selector.type == QuerySelector::COLUMN) {
+            return false;
+        }
+    }
+
+    // Build the filters on a copy, which is dropped if the batches cannot be
+    // used, so that the filters of this builder are built only once.
+    QueryBuilder builder = *this;
+    AggregatedFilter filter = builder.aggregateAllFilters();
+    for (const auto &valueFilter : builder.valueConditionFilters) {
+        if (builder.virtualTable.columns[valueFilter.columnIndex].type ==
+            VARCHAR) {
+            return false;
+        }
+    }
+
+    bool supported =
+        getDataSource()->iterateBatches([&](const RecordBatch &batch) {
+            RecordBatch::Mask mask = batch.mask;
+            for (auto &nullFilter : builder.nullConditionFilters) {
+                mask = nullFilter.applyBatch(batch, mask);
+            }
+            for (auto &valueFilter : builder.valueConditionFilters) {
+                mask = valueFilter.applyBatch(batch, mask);
+            }
+            builder.selectFilter.applyBatch(batch, mask);
+            return true;
+        });
+    if (!supported) {
+        return false;
+    }
+
+    Logger::log(VERBOSE, "QueryBuilder: aggregated the data source in "
+                         "batches\n");
+
+    Columns columns;
+    if (filter.finalize(columns)) {
+        callback(RecordID::NULL_RECORD, columns);
+    }
+    return true;
+}
+
+bool QueryBuilder::isCountStarOnly() const {
+    return selectFilter.selectors.size() == 1 &&
+           selectFilter.selectors[0].type == QuerySelector::COUNT_STAR &&
+           valueConditionFilters.empty() && columnConditionFilters.empty() &&
+           nullConditionFilters.empty();
+}
+
+ColumnBitmap QueryBuilder::getNeededColumns() const {
+    // All the columns are passed on without selectors.
+    if (selectFilter.selectors.empty()) {
+        return COLUMN_BITMAP_ALL;
+    }
+
+    std::vector<int> indexes;
+    for (int index : selectFilter.selectIndexes) {
+        // -1 for COUNT(*).
+        if (index >= 0) {
+            indexes.push_back(index);
+        }
+    }
+    for (const auto &filter : valueConditionFilters) {
+        indexes.push_back(filter.columnIndex);
+    }
+    for (const auto &filter : nullConditionFilters) {
+        indexes.push_back(filter.columnIndex);
+    }
+    for (const auto &filter : columnConditionFilters) {
+        indexes.push_back(filter.columnIndex1);
+        indexes.push_back(filter.columnIndex2);
+    }
+
+    ColumnBitmap columns = 0;
+    for (int index : indexes) {
+        // The columns of joined tables may not fit.
+        if (index >= MAX_COLUMNS) {
+            return COLUMN_BITMAP_ALL;
+        }
+        columns |= ColumnBitmap(1) << index;
+    }
+    return columns;
+}
+
 void QueryBuilder::checkDataSource() {
     if (getDataSource() == nullptr) {
         throw NoScanDataSourceError();
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 #include <regex>
 
@@ -229,6 +230,131 @@ bool SelectFilter::finalize(Columns &columns) {
 
     return true;
 }
+
+void SelectFilter::merge(const SelectFilter &other) {
+    assert(isAggregated && other.isAggregated);
+    assert(other.selectContexts.size() == selectContexts.size());
+
+    for (size_t i = 0; i < selectors.size(); i++) {
+        auto &context = selectContexts[i];
+        const auto &otherContext = other.selectContexts[i];
+        if (otherContext.isNull) {
+            continue;
+        }
+        if (context.isNull) {
+            context = otherContext;
+            continue;
+        }
+        context.count += otherContext.count;
+
+        DataType dataType = selectIndexes[i] == -1
+                                ? INT
+                                : table->columns[selectIndexes[i]].type;
+
+#define MERGE(_type)                                                    \
+    auto value = otherContext.value._type;                              \
+    switch (selectors[i].type) {                                        \
+        case QuerySelector::MIN:                                        \
+            context.value._type = std::min(context.value._type, value); \
+            break;                                                      \
+        case QuerySelector::MAX:                                        \
+            context.value._type = std::max(context.value._type, value); \
+            break;                                                      \
+        default:                                                        \
+            /* COUNT, SUM and AVG */                                    \
+            context.value._type += value;                               \
+    }
+        if (dataType == INT) {
+            MERGE(intValue);
+        } else {
+            MERGE(floatValue);
+        }
+#undef MERGE
+    }
+}
+
+template <typename T>
+static T _loadBatchValue(const RecordBatch::Vector &vector, int i) {
+    T value;
+    memcpy(&value, vector.data + i * vector.stride, sizeof(T));
+    return value;
+}
+
+// Aggregate the values of the records in `valid` into `result`, which must be
+// initialized. Branch-free where possible, so that the loops are vectorized.
+template <typename T>
+static void _aggregateBatch(QuerySelector::Type type,
+                            const RecordBatch::Vector &vector, int size,
+                            RecordBatch::Mask valid, T &result) {
+    switch (type) {
+        case QuerySelector::MIN:
+            for (int i = 0; i < size; i++) {
+                T value = _loadBatchValue<T>(vector, i);
+                result = ((valid >> i) & 1) ? std::min(result, value) : result;
+            }
+            break;
+        case QuerySelector::MAX:
+            for (int i = 0; i < size; i++) {
+                T value = _loadBatchValue<T>(vector, i);
+                result = ((valid >> i) & 1) ? std::max(result, value) : result;
+            }
+            break;
+        case QuerySelector::SUM:
+        case QuerySelector::AVG:
+            for (int i = 0; i < size; i++) {
+                T value = _loadBatchValue<T>(vector, i);
+                result += ((valid >> i) & 1) ? value : T(0);
+            }
+            break;
+        default:
+            assert(false);
+    }
+}
+
+void SelectFilter::applyBatch(const RecordBatch &batch,
+                              RecordBatch::Mask mask) {
+    assert(isAggregated);
+
+    for (size_t i = 0; i < selectors.size(); i++) {
+        auto &selector = selectors[i];
+        auto &context = selectContexts[i];
+        if (selector.type == QuerySelector::COUNT_STAR) {
+            context.initializeInt(0);
+            context.value.intValue += __builtin_popcountll(mask);
+            continue;
+        }
+
+        int column = selectIndexes[i];
+        RecordBatch::Mask valid = mask & batch.nonNull(column);
+        int numValid = __builtin_popcountll(valid);
+        context.count += numValid;
+        if (selector.type == QuerySelector::COUNT_COL) {
+            context.initializeInt(0);
+            context.value.intValue += numValid;
+            continue;
+        }
+        if (numValid == 0) {
+            continue;
+        }
+
+        // MIN and MAX start from any value in the batch.
+        bool fromValue = selector.type == QuerySelector::MIN ||
+                         selector.type == QuerySelector::MAX;
+        const auto &vector = batch.columns[column];
+        int first = __builtin_ctzll(valid);
+        if (table->columns[column].type == INT) {
+            context.initializeInt(
+                fromValue ? _loadBatchValue<int>(vector, first) : 0);
+            _aggregateBatch<int>(selector.type, vector, batch.size, valid,
+                                 context.value.intValue);
+        } else {
+            context.initializeFloat(
+                fromValue ? _loadBatchValue<float>(vector, first) : 0);
+            _aggregateBatch<float>(selector.type, vector, batch.size, valid,
+                                   context.value.floatValue);
+        }
+    }
+}
 // ====== End SelectFilter ======
 
 // ===== Begin NullConditionFilter =====
@@ -246,6 +372,12 @@ std::pair<bool, bool> NullConditionFilter::apply(Columns &columns) {
                   (!condition.isNull && !column.isNull);
     return {accept, true};
 }
+
+RecordBatch::Mask NullConditionFilter::applyBatch(const RecordBatch &batch,
+                                                  RecordBatch::Mask mask) {
+    RecordBatch::Mask nonNull = batch.nonNull(columnIndex);
+    return mask & (condition.isNull ? ~nonNull : nonNull);
+}
 // ====== End NullConditionFilter ======
 
 // ===== Begin ValueConditionFilter =====
@@ -327,10 +459,71 @@ std::pair<bool, bool> ValueConditionFilter::apply(Columns &columns) {
 
     _Comparer comparer = _getComparer(column.type);
 
-    return {comparer(condition.op, column.data.stringValue,
-                     condition.value.stringValue),
+    return {comparer(condition.op, column.raw(), condition.value.stringValue),
             true};
 }
+
+template <typename T, typename Compare>
+static RecordBatch::Mask _matchBatch(const RecordBatch::Vector &vector,
+                                     int size, Compare compare) {
+    RecordBatch::Mask result = 0;
+    for (int i = 0; i < size; i++) {
+        int32_t value = _loadBatchValue<int32_t>(vector, i);
+        result |= RecordBatch::Mask(compare(T((const char *)&value))) << i;
+    }
+    return result;
+}
+
+// The comparison is dispatched once for the whole batch.
+template <typename T>
+static RecordBatch::Mask _compareBatch(CompareOp op,
+                                       const RecordBatch::Vector &vector,
+                                       int size, const char *rhs) {
+    T r(rhs);
+    switch (op) {
+        case EQ:
+            return _matchBatch<T>(vector, size, [&](T l) { return l == r; });
+        case NE:
+            return _matchBatch<T>(vector, size, [&](T l) { return l != r; });
+        case LT:
+            return _matchBatch<T>(vector, size, [&](T l) { return l < r; });
+        case LE:
+            return _matchBatch<T>(vector, size, [&](T l) { return l <= r; });
+        case GT:
+            return _matchBatch<T>(vector, size, [&](T l) { return l > r; });
+        case GE:
+            return _matchBatch<T>(vector, size, [&](T l) { return l >= r; });
+        default:
+            Logger::log(ERROR,
+                        "RecordScanner: internal error: invalid compare op %d "
+                        "for _compareBatch<T>\n",
+                        op);
+            throw Internal::UnexpedtedOperatorError();
+    }
+}
+
+RecordBatch::Mask ValueConditionFilter::applyBatch(const RecordBatch &batch,
+                                                   RecordBatch::Mask mask) {
+    // Null values never satisfy a condition.
+    mask &= batch.nonNull(columnIndex);
+    if (mask == 0) {
+        return 0;
+    }
+
+    const auto &vector = batch.columns[columnIndex];
+    const char *rhs = condition.value.stringValue;
+    switch (table->columns[columnIndex].type) {
+        case INT:
+            return mask & _compareBatch<_Int>(condition.op, vector,
+                                              batch.size, rhs);
+        case FLOAT:
+            return mask & _compareBatch<_Float>(condition.op, vector,
+                                                batch.size, rhs);
+        default:
+            assert(false);
+            return 0;
+    }
+}
 // ====== End ValueConditionFilter ======
 
 // ===== Begin ColumnConditionFilter =====
@@ -354,8 +547,7 @@ std::pair<bool, bool> ColumnConditionFilter::apply(Columns &columns) {
 
     _Comparer comparer = _getComparer(column1.type);
 
-    return {comparer(condition.op, column1.data.stringValue,
-                     column2.data.stringValue),
+    return {comparer(condition.op, column1.raw(), column2.raw()),
             true};
 }
 
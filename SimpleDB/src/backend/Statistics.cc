@@ -0,0 +1,147 @@
+#include "internal/Statistics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace SimpleDB {
+namespace Internal {
+
+std::string ColumnStatistics::valueDesc(const Column &column) {
+    if (column.isNull) {
+        return "NULL";
+    }
+    switch (column.type) {
+        case INT:
+            return std::to_string(column.data.intValue);
+        case FLOAT: {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%g", column.data.floatValue);
+            return buf;
+        }
+        case VARCHAR:
+            return column.raw();
+    }
+    return {};
+}
+
+std::string ColumnStatistics::histogramDesc() const {
+    std::string desc;
+    for (double bound : histogram) {
+        if (!desc.empty()) {
+            desc += ",";
+        }
+        desc += valueDesc(type == INT ? Column(int(bound))
+                                      : Column(float(bound)));
+    }
+    return desc;
+}
+
+ColumnStatisticsCollector::ColumnStatisticsCollector(DataType type,
+                                                     int numBuckets)
+    : type(type), numBuckets(numBuckets) {
+    stats.type = type;
+    stats.min = Column::nullColumn(type, 0);
+    stats.max = Column::nullColumn(type, 0);
+}
+
+void ColumnStatisticsCollector::add(const Column &column) {
+    stats.rowCount++;
+    if (column.isNull) {
+        stats.nullCount++;
+        return;
+    }
+
+    if (stats.min.isNull || compare(column, stats.min) < 0) {
+        stats.min = column;
+    }
+    if (stats.max.isNull || compare(column, stats.max) > 0) {
+        stats.max = column;
+    }
+
+    uint64_t hashValue = hash(column);
+    if (minHashes.size() < NDV_SKETCH_SIZE) {
+        minHashes.insert(hashValue);
+    } else if (hashValue < *minHashes.rbegin() &&
+               minHashes.insert(hashValue).second) {
+        minHashes.erase(std::prev(minHashes.end()));
+    }
+
+    if (type != VARCHAR) {
+        double value =
+            type == INT ? column.data.intValue : column.data.floatValue;
+        if (values.size() < HISTOGRAM_SAMPLE_SIZE) {
+            values.push_back(value);
+        } else {
+            // Keep the i-th value with probability K / i.
+            uint64_t i = random() % uint64_t(stats.rowCount - stats.nullCount);
+            if (i < HISTOGRAM_SAMPLE_SIZE) {
+                values[i] = value;
+            }
+        }
+    }
+}
+
+ColumnStatistics ColumnStatisticsCollector::finish() {
+    if (minHashes.size() < NDV_SKETCH_SIZE) {
+        stats.ndv = minHashes.size();
+    } else {
+        // The K-th smallest of the uniformly distributed hashes is expected
+        // to be at (K - 1) / NDV of the hash space.
+        double kth = double(*minHashes.rbegin()) / double(UINT64_MAX);
+        double estimate = (NDV_SKETCH_SIZE - 1) / kth;
+        stats.ndv = std::min<double>(estimate,
+                                     stats.rowCount - stats.nullCount);
+    }
+
+    std::sort(values.begin(), values.end());
+    int n = values.size();
+    int buckets = std::min(numBuckets, n);
+    for (int i = 1; i <= buckets; i++) {
+        stats.histogram.push_back(values[int64_t(i) * n / buckets - 1]);
+    }
+    if (buckets > 0) {
+        // The maximum might be missed by the sample.
+        stats.histogram.back() =
+            type == INT ? stats.max.data.intValue : stats.max.data.floatValue;
+    }
+
+    minHashes.clear();
+    values.clear();
+    return std::move(stats);
+}
+
+uint64_t ColumnStatisticsCollector::hash(const Column &column) {
+    uint64_t x;
+    if (column.type == VARCHAR) {
+        x = std::hash<std::string_view>()(column.raw());
+    } else {
+        uint32_t bits;
+        memcpy(&bits, &column.data.intValue, sizeof(bits));
+        x = bits;
+    }
+
+    // The splitmix64 finalizer, as std::hash might be the identity.
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+int ColumnStatisticsCollector::compare(const Column &lhs, const Column &rhs) {
+    switch (lhs.type) {
+        case INT:
+            return (lhs.data.intValue > rhs.data.intValue) -
+                   (lhs.data.intValue < rhs.data.intValue);
+        case FLOAT:
+            return (lhs.data.floatValue > rhs.data.floatValue) -
+                   (lhs.data.floatValue < rhs.data.floatValue);
+        case VARCHAR:
+            return strcmp(lhs.raw(), rhs.raw());
+    }
+    return 0;
+}
+
+}  // namespace Internal
+}  // namespace SimpleDB
@@ -2,10 +2,15 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <iterator>
+#include <limits>
+#include <new>
 #include <set>
 #include <string>
 #include <vector>
@@ -15,10 +20,121 @@
 #include "internal/Logger.h"
 #include "internal/Macros.h"
 #include "internal/PageFile.h"
+#include "internal/QueryFilter.h"
 
 namespace SimpleDB {
 namespace Internal {
 
+namespace {
+
+// The metadata of the formats before it was versioned, each told by its
+// canary, LEGACY_TABLE_META_CANARY + version. The data pages are laid out as
+// now, but start at page 1 in version 0 (without the free-space map) and
+// page 2 before version 4 (without the dictionary page).
+namespace Legacy {
+
+// Before version 4, without dictionary encoding.
+struct ColumnMeta {
+    DataType type;
+    ColumnSizeType size;
+    bool nullable;
+    char name[MAX_COLUMN_NAME_LEN];
+    bool hasDefault;
+    ColumnValue defaultValue;
+};
+
+// Never stored, but kept in the layout.
+struct ForeignKeys {
+    alignas(ForeignKey) char data[sizeof(ForeignKey) * MAX_FOREIGN_KEYS];
+};
+
+struct TableMetaV0 {
+    uint16_t headCanary;
+    char name[MAX_TABLE_NAME_LEN + 1];
+    uint32_t numColumn;
+    ColumnMeta columns[MAX_COLUMNS];
+    int primaryKeyIndex;
+    ForeignKeys foreignKeys;
+    uint16_t numUsedPages;
+    uint16_t firstFree;
+    int recordSize;
+    uint16_t tailCanary;
+};
+
+// Also the metadata of version 2 with `hasZoneMap`, and of version 3 with
+// `numRecords`.
+struct TableMetaV1 {
+    uint16_t headCanary;
+    char name[MAX_TABLE_NAME_LEN + 1];
+    uint32_t numColumn;
+    ColumnMeta columns[MAX_COLUMNS];
+    int primaryKeyIndex;
+    ForeignKeys foreignKeys;
+    uint16_t numUsedPages;
+    int recordSize;
+    uint16_t tailCanary;
+};
+
+struct TableMetaV2 {
+    uint16_t headCanary;
+    char name[MAX_TABLE_NAME_LEN + 1];
+    uint32_t numColumn;
+    ColumnMeta columns[MAX_COLUMNS];
+    int primaryKeyIndex;
+    ForeignKeys foreignKeys;
+    uint16_t numUsedPages;
+    int recordSize;
+    bool hasZoneMap;
+    uint16_t tailCanary;
+};
+
+struct TableMetaV3 {
+    uint16_t headCanary;
+    char name[MAX_TABLE_NAME_LEN + 1];
+    uint32_t numColumn;
+    ColumnMeta columns[MAX_COLUMNS];
+    int primaryKeyIndex;
+    ForeignKeys foreignKeys;
+    uint16_t numUsedPages;
+    int numRecords;
+    int recordSize;
+    bool hasZoneMap;
+    uint16_t tailCanary;
+};
+
+// Versions 4 to 7 only add flags before `dictionarySize`, the tables written
+// by each being without the features added later.
+template <int numFlag>
+struct TableMetaV4 {
+    uint16_t headCanary;
+    char name[MAX_TABLE_NAME_LEN + 1];
+    uint32_t numColumn;
+    Internal::ColumnMeta columns[MAX_COLUMNS];
+    int primaryKeyIndex;
+    ForeignKeys foreignKeys;
+    uint16_t numUsedPages;
+    int numRecords;
+    int recordSize;
+    // hasZoneMap, pax, clustered, memory.
+    bool flags[numFlag];
+    int dictionarySize;
+    uint16_t tailCanary;
+};
+
+}  // namespace Legacy
+
+// The first entry with a key not less than `key`.
+std::vector<std::pair<int, int>>::iterator lowerBound(
+    std::vector<std::pair<int, int>> &entries, int key) {
+    return std::lower_bound(
+        entries.begin(), entries.end(), key,
+        [](const std::pair<int, int> &entry, int key) {
+            return entry.first < key;
+        });
+}
+
+}  // namespace
+
 const RecordID RecordID::NULL_RECORD = {-1, -1};
 bool RecordID::operator==(const RecordID &rhs) const {
     return page == rhs.page && slot == rhs.slot;
@@ -35,7 +151,8 @@ std::string ColumnMeta::typeDesc() const {
         case FLOAT:
             return "FLOAT";
         case VARCHAR:
-            return "VARCHAR(" + std::to_string(size) + ")";
+            return "VARCHAR(" + std::to_string(size) + ")" +
+                   (dictionary ? " DICTIONARY" : "");
     }
 }
 
@@ -55,7 +172,7 @@ std::string ColumnMeta::defaultValDesc() const {
 
 Table::~Table() { close(); }
 
-void Table::open(const std::string &file) {
+void Table::open(const std::string &file, MoveCallback onMove) {
     Logger::log(VERBOSE, "Table: initializing table from %s\n", file.c_str());
 
     if (initialized) {
@@ -71,7 +188,15 @@ void Table::open(const std::string &file) {
         fd = PF::open(file);
         // The metadata is written in the first page.
         PageHandle handle = PF::getHandle(fd, 0);
-        meta = *PF::loadRaw<TableMeta *>(handle);
+        uint16_t canary = *PF::loadRaw<uint16_t *>(handle);
+        // The metadata of an older format is read by the migration, which
+        // also checks its tail canary.
+        if (canary >= LEGACY_TABLE_META_CANARY && canary < TABLE_META_CANARY) {
+            meta.headCanary = canary;
+            migrate(onMove);
+        } else {
+            meta = *PF::loadRaw<TableMeta *>(handle);
+        }
     } catch (BaseError) {
         Logger::log(ERROR, "Table: fail to read table metadata from file %d\n",
                     fd.value);
@@ -88,18 +213,35 @@ void Table::open(const std::string &file) {
         throw Internal::ReadTableError();
     }
 
+    if (meta.version != TABLE_FORMAT_VERSION) {
+        Logger::log(ERROR,
+                    "Table: fail to read table metadata from file %d: "
+                    "unsupported format version %d\n",
+                    fd.value, meta.version);
+        throw Internal::ReadTableError();
+    }
+
     // Initialize name mapping.
     for (int i = 0; i < meta.numColumn; i++) {
         columnNameMap[meta.columns[i].name] = i;
     }
 
+    initLayout();
+    freePageHint = FIRST_DATA_PAGE;
+    streamPageHints.clear();
+    zoneMapCache.clear();
+    zoneMapCached.clear();
+    resetPageHandleCache();
+    loadDictionaries();
+    loadClusterDirectory();
     initialized = true;
 }
 
 void Table::create(const std::string &file, const std::string &name,
                    const std::vector<ColumnMeta> &columns,
                    const std::string &primaryKey,
-                   const std::vector<ForeignKey> &foreignKeys) {
+                   const std::vector<ForeignKey> &foreignKeys, bool zoneMap,
+                   bool pax, bool clustered) {
     Logger::log(VERBOSE, "Table: initializing empty table to %s\n",
                 file.c_str());
 
@@ -138,6 +280,11 @@ void Table::create(const std::string &file, const std::string &name,
         }
     }
 
+    if (clustered && primaryKeyIndex == -1) {
+        throw InvalidPrimaryKeyError(
+            "a clustered table must have a primary key");
+    }
+
     if (name.size() > MAX_TABLE_NAME_LEN) {
         Logger::log(
             ERROR,
@@ -146,8 +293,8 @@ void Table::create(const std::string &file, const std::string &name,
         throw Internal::CreateTableError();
     }
 
-    meta.firstFree = 1;
-    meta.numUsedPages = 1;
+    meta.numUsedPages = FIRST_DATA_PAGE;
+    meta.numRecords = 0;
     meta.numColumn = columns.size();
     meta.primaryKeyIndex = primaryKeyIndex;
     strcpy(meta.name, name.c_str());
@@ -175,11 +322,19 @@ void Table::create(const std::string &file, const std::string &name,
             throw Internal::DuplicateColumnNameError();
         }
 
+        if (columns[i].dictionary && columns[i].type != VARCHAR) {
+            Logger::log(ERROR,
+                        "Table: create table failed: column %s is not VARCHAR, "
+                        "thus cannot be dictionary-encoded\n",
+                        columns[i].name);
+            throw Internal::InvalidDictionaryColumnError();
+        }
+
         meta.columns[i] = columns[i];
         meta.columns[i].size = columns[i].type == VARCHAR ? columns[i].size : 4;
         columnNameMap[columns[i].name] = i;
 
-        totalSize += columns[i].size;
+        totalSize += columnStorageSize(i);
     }
 
     // Check and add foreign keys.
@@ -227,6 +382,12 @@ void Table::create(const std::string &file, const std::string &name,
     }
 
     meta.recordSize = totalSize;
+    meta.hasZoneMap = zoneMap;
+    meta.pax = pax;
+    meta.clustered = clustered;
+    meta.memory = false;
+    meta.dictionarySize = 0;
+    initLayout();
 
     try {
         // Create and open the file.
@@ -243,6 +404,19 @@ void Table::create(const std::string &file, const std::string &name,
 
     fd = PF::open(file);
 
+    // Initialize an empty free space map.
+    PageHandle handle = PF::getHandle(fd, FREE_SPACE_MAP_PAGE);
+    memset(PF::loadRaw(handle), 0, PAGE_SIZE);
+    PF::markDirty(handle);
+
+    freePageHint = FIRST_DATA_PAGE;
+    streamPageHints.clear();
+    zoneMapCache.clear();
+    zoneMapCached.clear();
+    resetPageHandleCache();
+    clearDictionaries();
+    clusterDirectory.clear();
+    clearClusterEntries();
     initialized = true;
 }
 
@@ -252,6 +426,173 @@ void Table::flushMeta() {
     PF::markDirty(handle);
 }
 
+void Table::migrate(MoveCallback onMove) {
+    int version = meta.headCanary - LEGACY_TABLE_META_CANARY;
+    const char *data = PF::loadRaw(PF::getHandle(fd, 0));
+
+    TableMeta newMeta;
+    bool valid = false;
+    int firstDataPage = FIRST_DATA_PAGE;
+    bool countRecords = false;
+
+    // The fields in all the versions.
+    auto upgrade = [&](const auto &oldMeta) {
+        valid = oldMeta.tailCanary == oldMeta.headCanary;
+        memcpy(newMeta.name, oldMeta.name, sizeof(newMeta.name));
+        newMeta.numColumn = std::min<uint32_t>(oldMeta.numColumn, MAX_COLUMNS);
+        for (int i = 0; i < newMeta.numColumn; i++) {
+            const auto &column = oldMeta.columns[i];
+            newMeta.columns[i].type = column.type;
+            newMeta.columns[i].size = column.size;
+            newMeta.columns[i].nullable = column.nullable;
+            memcpy(newMeta.columns[i].name, column.name,
+                   sizeof(column.name));
+            newMeta.columns[i].hasDefault = column.hasDefault;
+            newMeta.columns[i].defaultValue = column.defaultValue;
+        }
+        newMeta.primaryKeyIndex = oldMeta.primaryKeyIndex;
+        newMeta.numUsedPages = oldMeta.numUsedPages;
+        newMeta.recordSize = oldMeta.recordSize;
+        newMeta.numRecords = 0;
+        newMeta.hasZoneMap = false;
+        newMeta.pax = false;
+        newMeta.clustered = false;
+        newMeta.memory = false;
+        newMeta.dictionarySize = 0;
+    };
+
+    // The flags of versions 4 to 7.
+    auto upgradeFlags = [&](const auto &oldMeta) {
+        upgrade(oldMeta);
+        for (int i = 0; i < newMeta.numColumn; i++) {
+            newMeta.columns[i].dictionary = oldMeta.columns[i].dictionary;
+        }
+        newMeta.numRecords = oldMeta.numRecords;
+        newMeta.dictionarySize = oldMeta.dictionarySize;
+        bool *flags[] = {&newMeta.hasZoneMap, &newMeta.pax,
+                         &newMeta.clustered, &newMeta.memory};
+        for (int i = 0; i < std::size(oldMeta.flags); i++) {
+            *flags[i] = oldMeta.flags[i];
+        }
+    };
+
+    switch (version) {
+        case 0:
+            upgrade(*(const Legacy::TableMetaV0 *)data);
+            firstDataPage = 1;
+            countRecords = true;
+            break;
+        case 1:
+            upgrade(*(const Legacy::TableMetaV1 *)data);
+            firstDataPage = 2;
+            countRecords = true;
+            break;
+        case 2: {
+            const auto &oldMeta = *(const Legacy::TableMetaV2 *)data;
+            upgrade(oldMeta);
+            newMeta.hasZoneMap = oldMeta.hasZoneMap;
+            firstDataPage = 2;
+            countRecords = true;
+            break;
+        }
+        case 3: {
+            const auto &oldMeta = *(const Legacy::TableMetaV3 *)data;
+            upgrade(oldMeta);
+            newMeta.hasZoneMap = oldMeta.hasZoneMap;
+            newMeta.numRecords = oldMeta.numRecords;
+            firstDataPage = 2;
+            break;
+        }
+        case 4:
+            upgradeFlags(*(const Legacy::TableMetaV4<1> *)data);
+            break;
+        case 5:
+            upgradeFlags(*(const Legacy::TableMetaV4<2> *)data);
+            break;
+        case 6:
+            upgradeFlags(*(const Legacy::TableMetaV4<3> *)data);
+            break;
+        case 7:
+            upgradeFlags(*(const Legacy::TableMetaV4<4> *)data);
+            break;
+    }
+    if (!valid) {
+        // Leave it to the canary check.
+        return;
+    }
+
+    Logger::log(NOTICE,
+                "Table: upgrading table file %d of version %d, %d pages\n",
+                fd.value, version, int(newMeta.numUsedPages));
+
+    meta = newMeta;
+    initLayout();
+    resetPageHandleCache();
+
+    if (firstDataPage < FIRST_DATA_PAGE) {
+        // Move the data pages taking the place of the free-space map and the
+        // dictionary page to the end, keeping the slots of the records.
+        int numUsedPages = std::max<int>(meta.numUsedPages, FIRST_DATA_PAGE);
+        std::vector<char> buffer(PAGE_SIZE);
+        Columns columns;
+        for (int page = firstDataPage;
+             page < std::min<int>(meta.numUsedPages, FIRST_DATA_PAGE);
+             page++) {
+            if (numUsedPages == std::numeric_limits<PageCountType>::max()) {
+                Logger::log(ERROR, "Table: table %s has too many pages\n",
+                            meta.name);
+                throw Internal::TableFullError();
+            }
+            int newPage = numUsedPages++;
+            memcpy(buffer.data(), PF::loadRaw(PF::getHandle(fd, page)),
+                   PAGE_SIZE);
+            PageHandle handle = PF::getHandle(fd, newPage);
+            memcpy(PF::loadRaw(handle), buffer.data(), PAGE_SIZE);
+            PF::markDirty(handle);
+
+            PageMeta *pageMeta = (PageMeta *)buffer.data();
+            for (int slot = numHeaderSlots(); slot < numSlotPerPage();
+                 slot++) {
+                if ((pageMeta->occupied & (1LL << slot)) == 0) {
+                    continue;
+                }
+                if (onMove != nullptr) {
+                    deserialize(buffer.data(), slot, columns,
+                                COLUMN_BITMAP_ALL);
+                    onMove({page, slot}, {newPage, slot}, columns);
+                }
+            }
+        }
+        meta.numUsedPages = numUsedPages;
+
+        // Both are rebuilt from scratch, the dictionary being empty.
+        for (int page : {FREE_SPACE_MAP_PAGE, DICTIONARY_PAGE}) {
+            PageHandle handle = PF::getHandle(fd, page);
+            memset(PF::loadRaw(handle), 0, PAGE_SIZE);
+            PF::markDirty(handle);
+        }
+        for (int page = FIRST_DATA_PAGE; page < meta.numUsedPages; page++) {
+            PageHandle handle = getHandle(page);
+            PageMeta *pageMeta = PF::loadRaw<PageMeta *>(handle);
+            // The free list of version 0.
+            pageMeta->lowKey = std::numeric_limits<int32_t>::min();
+            PF::markDirty(handle);
+            markPageFree(page, !isPageFull(pageMeta));
+        }
+    }
+
+    if (countRecords) {
+        for (int page = FIRST_DATA_PAGE; page < meta.numUsedPages; page++) {
+            PageHandle handle = getHandle(page);
+            meta.numRecords += __builtin_popcountll(
+                uint64_t(PF::loadRaw<PageMeta *>(handle)->occupied &
+                         ~headerSlotMask()));
+        }
+    }
+
+    flushMeta();
+}
+
 void Table::flushPageMeta(int page, const PageMeta &meta) {
     PageHandle handle = PF::getHandle(fd, page);
     memcpy(PF::loadRaw(handle), &meta, sizeof(PageMeta));
@@ -263,11 +604,12 @@ void Table::get(RecordID id, Columns &columns, ColumnBitmap columnBitmap) {
                 id.slot);
 
     checkInit();
+    id = locate(id);
     validateSlot(id.page, id.slot);
 
-    PageHandle *handle = getHandle(id.page);
+    PageHandle handle = getHandle(id.page);
 
-    if (!occupied(*handle, id.slot)) {
+    if (!occupied(handle, id.slot)) {
         Logger::log(
             ERROR,
             "Table: fail to get record: page %d slot %d is not occupied\n",
@@ -275,8 +617,7 @@ void Table::get(RecordID id, Columns &columns, ColumnBitmap columnBitmap) {
         throw Internal::InvalidSlotError();
     }
 
-    char *start = PF::loadRaw(*handle) + id.slot * slotSize();
-    deserialize(start, columns, columnBitmap);
+    deserialize(PF::loadRaw(handle), id.slot, columns, columnBitmap);
 }
 
 Columns Table::get(RecordID id, ColumnBitmap columnBitmap) {
@@ -285,29 +626,111 @@ Columns Table::get(RecordID id, ColumnBitmap columnBitmap) {
     return columns;
 }
 
-RecordID Table::insert(const Columns &columns, ColumnBitmap bitmap) {
+RecordID Table::insert(const Columns &columns, ColumnBitmap bitmap,
+                        int stream) {
     checkInit();
 
+    // Validate the bitmap.
+    validateColumnBitmap(columns, bitmap, /*isUpdate=*/false);
+
     // Find an empty slot.
-    auto id = getEmptySlot();
+    int key = 0;
+    if (meta.clustered) {
+        getKey(columns, bitmap, key, /*isUpdate=*/false);
+    }
+    auto id = meta.clustered ? getClusterSlot(key) : getEmptySlot(stream);
 
     Logger::log(VERBOSE, "Table: insert record to page %d slot %d\n", id.page,
                 id.slot);
 
-    // Validate the bitmap.
-    validateColumnBitmap(columns, bitmap, /*isUpdate=*/false);
+    PageHandle handle = getHandle(id.page);
+    char *data = PF::loadRaw(handle);
 
-    PageHandle *handle = getHandle(id.page);
-    char *start = PF::loadRaw(*handle) + id.slot * slotSize();
-
-    serialize(columns, start, bitmap, /*all=*/true);
+    serialize(columns, data, id.slot, bitmap, /*all=*/true);
 
     // Mark the page as dirty.
-    PF::markDirty(*handle);
+    PF::markDirty(handle);
+    meta.numRecords++;
+
+    ZoneMap delta{};
+    addToZoneMap(delta, data, id.slot);
+    mergeZoneMap(id.page, delta);
 
     // We don't need to flush meta here.
 
-    return id;
+    return meta.clustered ? clusterRecord(key) : id;
+}
+
+std::vector<RecordID> Table::insertBatch(const std::vector<Columns> &rows,
+                                         ColumnBitmap bitmap) {
+    checkInit();
+
+    Logger::log(VERBOSE, "Table: inserting %ld records in a batch\n",
+                rows.size());
+
+    // Validate all the bitmaps before touching any page.
+    for (const auto &columns : rows) {
+        validateColumnBitmap(columns, bitmap, /*isUpdate=*/false);
+    }
+
+    std::vector<RecordID> ids;
+    ids.reserve(rows.size());
+
+    if (meta.clustered) {
+        // Each record goes to the page covering its key.
+        for (const auto &columns : rows) {
+            ids.push_back(insert(columns, bitmap));
+        }
+        return ids;
+    }
+
+    size_t next = 0;
+    while (next < rows.size()) {
+        int page = findFreePage(freePageHint);
+        if (page < 0) {
+            page = createPage();
+            Logger::log(VERBOSE,
+                        "Table: all pages are full, created a new page %d\n",
+                        page);
+        }
+        freePageHint = page;
+
+        PageHandle handle = getHandle(page);
+        PageMeta *pageMeta = PF::loadRaw<PageMeta *>(handle);
+
+        if (pageMeta->headCanary != PAGE_META_CANARY ||
+            pageMeta->tailCanary != PAGE_META_CANARY) {
+            Logger::log(ERROR,
+                        "Table: page %d meta corrupted: head canary %d, tail "
+                        "canary %d\n",
+                        page, pageMeta->headCanary, pageMeta->tailCanary);
+            throw Internal::InvalidPageMetaError();
+        }
+
+        // The page is modified from now on, even if serialization fails.
+        PF::markDirty(handle);
+
+        char *base = PF::loadRaw(handle);
+        ZoneMap delta{};
+        while (next < rows.size() && !isPageFull(pageMeta)) {
+            int slot = ffsll(~pageMeta->occupied) - 1;
+            serialize(rows[next], base, slot, bitmap, /*all=*/true);
+            addToZoneMap(delta, base, slot);
+            pageMeta->occupied |= (1LL << slot);
+            ids.push_back({page, slot});
+            meta.numRecords++;
+            next++;
+        }
+        assert(handle.validate());
+
+        if (isPageFull(pageMeta)) {
+            markPageFree(page, false);
+        }
+        mergeZoneMap(page, delta);
+    }
+
+    // Like insert(), the table meta is flushed on close.
+    return ids;
 }
 
 void Table::update(RecordID id, const Columns &columns, ColumnBitmap bitmap) {
@@ -315,11 +738,26 @@ void Table::update(RecordID id, const Columns &columns, ColumnBitmap bitmap) {
                 id.page, id.slot);
 
     checkInit();
+
+    // Validate the bitmap.
+    validateColumnBitmap(columns, bitmap, /*isUpdate=*/true);
+
+    int key;
+    if (meta.clustered && getKey(columns, bitmap, key, /*isUpdate=*/true) &&
+        key != id.slot) {
+        Logger::log(ERROR,
+                    "Table: fail to update record: cannot change the key %d "
+                    "of clustered table %s\n",
+                    id.slot, meta.name);
+        throw Internal::ClusterKeyUpdateError();
+    }
+
+    id = locate(id);
     validateSlot(id.page, id.slot);
 
-    PageHandle *handle = getHandle(id.page);
+    PageHandle handle = getHandle(id.page);
 
-    if (!occupied(*handle, id.slot)) {
+    if (!occupied(handle, id.slot)) {
         Logger::log(
             ERROR,
             "Table: fail to update record: page %d slot %d is not occupied\n",
@@ -327,14 +765,15 @@ void Table::update(RecordID id, const Columns &columns, ColumnBitmap bitmap) {
         throw Internal::InvalidSlotError();
     }
 
-    // Validate the bitmap.
-    validateColumnBitmap(columns, bitmap, /*isUpdate=*/true);
-
-    char *start = PF::loadRaw(*handle) + id.slot * slotSize();
-    serialize(columns, start, bitmap, /*all=*/false);
+    char *data = PF::loadRaw(handle);
+    serialize(columns, data, id.slot, bitmap, /*all=*/false);
 
     // Mark dirty.
-    PF::markDirty(*handle);
+    PF::markDirty(handle);
+
+    ZoneMap delta{};
+    addToZoneMap(delta, data, id.slot);
+    mergeZoneMap(id.page, delta);
 }
 
 void Table::remove(RecordID id) {
@@ -342,11 +781,13 @@ void Table::remove(RecordID id) {
                 id.page, id.slot);
 
     checkInit();
+    int key = id.slot;
+    id = locate(id);
     validateSlot(id.page, id.slot);
 
-    PageHandle *handle = getHandle(id.page);
+    PageHandle handle = getHandle(id.page);
 
-    if (!occupied(*handle, id.slot)) {
+    if (!occupied(handle, id.slot)) {
         Logger::log(
             ERROR,
             "Table: fail to remove record: page %d slot %d is not occupied\n",
@@ -354,21 +795,105 @@ void Table::remove(RecordID id) {
         throw Internal::InvalidSlotError();
     }
 
-    PageMeta *pageMeta = PF::loadRaw<PageMeta *>(*handle);
-
-    // Check previous occupation.
-    if (isPageFull(pageMeta)) {
-        // The page now will have an empty slot. Add it to the free list.
-        pageMeta->nextFree = meta.firstFree;
-        meta.firstFree = id.page;
-    }
+    PageMeta *pageMeta = PF::loadRaw<PageMeta *>(handle);
 
     // Mark the slot as unoccupied.
     pageMeta->occupied &= ~(1L << id.slot);
 
     // As we are dealing with the pointer directly, we don't need to flush.
-    PF::markDirty(*handle);
-    assert(handle->validate());
+    PF::markDirty(handle);
+    assert(handle.validate());
+    meta.numRecords--;
+
+    if (pageMeta->occupied == headerSlotMask()) {
+        resetZoneMap(id.page);
+    }
+
+    if (meta.clustered) {
+        auto &entries = clusterEntries(id.page);
+        entries.erase(lowerBound(entries, key));
+    }
+
+    // The empty slot is visible to the following inserts immediately.
+    markPageFree(id.page, true);
+    freePageHint = std::min(freePageHint, id.page);
+}
+
+Table::CompactResult Table::compact(int maxMoves, MoveCallback callback) {
+    checkInit();
+
+    Logger::log(VERBOSE, "Table: compacting table %s, at most %d moves\n",
+                meta.name, maxMoves);
+
+    CompactResult result;
+    if (meta.clustered) {
+        // Moving the records would break the key ranges of the pages.
+        result.done = true;
+        return result;
+    }
+
+    Columns columns;
+    int lastPage = meta.numUsedPages - 1;
+
+    while (true) {
+        // The empty pages at the end are to be truncated.
+        while (lastPage >= FIRST_DATA_PAGE && isPageEmpty(lastPage)) {
+            lastPage--;
+        }
+
+        int destPage = findFreePage(freePageHint);
+        if (destPage < 0 || destPage >= lastPage) {
+            // No hole is left before the last non-empty page.
+            result.done = true;
+            break;
+        }
+        if (result.numMovedRecords >= maxMoves) {
+            break;
+        }
+
+        // Move the last record of the last page.
+        PageHandle handle = getHandle(lastPage);
+        PageMeta *pageMeta = PF::loadRaw<PageMeta *>(handle);
+        int slot = 63 - __builtin_clzll(uint64_t(pageMeta->occupied));
+        RecordID from = {lastPage, slot};
+        deserialize(PF::loadRaw(handle), from.slot, columns,
+                    COLUMN_BITMAP_ALL);
+
+        // The source page might be evicted from now on. The record is written
+        // back from its columns, as the layout of the slots may differ.
+        RecordID to = getEmptySlot();
+        assert(to.page == destPage);
+        handle = getHandle(to.page);
+        serialize(columns, PF::loadRaw(handle), to.slot, COLUMN_BITMAP_ALL,
+                  /*all=*/true);
+        PF::markDirty(handle);
+        ZoneMap delta{};
+        addToZoneMap(delta, PF::loadRaw(handle), to.slot);
+        mergeZoneMap(to.page, delta);
+
+        handle = getHandle(from.page);
+        pageMeta = PF::loadRaw<PageMeta *>(handle);
+        pageMeta->occupied &= ~(1LL << from.slot);
+        PF::markDirty(handle);
+        markPageFree(from.page, true);
+        if (pageMeta->occupied == headerSlotMask()) {
+            resetZoneMap(from.page);
+        }
+
+        result.numMovedRecords++;
+        callback(from, to, columns);
+    }
+
+    int numPages = std::max(lastPage + 1, FIRST_DATA_PAGE);
+    result.numFreedPages = meta.numUsedPages - numPages;
+    if (result.numFreedPages > 0) {
+        truncatePages(numPages);
+    }
+
+    Logger::log(VERBOSE, "Table: moved %d records, freed %d pages of %s\n",
+                result.numMovedRecords, result.numFreedPages, meta.name);
+
+    return result;
 }
 
 void Table::setPrimaryKey(const std::string &field) {
@@ -417,6 +942,10 @@ void Table::dropPrimaryKey(const std::string &field) {
         throw PrimaryKeyNotExistsError();
     }
 
+    if (meta.clustered) {
+        throw InvalidPrimaryKeyError("the table is clustered by primary key");
+    }
+
     if (!field.empty() && getColumnIndex(field.c_str()) < 0) {
         throw Internal::ColumnNotFoundError(field);
     }
@@ -430,18 +959,23 @@ void Table::close() {
     }
     Logger::log(VERBOSE, "Table: closing table %s\n", meta.name);
 
+    if (meta.clustered) {
+        saveClusterDirectory();
+    }
     flushMeta();
 
     PF::close(fd);
-    for (auto &iter : pageHandleMap) {
-        if (iter.second != nullptr) {
-            delete iter.second;
-        }
-    }
 
     initialized = false;
     columnNameMap.clear();
-    pageHandleMap.clear();
+    pageHandleCache.clear();
+    clearDictionaries();
+    clusterDirectory.clear();
+    clearClusterEntries();
+    freePageHint = FIRST_DATA_PAGE;
+    streamPageHints.clear();
+    zoneMapCache.clear();
+    zoneMapCached.clear();
 }
 
 int Table::getColumnIndex(const char *name) const {
@@ -458,24 +992,51 @@ std::string Table::getColumnName(int index) const {
     return meta.columns[index].name;
 }
 
-void Table::iterate(IterateCallback callback) {
+void Table::iterate(IterateCallback callback) { iterate(callback, {}); }
+
+void Table::iterate(IterateCallback callback,
+                    const std::vector<CompareValueCondition> &conditions) {
+    ScanConditions scanConditions = getScanConditions(conditions);
+    if (scanConditions.empty) {
+        return;
+    }
+
+    if (meta.clustered) {
+        return iterateCluster(std::numeric_limits<int>::min(),
+                              std::numeric_limits<int>::max(), callback,
+                              scanConditions);
+    }
+
     Columns bufColumns;
 
-    for (int page = 1; page < meta.numUsedPages; page++) {
-        PageHandle *handle = getHandle(page);
-        for (int slot = 1; slot < numSlotPerPage(); slot++) {
-            if (!handle->validate()) {
+    for (int page = FIRST_DATA_PAGE; page < meta.numUsedPages; page++) {
+        if (!scanConditions.zoneMap.empty() &&
+            !mayMatch(getZoneMap(page), scanConditions.zoneMap)) {
+            Logger::log(VERBOSE, "Table: skipping page %d by its zone map\n",
+                        page);
+            continue;
+        }
+
+        PageHandle handle = getHandle(page);
+        for (int slot = numHeaderSlots(); slot < numSlotPerPage(); slot++) {
+            if (!handle.validate()) {
                 handle = getHandle(page);
             }
-            if (occupied(*handle, slot)) {
-                RecordID rid = {page, slot};
-
-                // TODO: Optimization: only get necessary columns.
-                get(rid, bufColumns);
-                bool _continue = callback(rid, bufColumns);
-                if (!_continue) {
-                    return;
-                }
+            if (!occupied(handle, slot)) {
+                continue;
+            }
+            if (!scanConditions.codes.empty() &&
+                !matchCodes(PF::loadRaw(handle), slot, scanConditions.codes)) {
+                continue;
+            }
+
+            RecordID rid = {page, slot};
+
+            // TODO: Optimization: only get necessary columns.
+            get(rid, bufColumns);
+            bool _continue = callback(rid, bufColumns);
+            if (!_continue) {
+                return;
             }
         }
     }
@@ -492,22 +1053,192 @@ std::vector<ColumnInfo> Table::getColumnInfo() {
     return columns;
 }
 
-PageHandle *Table::getHandle(int page) {
-    auto iter = pageHandleMap.find(page);
-    if (iter != pageHandleMap.end()) {
-        if (iter->second->validate()) {
-            return iter->second;
-        } else {
-            delete iter->second;
-            // Fall through to create a new handle.
+int Table::numMorsels() {
+    checkInit();
+    if (meta.clustered) {
+        // Clustered tables are scanned serially to keep the records in the
+        // order of the keys.
+        return 0;
+    }
+    int numDataPages = meta.numUsedPages - FIRST_DATA_PAGE;
+    return (numDataPages + PARALLEL_SCAN_MORSEL_PAGES - 1) /
+           PARALLEL_SCAN_MORSEL_PAGES;
+}
+
+void Table::iterateMorsel(int morsel, IterateCallback callback) {
+    iterateMorsel(morsel, callback, {});
+}
+
+void Table::iterateMorsel(
+    int morsel, IterateCallback callback,
+    const std::vector<CompareValueCondition> &conditions) {
+    checkInit();
+
+    ScanConditions scanConditions = getScanConditions(conditions);
+    if (scanConditions.empty) {
+        return;
+    }
+
+    int firstPage = FIRST_DATA_PAGE + morsel * PARALLEL_SCAN_MORSEL_PAGES;
+    int lastPage = std::min(firstPage + PARALLEL_SCAN_MORSEL_PAGES,
+                            int(meta.numUsedPages));
+
+    // The pages are copied out of the buffer pool, so that the records are
+    // deserialized without holding it. Neither the page handles nor the zone
+    // map cache is touched, as they are not thread-safe.
+    std::vector<char> buf(PAGE_SIZE);
+    Columns bufColumns;
+
+    for (int page = firstPage; page < lastPage; page++) {
+        PF::read(fd, page, buf.data());
+
+        if (!scanConditions.zoneMap.empty()) {
+            ZoneMap zoneMap;
+            memcpy(&zoneMap, buf.data() + zoneMapOffset(), sizeof(ZoneMap));
+            if (!mayMatch(zoneMap, scanConditions.zoneMap)) {
+                continue;
+            }
+        }
+
+        PageMeta pageMeta;
+        memcpy(&pageMeta, buf.data(), sizeof(PageMeta));
+        for (int slot = numHeaderSlots(); slot < numSlotPerPage(); slot++) {
+            if ((pageMeta.occupied & (PageMeta::BitmapType(1) << slot)) == 0) {
+                continue;
+            }
+            if (!scanConditions.codes.empty() &&
+                !matchCodes(buf.data(), slot, scanConditions.codes)) {
+                continue;
+            }
+            deserialize(buf.data(), slot, bufColumns, COLUMN_BITMAP_ALL);
+            if (!callback({page, slot}, bufColumns)) {
+                return;
+            }
         }
     }
+}
 
-    PageHandle handle = PF::getHandle(fd, page);
-    // Create a handle in the heap to allow updating in PF::read().
-    PageHandle *newHandle = new PageHandle(handle);
-    pageHandleMap[page] = newHandle;
-    return newHandle;
+bool Table::iterateBatches(BatchCallback callback) {
+    return iterateBatches(callback, {});
+}
+
+bool Table::iterateBatches(
+    BatchCallback callback,
+    const std::vector<CompareValueCondition> &conditions) {
+    checkInit();
+
+    if (!meta.pax) {
+        return false;
+    }
+
+    ScanConditions scanConditions = getScanConditions(conditions);
+    if (scanConditions.empty) {
+        return true;
+    }
+
+    RecordBatch batch;
+    batch.size = numSlotPerPage() - layout.firstSlot;
+
+    for (int page = FIRST_DATA_PAGE; page < meta.numUsedPages; page++) {
+        if (!scanConditions.zoneMap.empty() &&
+            !mayMatch(getZoneMap(page), scanConditions.zoneMap)) {
+            continue;
+        }
+
+        // The callback does not touch the buffer pool, thus the page stays.
+        PageHandle handle = getHandle(page);
+        const char *data = PF::loadRaw(handle);
+        PageMeta::BitmapType occupied =
+            PF::loadRaw<const PageMeta *>(handle)->occupied;
+        batch.mask = RecordBatch::Mask(occupied) >> layout.firstSlot;
+        if (batch.mask == 0) {
+            continue;
+        }
+
+        for (int i = 0; i < batch.size && !scanConditions.codes.empty();
+             i++) {
+            if (((batch.mask >> i) & 1) &&
+                !matchCodes(data, layout.firstSlot + i, scanConditions.codes)) {
+                batch.mask &= ~(RecordBatch::Mask(1) << i);
+            }
+        }
+
+        batch.nullBitmaps =
+            (const ColumnBitmap *)(data + layout.nullBitmapOffset);
+        for (int i = 0; i < meta.numColumn; i++) {
+            batch.columns[i] = {data + layout.columnOffsets[i],
+                                columnStorageSize(i)};
+        }
+        if (!callback(batch)) {
+            break;
+        }
+    }
+    return true;
+}
+
+void Table::iterateRange(int low, int high, IterateCallback callback) {
+    checkInit();
+    assert(meta.clustered);
+    iterateCluster(low, high, callback, {});
+}
+
+void Table::iterateCluster(int low, int high, IterateCallback callback,
+                           const ScanConditions &conditions) {
+    Columns bufColumns;
+
+    // The pages are visited in the order of their key ranges, starting from
+    // the one covering `low`.
+    auto iter = clusterDirectory.upper_bound(low);
+    if (iter != clusterDirectory.begin()) {
+        iter--;
+    }
+    for (; iter != clusterDirectory.end() && iter->first <= high; iter++) {
+        int page = iter->second;
+        if (!conditions.zoneMap.empty() &&
+            !mayMatch(getZoneMap(page), conditions.zoneMap)) {
+            Logger::log(VERBOSE, "Table: skipping page %d by its zone map\n",
+                        page);
+            continue;
+        }
+
+        // Copied, as the callback might modify the page.
+        std::vector<std::pair<int, int>> entries = clusterEntries(page);
+        for (auto [key, slot] : entries) {
+            if (key < low || key > high) {
+                continue;
+            }
+            PageHandle handle = getHandle(page);
+            const char *data = PF::loadRaw(handle);
+            if (!conditions.codes.empty() &&
+                !matchCodes(data, slot, conditions.codes)) {
+                continue;
+            }
+            deserialize(data, slot, bufColumns, COLUMN_BITMAP_ALL);
+            if (!callback(clusterRecord(key), bufColumns)) {
+                return;
+            }
+        }
+    }
+}
+
+bool Table::count(int &result) {
+    checkInit();
+    result = meta.numRecords;
+    return true;
+}
+
+PageHandle Table::getHandle(int page) {
+    CachedPageHandle &cached =
+        pageHandleCache[page & (PAGE_HANDLE_CACHE_SIZE - 1)];
+    if (cached.page != page || !cached.handle.validate()) {
+        cached.page = page;
+        cached.handle = PF::getHandle(fd, page);
+    }
+    return cached.handle;
+}
+
+void Table::resetPageHandleCache() {
+    pageHandleCache.assign(PAGE_HANDLE_CACHE_SIZE, CachedPageHandle());
 }
 
 void Table::checkInit() {
@@ -517,20 +1248,19 @@ void Table::checkInit() {
     }
 }
 
-void Table::deserialize(const char *srcData, Columns &destObjects,
+void Table::deserialize(const char *page, int slot, Columns &destObjects,
                         ColumnBitmap bitmap) {
     // First, fetch record meta.
-    RecordMeta *recordMeta = (RecordMeta *)srcData;
-    srcData += sizeof(RecordMeta);
+    RecordMeta *recordMeta = (RecordMeta *)(page + recordMetaOffset(slot));
 
     destObjects.resize(meta.numColumn);
 
     int index = 0;
     for (int i = 0; i < meta.numColumn; i++) {
         if ((bitmap & (ColumnBitmap(1) << i)) == 0) {
-            srcData += meta.columns[i].size;
             continue;
         }
+        const char *srcData = page + columnOffset(slot, i);
 
         Column &column = destObjects[index];
         column.size = meta.columns[i].size;
@@ -551,38 +1281,49 @@ void Table::deserialize(const char *srcData, Columns &destObjects,
         } else {
             // We must copy the data here as we are directly using the buffer,
             // which can be invalidated.
-            memcpy(column.data.stringValue, srcData, column.size);
-            column.isNull = false;
-            if (column.type == VARCHAR) {
-                column.data.stringValue[column.size] = '\0';
+            if (meta.columns[i].dictionary) {
+                DictionaryCode code;
+                memcpy(&code, srcData, sizeof(DictionaryCode));
+                assert(code < dictionaryValues[i].size());
+                const std::string &value = dictionaryValues[i][code];
+                column.setString(value.c_str(), value.size());
+            } else if (column.type == VARCHAR) {
+                column.setString(srcData, strnlen(srcData, column.size));
+            } else {
+                memcpy(&column.data.intValue, srcData, column.size);
             }
+            column.isNull = false;
         }
 
-        srcData += meta.columns[i].size;
         index++;
     };
 
     destObjects.resize(index);
 }
 
-void Table::serialize(const Columns &srcObjects, char *destData,
+void Table::serialize(const Columns &srcObjects, char *page, int slot,
                       ColumnBitmap bitmap, bool all) {
-    RecordMeta *recordMeta = (RecordMeta *)destData;
-    destData += sizeof(RecordMeta);
+    RecordMeta *recordMeta = (RecordMeta *)(page + recordMetaOffset(slot));
 
     // The actual index in `srcObjects`.
     int index = 0;
     for (int i = 0; i < meta.numColumn; i++) {
+        char *destData = page + columnOffset(slot, i);
         if ((bitmap & (ColumnBitmap(1) << i)) == 0) {
             if (all) {
 #if DEBUG
                 assert(meta.columns[i].hasDefault);
 #endif
                 // Use default value
-                memcpy(destData, meta.columns[i].defaultValue.stringValue,
-                       meta.columns[i].size);
+                if (meta.columns[i].dictionary) {
+                    DictionaryCode code = encode(
+                        i, meta.columns[i].defaultValue.stringValue);
+                    memcpy(destData, &code, sizeof(DictionaryCode));
+                } else {
+                    memcpy(destData, meta.columns[i].defaultValue.stringValue,
+                           meta.columns[i].size);
+                }
             }
-            destData += meta.columns[i].size;
             continue;
         }
 
@@ -606,13 +1347,18 @@ void Table::serialize(const Columns &srcObjects, char *destData,
             recordMeta->nullBitmap |= (1L << i);
         } else {
             recordMeta->nullBitmap &= ~(1L << i);
-            memcpy(destData, column.data.stringValue, meta.columns[i].size);
-            if (column.type == VARCHAR) {
-                destData[meta.columns[i].size] = '\0';
+            if (meta.columns[i].dictionary) {
+                DictionaryCode code = encode(i, column.raw());
+                memcpy(destData, &code, sizeof(DictionaryCode));
+            } else if (column.type == VARCHAR) {
+                // Pad with zeros, the string is not terminated if it takes up
+                // the whole column.
+                strncpy(destData, column.raw(), meta.columns[i].size);
+            } else {
+                memcpy(destData, &column.data.intValue, meta.columns[i].size);
             }
         }
 
-        destData += meta.columns[i].size;
         index++;
     }
 
@@ -630,15 +1376,16 @@ bool Table::occupied(const PageHandle &handle, int slot) {
 }
 
 void Table::validateSlot(int page, int slot) {
-    // The first slot of each page (except 0) is for metadata.
-    bool valid = page >= 1 && page < meta.numUsedPages && slot >= 1 &&
-                 slot < numSlotPerPage();
+    // The leading slots of each data page are for metadata.
+    bool valid = page >= FIRST_DATA_PAGE && page < meta.numUsedPages &&
+                 slot >= numHeaderSlots() && slot < numSlotPerPage();
     if (!valid) {
         Logger::log(
             ERROR,
-            "Table: page/slot pair (%d, %d) is not valid, must be in range [0, "
-            "%d) X [1, %d)\n",
-            page, slot, meta.numUsedPages, numSlotPerPage());
+            "Table: page/slot pair (%d, %d) is not valid, must be in range "
+            "[%d, %d) X [%d, %d)\n",
+            page, slot, FIRST_DATA_PAGE, meta.numUsedPages, numHeaderSlots(),
+            numSlotPerPage());
         throw Internal::InvalidSlotError();
     }
 }
@@ -669,68 +1416,508 @@ void Table::validateColumnBitmap(const Columns &columns, ColumnBitmap bitmap,
     }
 }
 
-RecordID Table::getEmptySlot() {
-    if (meta.numUsedPages == meta.firstFree) {
+RecordID Table::getEmptySlot(int stream) {
+    int page =
+        stream == 0 ? findFreePage(freePageHint) : findStreamPage(stream);
+
+    if (page < 0) {
         // All pages are full, create a new page.
+        page = createPage();
         Logger::log(VERBOSE,
-                    "Table: all pages are full, creating a new page %d\n",
-                    meta.firstFree);
+                    "Table: all pages are full, created a new page %d\n", page);
+    } else {
+        Logger::log(VERBOSE, "Table: got free page %d\n", page);
+    }
+    if (stream == 0) {
+        freePageHint = page;
+    } else {
+        streamPageHints[stream] = page;
+    }
 
-        PageMeta pageMeta;
-        pageMeta.nextFree = meta.firstFree + 1;
-        pageMeta.occupied =
-            0b11;  // The first slot (starting from 2) is now occupied.
+    PageHandle handle = getHandle(page);
+    PageMeta *pageMeta = PF::loadRaw<PageMeta *>(handle);
 
-        flushPageMeta(meta.firstFree, pageMeta);
+    if (pageMeta->headCanary != PAGE_META_CANARY ||
+        pageMeta->tailCanary != PAGE_META_CANARY) {
+        Logger::log(ERROR,
+                    "Table: page %d meta corrupted: head canary %d, tail "
+                    "canary %d\n",
+                    page, pageMeta->headCanary, pageMeta->tailCanary);
+        throw Internal::InvalidPageMetaError();
+    }
 
-        meta.numUsedPages++;
-        // The firstFree of table remain unchanged.
+    int index = ffsll(~pageMeta->occupied);
 
-        return {meta.firstFree, 1};
-    } else {
-        // One of the allocated pages has empty slots.
-        Logger::log(VERBOSE, "Table: got first free page %d\n", meta.firstFree);
+    if (index == 0 || index > numSlotPerPage()) {
+        Logger::log(ERROR, "Table: page %d is full but not marked as full\n",
+                    page);
+        throw Internal::InvalidPageMetaError();
+    }
 
-        int page = meta.firstFree;
-        PageHandle *handle = getHandle(page);
-        PageMeta *pageMeta = (PageMeta *)(PF::loadRaw(*handle));
+    index--;
 
-        if (pageMeta->headCanary != PAGE_META_CANARY ||
-            pageMeta->tailCanary != PAGE_META_CANARY) {
-            Logger::log(ERROR,
-                        "Table: page %d meta corrupted: head canary %d, tail "
-                        "canary %d\n",
-                        page, pageMeta->headCanary, pageMeta->tailCanary);
-            throw Internal::InvalidPageMetaError();
+    pageMeta->occupied |= (1LL << index);
+
+    // Mark the page as dirty.
+    assert(handle.validate());
+    PF::markDirty(handle);
+
+    if (isPageFull(pageMeta)) {
+        markPageFree(page, false);
+    }
+
+    return {page, index};
+}
+
+void Table::loadClusterDirectory() {
+    clusterDirectory.clear();
+    clearClusterEntries();
+    if (!meta.clustered || loadSavedClusterDirectory()) {
+        return;
+    }
+    Logger::log(VERBOSE,
+                "Table: rebuilding the directory of clustered table %s\n",
+                meta.name);
+    for (int page = FIRST_DATA_PAGE; page < meta.numUsedPages; page++) {
+        PageHandle handle = getHandle(page);
+        clusterDirectory[PF::loadRaw<const PageMeta *>(handle)->lowKey] = page;
+    }
+}
+
+bool Table::loadSavedClusterDirectory() {
+    // Reads past the end of the file are zeros, failing the canary.
+    ClusterDirectoryHeader header;
+    memcpy(&header, PF::loadRaw(PF::getHandle(fd, meta.numUsedPages)),
+           sizeof(header));
+    if (header.canary != CLUSTER_DIRECTORY_CANARY ||
+        header.numUsedPages != meta.numUsedPages || header.numEntry < 0 ||
+        header.numEntry > meta.numUsedPages - FIRST_DATA_PAGE) {
+        return false;
+    }
+
+    std::vector<char> buffer(sizeof(header) +
+                             header.numEntry * sizeof(ClusterDirectoryEntry));
+    for (size_t offset = 0; offset < buffer.size(); offset += PAGE_SIZE) {
+        PageHandle handle =
+            PF::getHandle(fd, meta.numUsedPages + offset / PAGE_SIZE);
+        memcpy(buffer.data() + offset, PF::loadRaw(handle),
+               std::min<size_t>(PAGE_SIZE, buffer.size() - offset));
+    }
+
+    const ClusterDirectoryEntry *entries =
+        (const ClusterDirectoryEntry *)(buffer.data() + sizeof(header));
+    for (int i = 0; i < header.numEntry; i++) {
+        if (entries[i].page < FIRST_DATA_PAGE ||
+            entries[i].page >= meta.numUsedPages) {
+            clusterDirectory.clear();
+            return false;
         }
+        clusterDirectory.emplace_hint(clusterDirectory.end(),
+                                      entries[i].lowKey, entries[i].page);
+    }
+    return true;
+}
 
-        int index = ffsll(~pageMeta->occupied);
+void Table::saveClusterDirectory() {
+    ClusterDirectoryHeader header;
+    header.numUsedPages = meta.numUsedPages;
+    header.numEntry = clusterDirectory.size();
+
+    std::vector<char> buffer(sizeof(header) +
+                             header.numEntry * sizeof(ClusterDirectoryEntry));
+    memcpy(buffer.data(), &header, sizeof(header));
+    ClusterDirectoryEntry *entries =
+        (ClusterDirectoryEntry *)(buffer.data() + sizeof(header));
+    for (auto [lowKey, page] : clusterDirectory) {
+        *entries++ = {lowKey, page};
+    }
 
-        if (index == 0 || index > numSlotPerPage()) {
-            Logger::log(
-                ERROR, "Table: page %d is full but not marked as full\n", page);
-            throw Internal::InvalidPageMetaError();
+    for (size_t offset = 0; offset < buffer.size(); offset += PAGE_SIZE) {
+        PageHandle handle =
+            PF::getHandle(fd, meta.numUsedPages + offset / PAGE_SIZE);
+        memcpy(PF::loadRaw(handle), buffer.data() + offset,
+               std::min<size_t>(PAGE_SIZE, buffer.size() - offset));
+        PF::markDirty(handle);
+    }
+}
+
+bool Table::getKey(const Columns &columns, ColumnBitmap bitmap, int &key,
+                   bool isUpdate) {
+    int keyIndex = meta.primaryKeyIndex;
+    if ((bitmap & (ColumnBitmap(1) << keyIndex)) == 0) {
+        if (isUpdate) {
+            return false;
         }
+        key = meta.columns[keyIndex].defaultValue.intValue;
+        return true;
+    }
+
+    // The columns are given in the order of the bits.
+    int index = __builtin_popcount(uint16_t(bitmap) & ((1u << keyIndex) - 1));
+    const Column &column = columns[index];
+    if (column.isNull || column.type != INT) {
+        Logger::log(ERROR,
+                    "Table: invalid key given for clustered table %s: type "
+                    "%d, null %d\n",
+                    meta.name, column.type, column.isNull);
+        throw Internal::ColumnSerializationError("invalid key");
+    }
+    key = column.data.intValue;
+    return true;
+}
+
+int Table::findClusterPage(int key) {
+    auto iter = clusterDirectory.upper_bound(key);
+    if (iter == clusterDirectory.begin()) {
+        return -1;
+    }
+    return std::prev(iter)->second;
+}
 
-        index--;
+int Table::readKey(const char *page, int slot) {
+    int key;
+    memcpy(&key, page + columnOffset(slot, meta.primaryKeyIndex), sizeof(int));
+    return key;
+}
 
-        pageMeta->occupied |= (1LL << index);
+std::vector<std::pair<int, int>> &Table::clusterEntries(int page) {
+    if (page >= clusterEntryCached.size()) {
+        clusterEntryCache.resize(page + 1);
+        clusterEntryCached.resize(page + 1, false);
+    }
+    std::vector<std::pair<int, int>> &entries = clusterEntryCache[page];
+    if (clusterEntryCached[page]) {
+        return entries;
+    }
 
-        if (isPageFull(pageMeta)) {
-            // This page is full, modify meta.
-            meta.firstFree = pageMeta->nextFree;
+    PageHandle handle = getHandle(page);
+    const char *data = PF::loadRaw(handle);
+    PageMeta::BitmapType occupied =
+        PF::loadRaw<const PageMeta *>(handle)->occupied & ~headerSlotMask();
+
+    entries.clear();
+    while (occupied != 0) {
+        int slot = ffsll(occupied) - 1;
+        occupied &= occupied - 1;
+        entries.push_back({readKey(data, slot), slot});
+    }
+    std::sort(entries.begin(), entries.end());
+    clusterEntryCached[page] = true;
+    return entries;
+}
+
+void Table::clearClusterEntries(int page) {
+    if (page < clusterEntryCached.size()) {
+        clusterEntryCache.resize(page);
+        clusterEntryCached.resize(page);
+    }
+}
+
+RecordID Table::locate(RecordID id) {
+    if (!meta.clustered) {
+        return id;
+    }
+
+    int page = id.page == CLUSTER_RECORD_PAGE ? findClusterPage(id.slot) : -1;
+    if (page >= 0) {
+        auto &entries = clusterEntries(page);
+        auto iter = lowerBound(entries, id.slot);
+        if (iter != entries.end() && iter->first == id.slot) {
+            return {page, iter->second};
         }
+    }
+
+    Logger::log(ERROR,
+                "Table: record (%d, %d) not found in clustered table %s\n",
+                id.page, id.slot, meta.name);
+    throw Internal::InvalidSlotError();
+}
+
+RecordID Table::getClusterSlot(int key) {
+    int page = findClusterPage(key);
+    if (page < 0) {
+        // The first page covers all the keys.
+        page = createPage();
+        clusterDirectory[std::numeric_limits<int>::min()] = page;
+    }
+
+    auto &entries = clusterEntries(page);
+    auto iter = lowerBound(entries, key);
+    if (iter != entries.end() && iter->first == key) {
+        Logger::log(ERROR, "Table: key %d exists in clustered table %s\n", key,
+                    meta.name);
+        throw Internal::DuplicateKeyError();
+    }
 
-        // Mark the page as dirty.
-        assert(handle->validate());
-        PF::markDirty(*handle);
+    PageHandle handle = getHandle(page);
+    if (isPageFull(PF::loadRaw<PageMeta *>(handle))) {
+        page = splitClusterPage(page, key);
+        handle = getHandle(page);
+    }
+
+    // Read the entries before the slot is taken, as its key is not written
+    // yet.
+    auto &pageEntries = clusterEntries(page);
+    handle = getHandle(page);
+
+    PageMeta *pageMeta = PF::loadRaw<PageMeta *>(handle);
+    int index = ffsll(~pageMeta->occupied) - 1;
+    pageMeta->occupied |= (1LL << index);
+    PF::markDirty(handle);
 
-        return {page, index};
+    if (isPageFull(pageMeta)) {
+        markPageFree(page, false);
+    }
+
+    pageEntries.insert(lowerBound(pageEntries, key), {key, index});
+
+    return {page, index};
+}
+
+int Table::splitClusterPage(int page, int key) {
+    std::vector<std::pair<int, int>> entries = clusterEntries(page);
+
+    // Keys inserted in ascending order leave the pages full, not half full.
+    size_t first =
+        key > entries.back().first ? entries.size() : entries.size() / 2;
+    int lowKey = first < entries.size() ? entries[first].first : key;
+
+    int newPage = createPage();
+    PageHandle handle = getHandle(newPage);
+    PF::loadRaw<PageMeta *>(handle)->lowKey = lowKey;
+    PF::markDirty(handle);
+    clusterDirectory[lowKey] = newPage;
+
+    Logger::log(VERBOSE,
+                "Table: splitting page %d of %s at key %d, moving %ld records "
+                "to page %d\n",
+                page, meta.name, lowKey, entries.size() - first, newPage);
+
+    Columns columns;
+    ZoneMap delta{};
+    int destSlot = numHeaderSlots();
+    for (size_t i = first; i < entries.size(); i++, destSlot++) {
+        int srcSlot = entries[i].second;
+        handle = getHandle(page);
+        deserialize(PF::loadRaw(handle), srcSlot, columns, COLUMN_BITMAP_ALL);
+        PF::loadRaw<PageMeta *>(handle)->occupied &= ~(1LL << srcSlot);
+        PF::markDirty(handle);
+
+        handle = getHandle(newPage);
+        char *data = PF::loadRaw(handle);
+        serialize(columns, data, destSlot, COLUMN_BITMAP_ALL, /*all=*/true);
+        PF::loadRaw<PageMeta *>(handle)->occupied |= (1LL << destSlot);
+        addToZoneMap(delta, data, destSlot);
+        PF::markDirty(handle);
+    }
+    mergeZoneMap(newPage, delta);
+    if (first < entries.size()) {
+        markPageFree(page, true);
+    }
+    // The moved entries are read back from the new page when it is located.
+    clusterEntries(page).resize(first);
+    clearClusterEntries(newPage);
+
+    return key >= lowKey ? newPage : page;
+}
+
+int Table::findFreePage(int startPage) {
+    PageHandle handle = getHandle(FREE_SPACE_MAP_PAGE);
+    const FreeSpaceMapWord *bitmap =
+        PF::loadRaw<const FreeSpaceMapWord *>(handle);
+    constexpr int bitsPerWord = sizeof(FreeSpaceMapWord) * 8;
+
+    startPage = std::max(startPage, FIRST_DATA_PAGE);
+    for (int word = startPage / bitsPerWord;
+         word * bitsPerWord < meta.numUsedPages; word++) {
+        FreeSpaceMapWord bits = bitmap[word];
+        if (word == startPage / bitsPerWord) {
+            // Ignore the pages before the start page.
+            bits &= ~FreeSpaceMapWord(0) << (startPage % bitsPerWord);
+        }
+        if (bits != 0) {
+            int page = word * bitsPerWord + ffsll(bits) - 1;
+            return page < meta.numUsedPages ? page : -1;
+        }
+    }
+    return -1;
+}
+
+int Table::findStreamPage(int stream) {
+    int startPage;
+    auto it = streamPageHints.find(stream);
+    if (it != streamPageHints.end()) {
+        startPage = it->second;
+    } else {
+        // Spread the streams over the data pages with a multiplicative hash.
+        int numDataPages = meta.numUsedPages - FIRST_DATA_PAGE;
+        startPage = numDataPages <= 0
+                        ? FIRST_DATA_PAGE
+                        : FIRST_DATA_PAGE +
+                              uint32_t(stream) * 2654435761U % numDataPages;
+    }
+
+    int page = findFreePage(std::max(startPage, freePageHint));
+    if (page < 0 && startPage > freePageHint) {
+        // No page before `freePageHint` has empty slots, wrap around to it.
+        page = findFreePage(freePageHint);
+    }
+    return page;
+}
+
+int Table::createPage() {
+    int page = meta.numUsedPages;
+    if (page == std::numeric_limits<PageCountType>::max()) {
+        Logger::log(ERROR, "Table: table %s has too many pages\n", meta.name);
+        throw Internal::TableFullError();
+    }
+
+    PageMeta pageMeta;
+    pageMeta.occupied = headerSlotMask();
+    flushPageMeta(page, pageMeta);
+    resetZoneMap(page);
+
+    meta.numUsedPages++;
+    markPageFree(page, true);
+    return page;
+}
+
+void Table::markPageFree(int page, bool hasFreeSlot) {
+    PageHandle handle = getHandle(FREE_SPACE_MAP_PAGE);
+    FreeSpaceMapWord *bitmap = PF::loadRaw<FreeSpaceMapWord *>(handle);
+    constexpr int bitsPerWord = sizeof(FreeSpaceMapWord) * 8;
+    FreeSpaceMapWord bit = FreeSpaceMapWord(1) << (page % bitsPerWord);
+
+    FreeSpaceMapWord &word = bitmap[page / bitsPerWord];
+    if (((word & bit) != 0) != hasFreeSlot) {
+        word ^= bit;
+        PF::markDirty(handle);
     }
 }
 
 int Table::slotSize() { return sizeof(PageMeta) + meta.recordSize; }
 
+int Table::columnStorageSize(int column) {
+    return meta.columns[column].dictionary ? sizeof(DictionaryCode)
+                                           : meta.columns[column].size;
+}
+
+void Table::initLayout() {
+    if (!meta.pax) {
+        int offset = sizeof(RecordMeta);
+        for (int i = 0; i < meta.numColumn; i++) {
+            layout.columnOffsets[i] = offset;
+            offset += columnStorageSize(i);
+        }
+        layout.nullBitmapOffset = 0;
+        layout.firstSlot = 0;
+        return;
+    }
+
+    // The minipages follow the page meta, and the zone map if it is stored in
+    // the leading slots. As a minipage element is never larger than a slot,
+    // they fit in the space of the slots.
+    layout.firstSlot = numHeaderSlots();
+    int numSlots = numSlotPerPage() - layout.firstSlot;
+    int offset = meta.hasZoneMap && zoneMapOffset() == sizeof(PageMeta)
+                     ? sizeof(PageMeta) + sizeof(ZoneMap)
+                     : sizeof(PageMeta);
+
+    layout.nullBitmapOffset = offset;
+    offset += numSlots * sizeof(RecordMeta);
+    for (int i = 0; i < meta.numColumn; i++) {
+        layout.columnOffsets[i] = offset;
+        offset += numSlots * columnStorageSize(i);
+    }
+    assert(offset <= numSlotPerPage() * slotSize());
+}
+
+int Table::recordMetaOffset(int slot) {
+    if (!meta.pax) {
+        return slot * slotSize();
+    }
+    return layout.nullBitmapOffset +
+           (slot - layout.firstSlot) * sizeof(RecordMeta);
+}
+
+int Table::columnOffset(int slot, int column) {
+    if (!meta.pax) {
+        return slot * slotSize() + layout.columnOffsets[column];
+    }
+    return layout.columnOffsets[column] +
+           (slot - layout.firstSlot) * columnStorageSize(column);
+}
+
+void Table::loadDictionaries() {
+    clearDictionaries();
+    if (meta.dictionarySize == 0) {
+        return;
+    }
+
+    PageHandle handle = getHandle(DICTIONARY_PAGE);
+    const char *data = PF::loadRaw(handle);
+    for (int offset = 0; offset < meta.dictionarySize;) {
+        DictionaryEntryHeader header;
+        memcpy(&header, data + offset, sizeof(DictionaryEntryHeader));
+        offset += sizeof(DictionaryEntryHeader);
+
+        std::string value(data + offset, header.length);
+        offset += header.length;
+
+        auto &values = dictionaryValues[header.column];
+        dictionaryCodes[header.column][value] = values.size();
+        values.push_back(std::move(value));
+    }
+}
+
+void Table::clearDictionaries() {
+    for (int i = 0; i < MAX_COLUMNS; i++) {
+        dictionaryValues[i].clear();
+        dictionaryCodes[i].clear();
+    }
+}
+
+Table::DictionaryCode Table::encode(int column, const char *value) {
+    std::string key(value, strnlen(value, meta.columns[column].size));
+    auto iter = dictionaryCodes[column].find(key);
+    if (iter != dictionaryCodes[column].end()) {
+        return iter->second;
+    }
+
+    auto &values = dictionaryValues[column];
+    int entrySize = sizeof(DictionaryEntryHeader) + key.size();
+    if (meta.dictionarySize + entrySize > PAGE_SIZE ||
+        values.size() > std::numeric_limits<DictionaryCode>::max()) {
+        Logger::log(ERROR,
+                    "Table: fail to add value to the dictionary of column %s: "
+                    "the dictionary is full\n",
+                    meta.columns[column].name);
+        throw Internal::DictionaryFullError();
+    }
+
+    PageHandle handle = getHandle(DICTIONARY_PAGE);
+    char *dest = PF::loadRaw(handle) + meta.dictionarySize;
+    DictionaryEntryHeader header = {uint8_t(column), uint8_t(key.size())};
+    memcpy(dest, &header, sizeof(DictionaryEntryHeader));
+    memcpy(dest + sizeof(DictionaryEntryHeader), key.data(), key.size());
+    PF::markDirty(handle);
+    meta.dictionarySize += entrySize;
+
+    DictionaryCode code = values.size();
+    dictionaryCodes[column][key] = code;
+    values.push_back(std::move(key));
+    return code;
+}
+
+bool Table::findCode(int column, const char *value, DictionaryCode &code) {
+    auto iter = dictionaryCodes[column].find(value);
+    if (iter == dictionaryCodes[column].end()) {
+        return false;
+    }
+    code = iter->second;
+    return true;
+}
+
 int Table::numSlotPerPage() {
     int nativeNum = PAGE_SIZE / slotSize();
     return nativeNum > MAX_SLOT_PER_PAGE ? MAX_SLOT_PER_PAGE : nativeNum;
@@ -741,8 +1928,291 @@ bool Table::isPageFull(PageMeta *pageMeta) {
     return index == 0 || index > numSlotPerPage();
 }
 
+bool Table::isPageEmpty(int page) {
+    PageHandle handle = getHandle(page);
+    // Only the metadata slots are occupied.
+    return PF::loadRaw<PageMeta *>(handle)->occupied == headerSlotMask();
+}
+
+void Table::truncatePages(int numPages) {
+    for (int page = numPages; page < meta.numUsedPages; page++) {
+        markPageFree(page, false);
+    }
+    meta.numUsedPages = numPages;
+    freePageHint = std::min(freePageHint, numPages);
+    if (zoneMapCached.size() > numPages) {
+        zoneMapCache.resize(numPages);
+        zoneMapCached.resize(numPages);
+    }
+    clearClusterEntries(numPages);
+    flushMeta();
+
+    // The handles of the dropped pages are invalidated by the truncation.
+    for (auto &cached : pageHandleCache) {
+        if (cached.page >= numPages) {
+            cached = CachedPageHandle();
+        }
+    }
+
+    PF::truncate(fd, numPages);
+}
+
+int Table::numHeaderSlots() {
+    if (!meta.hasZoneMap || zoneMapOffset() != sizeof(PageMeta)) {
+        return 1;
+    }
+    return (sizeof(PageMeta) + sizeof(ZoneMap) + slotSize() - 1) / slotSize();
+}
+
+Table::PageMeta::BitmapType Table::headerSlotMask() {
+    return (PageMeta::BitmapType(1) << numHeaderSlots()) - 1;
+}
+
+int Table::zoneMapOffset() {
+    // Prefer the space after the last slot, which is unused when the number of
+    // slots is capped by MAX_SLOT_PER_PAGE.
+    int end = numSlotPerPage() * slotSize();
+    return PAGE_SIZE - end >= int(sizeof(ZoneMap)) ? end : sizeof(PageMeta);
+}
+
+const Table::ZoneMap &Table::getZoneMap(int page) {
+    if (page >= zoneMapCached.size() || !zoneMapCached[page]) {
+        PageHandle handle = getHandle(page);
+        ZoneMap zoneMap;
+        memcpy(&zoneMap, PF::loadRaw(handle) + zoneMapOffset(),
+               sizeof(ZoneMap));
+        cacheZoneMap(page, zoneMap);
+    }
+    return zoneMapCache[page];
+}
+
+void Table::addToZoneMap(ZoneMap &zoneMap, const char *page, int slot) {
+    if (!meta.hasZoneMap) {
+        return;
+    }
+
+    RecordMeta recordMeta;
+    memcpy(&recordMeta, page + recordMetaOffset(slot), sizeof(RecordMeta));
+
+    for (int i = 0; i < meta.numColumn; i++) {
+        DataType type = meta.columns[i].type;
+        if (type == VARCHAR || (recordMeta.nullBitmap & (1L << i))) {
+            continue;
+        }
+        ZoneMapValue value;
+        memcpy(&value, page + columnOffset(slot, i), sizeof(ZoneMapValue));
+        widenZoneMap(zoneMap, i, type, value);
+    }
+}
+
+void Table::mergeZoneMap(int page, const ZoneMap &delta) {
+    if (!meta.hasZoneMap || delta.nonEmpty == 0) {
+        return;
+    }
+
+    PageHandle handle = getHandle(page);
+    char *dest = PF::loadRaw(handle) + zoneMapOffset();
+
+    // The zone map might not be aligned in the page.
+    ZoneMap zoneMap;
+    memcpy(&zoneMap, dest, sizeof(ZoneMap));
+    for (int i = 0; i < meta.numColumn; i++) {
+        if (delta.nonEmpty & (ColumnBitmap(1) << i)) {
+            DataType type = meta.columns[i].type;
+            widenZoneMap(zoneMap, i, type, delta.ranges[i].min);
+            widenZoneMap(zoneMap, i, type, delta.ranges[i].max);
+        }
+    }
+    memcpy(dest, &zoneMap, sizeof(ZoneMap));
+
+    PF::markDirty(handle);
+    cacheZoneMap(page, zoneMap);
+}
+
+void Table::resetZoneMap(int page) {
+    if (!meta.hasZoneMap) {
+        return;
+    }
+
+    ZoneMap zoneMap{};
+    PageHandle handle = getHandle(page);
+    memcpy(PF::loadRaw(handle) + zoneMapOffset(), &zoneMap, sizeof(ZoneMap));
+    PF::markDirty(handle);
+    cacheZoneMap(page, zoneMap);
+}
+
+void Table::widenZoneMap(ZoneMap &zoneMap, int column, DataType type,
+                         ZoneMapValue value) {
+    auto &range = zoneMap.ranges[column];
+    ColumnBitmap bit = ColumnBitmap(1) << column;
+
+    if ((zoneMap.nonEmpty & bit) == 0) {
+        range.min = range.max = value;
+        zoneMap.nonEmpty |= bit;
+    } else if (type == INT) {
+        range.min.intValue = std::min(range.min.intValue, value.intValue);
+        range.max.intValue = std::max(range.max.intValue, value.intValue);
+    } else {
+        range.min.floatValue = std::min(range.min.floatValue, value.floatValue);
+        range.max.floatValue = std::max(range.max.floatValue, value.floatValue);
+    }
+}
+
+void Table::cacheZoneMap(int page, const ZoneMap &zoneMap) {
+    if (page >= zoneMapCache.size()) {
+        zoneMapCache.resize(page + 1);
+        zoneMapCached.resize(page + 1, false);
+    }
+    zoneMapCache[page] = zoneMap;
+    zoneMapCached[page] = true;
+}
+
+Table::ScanConditions Table::getScanConditions(
+    const std::vector<CompareValueCondition> &conditions) {
+    ScanConditions result;
+    for (const auto &condition : conditions) {
+        if (!condition.columnId.tableName.empty() &&
+            condition.columnId.tableName != meta.name) {
+            continue;
+        }
+        int index = getColumnIndex(condition.columnId.columnName.c_str());
+        if (index < 0) {
+            continue;
+        }
+        const ColumnMeta &column = meta.columns[index];
+
+        // Only the conditions on the INT/FLOAT columns can be checked against
+        // the zone maps.
+        if (column.type != VARCHAR) {
+            if (meta.hasZoneMap) {
+                result.zoneMap.push_back({&condition, index});
+            }
+            continue;
+        }
+
+        if (!column.dictionary ||
+            (condition.op != EQ && condition.op != NE)) {
+            continue;
+        }
+        DictionaryCode code;
+        if (!findCode(index, condition.value.stringValue, code)) {
+            // No record has the value.
+            if (condition.op == EQ) {
+                result.empty = true;
+            }
+            continue;
+        }
+        result.codes.push_back({index, code, condition.op == EQ});
+    }
+    return result;
+}
+
+bool Table::matchCodes(const char *page, int slot,
+                       const std::vector<CodeCondition> &conditions) {
+    RecordMeta recordMeta;
+    memcpy(&recordMeta, page + recordMetaOffset(slot), sizeof(RecordMeta));
+    for (const auto &condition : conditions) {
+        // Null values never satisfy a condition.
+        if (recordMeta.nullBitmap & (1L << condition.columnIndex)) {
+            return false;
+        }
+        DictionaryCode code;
+        memcpy(&code, page + columnOffset(slot, condition.columnIndex),
+               sizeof(DictionaryCode));
+        if ((code == condition.code) != condition.equal) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Table::mayMatch(const ZoneMap &zoneMap,
+                     const std::vector<ZoneMapCondition> &conditions) {
+    for (const auto &[condition, column] : conditions) {
+        // Null values never satisfy a condition.
+        if ((zoneMap.nonEmpty & (ColumnBitmap(1) << column)) == 0) {
+            return false;
+        }
+
+        const auto &range = zoneMap.ranges[column];
+        double min, max, value;
+        bool exact = meta.columns[column].type == INT;
+        if (exact) {
+            min = range.min.intValue;
+            max = range.max.intValue;
+            value = condition->value.intValue;
+        } else {
+            // Floats are compared with a tolerance by the filters.
+            min = range.min.floatValue - EQUAL_PRECISION;
+            max = range.max.floatValue + EQUAL_PRECISION;
+            value = condition->value.floatValue;
+        }
+
+        bool match = true;
+        switch (condition->op) {
+            case EQ:
+                match = min <= value && value <= max;
+                break;
+            case NE:
+                match = !exact || min != max || min != value;
+                break;
+            case LT:
+                match = min < value;
+                break;
+            case LE:
+                match = min <= value;
+                break;
+            case GT:
+                match = max > value;
+                break;
+            case GE:
+                match = max >= value;
+                break;
+        }
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // ==== Column ====
 
+namespace {
+
+// Leads the buffer of a string, whose characters follow it.
+struct StringHeader {
+    std::atomic<int> refs;
+    size_t capacity;
+};
+
+StringHeader *headerOf(char *string) {
+    return reinterpret_cast<StringHeader *>(string) - 1;
+}
+
+char *newString(size_t capacity) {
+    char *buffer = new char[sizeof(StringHeader) + capacity + 1];
+    new (buffer) StringHeader{{1}, capacity};
+    return buffer + sizeof(StringHeader);
+}
+
+void acquireString(char *string) {
+    if (string != nullptr) {
+        headerOf(string)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void releaseString(char *string) {
+    if (string != nullptr &&
+        headerOf(string)->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        StringHeader *header = headerOf(string);
+        header->~StringHeader();
+        delete[] reinterpret_cast<char *>(header);
+    }
+}
+
+}  // namespace
+
 Column Column::nullColumn(DataType type, ColumnSizeType size) {
     Column column;
     column.type = type;
@@ -780,9 +2250,63 @@ Column::Column(const char *data, int maxLength) {
 
     size = maxLength;
     type = VARCHAR;
-    size_t copiedSize = std::min(strlen(data), size_t(maxLength));
-    memcpy(this->data.stringValue, data, copiedSize);
-    this->data.stringValue[copiedSize] = '\0';
+    setString(data, strnlen(data, maxLength));
+}
+
+Column::Column(const Column &rhs)
+    : data(rhs.data), type(rhs.type), size(rhs.size), isNull(rhs.isNull) {
+    acquireString(data.stringValue);
+}
+
+Column::Column(Column &&rhs) noexcept
+    : data(rhs.data), type(rhs.type), size(rhs.size), isNull(rhs.isNull) {
+    rhs.data.stringValue = nullptr;
+}
+
+Column &Column::operator=(const Column &rhs) {
+    // Acquired first, in case the string is already shared with `rhs`.
+    acquireString(rhs.data.stringValue);
+    releaseString(data.stringValue);
+    data = rhs.data;
+    type = rhs.type;
+    size = rhs.size;
+    isNull = rhs.isNull;
+    return *this;
+}
+
+Column &Column::operator=(Column &&rhs) noexcept {
+    if (this == &rhs) {
+        return *this;
+    }
+    releaseString(data.stringValue);
+    data = rhs.data;
+    type = rhs.type;
+    size = rhs.size;
+    isNull = rhs.isNull;
+    rhs.data.stringValue = nullptr;
+    return *this;
+}
+
+Column::~Column() { releaseString(data.stringValue); }
+
+void Column::setString(const char *data, size_t length) {
+    // Written in place only if not shared with another column, e.g. when a
+    // row buffer is read into again.
+    char *buffer = this->data.stringValue;
+    if (buffer != nullptr &&
+        headerOf(buffer)->refs.load(std::memory_order_acquire) == 1 &&
+        headerOf(buffer)->capacity >= length) {
+        memmove(buffer, data, length);
+        buffer[length] = '\0';
+        return;
+    }
+
+    // `data` may be in the old buffer, which is released after the copy.
+    char *newBuffer = newString(std::max(length, size_t(size)));
+    memcpy(newBuffer, data, length);
+    newBuffer[length] = '\0';
+    releaseString(buffer);
+    this->data.stringValue = newBuffer;
 }
 
 }  // namespace Internal
@@ -1,24 +1,32 @@
 #include <SQLParser/SqlLexer.h>
 
+#include <algorithm>
 #include <any>
 #include <bitset>
 #include <cassert>
 #include <cstdio>
 #include <filesystem>
+#include <fstream>
 #include <memory>
 #include <system_error>
+#include <thread>
 #include <tuple>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "Error.h"
+#include "internal/CSVReader.h"
 #include "internal/Column.h"
 #include "internal/Index.h"
 #include "internal/JoinedTable.h"
 #include "internal/Logger.h"
 #include "internal/Macros.h"
+#include "internal/MemoryTable.h"
+#include "internal/ParseHelper.h"
 #include "internal/ParseTreeVisitor.h"
 #include "internal/QueryBuilder.h"
+#include "internal/Statistics.h"
 #include "internal/Table.h"
 
 // Keep last...
@@ -71,6 +79,8 @@ void DBMS::init() {
     initSystemTable(&systemIndexesTable, "indexes", systemIndexesTableColumns);
     initSystemTable(&systemForeignKeyTable, "foreign_key",
                     systemForeignKeyTableColumns);
+    initSystemTable(&systemStatisticsTable, "statistics",
+                    systemStatisticsTableColumns);
 
     initialized = true;
 }
@@ -80,6 +90,7 @@ void DBMS::close() {
     systemTablesTable.close();
     systemIndexesTable.close();
     systemForeignKeyTable.close();
+    systemStatisticsTable.close();
 
     clearCurrentDatabase();
     initialized = false;
@@ -154,6 +165,10 @@ PlainResult DBMS::dropDatabase(const std::string &dbName) {
         clearCurrentDatabase();
     }
 
+    for (const auto &[recordId, _] : findStatistics(dbName, {})) {
+        systemStatisticsTable.remove(recordId);
+    }
+
     systemDatabaseTable.remove(id);
     std::filesystem::remove_all(rootPath / dbName);
 
@@ -198,7 +213,9 @@ ShowDatabasesResult DBMS::showDatabases() {
 PlainResult DBMS::createTable(const std::string &tableName,
                               const std::vector<ColumnMeta> &columns,
                               const std::string &primaryKey,
-                              const std::vector<ForeignKey> &ForeignKeys) {
+                              const std::vector<ForeignKey> &ForeignKeys,
+                              bool zoneMap, bool pax, bool clustered,
+                              bool memory) {
     Logger::log(VERBOSE, "DBMS: creating table %s\n", tableName.c_str());
 
     checkUseDatabase();
@@ -246,10 +263,11 @@ PlainResult DBMS::createTable(const std::string &tableName,
     }
 
     std::filesystem::path path = getUserTablePath(currentDatabase, tableName);
-    Table *table = new Table();
+    Table *table = memory ? new MemoryTable() : new Table();
 
     try {
-        table->create(path, tableName, columns, primaryKey, foreignKeys);
+        table->create(path, tableName, columns, primaryKey, foreignKeys,
+                      zoneMap, pax, clustered);
     } catch (BaseError &e) {
         throw CreateTableError(e.what());
     }
@@ -274,9 +292,10 @@ PlainResult DBMS::createTable(const std::string &tableName,
         });
     }
 
-    // Create index on primary key.
-    if (!primaryKey.empty()) {
-        createIndex(tableName, primaryKey, /*isPrimaryKey=*/true);
+    // Create index on primary key. Memory tables are hashed by their primary
+    // keys instead.
+    if (!primaryKey.empty() && !memory) {
+        createIndex(tableName, {primaryKey}, /*isPrimaryKey=*/true);
     }
 
     return makePlainResult("OK");
@@ -308,6 +327,8 @@ PlainResult DBMS::dropTable(const std::string &tableName) {
         delete it->second;
         openedTables.erase(it);
     }
+    closeIndexes(tableName);
+    tableIndexInfos.erase(tableName);
 
     // Remove the table and other related stuff from the system tables.
     systemTablesTable.remove(id);
@@ -326,6 +347,10 @@ PlainResult DBMS::dropTable(const std::string &tableName) {
         return true;
     });
 
+    for (const auto &[rid, _] : findStatistics(currentDatabase, tableName)) {
+        systemStatisticsTable.remove(rid);
+    }
+
     // Remove the table file.
     std::filesystem::remove(getUserTablePath(currentDatabase, tableName));
 
@@ -405,10 +430,14 @@ PlainResult DBMS::alterPrimaryKey(const std::string &tableName,
                         .what());
             }
             table->dropPrimaryKey(primaryKey);
-            dropIndex(tableName, actualPk, /*isPrimaryKey=*/true);
+            if (!table->meta.memory) {
+                dropIndex(tableName, {actualPk}, /*isPrimaryKey=*/true);
+            }
         } else {
             table->setPrimaryKey(primaryKey);
-            createIndex(tableName, primaryKey, /*isPrimaryKey=*/true);
+            if (!table->meta.memory) {
+                createIndex(tableName, {primaryKey}, /*isPrimaryKey=*/true);
+            }
         }
     } catch (Internal::TableErrorBase &e) {
         throw Error::AlterPrimaryKeyError(e.what());
@@ -521,12 +550,13 @@ Service::PlainResult DBMS::dropForeignKey(const std::string &tableName,
 }
 
 PlainResult DBMS::createIndex(const std::string &tableName,
-                              const std::string &columnName,
-                              bool isPrimaryKey) {
+                              const std::vector<std::string> &columnNames,
+                              bool isPrimaryKey, bool hash) {
+    std::string indexName = IndexedTable::getIndexName(columnNames);
     Logger::log(VERBOSE, "DBMS: creating index on %s.%s", tableName.c_str(),
-                columnName.c_str());
+                indexName.c_str());
     checkUseDatabase();
-    auto [id, record] = findIndex(currentDatabase, tableName, columnName);
+    auto [id, record] = findIndex(currentDatabase, tableName, indexName);
 
     if (id != RecordID::NULL_RECORD) {
         if (isPrimaryKey) {
@@ -535,35 +565,61 @@ PlainResult DBMS::createIndex(const std::string &tableName,
                                       0b1000);
             return makePlainResult("OK");
         }
-        throw Error::AlterIndexError("index exists for " + columnName);
+        throw Error::AlterIndexError("index exists for " + indexName);
+    }
+
+    if (indexName.size() >= MAX_COLUMN_NAME_LEN) {
+        throw Error::AlterIndexError("too many columns: " + indexName);
     }
 
     auto [recordId, table] = getTable(tableName);
-    int columnIndex = table->getColumnIndex(columnName.c_str());
+    std::vector<int> columnIndexes;
+    std::vector<ColumnMeta> columnMetas;
 
-    if (columnIndex < 0) {
-        throw Error::AlterIndexError("column not exists: " + columnName);
+    for (const auto &columnName : columnNames) {
+        int columnIndex = table->getColumnIndex(columnName.c_str());
+        if (columnIndex < 0) {
+            throw Error::AlterIndexError("column not exists: " + columnName);
+        }
+        if (std::find(columnIndexes.begin(), columnIndexes.end(),
+                      columnIndex) != columnIndexes.end()) {
+            throw Error::AlterIndexError("duplicate column: " + columnName);
+        }
+        columnIndexes.push_back(columnIndex);
+        columnMetas.push_back(table->meta.columns[columnIndex]);
     }
 
-    const ColumnMeta &columnMeta = table->meta.columns[columnIndex];
+    // The index files would outlive the records of a memory table.
+    if (table->meta.memory) {
+        throw Error::AlterIndexError(
+            "memory tables are only indexed by their primary keys");
+    }
 
-    if (columnMeta.type != INT) {
+    if (hash && (columnMetas.size() != 1 || columnMetas[0].type == FLOAT)) {
         throw Error::AlterIndexError(
-            "creating index on VARCHAR or FLOAT is not supported");
+            "hash indexes are on a single INT or VARCHAR column");
     }
 
-    // Now create the index. We are not caching this as it is relatively
-    // lightweight.
+    // Now create the index, it is cached when first used.
     Index newIndex;
-    auto path = getIndexPath(currentDatabase, tableName, columnName);
+    auto path = getIndexPath(currentDatabase, tableName, indexName);
     std::filesystem::create_directories(path.parent_path());
-    newIndex.create(path);
+    try {
+        newIndex.create(path, columnMetas, hash);
+    } catch (Internal::CreateIndexError &) {
+        throw Error::AlterIndexError("keys too long: " + indexName);
+    }
 
-    // Inser existing records into the index.
-    table->iterate([&](RecordID id, Columns &columns) {
-        newIndex.insert(columns[columnIndex].data.intValue,
-                        columns[columnIndex].isNull, id);
-        return true;
+    // Load the existing records into the index.
+    newIndex.bulkLoad([&](const Index::BulkInsertFunc &insert) {
+        Columns key(columnIndexes.size());
+        table->iterate([&](RecordID id, Columns &columns) {
+            for (int i = 0; i < columnIndexes.size(); i++) {
+                key[i] = columns[columnIndexes[i]];
+            }
+            insert(key, id);
+            return true;
+        });
     });
 
     newIndex.close();
@@ -572,22 +628,25 @@ PlainResult DBMS::createIndex(const std::string &tableName,
     systemIndexesTable.insert(
         {Column(currentDatabase.c_str(), MAX_DATABASE_NAME_LEN),
          Column(tableName.c_str(), MAX_TABLE_NAME_LEN),
-         Column(columnName.c_str(), MAX_COLUMN_NAME_LEN),
+         Column(indexName.c_str(), MAX_COLUMN_NAME_LEN),
          Column(isPrimaryKey ? 0 : 1)});
+    tableIndexInfos.erase(tableName);
 
     return makePlainResult("OK");
 }
 
 PlainResult DBMS::dropIndex(const std::string &tableName,
-                            const std::string &columnName, bool isPrimaryKey) {
+                            const std::vector<std::string> &columnNames,
+                            bool isPrimaryKey) {
+    std::string indexName = IndexedTable::getIndexName(columnNames);
     Logger::log(VERBOSE, "DBMS: dropping index on %s.%s", tableName.c_str(),
-                columnName.c_str());
+                indexName.c_str());
 
     checkUseDatabase();
-    auto [id, record] = findIndex(currentDatabase, tableName, columnName);
+    auto [id, record] = findIndex(currentDatabase, tableName, indexName);
 
     if (id == RecordID::NULL_RECORD) {
-        throw Error::AlterIndexError("index does not exist: " + columnName);
+        throw Error::AlterIndexError("index does not exist: " + indexName);
     }
 
     int indexType = record[3].data.intValue;
@@ -614,9 +673,11 @@ PlainResult DBMS::dropIndex(const std::string &tableName,
 
     // Remove record from system table.
     systemIndexesTable.remove(id);
+    tableIndexInfos.erase(tableName);
 
     // Remove file.
-    auto path = getIndexPath(currentDatabase, tableName, columnName);
+    closeIndexes(tableName, indexName);
+    auto path = getIndexPath(currentDatabase, tableName, indexName);
     std::filesystem::remove(path);
 
     return makePlainResult("OK");
@@ -642,6 +703,81 @@ ShowIndexesResult DBMS::showIndexes(const std::string &tableName) {
     return showIndexesResult;
 }
 
+PlainResult DBMS::analyzeTable(const std::string &tableName) {
+    Logger::log(VERBOSE, "DBMS: analyzing table %s\n", tableName.c_str());
+
+    checkUseDatabase();
+
+    auto [_, table] = getTable(tableName);
+
+    if (table == nullptr) {
+        throw Error::TableNotExistsError(tableName);
+    }
+
+    std::vector<ColumnStatisticsCollector> collectors;
+    for (int i = 0; i < table->meta.numColumn; i++) {
+        collectors.emplace_back(table->meta.columns[i].type,
+                                STATISTICS_HISTOGRAM_BUCKETS);
+    }
+
+    int numRows = 0;
+    table->iterate([&](RecordID, Columns &columns) {
+        for (int i = 0; i < collectors.size(); i++) {
+            collectors[i].add(columns[i]);
+        }
+        numRows++;
+        return true;
+    });
+
+    // Replace the previous statistics.
+    for (const auto &[rid, _] : findStatistics(currentDatabase, tableName)) {
+        systemStatisticsTable.remove(rid);
+    }
+
+    auto describe = [](const Column &value) {
+        return value.isNull ? Column::nullVarcharColumn(MAX_VARCHAR_LEN)
+                            : Column(ColumnStatistics::valueDesc(value).c_str(),
+                                     MAX_VARCHAR_LEN);
+    };
+
+    for (int i = 0; i < collectors.size(); i++) {
+        ColumnStatistics stats = collectors[i].finish();
+        std::string histogram = stats.histogramDesc();
+        systemStatisticsTable.insert(
+            {Column(currentDatabase.c_str(), MAX_DATABASE_NAME_LEN),
+             Column(tableName.c_str(), MAX_TABLE_NAME_LEN),
+             Column(table->meta.columns[i].name, MAX_COLUMN_NAME_LEN),
+             Column(stats.rowCount), Column(stats.nullFraction()),
+             describe(stats.min), describe(stats.max), Column(stats.ndv),
+             histogram.empty()
+                 ? Column::nullVarcharColumn(MAX_VARCHAR_LEN)
+                 : Column(histogram.c_str(), MAX_VARCHAR_LEN)});
+    }
+
+    return makePlainResult("OK", numRows);
+}
+
+QueryResult DBMS::showStatistics(const std::string &tableName) {
+    Logger::log(VERBOSE, "DBMS: showing statistics of table %s\n",
+                tableName.c_str());
+
+    checkUseDatabase();
+
+    if (getTable(tableName).second == nullptr) {
+        throw Error::TableNotExistsError(tableName);
+    }
+
+    QueryBuilder builder(&systemStatisticsTable);
+    builder.condition("database", EQ, currentDatabase.c_str())
+        .condition("table", EQ, tableName.c_str());
+    for (const char *column : {"field", "row_count", "null_fraction", "min",
+                               "max", "ndv", "histogram"}) {
+        builder.select(column);
+    }
+
+    return select(builder);
+}
+
 PlainResult DBMS::update(QueryBuilder &builder,
                          const std::vector<std::string> &columnNames,
                          const Columns &columns) {
@@ -660,13 +796,10 @@ PlainResult DBMS::update(QueryBuilder &builder,
     // Check if the input columns are valid.
     std::vector<ColumnInfo> columnInfos = builder.getColumnInfo();
     ColumnBitmap updateBitmap = 0;
-    std::vector<std::shared_ptr<Index>> indexes;
-    std::vector<int> indexMapping;                 // col i -> index i
     std::vector<int> columnUpdateIndexRevMapping;  // col i -> update i
     std::vector<int> columnUpdateIndexMapping;     // update i -> col i
     int primaryKeyIndex = -1;
 
-    indexMapping.assign(columnInfos.size(), -1);
     columnUpdateIndexRevMapping.assign(columnInfos.size(), -1);
 
     for (int i = 0; i < columns.size(); i++) {
@@ -679,19 +812,32 @@ PlainResult DBMS::update(QueryBuilder &builder,
         columnUpdateIndexMapping.push_back(colIndex);
         columnUpdateIndexRevMapping[colIndex] = i;
 
-        auto index =
-            getIndex(currentDatabase, table->meta.name, columnNames[i]).second;
-
-        if (index != nullptr) {
-            indexes.push_back(index);
-            indexMapping[colIndex] = indexes.size() - 1;
-        }
-
         if (colIndex == table->meta.primaryKeyIndex) {
             primaryKeyIndex = i;
         }
     }
 
+    // The indexes on any of the updated columns.
+    std::vector<IndexInfo> indexInfos;
+    std::vector<std::shared_ptr<Index>> indexes;
+    for (const auto &info : findIndexInfos(table)) {
+        for (int columnIndex : info.columns) {
+            if (updateBitmap & (1L << columnIndex)) {
+                indexInfos.push_back(info);
+                indexes.push_back(
+                    getIndex(currentDatabase, table->meta.name, info.name)
+                        .second);
+                break;
+            }
+        }
+    }
+
+    // The records of a clustered table are identified by their keys.
+    if (primaryKeyIndex >= 0 && table->meta.clustered) {
+        throw Error::UpdateError(
+            ClusterKeyUpdateError(columnNames[primaryKeyIndex]).what());
+    }
+
     // Check foreign key constaints (referenced by other tables).
     auto referencedColumns =
         findForeignKeys(currentDatabase, {}, {}, table->meta.name, {});
@@ -723,12 +869,22 @@ PlainResult DBMS::update(QueryBuilder &builder,
             // This update is doomed to cause a duplicate pk.
             throw Error::UpdateError("duplicate primary key");
         }
-        assert(indexMapping[primaryKeyIndex] != -1);
-        // The the index of this column.
-        auto index = indexes[indexMapping[primaryKeyIndex]];
         // Check if the new pk already exists.
-        if (index->has(columns[primaryKeyIndex].data.intValue,
-                       columns[primaryKeyIndex].isNull)) {
+        bool exists;
+        if (auto memoryTable = dynamic_cast<MemoryTable *>(table)) {
+            exists = memoryTable->findKey(
+                         columns[primaryKeyIndex].data.intValue) !=
+                     RecordID::NULL_RECORD;
+        } else {
+            // The the index of this column.
+            auto index =
+                getIndex(currentDatabase, table->meta.name,
+                         columnNames[primaryKeyIndex])
+                    .second;
+            assert(index != nullptr);
+            exists = index->has(columns[primaryKeyIndex]);
+        }
+        if (exists) {
             throw Error::UpdateError("duplicate primary key");
         }
     }
@@ -782,21 +938,14 @@ PlainResult DBMS::update(QueryBuilder &builder,
         table->update(rid, columns, updateBitmap);
 
         // Update index.
-        for (int columnIndex : columnUpdateIndexMapping) {
-            if (indexMapping[columnIndex] >= 0) {
-                auto index = indexes[indexMapping[columnIndex]];
-                int updateColIndex = columnUpdateIndexRevMapping[columnIndex];
-                auto &oldCol = oldColumns[i][updateColIndex];
-                auto &newCol = columns[updateColIndex];
-                index->remove(oldCol.data.intValue, oldCol.isNull, rid);
-                index->insert(newCol.data.intValue, newCol.isNull, rid);
-            }
+        Columns newColumns = oldColumns[i];
+        for (int j = 0; j < columns.size(); j++) {
+            newColumns[columnUpdateIndexMapping[j]] = columns[j];
+        }
+        for (int j = 0; j < indexes.size(); j++) {
+            indexes[j]->remove(indexInfos[j].getKey(oldColumns[i]), rid);
+            indexes[j]->insert(indexInfos[j].getKey(newColumns), rid);
         }
-    }
-
-    // Close all indexes.
-    for (auto &index : indexes) {
-        index->close();
     }
 
     return makePlainResult("OK", rids.size());
@@ -825,29 +974,22 @@ PlainResult DBMS::delete_(Internal::QueryBuilder &builder) {
     }
 
     // Get all indexes.
+    const std::vector<IndexInfo> &indexInfos = findIndexInfos(table);
     std::vector<std::shared_ptr<Index>> indexes;
-    std::vector<int> indexMapping;  // indexes.i -> col i
 
-    for (int i = 0; i < table->meta.numColumn; i++) {
-        auto index = getIndex(currentDatabase, table->meta.name,
-                              table->meta.columns[i].name)
-                         .second;
-        if (index == nullptr) {
-            continue;
-        }
-        indexes.push_back(index);
-        indexMapping.push_back(i);
+    for (const auto &info : indexInfos) {
+        indexes.push_back(
+            getIndex(currentDatabase, table->meta.name, info.name).second);
     }
 
     // Get all records and index keys.
     std::vector<RecordID> rids;
-    std::vector<Columns> oldColumns;
+    std::vector<std::vector<Columns>> oldKeys;
     builder.iterate([&](RecordID id, Columns &record) {
         rids.push_back(id);
-        oldColumns.emplace_back();
-        for (int i = 0; i < indexMapping.size(); i++) {
-            oldColumns[oldColumns.size() - 1].push_back(
-                record[indexMapping[i]]);
+        oldKeys.emplace_back();
+        for (const auto &info : indexInfos) {
+            oldKeys.back().push_back(info.getKey(record));
         }
         return true;
     });
@@ -857,18 +999,11 @@ PlainResult DBMS::delete_(Internal::QueryBuilder &builder) {
         RecordID rid = rids[i];
         table->remove(rid);
         // Update index.
-        for (int j = 0; j < indexMapping.size(); j++) {
-            auto index = indexes[j];
-            auto &oldCol = oldColumns[i][indexMapping[j]];
-            index->remove(oldCol.data.intValue, oldCol.isNull, rid);
+        for (int j = 0; j < indexes.size(); j++) {
+            indexes[j]->remove(oldKeys[i][j], rid);
         }
     }
 
-    // Close all indexes.
-    for (auto index : indexes) {
-        index->close();
-    }
-
     Logger::log(VERBOSE, "DBMS: deleted %lu records from %s\n", rids.size(),
                 table->meta.name);
 
@@ -959,33 +1094,282 @@ PlainResult DBMS::insert(const std::string &tableName,
     RecordID id = table->insert(columns, ~emptyBits);
 
     // Insert into indexes.
-    std::map<int, std::shared_ptr<Index>> indexes;
+    const std::vector<IndexInfo> &indexInfos = findIndexInfos(table);
+    // The record as stored, with the default values filled in.
+    Columns record;
+    if (!indexInfos.empty()) {
+        table->get(id, record);
+    }
 
-    QueryBuilder::Result result = findIndexes(currentDatabase, tableName);
+    for (const auto &info : indexInfos) {
+        auto index = getIndex(currentDatabase, tableName, info.name).second;
+        index->insert(info.getKey(record), id);
+    }
 
-    for (const auto &pair : result) {
-        auto [_, indexColumns] = pair;
-        const std::string &columnName = indexColumns[2].data.stringValue;
-        int columnIndex = table->getColumnIndex(columnName.c_str());
+    return makePlainResult("OK", 1);
+}
 
-        auto path = getIndexPath(currentDatabase, tableName, columnName);
+PlainResult DBMS::loadData(const std::string &tableName,
+                           const std::string &path, char delimiter) {
+    Logger::log(VERBOSE, "DBMS: loading data from %s into %s\n", path.c_str(),
+                tableName.c_str());
+    checkUseDatabase();
+
+    auto [_, table] = getTable(tableName);
+
+    if (table == nullptr) {
+        throw Error::TableNotExistsError(tableName);
+    }
 
-        // TODO: Cache index.
-        Index index;
-        index.open(path);
+    std::ifstream stream(path);
+    if (!stream.is_open()) {
+        throw Error::InsertError("cannot open file " + path);
+    }
 
-        int key = columnMapping[columnIndex] == -1
-                      ? table->meta.columns[columnIndex].defaultValue.intValue
-                      : columns[columnMapping[columnIndex]].data.intValue;
-        bool isNull = columnMapping[columnIndex] == -1
-                          ? !table->meta.columns[columnIndex].hasDefault
-                          : columns[columnMapping[columnIndex]].isNull;
+    const int numColumn = table->meta.numColumn;
+    const int primaryKeyIndex = table->meta.primaryKeyIndex;
 
-        index.insert(key, isNull, id);
-        index.close();
+    // Instead of querying the indexes for every row, the constraints are
+    // checked against the sets of existing keys.
+    std::unordered_set<int> primaryKeys;
+    if (primaryKeyIndex >= 0) {
+        table->iterate([&](RecordID, Columns &columns) {
+            primaryKeys.insert(columns[primaryKeyIndex].data.intValue);
+            return true;
+        });
     }
 
-    return makePlainResult("OK", 1);
+    struct ForeignKeyCheck {
+        int columnIndex;
+        std::string refTable;
+        std::unordered_set<int> refKeys;
+    };
+    std::vector<ForeignKeyCheck> foreignKeyChecks;
+    for (const auto &foreignKey :
+         findForeignKeys(currentDatabase, tableName, {}, {}, {})) {
+        Table *refTable = getTable(foreignKey.refTable).second;
+        assert(refTable != nullptr);
+        int refColIndex =
+            refTable->getColumnIndex(foreignKey.refColumn.c_str());
+        assert(refColIndex >= 0);
+
+        ForeignKeyCheck check;
+        check.columnIndex = table->getColumnIndex(foreignKey.column.c_str());
+        check.refTable = foreignKey.refTable;
+        refTable->iterate([&](RecordID, Columns &columns) {
+            check.refKeys.insert(columns[refColIndex].data.intValue);
+            return true;
+        });
+        foreignKeyChecks.push_back(std::move(check));
+    }
+
+    // Index entries are collected during the load, and bulk loaded into the
+    // empty indexes afterwards, or inserted in key order into the others.
+    struct IndexEntries {
+        IndexInfo info;
+        std::vector<std::pair<Columns, RecordID>> entries;
+    };
+    std::vector<IndexEntries> indexEntries;
+    for (const auto &info : findIndexInfos(table)) {
+        indexEntries.push_back({info, {}});
+    }
+
+    std::vector<Columns> batch;
+    batch.reserve(LOAD_DATA_BATCH_SIZE);
+    int numRows = 0;
+
+    auto flushBatch = [&]() {
+        if (batch.empty()) {
+            return;
+        }
+        // Not inserted again if it fails.
+        std::vector<Columns> rows = std::move(batch);
+        batch.clear();
+        std::vector<RecordID> ids = table->insertBatch(rows);
+        for (auto &index : indexEntries) {
+            for (int i = 0; i < rows.size(); i++) {
+                index.entries.push_back({index.info.getKey(rows[i]), ids[i]});
+            }
+        }
+        numRows += rows.size();
+    };
+
+    auto buildIndexes = [&]() {
+        for (auto &index : indexEntries) {
+            Index &indexFile =
+                *getIndex(currentDatabase, tableName, index.info.name).second;
+            if (indexFile.canBulkLoad()) {
+                indexFile.bulkLoad([&](const Index::BulkInsertFunc &insert) {
+                    for (const auto &[key, id] : index.entries) {
+                        insert(key, id);
+                    }
+                });
+                index.entries.clear();
+                continue;
+            }
+            // Sort by the keys, with the NULL entries first.
+            std::vector<std::pair<Index::Key, int>> order;
+            order.reserve(index.entries.size());
+            for (int i = 0; i < index.entries.size(); i++) {
+                const Columns &key = index.entries[i].first;
+                order.push_back(
+                    {key[0].isNull ? Index::Key() : indexFile.encodeKey(key),
+                     i});
+            }
+            std::sort(order.begin(), order.end());
+            for (const auto &[_, i] : order) {
+                indexFile.insert(index.entries[i].first,
+                                 index.entries[i].second);
+            }
+            index.entries.clear();
+        }
+    };
+
+    CSVReader reader(stream, delimiter);
+    std::vector<CSVReader::Field> fields;
+
+    try {
+        while (reader.next(fields)) {
+            if (fields.size() != numColumn) {
+                throw Error::InsertError("number of columns does not match");
+            }
+
+            Columns columns;
+            columns.reserve(numColumn);
+            for (int i = 0; i < numColumn; i++) {
+                columns.push_back(ParseHelper::parseCSVField(
+                    fields[i], table->meta.columns[i]));
+            }
+
+            if (primaryKeyIndex >= 0) {
+                int key = columns[primaryKeyIndex].data.intValue;
+                if (!primaryKeys.insert(key).second) {
+                    throw Error::InsertError("duplicate primary key " +
+                                             std::to_string(key));
+                }
+            }
+
+            for (const auto &check : foreignKeyChecks) {
+                const Column &column = columns[check.columnIndex];
+                if (!column.isNull &&
+                    check.refKeys.find(column.data.intValue) ==
+                        check.refKeys.end()) {
+                    throw Error::InsertError(
+                        ForeignKeyViolationError(
+                            "referenced record " +
+                            std::to_string(column.data.intValue) + " in " +
+                            check.refTable + " not found")
+                            .what());
+                }
+            }
+
+            batch.push_back(std::move(columns));
+            if (batch.size() == LOAD_DATA_BATCH_SIZE) {
+                flushBatch();
+            }
+        }
+    } catch (BaseError &e) {
+        // Keep the rows before the failing one, and make the indexes
+        // consistent with the table, whatever the error is, e.g. a malformed
+        // file.
+        flushBatch();
+        buildIndexes();
+        throw Error::InsertError("line " + std::to_string(reader.lineNumber()) +
+                                 " (" + std::to_string(numRows) +
+                                 " rows loaded): " + e.what());
+    }
+
+    flushBatch();
+    buildIndexes();
+
+    Logger::log(VERBOSE, "DBMS: loaded %d records into %s\n", numRows,
+                tableName.c_str());
+
+    return makePlainResult("OK", numRows);
+}
+
+PlainResult DBMS::vacuumTable(const std::string &tableName, int limit) {
+    Logger::log(VERBOSE, "DBMS: vacuuming table %s\n", tableName.c_str());
+    checkUseDatabase();
+
+    auto [_, table] = getTable(tableName);
+
+    if (table == nullptr) {
+        throw Error::TableNotExistsError(tableName);
+    }
+
+    struct IndexMoves {
+        IndexInfo info;
+        std::vector<std::tuple<Columns, RecordID, RecordID>> moves;
+    };
+    std::vector<IndexMoves> indexMoves;
+    for (const auto &info : findIndexInfos(table)) {
+        indexMoves.push_back({info, {}});
+    }
+
+    int numMovedRecords = 0;
+    int numFreedPages = 0;
+    Table::CompactResult result;
+
+    // Each batch leaves the table and its indexes consistent, so the work done
+    // is kept even if a later batch fails.
+    do {
+        int batchSize = VACUUM_BATCH_SIZE;
+        if (limit >= 0) {
+            batchSize = std::min(batchSize, limit - numMovedRecords);
+        }
+        result = table->compact(
+            batchSize,
+            [&](RecordID from, RecordID to, const Columns &columns) {
+                for (auto &index : indexMoves) {
+                    index.moves.push_back(
+                        {index.info.getKey(columns), from, to});
+                }
+            });
+
+        for (auto &index : indexMoves) {
+            Index &indexFile =
+                *getIndex(currentDatabase, tableName, index.info.name).second;
+            for (const auto &[key, from, to] : index.moves) {
+                indexFile.remove(key, from);
+                indexFile.insert(key, to);
+            }
+            index.moves.clear();
+        }
+
+        numMovedRecords += result.numMovedRecords;
+        numFreedPages += result.numFreedPages;
+    } while (!result.done && (limit < 0 || numMovedRecords < limit));
+
+    if (!result.done) {
+        Logger::log(VERBOSE,
+                    "DBMS: moved %d records and freed %d pages of %s, stopped "
+                    "at the limit\n",
+                    numMovedRecords, numFreedPages, tableName.c_str());
+        return makePlainResult("OK, " + std::to_string(numFreedPages) +
+                                   " pages freed, more to vacuum",
+                               numMovedRecords);
+    }
+
+    // Then pack the entries of the indexes.
+    int numFreedIndexPages = 0;
+    for (const auto &index : indexMoves) {
+        numFreedIndexPages +=
+            getIndex(currentDatabase, tableName, index.info.name)
+                .second->vacuum();
+    }
+
+    Logger::log(VERBOSE,
+                "DBMS: moved %d records, freed %d pages and %d index pages "
+                "of %s\n",
+                numMovedRecords, numFreedPages, numFreedIndexPages,
+                tableName.c_str());
+
+    return makePlainResult("OK, " + std::to_string(numFreedPages) +
+                               " pages and " +
+                               std::to_string(numFreedIndexPages) +
+                               " index pages freed",
+                           numMovedRecords);
 }
 
 QueryBuilder DBMS::buildQuery(
@@ -1025,10 +1409,21 @@ QueryBuilder DBMS::buildQuery(
             joinedTable->append(indexedTable);
         }
         builder = QueryBuilder(joinedTable);
+        // Large full scans are run on all the cores.
+        builder.parallel(std::thread::hardware_concurrency());
     }
 
+    // The equalities come first, so that the later columns of composite
+    // indexes can be taken after them.
     for (const auto &cond : valueConditions) {
-        builder.condition(cond);
+        if (cond.op == EQ) {
+            builder.condition(cond);
+        }
+    }
+    for (const auto &cond : valueConditions) {
+        if (cond.op != EQ) {
+            builder.condition(cond);
+        }
     }
 
     for (const auto &cond : columnConditions) {
@@ -1210,6 +1605,48 @@ QueryBuilder::Result DBMS::findIndexes(const std::string &database,
     return builder.execute();
 }
 
+const std::vector<DBMS::IndexInfo> &DBMS::findIndexInfos(const Table *table) {
+    auto iter = tableIndexInfos.find(table->meta.name);
+    if (iter != tableIndexInfos.end()) {
+        return iter->second;
+    }
+
+    std::vector<IndexInfo> &infos = tableIndexInfos[table->meta.name];
+
+    for (const auto &[_, columns] :
+         findIndexes(currentDatabase, table->meta.name)) {
+        IndexInfo info;
+        info.name = columns[2].data.stringValue;
+        for (const auto &column : IndexedTable::getIndexColumns(info.name)) {
+            info.columns.push_back(table->getColumnIndex(column.c_str()));
+            assert(info.columns.back() >= 0);
+        }
+        infos.push_back(std::move(info));
+    }
+
+    return infos;
+}
+
+Columns DBMS::IndexInfo::getKey(const Columns &record) const {
+    Columns key;
+    key.reserve(columns.size());
+    for (int columnIndex : columns) {
+        key.push_back(record[columnIndex]);
+    }
+    return key;
+}
+
+QueryBuilder::Result DBMS::findStatistics(const std::string &database,
+                                          const std::string &table) {
+    QueryBuilder builder(&systemStatisticsTable);
+    builder.condition("database", EQ, database.c_str());
+    if (!table.empty()) {
+        builder.condition("table", EQ, table.c_str());
+    }
+
+    return builder.execute();
+}
+
 std::vector<DBMS::ForeignKeyInfo> DBMS::findForeignKeys(
     const std::string &database, const std::string &table,
     const std::string &column, const std::string &refTable,
@@ -1292,8 +1729,33 @@ std::pair<RecordID, Table *> DBMS::getTable(const std::string &tableName) {
         table = it->second;
     } else {
         table = new Table();
-        table->open(path);
+        // The records moved by an upgrade of the file are moved in the
+        // indexes too.
+        std::vector<std::tuple<Columns, RecordID, RecordID>> moves;
+        table->open(path,
+                    [&](RecordID from, RecordID to, const Columns &columns) {
+                        moves.push_back({columns, from, to});
+                    });
+        if (table->meta.memory) {
+            // The class of a table is only known from its metadata, which is
+            // all that is read again, as a memory table has no pages.
+            delete table;
+            table = new MemoryTable();
+            table->open(path);
+        }
         openedTables[tableName] = table;
+
+        if (!moves.empty()) {
+            for (const auto &info : findIndexInfos(table)) {
+                Index &index =
+                    *getIndex(currentDatabase, tableName, info.name).second;
+                for (const auto &[columns, from, to] : moves) {
+                    Columns key = info.getKey(columns);
+                    index.remove(key, from);
+                    index.insert(key, to);
+                }
+            }
+        }
     }
 
     return {id, table};
@@ -1302,28 +1764,52 @@ std::pair<RecordID, Table *> DBMS::getTable(const std::string &tableName) {
 std::pair<RecordID, std::shared_ptr<Index>> DBMS::getIndex(
     const std::string &database, const std::string &table,
     const std::string &column) {
-    auto [id, columns] = findIndex(currentDatabase, table, column);
+    IndexKey key = {database, table, column};
+    auto iter = openedIndexes.find(key);
+    if (iter != openedIndexes.end()) {
+        return {iter->second.id, iter->second.index};
+    }
+
+    auto [id, columns] = findIndex(database, table, column);
     if (id == RecordID::NULL_RECORD) {
         return {id, nullptr};
     }
-    auto path = getIndexPath(currentDatabase, table, column);
-    std::shared_ptr<Index> index = std::make_shared<Index>();
-    index->open(path);
+
+    auto index = std::make_shared<Index>();
+    index->open(getIndexPath(database, table, column));
+    openedIndexes[key] = {id, index};
 
     return {id, index};
 }
 
+void DBMS::closeIndexes(const std::string &table, const std::string &column) {
+    for (auto it = openedIndexes.begin(); it != openedIndexes.end();) {
+        const auto &[database, indexTable, indexColumn] = it->first;
+        if (database == currentDatabase && indexTable == table &&
+            (column.empty() || indexColumn == column)) {
+            it->second.index->close();
+            it = openedIndexes.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
 std::shared_ptr<IndexedTable> DBMS::newIndexedTable(Table *table) {
+    std::vector<std::string> compositeIndexes;
+    for (const auto &info : findIndexInfos(table)) {
+        if (info.columns.size() > 1) {
+            compositeIndexes.push_back(info.name);
+        }
+    }
+
     std::shared_ptr<IndexedTable> indexedTable = std::make_shared<IndexedTable>(
         table,
         [this](const std::string &table,
                const std::string &column) -> std::shared_ptr<Index> {
-            auto index = this->getIndex(currentDatabase, table, column).second;
-            if (index != nullptr) {
-                index->setReadOnly();
-            }
-            return index;
-        });
+            return this->getIndex(currentDatabase, table, column).second;
+        },
+        compositeIndexes);
 
     return indexedTable;
 }
@@ -1342,6 +1828,11 @@ void DBMS::clearCurrentDatabase() {
             delete pair.second;
         }
         openedTables.clear();
+        for (auto &pair : openedIndexes) {
+            pair.second.index->close();
+        }
+        openedIndexes.clear();
+        tableIndexInfos.clear();
     }
     currentDatabase.clear();
 }
@@ -122,8 +122,13 @@ antlrcpp::Any ParseTreeVisitor::visitCreate_table(
             .as<std::tuple<std::vector<ColumnMeta>, std::string,
                            std::vector<ForeignKey>>>();
 
-    PlainResult result = dbms->createTable(ctx->Identifier()->getText(),
-                                           columns, primaryKey, foreignKeys);
+    PlainResult result =
+        dbms->createTable(ctx->Identifier()->getText(), columns, primaryKey,
+                          foreignKeys,
+                          /*zoneMap=*/ctx->ZoneMap() != nullptr,
+                          /*pax=*/ctx->Pax() != nullptr,
+                          /*clustered=*/ctx->Clustered() != nullptr,
+                          /*memory=*/ctx->Memory() != nullptr);
 
     return wrap(result);
 }
@@ -198,6 +203,8 @@ antlrcpp::Any ParseTreeVisitor::visitNormal_field(
         column.hasDefault = false;
     }
 
+    column.dictionary = ctx->Dictionary() != nullptr;
+
     return column;
 }
 
@@ -241,32 +248,30 @@ antlrcpp::Any ParseTreeVisitor::visitAlter_table_add_foreign_key(
 
 antlrcpp::Any ParseTreeVisitor::visitAlter_add_index(
     SqlParser::Alter_add_indexContext *ctx) {
-    PlainResult result;
-
-    // We are not dealing with something like "... ADD INDEX (a, a)", which will
-    // raise an exception for "index exists".
-
     const auto &tableName = ctx->Identifier()->getText();
 
-    for (int i = 0; i < ctx->identifiers()->children.size(); i++) {
-        const auto &columnName = ctx->identifiers()->Identifier(i)->getText();
-        result = dbms->createIndex(tableName, columnName);
+    // A composite index on more than one column.
+    std::vector<std::string> columnNames;
+    for (auto *identifier : ctx->identifiers()->Identifier()) {
+        columnNames.push_back(identifier->getText());
     }
 
+    PlainResult result =
+        dbms->createIndex(tableName, columnNames, /*isPrimaryKey=*/false,
+                          /*hash=*/ctx->Hash() != nullptr);
     return wrap(result);
 }
 
 antlrcpp::Any ParseTreeVisitor::visitAlter_drop_index(
     SqlParser::Alter_drop_indexContext *ctx) {
-    PlainResult result;
-
     const auto &tableName = ctx->Identifier()->getText();
 
-    for (int i = 0; i < ctx->identifiers()->children.size(); i++) {
-        const auto &columnName = ctx->identifiers()->Identifier(i)->getText();
-        result = dbms->dropIndex(tableName, columnName);
+    std::vector<std::string> columnNames;
+    for (auto *identifier : ctx->identifiers()->Identifier()) {
+        columnNames.push_back(identifier->getText());
     }
 
+    PlainResult result = dbms->dropIndex(tableName, columnNames);
     return wrap(result);
 }
 
@@ -279,6 +284,12 @@ antlrcpp::Any ParseTreeVisitor::visitShow_indexes(
     return wrap(result);
 }
 
+antlrcpp::Any ParseTreeVisitor::visitShow_stats(
+    SQLParser::SqlParser::Show_statsContext *ctx) {
+    QueryResult result = dbms->showStatistics(ctx->Identifier()->getText());
+    return wrap(result);
+}
+
 antlrcpp::Any ParseTreeVisitor::visitInsert_into_table(
     SQLParser::SqlParser::Insert_into_tableContext *ctx) {
     const std::string &tableName = ctx->Identifier()->getText();
@@ -352,7 +363,7 @@ antlrcpp::Any ParseTreeVisitor::visitWhere_operator_expression(
     auto expressionNode = ctx->expression();
     if (expressionNode->value() != nullptr) {
         result.value =
-            ParseHelper::parseColumnValue(ctx->expression()->value()).data;
+            ParseHelper::parseConditionValue(ctx->expression()->value());
         result.isValueCondition = true;
     } else if (expressionNode->column() != nullptr) {
         result.rhs = expressionNode->column()->accept(this).as<ColumnId>();
@@ -526,5 +537,41 @@ antlrcpp::Any ParseTreeVisitor::visitDelete_from_table(
     return wrap(res);
 }
 
+antlrcpp::Any ParseTreeVisitor::visitLoad_data(
+    SqlParser::Load_dataContext *ctx) {
+    std::string path = ParseHelper::parseString(ctx->String(0)->getText());
+    std::string tableName = ctx->Identifier()->getText();
+
+    char delimiter = ',';
+    if (ctx->String(1) != nullptr) {
+        std::string delimiterString =
+            ParseHelper::parseString(ctx->String(1)->getText());
+        if (delimiterString.size() != 1) {
+            throw Error::IncompatableValueError(
+                "field delimiter must be a single character");
+        }
+        delimiter = delimiterString[0];
+    }
+
+    PlainResult res = dbms->loadData(tableName, path, delimiter);
+    return wrap(res);
+}
+
+antlrcpp::Any ParseTreeVisitor::visitVacuum_table(
+    SqlParser::Vacuum_tableContext *ctx) {
+    int limit = -1;
+    if (ctx->Integer() != nullptr) {
+        limit = ParseHelper::parseInt(ctx->Integer()->getText());
+    }
+    PlainResult res = dbms->vacuumTable(ctx->Identifier()->getText(), limit);
+    return wrap(res);
+}
+
+antlrcpp::Any ParseTreeVisitor::visitAnalyze_table(
+    SqlParser::Analyze_tableContext *ctx) {
+    PlainResult res = dbms->analyzeTable(ctx->Identifier()->getText());
+    return wrap(res);
+}
+
 }  // namespace Internal
 }
\ No newline at end of file
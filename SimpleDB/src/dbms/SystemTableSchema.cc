@@ -74,4 +74,46 @@ std::vector<Internal::ColumnMeta> DBMS::systemForeignKeyTableColumns = {
      .hasDefault = false},
 };
 
+std::vector<Internal::ColumnMeta> DBMS::systemStatisticsTableColumns = {
+    {.type = VARCHAR,
+     .size = MAX_DATABASE_NAME_LEN,
+     .nullable = false,
+     .name = "database",
+     .hasDefault = false},
+    {.type = VARCHAR,
+     .size = MAX_TABLE_NAME_LEN,
+     .nullable = false,
+     .name = "table",
+     .hasDefault = false},
+    {.type = VARCHAR,
+     .size = MAX_COLUMN_NAME_LEN,
+     .nullable = false,
+     .name = "field",
+     .hasDefault = false},
+    {.type = INT, .nullable = false, .name = "row_count", .hasDefault = false},
+    {.type = FLOAT,
+     .nullable = false,
+     .name = "null_fraction",
+     .hasDefault = false},
+    /* min and max are stored as text, so that they work for all types */
+    {.type = VARCHAR,
+     .size = MAX_VARCHAR_LEN,
+     .nullable = true,
+     .name = "min",
+     .hasDefault = false},
+    {.type = VARCHAR,
+     .size = MAX_VARCHAR_LEN,
+     .nullable = true,
+     .name = "max",
+     .hasDefault = false},
+    {.type = INT, .nullable = false, .name = "ndv", .hasDefault = false},
+    /* comma-separated upper bounds of the equi-depth buckets (INT and FLOAT
+       only) */
+    {.type = VARCHAR,
+     .size = MAX_VARCHAR_LEN,
+     .nullable = true,
+     .name = "histogram",
+     .hasDefault = false},
+};
+
 }  // namespace SimpleDB
\ No newline at end of file
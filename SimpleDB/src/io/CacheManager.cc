@@ -44,6 +44,31 @@ void CacheManager::onCloseFile(FileDescriptor fd) {
     }
 }
 
+void CacheManager::onTruncateFile(FileDescriptor fd, int numPages) {
+    if (!fileManager->validate(fd)) {
+        Logger::log(
+            ERROR,
+            "CacheManager: fail on truncating file: invalid file descriptor: "
+            "%d",
+            fd.value);
+        throw Internal::InvalidDescriptorError();
+    }
+
+    auto &map = activeCacheMapVec[fd];
+
+    std::vector<PageCache *> caches;
+    for (auto iter = map.lower_bound(numPages); iter != map.end(); iter++) {
+        caches.push_back(iter->second);
+    }
+
+    for (auto cache : caches) {
+        // Clear the dirty flag so that the page is dropped instead of being
+        // written beyond the end of the file.
+        cache->dirty = false;
+        writeBack(cache);
+    }
+}
+
 void CacheManager::close() {
     if (closed) {
         return;
@@ -183,6 +208,122 @@ char *CacheManager::loadRaw(const PageHandle &handle) {
     return handle.cache->buf;
 }
 
+void CacheManager::readPage(FileDescriptor fd, int page, char *dest) {
+    std::unique_lock<std::mutex> lock(readMutex);
+    PageCache *cache = pinPageCache(fd, page, lock);
+
+    lock.unlock();
+    memcpy(dest, cache->buf, PAGE_SIZE);
+    lock.lock();
+
+    unpin(cache);
+}
+
+CacheManager::PageCache *CacheManager::pinPageCache(
+    FileDescriptor fd, int page, std::unique_lock<std::mutex> &lock) {
+    if (!fileManager->validate(fd) || page < 0) {
+        // Let getPageCache() report the error.
+        return getPageCache(fd, page);
+    }
+
+    auto &cacheMap = activeCacheMapVec[fd];
+    while (true) {
+        auto iter = cacheMap.find(page);
+        if (iter != cacheMap.end()) {
+            PageCache *cache = iter->second;
+            cache->pins++;
+            activeCache.remove(cache->nodeInActiveCache);
+            cache->nodeInActiveCache = activeCache.insertHead(cache);
+
+            readCondition.wait(lock, [cache] { return !cache->loading; });
+            if (cache->meta.fd == fd && cache->meta.page == page) {
+                return cache;
+            }
+            // The load failed and the cache was dropped, try again.
+            unpin(cache);
+            continue;
+        }
+
+        PageCache *cache = nullptr;
+        if (freeCache.size() > 0) {
+            cache = freeCache.removeTail();
+        } else {
+            // Select the least recently used cache not being read.
+            cache = activeCache.findFromTail(
+                [](PageCache *cache) { return cache->pins == 0; });
+            if (cache == nullptr) {
+                readCondition.wait(lock);
+                continue;
+            }
+
+            if (cache->dirty) {
+                // Write it back with the cache pinned, so that it can still
+                // be read but not replaced, then select again, as the page
+                // might be cached by others meanwhile.
+                cache->pins++;
+                lock.unlock();
+                try {
+                    fileManager->writePage(cache->meta.fd, cache->meta.page,
+                                           cache->buf);
+                } catch (...) {
+                    lock.lock();
+                    unpin(cache);
+                    throw;
+                }
+                lock.lock();
+                cache->dirty = false;
+                unpin(cache);
+                continue;
+            }
+
+            Logger::log(VERBOSE,
+                        "CacheManager: replace cache of page %d of file %d "
+                        "for page %d of file %d\n",
+                        cache->meta.page, cache->meta.fd.value, page,
+                        fd.value);
+            activeCacheMapVec[cache->meta.fd].erase(cache->meta.page);
+            activeCache.remove(cache->nodeInActiveCache);
+            cache->generation++;
+        }
+
+        // Claim the cache, then read the page without holding the lock. Others
+        // asking for the page wait until it is loaded.
+        cache->reset({fd, page});
+        cache->loading = true;
+        cache->pins = 1;
+        cacheMap[page] = cache;
+        cache->nodeInActiveCache = activeCache.insertHead(cache);
+
+        lock.unlock();
+        try {
+            fileManager->readPage(fd, page, cache->buf, true);
+        } catch (...) {
+            lock.lock();
+            cacheMap.erase(page);
+            cache->meta = PageMeta();
+            cache->loading = false;
+            readCondition.notify_all();
+            // Wait for the others to let it go before freeing it.
+            readCondition.wait(lock, [cache] { return cache->pins == 1; });
+            cache->pins = 0;
+            activeCache.remove(cache->nodeInActiveCache);
+            cache->nodeInActiveCache = nullptr;
+            freeCache.insertHead(cache);
+            cache->generation++;
+            throw;
+        }
+        lock.lock();
+        cache->loading = false;
+        readCondition.notify_all();
+        return cache;
+    }
+}
+
+void CacheManager::unpin(PageCache *cache) {
+    cache->pins--;
+    readCondition.notify_all();
+}
+
 void CacheManager::markDirty(const PageHandle &handle) {
     PageCache *cache = handle.cache;
 
@@ -34,6 +34,11 @@ void FileCoordinator::deleteFile(const std::string &fileName) {
     fileManager->deleteFile(fileName);
 }
 
+void FileCoordinator::truncateFile(FileDescriptor fd, int numPages) {
+    cacheManager->onTruncateFile(fd, numPages);
+    fileManager->truncateFile(fd, numPages);
+}
+
 PageHandle FileCoordinator::getHandle(FileDescriptor fd, int page) {
     return cacheManager->getHandle(fd, page);
 }
@@ -47,6 +52,10 @@ void FileCoordinator::markDirty(const PageHandle &handle) {
     cacheManager->markDirty(handle);
 }
 
+void FileCoordinator::readPage(FileDescriptor fd, int page, char *dest) {
+    cacheManager->readPage(fd, page, dest);
+}
+
 PageHandle FileCoordinator::renew(const PageHandle &handle) {
     return cacheManager->renew(handle);
 }
@@ -1,6 +1,7 @@
 #include "internal/FileManager.h"
 
 #include <string.h>
+#include <unistd.h>
 
 #include <filesystem>
 #include <iostream>
@@ -94,32 +95,35 @@ void FileManager::readPage(FileDescriptor descriptor, int page, char *data,
     }
 
     const OpenedFile &file = openedFiles[descriptor];
-    FILE *fd = file.fd;
 
-    int err = fseek(fd, page * PAGE_SIZE, SEEK_SET);
-    if (err) {
+    // Positional reads do not share the file offset, so that the pages can be
+    // read by several threads at the same time.
+    ssize_t readSize = pread(fileno(file.fd), data, PAGE_SIZE,
+                             off_t(page) * PAGE_SIZE);
+    if (readSize < 0) {
         if (!couldFail) {
-            Logger::log(
-                ERROR,
-                "FileManager: fail to read page of file %s: seek to page "
-                "%d failed: %s\n",
-                file.fileName.c_str(), page, strerror(errno));
+            Logger::log(ERROR,
+                        "FileManager: fail to read page %d of file %s: %s\n",
+                        page, file.fileName.c_str(), strerror(errno));
             throw Internal::ReadFileError();
         } else {
+            memset(data, 0, PAGE_SIZE);
             return;
         }
     }
 
-    size_t readSize = fread(data, 1, PAGE_SIZE, fd);
     if (readSize != PAGE_SIZE) {
         if (!couldFail) {
             Logger::log(
                 ERROR,
                 "FileManager: fail to read page of file %s: read page %d "
-                "failed (read size %lu)\n",
+                "failed (read size %ld)\n",
                 file.fileName.c_str(), page, readSize);
             throw Internal::ReadFileError();
         } else {
+            // The page is (partly) beyond the end of the file, which reads as
+            // zeros rather than what the buffer held before.
+            memset(data + readSize, 0, PAGE_SIZE - readSize);
             return;
         }
     }
@@ -144,28 +148,57 @@ void FileManager::writePage(FileDescriptor descriptor, int page, char *data) {
     }
 
     const OpenedFile &file = openedFiles[descriptor];
-    FILE *fd = file.fd;
 
-    int err = fseek(fd, page * PAGE_SIZE, SEEK_SET);
-    if (err) {
+    // Positional as well, so that it is seen by the reads above.
+    ssize_t writeSize = pwrite(fileno(file.fd), data, PAGE_SIZE,
+                               off_t(page) * PAGE_SIZE);
+    if (writeSize != PAGE_SIZE) {
         Logger::log(ERROR,
-                    "FileManager: fail to write page of file %s: seek to page "
-                    "%d failed: %s\n",
-                    file.fileName.c_str(), page, strerror(errno));
+                    "FileManager: fail to write page %d of file %s (write "
+                    "size: %ld): %s\n",
+                    page, file.fileName.c_str(), writeSize, strerror(errno));
         throw Internal::WriteFileError();
     }
 
-    size_t writeSize = fwrite(data, 1, PAGE_SIZE, fd);
-    if (writeSize != PAGE_SIZE) {
+    Logger::log(VERBOSE, "FileManager: wrote page %d to file %s\n", page,
+                file.fileName.c_str());
+}
+
+void FileManager::truncateFile(FileDescriptor descriptor, int numPages) {
+    if (!validate(descriptor)) {
         Logger::log(
             ERROR,
-            "FileManager: fail to write page %d of file %s (write size: %lu)\n",
-            page, file.fileName.c_str(), writeSize);
-        throw Internal::WriteFileError();
+            "FileManager: fail to truncate file: invalid descriptor %d\n",
+            descriptor.value);
+        throw Internal::InvalidDescriptorError();
     }
 
-    Logger::log(VERBOSE, "FileManager: wrote page %d to file %s\n", page,
-                file.fileName.c_str());
+    if (numPages < 0) {
+        Logger::log(
+            ERROR,
+            "FileManager: fail to truncate file: invalid page number %d\n",
+            numPages);
+        throw Internal::InvalidPageNumberError();
+    }
+
+    const OpenedFile &file = openedFiles[descriptor];
+    FILE *fd = file.fd;
+
+    // Flush the stream buffer first, or a pending write might extend the file
+    // again after the truncation.
+    int err = fflush(fd);
+    if (err == 0) {
+        err = ftruncate(fileno(fd), off_t(numPages) * PAGE_SIZE);
+    }
+    if (err) {
+        Logger::log(ERROR,
+                    "FileManager: fail to truncate file %s to %d pages: %s\n",
+                    file.fileName.c_str(), numPages, strerror(errno));
+        throw Internal::TruncateFileError();
+    }
+
+    Logger::log(VERBOSE, "FileManager: truncated file %s to %d pages\n",
+                file.fileName.c_str(), numPages);
 }
 
 bool FileManager::validate(FileDescriptor fd) {
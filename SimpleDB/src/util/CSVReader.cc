@@ -0,0 +1,90 @@
+#include "internal/CSVReader.h"
+
+#include "Error.h"
+#include "internal/Logger.h"
+
+namespace SimpleDB {
+namespace Internal {
+
+bool CSVReader::next(std::vector<Field> &fields) {
+    std::streambuf *buf = stream.rdbuf();
+    int numFields = 0;
+
+    // Skip empty lines.
+    int c = buf->sgetc();
+    while (c == '\n' || c == '\r') {
+        if (buf->sbumpc() == '\n') {
+            line++;
+        }
+        c = buf->sgetc();
+    }
+    if (c == std::char_traits<char>::eof()) {
+        fields.clear();
+        return false;
+    }
+
+    recordLine = line;
+
+    while (true) {
+        // Start a new field.
+        if (numFields == fields.size()) {
+            fields.emplace_back();
+        }
+        Field &field = fields[numFields++];
+        field.value.clear();
+        field.quoted = false;
+
+        c = buf->sbumpc();
+        if (c == '"') {
+            field.quoted = true;
+            while (true) {
+                c = buf->sbumpc();
+                if (c == std::char_traits<char>::eof()) {
+                    Logger::log(ERROR,
+                                "CSVReader: unterminated quoted field at line "
+                                "%d\n",
+                                recordLine);
+                    throw Internal::ReadFileError();
+                }
+                if (c == '"') {
+                    if (buf->sgetc() != '"') {
+                        break;
+                    }
+                    // An escaped quote.
+                    buf->sbumpc();
+                } else if (c == '\n') {
+                    line++;
+                }
+                field.value.push_back(c);
+            }
+            c = buf->sbumpc();
+        }
+
+        // Unquoted part of the field (or garbage after the closing quote,
+        // which is accepted as-is).
+        while (c != delimiter && c != '\n' && c != '\r' &&
+               c != std::char_traits<char>::eof()) {
+            field.value.push_back(c);
+            c = buf->sbumpc();
+        }
+
+        if (c == delimiter) {
+            continue;
+        }
+
+        // End of the record.
+        if (c == '\r' && buf->sgetc() == '\n') {
+            buf->sbumpc();
+        }
+        if (c != std::char_traits<char>::eof()) {
+            line++;
+        }
+        break;
+    }
+
+    fields.resize(numFields);
+    return true;
+}
+
+}  // namespace Internal
+}  // namespace SimpleDB
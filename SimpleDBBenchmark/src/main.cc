@@ -0,0 +1,339 @@
+// --benchmark=table: compare the point lookups on the primary key of a memory
+// table and a disk table, whose pages and index stay in the buffer pool. The
+// lookups are run through IndexedTable and QueryBuilder, as those of the DBMS
+// are, and directly on the index (or the hash of the keys) and the table.
+//
+// --benchmark=index: insert keys in random order into an index, which splits
+// the nodes along the way, then look them up and scan them in ranges. The
+// index is also built from the same keys with a bulk load, and a hash index
+// is filled and looked up with them.
+//
+// --benchmark=range: insert records in random order of their keys into a disk
+// table larger than the buffer pool, then query ranges of the keys through
+// an index, fetching the records in the order of the keys or by bitmap scans.
+//
+// --benchmark=scan: aggregate a disk table with parallel scans of 1, 2, 4, ...
+// threads, with the table larger than the buffer pool, so that the workers
+// both copy the cached pages and read the others from the disk.
+
+#include <SimpleDB/SimpleDB.h>
+#include <SimpleDB/internal/Index.h>
+#include <SimpleDB/internal/IndexedTable.h>
+#include <SimpleDB/internal/QueryBuilder.h>
+#include <SimpleDB/internal/Table.h>
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace SimpleDB::Internal;
+
+DEFINE_string(benchmark, "table",
+              "The benchmark to run: table, index, range or scan");
+DEFINE_string(dir, "/tmp/simpledb_benchmark",
+              "Directory for the files of the disk table");
+DEFINE_int32(rows, 10000, "Number of records in each table (or index)");
+DEFINE_int32(lookups, 100000, "Number of point lookups on each table");
+DEFINE_int32(range, 1000, "Number of keys in each range of --benchmark=range");
+DEFINE_int32(threads, 0,
+             "Maximum number of threads of --benchmark=scan, 0 for the number "
+             "of cores");
+DEFINE_int32(scans, 5, "Number of scans with each number of threads");
+
+static const std::vector<ColumnMeta> columns = {
+    {.type = INT, .size = 4, .nullable = false, .name = "id"},
+    {.type = FLOAT, .size = 4, .nullable = true, .name = "price"},
+    {.type = VARCHAR, .size = 32, .nullable = true, .name = "name"},
+};
+
+static void fill(Table &table, Index *index) {
+    for (int i = 0; i < FLAGS_rows; i++) {
+        std::string name = "item" + std::to_string(i);
+        RecordID id = table.insert(
+            {Column(i), Column(i * 0.5F), Column(name.c_str(), 32)});
+        if (index != nullptr) {
+            index->insert(i, false, id);
+        }
+    }
+}
+
+// Returns the average time of a lookup in nanoseconds.
+static double lookup(Table &table, std::shared_ptr<Index> index,
+                     const std::vector<int> &keys, bool direct) {
+    long found = 0;
+    Columns columns;
+    auto begin = std::chrono::steady_clock::now();
+    for (int key : keys) {
+        if (direct) {
+            RecordID id = index != nullptr ? index->findEq(key, false)[0]
+                                           : table.findKey(key);
+            table.get(id, columns);
+            found++;
+            continue;
+        }
+        auto indexedTable = std::make_shared<IndexedTable>(
+            &table, [&](const std::string &, const std::string &column) {
+                return column == "id" ? index : nullptr;
+            });
+        QueryBuilder builder(indexedTable);
+        builder.condition("id", EQ, key);
+        found += builder.execute().size();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    if (found != keys.size()) {
+        fprintf(stderr, "Only %ld of %ld keys are found\n", found,
+                keys.size());
+    }
+    return std::chrono::duration<double, std::nano>(end - begin).count() /
+           keys.size();
+}
+
+static double elapsed(std::chrono::steady_clock::time_point begin, int n) {
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / n;
+}
+
+static void benchmarkIndex() {
+    std::vector<int> keys(FLAGS_rows);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+
+    const std::string path = FLAGS_dir + "/index";
+    Index index;
+    index.create(path);
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int key : keys) {
+        index.insert(key, false, {key, 0});
+    }
+    double insertTime = elapsed(begin, keys.size());
+
+    Index bulkIndex;
+    bulkIndex.create(FLAGS_dir + "/bulk_index");
+    begin = std::chrono::steady_clock::now();
+    bulkIndex.bulkLoad([&](const Index::BulkInsertFunc &insert) {
+        for (int key : keys) {
+            insert({Column(key)}, {key, 0});
+        }
+    });
+    double bulkLoadTime = elapsed(begin, keys.size());
+    bulkIndex.close();
+
+    Index hashIndex;
+    hashIndex.create(FLAGS_dir + "/hash_index", {columns[0]}, /*hash=*/true);
+    begin = std::chrono::steady_clock::now();
+    for (int key : keys) {
+        hashIndex.insert(key, false, {key, 0});
+    }
+    double hashInsertTime = elapsed(begin, keys.size());
+
+    std::mt19937 random(0);
+    std::uniform_int_distribution<int> distribution(0, FLAGS_rows - 1);
+    std::vector<int> lookupKeys(FLAGS_lookups);
+    for (int &key : lookupKeys) {
+        key = distribution(random);
+    }
+
+    long found = 0;
+    begin = std::chrono::steady_clock::now();
+    for (int key : lookupKeys) {
+        index.iterateEq(key, false, [&](RecordID) {
+            found++;
+            return true;
+        });
+    }
+    double lookupTime = elapsed(begin, lookupKeys.size());
+
+    begin = std::chrono::steady_clock::now();
+    for (int key : lookupKeys) {
+        hashIndex.iterateEq(key, false, [&](RecordID) {
+            found++;
+            return true;
+        });
+    }
+    double hashLookupTime = elapsed(begin, lookupKeys.size());
+
+    // Ranges of 100 keys.
+    begin = std::chrono::steady_clock::now();
+    for (int key : lookupKeys) {
+        found += index.countRange({key, key + 99});
+    }
+    double rangeTime = elapsed(begin, lookupKeys.size());
+
+    if (found == 0) {
+        fprintf(stderr, "No key is found\n");
+    }
+
+    index.close();
+    hashIndex.close();
+    int numPages = std::filesystem::file_size(path) / PAGE_SIZE;
+
+    printf("%d keys in %d pages, %d lookups, ns/op\n", FLAGS_rows, numPages,
+           FLAGS_lookups);
+    printf("%-24s %10.1f\n", "insert", insertTime);
+    printf("%-24s %10.1f\n", "bulk load", bulkLoadTime);
+    printf("%-24s %10.1f\n", "point lookup", lookupTime);
+    printf("%-24s %10.1f\n", "range of 100 keys", rangeTime);
+    printf("%-24s %10.1f\n", "hash insert", hashInsertTime);
+    printf("%-24s %10.1f\n", "hash point lookup", hashLookupTime);
+}
+
+// Returns the average time of a range query in nanoseconds.
+static double queryRanges(Table &table, std::shared_ptr<Index> index,
+                          const std::vector<int> &keys, bool bitmapScan) {
+    long found = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int key : keys) {
+        auto indexedTable = std::make_shared<IndexedTable>(
+            &table, [&](const std::string &, const std::string &column) {
+                return column == "id" ? index : nullptr;
+            });
+        if (!bitmapScan) {
+            indexedTable->setBitmapScanThreshold(INT_MAX);
+        }
+        QueryBuilder builder(indexedTable);
+        builder.condition("id", GE, key).condition("id", LT, key + FLAGS_range);
+        found += builder.execute().size();
+    }
+
+    if (found != long(keys.size()) * FLAGS_range) {
+        fprintf(stderr, "Only %ld records are found\n", found);
+    }
+    return elapsed(begin, keys.size());
+}
+
+static void benchmarkRanges() {
+    Table table;
+    table.create(FLAGS_dir + "/range", "range", columns);
+    auto index = std::make_shared<Index>();
+    index->create(FLAGS_dir + "/range.index");
+
+    std::vector<int> keys(FLAGS_rows);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+    for (int key : keys) {
+        std::string name = "item" + std::to_string(key);
+        RecordID id = table.insert(
+            {Column(key), Column(key * 0.5F), Column(name.c_str(), 32)});
+        index->insert(key, false, id);
+    }
+
+    std::mt19937 random(0);
+    std::uniform_int_distribution<int> distribution(
+        0, std::max(FLAGS_rows - FLAGS_range, 0));
+    std::vector<int> lowKeys(FLAGS_lookups);
+    for (int &key : lowKeys) {
+        key = distribution(random);
+    }
+
+    printf("%d queries of %d keys on %d records, us/query\n", FLAGS_lookups,
+           FLAGS_range, FLAGS_rows);
+    printf("%-24s %10.1f\n", "key order",
+           queryRanges(table, index, lowKeys, /*bitmapScan=*/false) / 1000);
+    printf("%-24s %10.1f\n", "bitmap scan",
+           queryRanges(table, index, lowKeys, /*bitmapScan=*/true) / 1000);
+
+    index->close();
+    table.close();
+}
+
+static void benchmarkTables() {
+    Table diskTable, memoryTable;
+    diskTable.create(FLAGS_dir + "/disk", "disk", columns, "id");
+    memoryTable.create(FLAGS_dir + "/memory", "memory", columns, "id", {},
+                       /*zoneMap=*/false, /*pax=*/false, /*clustered=*/false,
+                       /*memory=*/true);
+    auto index = std::make_shared<Index>();
+    index->create(FLAGS_dir + "/disk.index");
+
+    fill(diskTable, index.get());
+    fill(memoryTable, nullptr);
+
+    std::mt19937 random(0);
+    std::uniform_int_distribution<int> distribution(0, FLAGS_rows - 1);
+    std::vector<int> keys(FLAGS_lookups);
+    for (int &key : keys) {
+        key = distribution(random);
+    }
+
+    // Warm up the buffer pool, so that the disk table is read from memory.
+    lookup(diskTable, index, keys, /*direct=*/true);
+
+    printf("%d lookups on %d records, ns/lookup\n", FLAGS_lookups,
+           FLAGS_rows);
+    printf("%-24s %10s %10s\n", "", "query", "direct");
+    printf("%-24s %10.1f %10.1f\n", "disk table (cached)",
+           lookup(diskTable, index, keys, /*direct=*/false),
+           lookup(diskTable, index, keys, /*direct=*/true));
+    printf("%-24s %10.1f %10.1f\n", "memory table",
+           lookup(memoryTable, nullptr, keys, /*direct=*/false),
+           lookup(memoryTable, nullptr, keys, /*direct=*/true));
+
+    index->close();
+    diskTable.close();
+    memoryTable.close();
+}
+
+static void benchmarkScan() {
+    Table table;
+    table.create(FLAGS_dir + "/scan", "scan", columns);
+    fill(table, nullptr);
+
+    int maxThreads = FLAGS_threads > 0 ? FLAGS_threads
+                                       : std::thread::hardware_concurrency();
+    printf("SUM over %d records (%d morsels of %d pages, %d pages in the "
+           "buffer pool), ms/scan\n",
+           FLAGS_rows, table.numMorsels(), PARALLEL_SCAN_MORSEL_PAGES,
+           NUM_BUFFER_PAGE);
+    printf("%-8s %10s %10s\n", "threads", "ms", "speedup");
+
+    double serial = 0;
+    for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < FLAGS_scans; i++) {
+            QueryBuilder builder(&table);
+            builder.parallel(numThreads)
+                .select({.type = QuerySelector::SUM,
+                         .column = {.columnName = "price"}});
+            auto _ = builder.execute();
+        }
+        double ms = elapsed(begin, FLAGS_scans) / 1e6;
+        if (numThreads == 1) {
+            serial = ms;
+        }
+        printf("%-8d %10.2f %10.2f\n", numThreads, ms, serial / ms);
+    }
+
+    table.close();
+}
+
+int main(int argc, char **argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    Logger::setLogLevel(SILENT);
+
+    std::filesystem::remove_all(FLAGS_dir);
+    std::filesystem::create_directories(FLAGS_dir);
+
+    if (FLAGS_benchmark == "index") {
+        benchmarkIndex();
+    } else if (FLAGS_benchmark == "range") {
+        benchmarkRanges();
+    } else if (FLAGS_benchmark == "scan") {
+        benchmarkScan();
+    } else {
+        benchmarkTables();
+    }
+
+    std::filesystem::remove_all(FLAGS_dir);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef TESTING
+#define TESTING 1
+#endif
+#include <SimpleDB/SimpleDB.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace SimpleDB;
+using namespace SimpleDB::Internal;
+
+class CSVReaderTest : public ::testing::Test {
+protected:
+    std::vector<std::vector<std::string>> readAll(const std::string &csv,
+                                                  char delimiter = ',') {
+        std::istringstream stream(csv);
+        CSVReader reader(stream, delimiter);
+        std::vector<CSVReader::Field> fields;
+        std::vector<std::vector<std::string>> records;
+        while (reader.next(fields)) {
+            std::vector<std::string> record;
+            for (const auto &field : fields) {
+                record.push_back(field.value);
+            }
+            records.push_back(record);
+        }
+        return records;
+    }
+};
+
+TEST_F(CSVReaderTest, TestPlainFields) {
+    auto records = readAll("1,2.5,hello\n2,,world\n\n3,4,x");
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0], (std::vector<std::string>{"1", "2.5", "hello"}));
+    EXPECT_EQ(records[1], (std::vector<std::string>{"2", "", "world"}));
+    EXPECT_EQ(records[2], (std::vector<std::string>{"3", "4", "x"}));
+}
+
+TEST_F(CSVReaderTest, TestQuotedFields) {
+    auto records =
+        readAll("\"a,b\",\"say \"\"hi\"\"\"\r\n\"multi\nline\",\"\"\n");
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0], (std::vector<std::string>{"a,b", "say \"hi\""}));
+    EXPECT_EQ(records[1], (std::vector<std::string>{"multi\nline", ""}));
+}
+
+TEST_F(CSVReaderTest, TestDelimiterAndLineNumber) {
+    std::istringstream stream("1|a\n\"2\n\"|b\n3|c\n");
+    CSVReader reader(stream, '|');
+    std::vector<CSVReader::Field> fields;
+
+    ASSERT_TRUE(reader.next(fields));
+    EXPECT_EQ(reader.lineNumber(), 1);
+    ASSERT_TRUE(reader.next(fields));
+    EXPECT_EQ(reader.lineNumber(), 2);
+    EXPECT_TRUE(fields[0].quoted);
+    EXPECT_FALSE(fields[1].quoted);
+    ASSERT_TRUE(reader.next(fields));
+    EXPECT_EQ(reader.lineNumber(), 4);
+    EXPECT_EQ(fields[1].value, "c");
+    EXPECT_FALSE(reader.next(fields));
+}
+
+TEST_F(CSVReaderTest, TestUnterminatedQuote) {
+    std::istringstream stream("\"abc");
+    CSVReader reader(stream);
+    std::vector<CSVReader::Field> fields;
+    EXPECT_THROW(reader.next(fields), Internal::ReadFileError);
+}
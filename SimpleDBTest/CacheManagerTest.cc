@@ -6,6 +6,8 @@
 
 #include <filesystem>
 #include <random>
+#include <thread>
+#include <vector>
 
 #include "Util.h"
 
@@ -137,3 +139,62 @@ TEST_F(CacheManagerTest, TestLeak) {
 
     fileManager->closeFile(fd);
 }
+
+TEST_F(CacheManagerTest, TestConcurrentReadPage) {
+    DisableLogGuard guard;
+
+    const char filePath[] = "tmp/file";
+
+    fileManager->createFile(filePath);
+    FileDescriptor fd = fileManager->openFile(filePath);
+
+    // Twice the pages of the buffer, the first ones only written to the cache,
+    // so that the readers replace dirty caches as well.
+    const int numPages = 2 * NUM_BUFFER_PAGE;
+    char buf[PAGE_SIZE] = {};
+    for (int i = 0; i < numPages; i++) {
+        memcpy(buf, &i, sizeof(i));
+        if (i < NUM_BUFFER_PAGE) {
+            PageHandle handle = manager->getHandle(fd, i);
+            memcpy(manager->load(handle), buf, PAGE_SIZE);
+            manager->markDirty(handle);
+        } else {
+            fileManager->writePage(fd, i, buf);
+        }
+    }
+
+    const int numThreads = 8;
+    std::vector<int> numErrors(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t] {
+            std::mt19937 random(t);
+            char readBuf[PAGE_SIZE];
+            for (int i = 0; i < 4 * NUM_BUFFER_PAGE; i++) {
+                int page = random() % numPages;
+                int value;
+                manager->readPage(fd, page, readBuf);
+                memcpy(&value, readBuf, sizeof(value));
+                numErrors[t] += value != page;
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (int t = 0; t < numThreads; t++) {
+        EXPECT_EQ(numErrors[t], 0);
+    }
+
+    // No cache is leaked or left pinned.
+    EXPECT_EQ(manager->freeCache.size() + manager->activeCache.size(),
+              NUM_BUFFER_PAGE);
+    for (int i = 0; i < NUM_BUFFER_PAGE; i++) {
+        EXPECT_EQ(manager->cacheBuf[i].pins, 0);
+        EXPECT_FALSE(manager->cacheBuf[i].loading);
+    }
+
+    EXPECT_NO_THROW(manager->onCloseFile(fd));
+    fileManager->closeFile(fd);
+}
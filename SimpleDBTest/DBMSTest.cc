@@ -12,6 +12,7 @@
 #include <gtest/gtest.h>
 
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <vector>
 
@@ -330,10 +331,211 @@ TEST_F(DBMSTest, TestPrimaryKeyIndex) {
     ASSERT_EQ(resultRow[3].data.intValue, 0 /*pri*/);
 }
 
+TEST_F(DBMSTest, TestIndexCache) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 INT);"));
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1);"));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " +
+                                   std::to_string(i * 2) + ");"));
+    }
+
+    // The index is opened once and shared by the statements.
+    auto index = dbms.getIndex(testDbName, "t1", "c1").second;
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(dbms.getIndex(testDbName, "t1", "c1").second, index);
+    // Along with its record in the system table.
+    EXPECT_EQ(dbms.getIndex(testDbName, "t1", "c1").first,
+              dbms.findIndex(testDbName, "t1", "c1").first);
+    // So are the indexes of the table.
+    ASSERT_EQ(dbms.tableIndexInfos["t1"].size(), 1);
+    EXPECT_EQ(dbms.tableIndexInfos["t1"][0].name, "c1");
+
+    std::vector<Service::ExecutionResult> results;
+    auto countWhere = [&](const std::string &condition) {
+        results = executeSQL("SELECT COUNT(*) FROM t1 WHERE " + condition +
+                             ";");
+        return results[0].query().rows(0).values(0).int_value();
+    };
+    EXPECT_EQ(countWhere("c1 < 10"), 10);
+    ASSERT_NO_THROW(executeSQL("UPDATE t1 SET c1 = 200 WHERE c1 = 5;"));
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c1 >= 90;"));
+    EXPECT_EQ(countWhere("c1 < 10"), 9);
+    EXPECT_EQ(countWhere("c1 >= 50"), 40);
+
+    // Dropping the index forgets it, and a new one is opened when re-added.
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 DROP INDEX (c1);"));
+    EXPECT_EQ(dbms.getIndex(testDbName, "t1", "c1").second, nullptr);
+    EXPECT_FALSE(index->initialized);
+    EXPECT_EQ(dbms.tableIndexInfos.count("t1"), 0);
+    ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (300, 600);"));
+    EXPECT_TRUE(dbms.tableIndexInfos["t1"].empty());
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1);"));
+    EXPECT_EQ(dbms.tableIndexInfos.count("t1"), 0);
+    EXPECT_EQ(countWhere("c1 >= 50"), 41);
+    EXPECT_EQ(countWhere("c1 = 300"), 1);
+
+    // So is dropping the table.
+    ASSERT_NO_THROW(executeSQL("DROP TABLE t1;"));
+    EXPECT_EQ(dbms.tableIndexInfos.count("t1"), 0);
+    ASSERT_NO_THROW(executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 INT);"));
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1);"));
+    ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (1, 2);"));
+    EXPECT_EQ(countWhere("c1 >= 0"), 1);
+
+    // And switching the database, which flushes the indexes.
+    ASSERT_NO_THROW(dbms.createDatabase("db2"));
+    ASSERT_NO_THROW(dbms.useDatabase("db2"));
+    EXPECT_TRUE(dbms.openedIndexes.empty());
+    EXPECT_TRUE(dbms.tableIndexInfos.empty());
+    ASSERT_NO_THROW(dbms.useDatabase(testDbName));
+    EXPECT_EQ(countWhere("c1 = 1"), 1);
+}
+
 TEST_F(DBMSTest, TestAddIndexOnDuplicateColumn) {
     // TODO
 }
 
+TEST_F(DBMSTest, TestFloatAndVarcharIndex) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT, c2 FLOAT, c3 VARCHAR(16));"));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " +
+                                   std::to_string(i * 0.5) + ", 'name" +
+                                   std::to_string(i) + "');"));
+    }
+
+    // The existing records are loaded, and the later changes are kept.
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c2);"));
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c3);"));
+    ASSERT_NO_THROW(
+        executeSQL("INSERT INTO t1 VALUES (100, 50.0, 'name100');"));
+    ASSERT_NO_THROW(executeSQL("UPDATE t1 SET c3 = 'updated' WHERE c1 = 1;"));
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c3 = 'name2';"));
+
+    auto count = [&](const std::string &condition) {
+        auto results =
+            executeSQL("SELECT COUNT(*) FROM t1 WHERE " + condition + ";");
+        return results[0].query().rows(0).values(0).int_value();
+    };
+    EXPECT_EQ(count("c2 = 1.5"), 1);
+    EXPECT_EQ(count("c2 >= 10.0"), 81);
+    EXPECT_EQ(count("c2 < 1.0"), 2);
+    EXPECT_EQ(count("c3 = 'name3'"), 1);
+    EXPECT_EQ(count("c3 = 'name1'"), 0);
+    EXPECT_EQ(count("c3 = 'updated'"), 1);
+    EXPECT_EQ(count("c3 = 'name2'"), 0);
+    // name0, name10 to name19 and name100.
+    EXPECT_EQ(count("c3 < 'name2'"), 12);
+    EXPECT_EQ(count("c3 <> 'name3'"), 99);
+
+    // Answered by the indexes alone.
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(results =
+                        executeSQL("SELECT c2 FROM t1 WHERE c2 >= 49.0;"));
+    ASSERT_EQ(results[0].query().rows_size(), 3);
+    EXPECT_FLOAT_EQ(results[0].query().rows(1).values(0).float_value(), 49.5);
+    ASSERT_NO_THROW(results =
+                        executeSQL("SELECT c3 FROM t1 WHERE c3 > 'name97';"));
+    // name98, name99 and updated.
+    ASSERT_EQ(results[0].query().rows_size(), 3);
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "name98");
+}
+
+TEST_F(DBMSTest, TestCompositeIndex) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(executeSQL(
+        "CREATE TABLE t1 (tenant INT, created INT, name VARCHAR(16));"));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NO_THROW(executeSQL(
+            "INSERT INTO t1 VALUES (" + std::to_string(i % 4) + ", " +
+            std::to_string(i) + ", 'name" + std::to_string(i) + "');"));
+    }
+
+    // The existing records are loaded, and the later changes are kept.
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (tenant, created);"));
+    ASSERT_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (tenant, created);"),
+                 Error::AlterIndexError);
+    ASSERT_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (tenant, tenant);"),
+                 Error::AlterIndexError);
+    ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (1, 100, 'name100');"));
+    ASSERT_NO_THROW(
+        executeSQL("UPDATE t1 SET created = 200 WHERE name = 'name1';"));
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE created = 5;"));
+
+    auto count = [&](const std::string &condition) {
+        auto results =
+            executeSQL("SELECT COUNT(*) FROM t1 WHERE " + condition + ";");
+        return results[0].query().rows(0).values(0).int_value();
+    };
+    EXPECT_EQ(count("tenant = 1"), 25);
+    EXPECT_EQ(count("created >= 90 AND tenant = 1"), 4);
+    EXPECT_EQ(count("tenant = 1 AND created = 200"), 1);
+    EXPECT_EQ(count("tenant = 1 AND created < 10"), 1);
+    EXPECT_EQ(count("tenant = 2 AND created <> 2"), 24);
+    EXPECT_EQ(count("tenant >= 2 AND created < 10"), 4);
+
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 DROP INDEX (tenant, created);"));
+    ASSERT_THROW(executeSQL("ALTER TABLE t1 DROP INDEX (tenant, created);"),
+                 Error::AlterIndexError);
+    EXPECT_EQ(count("created >= 90 AND tenant = 1"), 4);
+}
+
+TEST_F(DBMSTest, TestHashIndex) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(executeSQL(
+        "CREATE TABLE t1 (c1 INT NOT NULL, c2 FLOAT, c3 VARCHAR(16));"));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " +
+                                   std::to_string(i * 0.5) + ", 'name" +
+                                   std::to_string(i % 10) + "');"));
+    }
+
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1) USING HASH;"));
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c3) USING HASH;"));
+    EXPECT_TRUE(dbms.getIndex(testDbName, "t1", "c1").second->isHash());
+    EXPECT_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c2) USING HASH;"),
+                 Error::AlterIndexError);
+    EXPECT_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1, c3) USING HASH;"),
+                 Error::AlterIndexError);
+
+    ASSERT_NO_THROW(executeSQL("UPDATE t1 SET c3 = 'updated' WHERE c1 = 1;"));
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c3 = 'name2';"));
+
+    auto count = [&](const std::string &condition) {
+        auto results =
+            executeSQL("SELECT COUNT(*) FROM t1 WHERE " + condition + ";");
+        return results[0].query().rows(0).values(0).int_value();
+    };
+    EXPECT_EQ(count("c1 = 3"), 1);
+    EXPECT_EQ(count("c1 = 2"), 0);
+    EXPECT_EQ(count("c3 = 'name1'"), 9);
+    EXPECT_EQ(count("c3 = 'updated'"), 1);
+    // Left to the scan.
+    EXPECT_EQ(count("c1 >= 50"), 45);
+    EXPECT_EQ(count("c3 <> 'name3'"), 80);
+
+    // The primary key takes the hash index for its checks.
+    ASSERT_NO_THROW(
+        executeSQL("ALTER TABLE t1 ADD CONSTRAINT PRIMARY KEY (c1);"));
+    EXPECT_THROW(executeSQL("INSERT INTO t1 VALUES (3, 0.0, 'dup');"),
+                 Error::InsertError);
+    ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (2, 0.0, 'name2');"));
+    EXPECT_EQ(count("c1 = 2"), 1);
+}
+
 TEST_F(DBMSTest, TestInsertRecord) {
     initDBMS();
     createAndUseDatabase();
@@ -382,6 +584,379 @@ TEST_F(DBMSTest, TestInsertRecord) {
     ASSERT_THROW(executeSQL(insertSql5), Error::InsertError);
 }
 
+TEST_F(DBMSTest, TestLoadData) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(executeSQL(
+        "CREATE TABLE t1 (c1 INT NOT NULL, c2 FLOAT, c3 VARCHAR(16), "
+        "PRIMARY KEY (c1));"));
+    ASSERT_NO_THROW(executeSQL(
+        "CREATE TABLE t2 (c1 INT, FOREIGN KEY (c1) REFERENCES t1(c1));"));
+
+    const int NUM_RECORDS = 10000;
+    {
+        std::ofstream csv("tmp/t1.csv");
+        for (int i = 0; i < NUM_RECORDS; i++) {
+            csv << i << "," << (i % 2 ? std::to_string(i * 0.5) : "") << ","
+                << "\"name, " << i << "\"\n";
+        }
+    }
+
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(
+        results = executeSQL("LOAD DATA INFILE 'tmp/t1.csv' INTO TABLE t1;"));
+    EXPECT_EQ(results[0].plain().affected_rows(), NUM_RECORDS);
+
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t1;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), NUM_RECORDS);
+
+    // The primary key index is built.
+    ASSERT_NO_THROW(results = executeSQL("SELECT c3 FROM t1 WHERE c1 = 42;"));
+    ASSERT_EQ(results[0].query().rows_size(), 1);
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "name, 42");
+
+    // Duplicate primary key.
+    EXPECT_THROW(executeSQL("LOAD DATA INFILE 'tmp/t1.csv' INTO TABLE t1;"),
+                 Error::InsertError);
+
+    // Foreign keys and custom delimiters.
+    {
+        std::ofstream csv("tmp/t2.csv");
+        csv << "1\nNULL\n2\n" << NUM_RECORDS << "\n3\n";
+    }
+    EXPECT_THROW(executeSQL("LOAD DATA INFILE 'tmp/t2.csv' INTO TABLE t2 "
+                            "FIELDS TERMINATED BY '|';"),
+                 Error::InsertError);
+    // Rows before the failing one are kept.
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t2;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), 3);
+
+    EXPECT_THROW(executeSQL("LOAD DATA INFILE 'tmp/none.csv' INTO TABLE t2;"),
+                 Error::InsertError);
+
+    // A malformed file, after some batches are written.
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t3 (c1 INT NOT NULL, c2 VARCHAR(16), "
+                   "PRIMARY KEY (c1));"));
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t3 ADD INDEX (c2);"));
+    {
+        std::ofstream csv("tmp/t3.csv");
+        for (int i = 0; i < NUM_RECORDS; i++) {
+            csv << i << ",name" << i << "\n";
+        }
+        csv << NUM_RECORDS << ",\"unterminated\n";
+    }
+    EXPECT_THROW(executeSQL("LOAD DATA INFILE 'tmp/t3.csv' INTO TABLE t3;"),
+                 Error::InsertError);
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t3;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), NUM_RECORDS);
+    // The rows loaded are indexed.
+    ASSERT_NO_THROW(
+        results = executeSQL("SELECT c1 FROM t3 WHERE c2 = 'name42';"));
+    ASSERT_EQ(results[0].query().rows_size(), 1);
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), 42);
+    EXPECT_THROW(executeSQL("INSERT INTO t3 VALUES (42, 'new');"),
+                 Error::InsertError);
+}
+
+TEST_F(DBMSTest, TestVacuum) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(executeSQL(
+        "CREATE TABLE t1 (c1 INT NOT NULL, c2 INT, PRIMARY KEY (c1));"));
+
+    const int NUM_RECORDS = 10000;
+    const int NUM_KEPT = 100;
+    {
+        std::ofstream csv("tmp/t1.csv");
+        for (int i = 0; i < NUM_RECORDS; i++) {
+            csv << i << "," << i * 2 << "\n";
+        }
+    }
+    ASSERT_NO_THROW(executeSQL("LOAD DATA INFILE 'tmp/t1.csv' INTO TABLE t1;"));
+    auto indexPath = dbms.getIndexPath(testDbName, "t1", "c1");
+    auto indexSize = std::filesystem::file_size(indexPath);
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c1 < " +
+                               std::to_string(NUM_RECORDS - NUM_KEPT) + ";"));
+    // The index left sparse is only vacuumed by VACUUM TABLE.
+    EXPECT_EQ(std::filesystem::file_size(indexPath), indexSize);
+
+    std::vector<Service::ExecutionResult> results;
+    // A bounded vacuum moves at most the given number of records.
+    const int LIMIT = 30;
+    ASSERT_NO_THROW(results = executeSQL("VACUUM TABLE t1 LIMIT " +
+                                         std::to_string(LIMIT) + ";"));
+    EXPECT_EQ(results[0].plain().affected_rows(), LIMIT);
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t1;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), NUM_KEPT);
+
+    // The next one resumes where it stopped.
+    ASSERT_NO_THROW(results = executeSQL("VACUUM TABLE t1;"));
+    EXPECT_EQ(results[0].plain().affected_rows(), NUM_KEPT - LIMIT);
+    EXPECT_LT(std::filesystem::file_size(indexPath), indexSize);
+
+    // Nothing to do the second time.
+    ASSERT_NO_THROW(results = executeSQL("VACUUM TABLE t1;"));
+    EXPECT_EQ(results[0].plain().affected_rows(), 0);
+
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t1;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), NUM_KEPT);
+
+    // The index points to the new locations.
+    int key = NUM_RECORDS - 1;
+    ASSERT_NO_THROW(results = executeSQL("SELECT c2 FROM t1 WHERE c1 = " +
+                                         std::to_string(key) + ";"));
+    ASSERT_EQ(results[0].query().rows_size(), 1);
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), key * 2);
+
+    EXPECT_THROW(executeSQL("VACUUM TABLE t2;"), Error::TableNotExistsError);
+}
+
+TEST_F(DBMSTest, TestDictionaryColumn) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 VARCHAR(16) DEFAULT "
+                   "'new' DICTIONARY);"));
+    for (int i = 0; i < 100; i++) {
+        std::string value =
+            i % 10 == 0 ? "NULL" : "'s" + std::to_string(i % 3) + "'";
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " + value + ");"));
+    }
+    ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (100, DEFAULT);"));
+
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(results = executeSQL("DESC t1;"));
+    EXPECT_EQ(results[0].describe_table().columns(1).type(),
+              "VARCHAR(16) DICTIONARY");
+
+    auto count = [&](const std::string &where) {
+        auto countResults =
+            executeSQL("SELECT COUNT(*) FROM t1 WHERE " + where + ";");
+        return countResults[0].query().rows(0).values(0).int_value();
+    };
+    EXPECT_EQ(count("c2 = 's1'"), 30);
+    EXPECT_EQ(count("c2 <> 's1'"), 61);
+    EXPECT_EQ(count("c2 = 'new'"), 1);
+    EXPECT_EQ(count("c2 = 'none'"), 0);
+    EXPECT_EQ(count("c2 > 's0'"), 60);
+
+    ASSERT_NO_THROW(executeSQL("UPDATE t1 SET c2 = 's3' WHERE c1 = 1;"));
+    ASSERT_NO_THROW(results = executeSQL("SELECT c2 FROM t1 WHERE c1 = 1;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "s3");
+
+    EXPECT_THROW(executeSQL("CREATE TABLE t2 (c1 INT DICTIONARY);"),
+                 Error::CreateTableError);
+}
+
+TEST_F(DBMSTest, TestPaxTable) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 FLOAT, c3 "
+                   "VARCHAR(16)) LAYOUT = PAX;"));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " +
+                                   std::to_string(i % 10) + ".5, 'v" +
+                                   std::to_string(i) + "');"));
+    }
+
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(
+        results = executeSQL(
+            "SELECT SUM(c1), MAX(c2), COUNT(c3) FROM t1 WHERE c1 >= 50;"));
+    const auto &row = results[0].query().rows(0);
+    EXPECT_EQ(row.values(0).int_value(), (50 + 99) * 50 / 2);
+    EXPECT_FLOAT_EQ(row.values(1).float_value(), 9.5);
+    EXPECT_EQ(row.values(2).int_value(), 50);
+
+    ASSERT_NO_THROW(results = executeSQL("SELECT c3 FROM t1 WHERE c1 = 7;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "v7");
+
+    // Indexes work on the records of PAX tables as well.
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1);"));
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c1 < 10;"));
+    ASSERT_NO_THROW(results = executeSQL("SELECT c3 FROM t1 WHERE c1 = 42;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "v42");
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t1;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), 90);
+}
+
+TEST_F(DBMSTest, TestZoneMapTable) {
+    initDBMS();
+    createAndUseDatabase();
+
+    // Zone maps are only kept when asked for.
+    ASSERT_NO_THROW(executeSQL("CREATE TABLE t0 (c1 INT NOT NULL);"));
+    EXPECT_FALSE(dbms.getTable("t0").second->meta.hasZoneMap);
+
+    ASSERT_NO_THROW(executeSQL(
+        "CREATE TABLE t1 (c1 INT NOT NULL, c2 FLOAT) WITH ZONEMAP;"));
+    EXPECT_TRUE(dbms.getTable("t1").second->meta.hasZoneMap);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " +
+                                   std::to_string(i % 10) + ".5);"));
+    }
+
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(
+        results = executeSQL("SELECT COUNT(c2) FROM t1 WHERE c1 >= 90;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), 10);
+}
+
+TEST_F(DBMSTest, TestClusteredTable) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_THROW(executeSQL("CREATE TABLE t0 (c1 INT NOT NULL) CLUSTERED;"),
+                 Error::CreateTableError);
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 INT, c3 "
+                   "VARCHAR(100), PRIMARY KEY (c1)) CLUSTERED;"));
+    ASSERT_NO_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c2);"));
+    // The keys are inserted out of order, splitting the pages.
+    for (int i = 0; i < 200; i++) {
+        int key = i * 7 % 200;
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(key) + ", " +
+                                   std::to_string(key % 10) + ", 'v" +
+                                   std::to_string(key) + "');"));
+    }
+    ASSERT_THROW(executeSQL("INSERT INTO t1 VALUES (7, 0, 'v');"),
+                 Error::InsertError);
+
+    // Range scans on the key return the records in order.
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(
+        results = executeSQL("SELECT c1 FROM t1 WHERE c1 >= 50 AND c1 < 60;"));
+    ASSERT_EQ(results[0].query().rows_size(), 10);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(results[0].query().rows(i).values(0).int_value(), 50 + i);
+    }
+
+    // The secondary index refers to the records by their keys.
+    ASSERT_NO_THROW(results = executeSQL("SELECT c3 FROM t1 WHERE c2 = 3;"));
+    EXPECT_EQ(results[0].query().rows_size(), 20);
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c2 = 3;"));
+    ASSERT_NO_THROW(executeSQL("UPDATE t1 SET c3 = 'w' WHERE c1 = 42;"));
+    ASSERT_NO_THROW(results = executeSQL("SELECT c3 FROM t1 WHERE c1 = 42;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "w");
+
+    ASSERT_THROW(executeSQL("UPDATE t1 SET c1 = 1000 WHERE c1 = 42;"),
+                 Error::UpdateError);
+    ASSERT_THROW(executeSQL("ALTER TABLE t1 DROP PRIMARY KEY;"),
+                 Error::AlterPrimaryKeyError);
+    ASSERT_NO_THROW(executeSQL("VACUUM TABLE t1;"));
+
+    ASSERT_NO_THROW(results = executeSQL("SELECT c1 FROM t1;"));
+    const auto &query = results[0].query();
+    ASSERT_EQ(query.rows_size(), 180);
+    for (int i = 1; i < query.rows_size(); i++) {
+        EXPECT_LT(query.rows(i - 1).values(0).int_value(),
+                  query.rows(i).values(0).int_value());
+    }
+}
+
+TEST_F(DBMSTest, TestMemoryTable) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 VARCHAR(16), "
+                   "PRIMARY KEY (c1)) ENGINE = MEMORY;"));
+    ASSERT_NO_THROW(executeSQL("CREATE TABLE t2 (c1 INT, c2 INT);"));
+    for (int i = 0; i < 50; i++) {
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", 'v" +
+                                   std::to_string(i) + "');"));
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t2 VALUES (" +
+                                   std::to_string(i % 5) + ", " +
+                                   std::to_string(i) + ");"));
+    }
+    ASSERT_THROW(executeSQL("INSERT INTO t1 VALUES (7, 'v');"),
+                 Error::InsertError);
+    ASSERT_THROW(executeSQL("ALTER TABLE t1 ADD INDEX (c1);"),
+                 Error::AlterIndexError);
+
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(results = executeSQL("SELECT c2 FROM t1 WHERE c1 = 7;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "v7");
+
+    // Memory tables take part in joins as other tables do.
+    ASSERT_NO_THROW(
+        results = executeSQL(
+            "SELECT t1.c2, t2.c2 FROM t1, t2 WHERE t1.c1 = t2.c1;"));
+    EXPECT_EQ(results[0].query().rows_size(), 50);
+
+    ASSERT_NO_THROW(executeSQL("UPDATE t1 SET c1 = 100 WHERE c1 = 7;"));
+    ASSERT_THROW(executeSQL("UPDATE t1 SET c1 = 8 WHERE c1 = 100;"),
+                 Error::UpdateError);
+    ASSERT_NO_THROW(executeSQL("DELETE FROM t1 WHERE c1 < 10;"));
+    ASSERT_NO_THROW(
+        results = executeSQL("SELECT c2 FROM t1 WHERE c1 = 100;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).varchar_value(), "v7");
+    ASSERT_NO_THROW(results = executeSQL("SELECT COUNT(*) FROM t1;"));
+    EXPECT_EQ(results[0].query().rows(0).values(0).int_value(), 41);
+}
+
+TEST_F(DBMSTest, TestAnalyze) {
+    initDBMS();
+    createAndUseDatabase();
+
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 VARCHAR(16));"));
+    for (int i = 0; i < 100; i++) {
+        std::string value =
+            i % 4 == 0 ? "NULL" : "'v" + std::to_string(i % 3) + "'";
+        ASSERT_NO_THROW(executeSQL("INSERT INTO t1 VALUES (" +
+                                   std::to_string(i) + ", " + value + ");"));
+    }
+
+    std::vector<Service::ExecutionResult> results;
+    ASSERT_NO_THROW(results = executeSQL("ANALYZE TABLE t1;"));
+    EXPECT_EQ(results[0].plain().affected_rows(), 100);
+    // Analyzing again replaces the statistics.
+    ASSERT_NO_THROW(executeSQL("ANALYZE TABLE t1;"));
+
+    ASSERT_NO_THROW(results = executeSQL("SHOW STATS FROM t1;"));
+    const auto &query = results[0].query();
+    ASSERT_EQ(query.rows_size(), 2);
+
+    const auto &c1 = query.rows(0);
+    EXPECT_EQ(c1.values(0).varchar_value(), "c1");
+    EXPECT_EQ(c1.values(1).int_value(), 100);
+    EXPECT_FLOAT_EQ(c1.values(2).float_value(), 0);
+    EXPECT_EQ(c1.values(3).varchar_value(), "0");
+    EXPECT_EQ(c1.values(4).varchar_value(), "99");
+    EXPECT_EQ(c1.values(5).int_value(), 100);
+    EXPECT_EQ(c1.values(6).varchar_value(),
+              "5,11,17,24,30,36,42,49,55,61,67,74,80,86,92,99");
+
+    const auto &c2 = query.rows(1);
+    EXPECT_EQ(c2.values(0).varchar_value(), "c2");
+    EXPECT_FLOAT_EQ(c2.values(2).float_value(), 0.25);
+    EXPECT_EQ(c2.values(3).varchar_value(), "v0");
+    EXPECT_EQ(c2.values(4).varchar_value(), "v2");
+    EXPECT_EQ(c2.values(5).int_value(), 3);
+    EXPECT_TRUE(c2.values(6).null_value());
+
+    // The statistics are dropped with the table.
+    ASSERT_NO_THROW(executeSQL("DROP TABLE t1;"));
+    ASSERT_NO_THROW(
+        executeSQL("CREATE TABLE t1 (c1 INT NOT NULL, c2 VARCHAR(16));"));
+    ASSERT_NO_THROW(results = executeSQL("SHOW STATS FROM t1;"));
+    EXPECT_EQ(results[0].query().rows_size(), 0);
+
+    EXPECT_THROW(executeSQL("ANALYZE TABLE t2;"), Error::TableNotExistsError);
+}
+
 TEST_F(DBMSTest, TestSelect) {
     initDBMS();
     createAndUseDatabase();
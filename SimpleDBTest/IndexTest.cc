@@ -7,7 +7,11 @@
 #include <SimpleDB/SimpleDB.h>
 #include <gtest/gtest.h>
 
+#include <cfloat>
+#include <cmath>
 #include <filesystem>
+#include <map>
+#include <numeric>
 #include <random>
 #include <set>
 
@@ -54,6 +58,7 @@ TEST_F(IndexTest, TestCreateNewIndex) {
 
     EXPECT_EQ(index.meta.numNode, 1);
     EXPECT_EQ(index.meta.rootNode, 0);
+    EXPECT_EQ(index.meta.version, INDEX_FORMAT_VERSION);
 }
 
 TEST_F(IndexTest, TestInitFromInvalidFile) {
@@ -62,6 +67,268 @@ TEST_F(IndexTest, TestInitFromInvalidFile) {
     EXPECT_THROW(index.open(fileName), Internal::ReadIndexError);
 }
 
+TEST_F(IndexTest, TestInitFromUnsupportedVersion) {
+    initIndex();
+    index.meta.version = INDEX_FORMAT_VERSION + 1;
+    index.close();
+
+    EXPECT_THROW(index.open(indexFile), Internal::ReadIndexError);
+}
+
+TEST_F(IndexTest, TestMigrateLegacyIndex) {
+    DisableLogGuard _;
+
+    // The unversioned format: 424-byte node slots, 18 per page.
+    struct LegacyMeta {
+        uint16_t headCanary;
+        int numNode;
+        int numEntry;
+        int firstFreeSlot;
+        int rootNode;
+        uint16_t tailCanary;
+    };
+    struct LegacyEntry {
+        int key;
+        bool isNull;
+        RecordID record;
+    };
+    struct LegacyLeafNode {
+        bool isLeaf;
+        int index;
+        LegacyEntry entry[20];
+        int numEntry;
+        int parent;
+        int32_t validBitmap;
+        int next;
+        int previous;
+    };
+
+    // A single leaf holding 10 keys, with key 3 removed, in the second slot
+    // (the first one is an unused inner node).
+    std::vector<char> metaPage(PAGE_SIZE), nodePage(PAGE_SIZE);
+    LegacyMeta *meta = (LegacyMeta *)metaPage.data();
+    *meta = {LEGACY_INDEX_META_CANARY, 2, 9, 2, 1, LEGACY_INDEX_META_CANARY};
+
+    LegacyLeafNode *node = (LegacyLeafNode *)(nodePage.data() + 424);
+    node->isLeaf = true;
+    node->index = 1;
+    node->numEntry = 10;
+    node->parent = -1;
+    node->validBitmap = ~(1 << 3);
+    node->next = node->previous = 1;
+    for (int i = 0; i < 10; i++) {
+        node->entry[i] = {i, false, {i, i}};
+    }
+
+    PF::create(indexFile);
+    FileDescriptor fd = PF::open(indexFile);
+    memcpy(PF::loadRaw(PF::getHandle(fd, 0)), metaPage.data(), PAGE_SIZE);
+    PF::markDirty(PF::getHandle(fd, 0));
+    memcpy(PF::loadRaw(PF::getHandle(fd, 1)), nodePage.data(), PAGE_SIZE);
+    PF::markDirty(PF::getHandle(fd, 1));
+    PF::close(fd);
+
+    ASSERT_NO_THROW(index.open(indexFile));
+    EXPECT_EQ(index.meta.version, INDEX_FORMAT_VERSION);
+    EXPECT_EQ(index.meta.numEntry, 9);
+
+    // The migration is persisted.
+    index.setReadOnly();
+    reloadIndex();
+    EXPECT_EQ(index.meta.numEntry, 9);
+
+    for (int i = 0; i < 10; i++) {
+        auto rids = index.findEq(i, false);
+        if (i == 3) {
+            EXPECT_TRUE(rids.empty());
+        } else {
+            ASSERT_EQ(rids.size(), 1);
+            EXPECT_EQ(rids[0], RecordID({i, i}));
+        }
+    }
+}
+
+TEST_F(IndexTest, TestMigrateV1Index) {
+    DisableLogGuard _;
+
+    // Version 1: a node per page, with an array of entries.
+    struct V1Entry {
+        int key;
+        bool isNull;
+        RecordID record;
+    };
+    struct V1LeafNode {
+        bool isLeaf;
+        int index;
+        V1Entry entry[400];
+        int numEntry;
+        int parent;
+        uint64_t validBitmap[7];
+        int next;
+        int previous;
+    };
+
+    struct V1Meta {
+        uint16_t headCanary;
+        uint16_t version;
+        int numNode;
+        int numEntry;
+        int firstFreeSlot;
+        int rootNode;
+        uint16_t tailCanary;
+    };
+
+    initIndex();
+    index.close();
+
+    // A root leaf holding a NULL entry and two keys, with key 1 removed.
+    FileDescriptor fd = PF::open(indexFile);
+    PageHandle metaHandle = PF::getHandle(fd, 0);
+    *PF::loadRaw<V1Meta *>(metaHandle) = {INDEX_META_CANARY, 1, 1, 2, 1, 0,
+                                          INDEX_META_CANARY};
+    PF::markDirty(metaHandle);
+    PageHandle handle = PF::getHandle(fd, 1);
+    V1LeafNode *node = PF::loadRaw<V1LeafNode *>(handle);
+    memset(node, 0, sizeof(V1LeafNode));
+    node->isLeaf = true;
+    node->numEntry = 3;
+    node->parent = -1;
+    node->validBitmap[0] = 0b101;
+    node->entry[0] = {0, true, {5, 5}};
+    node->entry[1] = {1, false, {1, 1}};
+    node->entry[2] = {2, false, {2, 2}};
+    PF::markDirty(handle);
+    PF::close(fd);
+
+    ASSERT_NO_THROW(index.open(indexFile));
+    EXPECT_EQ(index.meta.version, INDEX_FORMAT_VERSION);
+    EXPECT_EQ(index.meta.numEntry, 2);
+
+    EXPECT_TRUE(index.findEq(1, false).empty());
+    EXPECT_EQ(index.findEq(2, false), std::vector<RecordID>({{2, 2}}));
+    EXPECT_NO_THROW(index.remove(0, true, {5, 5}));
+}
+
+TEST_F(IndexTest, TestMigrateV2Index) {
+    DisableLogGuard _;
+
+    // Version 2: INT keys only, with the nodes laid out as those of 4-byte
+    // keys now.
+    struct V2Meta {
+        uint16_t headCanary;
+        uint16_t version;
+        int numNode;
+        int numEntry;
+        int firstFreeSlot;
+        int rootNode;
+        uint16_t tailCanary;
+    };
+
+    initIndex();
+    for (int i = 0; i < 2 * MAX_NUM_ENTRY_PER_NODE; i++) {
+        ASSERT_NO_THROW(index.insert(i, false, {i, i}));
+    }
+    V2Meta oldMeta = {INDEX_META_CANARY,        2,
+                      index.meta.numNode,       index.meta.numEntry,
+                      index.meta.firstFreeSlot, index.meta.rootNode,
+                      INDEX_META_CANARY};
+    index.close();
+
+    FileDescriptor fd = PF::open(indexFile);
+    PageHandle handle = PF::getHandle(fd, 0);
+    memset(PF::loadRaw(handle), 0, PAGE_SIZE);
+    *PF::loadRaw<V2Meta *>(handle) = oldMeta;
+    PF::markDirty(handle);
+    PF::close(fd);
+
+    ASSERT_NO_THROW(index.open(indexFile));
+    EXPECT_EQ(index.meta.version, INDEX_FORMAT_VERSION);
+    EXPECT_EQ(index.getKeyType(), INT);
+    EXPECT_EQ(index.meta.numNode, oldMeta.numNode);
+    EXPECT_EQ(index.countRange({INT_MIN, INT_MAX}),
+              2 * MAX_NUM_ENTRY_PER_NODE);
+    EXPECT_EQ(index.findEq(7, false), std::vector<RecordID>({{7, 7}}));
+}
+
+TEST_F(IndexTest, TestMigrateV3Index) {
+    DisableLogGuard _;
+
+    // Version 3: keys of a single column, with the nodes laid out as now.
+    struct V3Meta {
+        uint16_t headCanary;
+        uint16_t version;
+        int numNode;
+        int numEntry;
+        int firstFreeSlot;
+        int rootNode;
+        DataType keyType;
+        int columnSize;
+        int keySize;
+        uint16_t tailCanary;
+    };
+
+    const int size = 16;
+    ASSERT_NO_THROW(index.create(indexFile, VARCHAR, size));
+    for (int i = 0; i < 2 * MAX_NUM_ENTRY_PER_NODE; i++) {
+        std::string value = std::to_string(i);
+        ASSERT_NO_THROW(index.insert(Column(value.c_str(), size), {i, i}));
+    }
+    V3Meta oldMeta = {INDEX_META_CANARY,
+                      3,
+                      index.meta.numNode,
+                      index.meta.numEntry,
+                      index.meta.firstFreeSlot,
+                      index.meta.rootNode,
+                      VARCHAR,
+                      size,
+                      size,
+                      INDEX_META_CANARY};
+    index.close();
+
+    FileDescriptor fd = PF::open(indexFile);
+    PageHandle handle = PF::getHandle(fd, 0);
+    memset(PF::loadRaw(handle), 0, PAGE_SIZE);
+    *PF::loadRaw<V3Meta *>(handle) = oldMeta;
+    PF::markDirty(handle);
+    PF::close(fd);
+
+    ASSERT_NO_THROW(index.open(indexFile));
+    EXPECT_EQ(index.meta.version, INDEX_FORMAT_VERSION);
+    EXPECT_EQ(index.getNumKeyColumn(), 1);
+    EXPECT_EQ(index.getKeyType(), VARCHAR);
+    EXPECT_EQ(index.getKeySize(), size);
+    EXPECT_EQ(index.meta.numNode, oldMeta.numNode);
+    EXPECT_EQ(index.findEq(Column("7", size)), std::vector<RecordID>({{7, 7}}));
+}
+
+TEST_F(IndexTest, TestNullAndMinKeys) {
+    DisableLogGuard _;
+    initIndex();
+
+    // NULL entries are stored with INT_MIN keys, but are not INT_MIN.
+    for (int i = 0; i < 2 * MAX_NUM_ENTRY_PER_NODE; i++) {
+        ASSERT_NO_THROW(index.insert(i % 3 == 0 ? 0 : INT_MIN, i % 3 == 0,
+                                     {i, i}));
+        ASSERT_NO_THROW(index.insert(i, false, {i, i}));
+    }
+
+    int numMin = 0;
+    for (int i = 0; i < 2 * MAX_NUM_ENTRY_PER_NODE; i++) {
+        numMin += i % 3 != 0;
+    }
+    EXPECT_EQ(index.findEq(INT_MIN, false).size(), numMin);
+    EXPECT_EQ(index.countRange({INT_MIN, INT_MIN}), numMin);
+    EXPECT_EQ(index.countRange({INT_MIN, 9}), numMin + 10);
+
+    // The NULL entries are found by their records only.
+    for (int i = 0; i < 2 * MAX_NUM_ENTRY_PER_NODE; i += 3) {
+        ASSERT_NO_THROW(index.remove(i, true, {i, i}));
+        ASSERT_THROW(index.remove(INT_MIN, false, {i, i}),
+                     Internal::IndexKeyNotExistsError);
+    }
+    EXPECT_EQ(index.meta.numEntry, numMin + 2 * MAX_NUM_ENTRY_PER_NODE);
+}
+
 TEST_F(IndexTest, TestInsertGet) {
     DisableLogGuard _;
     initIndex();
@@ -104,6 +371,354 @@ TEST_F(IndexTest, TestInsertGet) {
     FileCoordinator::shared.cacheManager->discardAll(index.fd);
 }
 
+TEST_F(IndexTest, TestBulkLoad) {
+    DisableLogGuard _;
+
+    for (int runSize :
+         {int(INDEX_BULK_RUN_BYTES / sizeof(Index::IndexEntry)), 1000}) {
+        index.close();
+        std::filesystem::remove(indexFile);
+        initIndex();
+
+        // Some duplicated keys and NULLs.
+        const int numBulk = 50 * MAX_NUM_ENTRY_PER_NODE;
+        std::vector<std::pair<int, RecordID>> entries;
+        for (int i = 0; i < numBulk; i++) {
+            entries.push_back({rand() % 10000, {i, rand()}});
+        }
+        std::shuffle(entries.begin(), entries.end(), std::mt19937(0));
+
+        ASSERT_NO_THROW(index.bulkLoad(
+            [&](const Index::BulkInsertFunc &insert) {
+                for (int i = 0; i < entries.size(); i++) {
+                    insert({i % 10 == 0 ? Column::nullIntColumn()
+                                        : Column(entries[i].first)},
+                           entries[i].second);
+                }
+            },
+            /*fillFactor=*/0.5, runSize));
+        EXPECT_EQ(index.meta.numEntry, entries.size());
+        // The sorted runs are removed.
+        EXPECT_EQ(std::distance(std::filesystem::directory_iterator("tmp"),
+                                std::filesystem::directory_iterator()),
+                  1);
+
+        // Keep inserting and removing after the bulk load.
+        for (int i = 0; i < 10 * MAX_NUM_ENTRY_PER_NODE; i++) {
+            entries.push_back({rand() % 10000, {-1, i}});
+            ASSERT_NO_THROW(index.insert(entries.back().first, false,
+                                         entries.back().second));
+        }
+        for (int i = 1; i < entries.size(); i += 10) {
+            ASSERT_NO_THROW(index.remove(entries[i].first, false,
+                                         entries[i].second));
+        }
+
+        reloadIndex();
+
+        std::map<int, std::multiset<std::pair<int, int>>> expected;
+        for (int i = 0; i < entries.size(); i++) {
+            bool isNull = i < numBulk && i % 10 == 0;
+            if (!isNull && i % 10 != 1) {
+                auto [page, slot] = entries[i].second;
+                expected[entries[i].first].insert({page, slot});
+            }
+        }
+        for (auto &[key, rids] : expected) {
+            std::multiset<std::pair<int, int>> found;
+            for (auto [page, slot] : index.findEq(key, false)) {
+                found.insert({page, slot});
+            }
+            ASSERT_EQ(found, rids);
+        }
+        int numNonNull = 0;
+        for (auto &[key, rids] : expected) {
+            numNonNull += rids.size();
+        }
+        EXPECT_EQ(index.countRange({INT_MIN, INT_MAX}), numNonNull);
+        // The NULLs are kept as well.
+        for (int i = 0; i < numBulk; i += 10) {
+            ASSERT_NO_THROW(index.remove(entries[i].first, true,
+                                         entries[i].second));
+        }
+    }
+}
+
+TEST_F(IndexTest, TestBulkLoadNonEmpty) {
+    initIndex();
+    ASSERT_NO_THROW(index.insert(1, false, {1, 1}));
+    EXPECT_THROW(index.bulkLoad([](const Index::BulkInsertFunc &) {}),
+                 Internal::IndexNotEmptyError);
+}
+
+TEST_F(IndexTest, TestKeyOrder) {
+    auto intKey = [](int value) {
+        return Index::encodeKey(Column(value), INT, sizeof(int));
+    };
+    EXPECT_LT(intKey(INT_MIN), intKey(-1));
+    EXPECT_LT(intKey(-1), intKey(0));
+    EXPECT_LT(intKey(0), intKey(INT_MAX));
+
+    Index::Key key = intKey(-1);
+    EXPECT_TRUE(Index::incrementKey(key));
+    EXPECT_EQ(Index::decodeIntKey(key), 0);
+    EXPECT_TRUE(Index::decrementKey(key));
+    EXPECT_EQ(key, intKey(-1));
+
+    Index::Key max = Index::maxKey(sizeof(int));
+    EXPECT_EQ(Index::decodeIntKey(max), INT_MAX);
+    EXPECT_FALSE(Index::incrementKey(max));
+    Index::Key min = Index::minKey(sizeof(int));
+    EXPECT_EQ(Index::decodeIntKey(min), INT_MIN);
+    EXPECT_FALSE(Index::decrementKey(min));
+}
+
+TEST_F(IndexTest, TestFloatKeys) {
+    DisableLogGuard _;
+    ASSERT_NO_THROW(index.create(indexFile, FLOAT, sizeof(float)));
+
+    std::vector<float> values = {-INFINITY, -1e30F, -2.5F,   -1.0F,
+                                 -FLT_MIN,  -0.0F,  0.0F,    FLT_MIN,
+                                 1.0F,      2.5F,   1e30F,   INFINITY};
+    for (int i = values.size() - 1; i >= 0; i--) {
+        ASSERT_NO_THROW(index.insert(Column(values[i]), {i, i}));
+    }
+    ASSERT_NO_THROW(index.insert(Column::nullFloatColumn(), {-1, -1}));
+
+    reloadIndex();
+
+    // The keys are in the order of the values.
+    for (int i = 0; i < values.size(); i++) {
+        for (int j = 0; j < values.size(); j++) {
+            Index::Range range = {index.encodeKey(Column(values[i])),
+                                  index.encodeKey(Column(values[j]))};
+            EXPECT_EQ(index.countRange(range), i <= j ? j - i + 1 : 0);
+        }
+    }
+    EXPECT_EQ(index.findEq(Column(2.5F)), std::vector<RecordID>({{9, 9}}));
+    EXPECT_TRUE(index.findEq(Column(2.4F)).empty());
+    EXPECT_TRUE(index.findEq(Column::nullFloatColumn()).empty());
+}
+
+TEST_F(IndexTest, TestVarcharKeys) {
+    DisableLogGuard _;
+
+    const int size = 16;
+    const int numValues = 8000;
+
+    // Strings sharing their prefixes, some empty and some NULL.
+    auto value = [](int i) {
+        char buffer[size];
+        snprintf(buffer, sizeof(buffer), "value%06d", i);
+        return i % 100 == 0 ? std::string() : std::string(buffer);
+    };
+
+    ASSERT_NO_THROW(index.create(indexFile, VARCHAR, size));
+    EXPECT_EQ(index.getKeySize(), size);
+    EXPECT_FALSE(index.isTruncated());
+
+    std::vector<int> order(numValues);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(0));
+    for (int i : order) {
+        ASSERT_NO_THROW(index.insert(Column(value(i).c_str(), size), {i, i}));
+        if (i % 50 == 0) {
+            ASSERT_NO_THROW(
+                index.insert(Column::nullVarcharColumn(size), {-1, i}));
+        }
+    }
+    EXPECT_THROW(index.insert(Column(value(1).c_str(), size), {1, 1}),
+                 Internal::IndexKeyExistsError);
+
+    reloadIndex();
+
+    for (int i = 1; i < numValues; i += 7) {
+        if (i % 100 != 0) {
+            EXPECT_EQ(index.findEq(Column(value(i).c_str(), size)),
+                      std::vector<RecordID>({{i, i}}));
+        }
+    }
+    EXPECT_EQ(index.findEq(Column("", size)).size(), numValues / 100);
+    EXPECT_TRUE(index.findEq(Column("value", size)).empty());
+
+    Index::Range range = {index.encodeKey(Column(value(101).c_str(), size)),
+                          index.encodeKey(Column(value(199).c_str(), size))};
+    EXPECT_EQ(index.countRange(range), 99);
+    range = {index.encodeKey(Column("value", size)),
+             Index::maxKey(index.getKeySize())};
+    EXPECT_EQ(index.countRange(range), numValues - numValues / 100);
+
+    for (int i = 0; i < numValues; i += 50) {
+        ASSERT_NO_THROW(index.remove(Column::nullVarcharColumn(size), {-1, i}));
+    }
+    ASSERT_NO_THROW(index.remove(Column("", size), {0, 0}));
+    EXPECT_EQ(index.meta.numEntry, numValues - 1);
+}
+
+TEST_F(IndexTest, TestTruncatedVarcharKeys) {
+    DisableLogGuard _;
+
+    const int size = 2 * INDEX_MAX_KEY_SIZE;
+    ASSERT_NO_THROW(index.create(indexFile, VARCHAR, size));
+    EXPECT_EQ(index.getKeySize(), INDEX_MAX_KEY_SIZE);
+    EXPECT_TRUE(index.isTruncated());
+
+    // Values differing after the keys are all found by either of them.
+    std::string prefix(INDEX_MAX_KEY_SIZE, 'x');
+    for (int i = 0; i < 10; i++) {
+        std::string value = prefix + std::to_string(i);
+        ASSERT_NO_THROW(index.insert(Column(value.c_str(), size), {i, i}));
+    }
+    ASSERT_NO_THROW(index.insert(Column("y", size), {10, 10}));
+
+    std::string value = prefix + "0";
+    EXPECT_EQ(index.findEq(Column(value.c_str(), size)).size(), 10);
+    EXPECT_EQ(index.findEq(Column("y", size)),
+              std::vector<RecordID>({{10, 10}}));
+}
+
+TEST_F(IndexTest, TestCompositeKeys) {
+    DisableLogGuard _;
+
+    const int size = 100;
+    const int numGroups = 20;
+    const int numValues = 50;
+    ColumnMeta group, value, name;
+    group.type = INT;
+    value.type = FLOAT;
+    name.type = VARCHAR;
+    name.size = size;
+
+    // The VARCHAR column takes what the others leave.
+    ASSERT_NO_THROW(index.create(indexFile, {group, value, name}));
+    EXPECT_EQ(index.getNumKeyColumn(), 3);
+    EXPECT_EQ(index.getKeyColumn(2).keySize, INDEX_MAX_KEY_SIZE - 10);
+    EXPECT_EQ(index.getKeySize(), INDEX_MAX_KEY_SIZE);
+    EXPECT_FALSE(index.isTruncated(0));
+    EXPECT_TRUE(index.isTruncated(2));
+
+    auto key = [&](int i, int j) -> Columns {
+        std::string string = "name" + std::to_string(j);
+        return {Column(i),
+                j % 10 == 0 ? Column::nullFloatColumn() : Column(j * 0.5F),
+                Column(string.c_str(), size)};
+    };
+
+    std::vector<std::pair<int, int>> order;
+    for (int i = 0; i < numGroups; i++) {
+        for (int j = 0; j < numValues; j++) {
+            order.push_back({i, j});
+        }
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(0));
+    for (auto [i, j] : order) {
+        ASSERT_NO_THROW(index.insert(key(i, j), {i, j}));
+    }
+    ASSERT_NO_THROW(index.insert(
+        {Column::nullIntColumn(), Column(1.0F), Column("x", size)}, {-1, 0}));
+    EXPECT_THROW(index.insert(key(1, 1), {1, 1}),
+                 Internal::IndexKeyExistsError);
+
+    reloadIndex();
+
+    EXPECT_EQ(index.findEq(key(3, 7)), std::vector<RecordID>({{3, 7}}));
+    EXPECT_TRUE(index.findEq(key(3, 10)).empty());
+    EXPECT_TRUE(index.has(key(3, 11)));
+
+    // The keys of a group are prefixed by the key of its first column, with
+    // the NULL values of the second column first.
+    Index::Key prefix = Index::encodeKey(Column(3), INT, sizeof(int));
+    Index::Range range = {prefix, prefix};
+    range.first.resize(index.getKeySize(), '\0');
+    range.second.resize(index.getKeySize(), '\xff');
+    EXPECT_EQ(index.countRange(range), numValues);
+
+    // Then ranges of the second column.
+    range.first = prefix + '\1' + Index::encodeKey(Column(5.0F), FLOAT, 4);
+    range.second = prefix + '\1' + Index::encodeKey(Column(9.5F), FLOAT, 4);
+    range.first.resize(index.getKeySize(), '\0');
+    range.second.resize(index.getKeySize(), '\xff');
+    std::vector<RecordID> found;
+    index.iterateRange(range, [&](RecordID id) {
+        found.push_back(id);
+        return true;
+    });
+    // 10 to 19, but NULL for 10.
+    std::vector<RecordID> expected;
+    for (int j = 11; j < 20; j++) {
+        expected.push_back({3, j});
+    }
+    EXPECT_EQ(found, expected);
+
+    for (auto [i, j] : order) {
+        ASSERT_NO_THROW(index.remove(key(i, j), {i, j}));
+    }
+    EXPECT_EQ(index.meta.numEntry, 1);
+}
+
+TEST_F(IndexTest, TestDecodeKeys) {
+    ColumnMeta id, value, name;
+    id.type = INT;
+    value.type = FLOAT;
+    name.type = VARCHAR;
+    name.size = 16;
+    ASSERT_NO_THROW(index.create(indexFile, {id, value, name}));
+
+    std::vector<Columns> keys = {
+        {Column(-3), Column(-1.25F), Column("name", 16)},
+        {Column(INT_MAX), Column::nullFloatColumn(), Column("", 16)},
+        {Column(0), Column(FLT_MAX), Column::nullVarcharColumn(16)},
+    };
+    for (int i = 0; i < keys.size(); i++) {
+        ASSERT_NO_THROW(index.insert(keys[i], {i, 0}));
+    }
+
+    std::vector<Columns> decoded;
+    index.iterateRangeKeys(
+        {Index::minKey(index.getKeySize()), Index::maxKey(index.getKeySize())},
+        [&](RecordID id, const char *key) {
+            Columns values;
+            index.decodeKey(key, values);
+            decoded.push_back(values);
+            return true;
+        });
+
+    // In the order of the keys.
+    std::vector<Columns> expected = {keys[0], keys[2], keys[1]};
+    ASSERT_EQ(decoded.size(), expected.size());
+    for (int i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(decoded[i].size(), 3);
+        for (int j = 0; j < 3; j++) {
+            EXPECT_EQ(decoded[i][j].type, expected[i][j].type);
+            EXPECT_EQ(decoded[i][j].size, expected[i][j].size);
+            EXPECT_EQ(decoded[i][j].isNull, expected[i][j].isNull);
+            if (expected[i][j].isNull) {
+                continue;
+            }
+            if (expected[i][j].type == VARCHAR) {
+                EXPECT_STREQ(decoded[i][j].raw(), expected[i][j].raw());
+            } else {
+                EXPECT_EQ(std::string(decoded[i][j].raw(), 4),
+                          std::string(expected[i][j].raw(), 4));
+            }
+        }
+    }
+}
+
+TEST_F(IndexTest, TestTooManyKeyColumns) {
+    DisableLogGuard _;
+
+    ColumnMeta column;
+    column.type = INT;
+    std::vector<ColumnMeta> columns(INDEX_MAX_KEY_COLUMNS + 1, column);
+    EXPECT_THROW(index.create(indexFile, columns), Internal::CreateIndexError);
+
+    columns.resize(INDEX_MAX_KEY_COLUMNS);
+    columns.back().type = VARCHAR;
+    columns.back().size = 10;
+    EXPECT_NO_THROW(index.create(indexFile, columns));
+}
+
 TEST_F(IndexTest, TestRemove) {
     DisableLogGuard _;
     initIndex();
@@ -144,4 +759,219 @@ TEST_F(IndexTest, TestRemove) {
     }
 
     FileCoordinator::shared.cacheManager->discardAll(index.fd);
-}
\ No newline at end of file
+}
+TEST_F(IndexTest, TestVacuum) {
+    DisableLogGuard _;
+    initIndex();
+
+    // A multiple of 40, so that the quarters are multiples of 10.
+    const int numKeys = 50 * index.layout.capacity / 40 * 40;
+    std::vector<int> keys(numKeys);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+    for (int key : keys) {
+        ASSERT_NO_THROW(index.insert(key, false, {key, 0}));
+    }
+
+    // Keep every tenth key, and none in the second quarter, which leaves some
+    // leaves empty.
+    auto kept = [&](int key) {
+        return key % 10 == 0 && (key < numKeys / 4 || key >= numKeys / 2);
+    };
+    int numKept = 0;
+    for (int key : keys) {
+        if (kept(key)) {
+            numKept++;
+        } else {
+            ASSERT_NO_THROW(index.remove(key, false, {key, 0}));
+        }
+    }
+
+    auto check = [&]() {
+        EXPECT_EQ(index.meta.numEntry, numKept);
+        EXPECT_EQ(index.countRange({0, numKeys}), numKept);
+        EXPECT_EQ(index.countRange({numKeys / 4, numKeys / 2 - 1}), 0);
+        std::vector<RecordID> records;
+        index.iterateRange({numKeys / 4 - 10, numKeys / 2 + 10},
+                           [&](RecordID id) {
+                               records.push_back(id);
+                               return true;
+                           });
+        std::vector<RecordID> expected = {{numKeys / 4 - 10, 0},
+                                          {numKeys / 2, 0},
+                                          {numKeys / 2 + 10, 0}};
+        EXPECT_EQ(records, expected);
+        EXPECT_TRUE(index.has(numKeys - 10, false));
+        EXPECT_FALSE(index.has(numKeys - 9, false));
+    };
+    check();
+
+    // The removed entries are gone, but their nodes are kept until vacuumed.
+    ASSERT_TRUE(index.needsVacuum());
+    int numNode = index.meta.numNode;
+    int numFreed;
+    ASSERT_NO_THROW(numFreed = index.vacuum());
+    EXPECT_GT(numFreed, 0);
+    EXPECT_EQ(index.meta.numNode, numNode - numFreed);
+    EXPECT_FALSE(index.needsVacuum());
+    EXPECT_FALSE(std::filesystem::exists(std::string(indexFile) + ".vacuum"));
+    check();
+
+    reloadIndex();
+    check();
+
+    // Nothing to free the second time.
+    EXPECT_EQ(index.vacuum(), 0);
+
+    for (int key = 0; key < numKeys; key++) {
+        if (!kept(key)) {
+            ASSERT_NO_THROW(index.insert(key, false, {key, 0}));
+        }
+    }
+    EXPECT_EQ(index.countRange({0, numKeys}), numKeys);
+}
+
+TEST_F(IndexTest, TestHashIndex) {
+    DisableLogGuard _;
+    ColumnMeta column;
+    column.type = INT;
+    ASSERT_NO_THROW(index.create(indexFile, {column}, /*hash=*/true));
+    EXPECT_TRUE(index.isHash());
+
+    const int numKeys = 100 * index.bucketCapacity;
+    std::vector<int> keys(numKeys);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+    for (int key : keys) {
+        ASSERT_NO_THROW(index.insert(key, false, {key, 0}));
+        if (key % 10 == 0) {
+            ASSERT_NO_THROW(index.insert(key, false, {key, 1}));
+        }
+    }
+    ASSERT_NO_THROW(index.insert(0, true, {-1, 0}));
+    EXPECT_EQ(index.meta.numEntry, numKeys + numKeys / 10 + 1);
+    EXPECT_GT(index.hashMeta.globalDepth, 0);
+
+    reloadIndex();
+    ASSERT_TRUE(index.isHash());
+
+    for (int key = 0; key < numKeys; key++) {
+        std::vector<RecordID> records = index.findEq(key, false);
+        ASSERT_EQ(records.size(), key % 10 == 0 ? 2 : 1);
+        EXPECT_EQ(records[0].page, key);
+    }
+    EXPECT_FALSE(index.has(numKeys, false));
+    EXPECT_FALSE(index.has(-1, false));
+    EXPECT_EQ(index.countRange({10, 10}), 2);
+    EXPECT_THROW(index.countRange({0, 10}), Internal::HashIndexRangeError);
+
+    // Remove most of the keys.
+    for (int key : keys) {
+        if (key % 3 != 0) {
+            ASSERT_NO_THROW(index.remove(key, false, {key, 0}));
+        }
+    }
+    EXPECT_THROW(index.remove(1, false, {1, 0}),
+                 Internal::IndexKeyNotExistsError);
+    ASSERT_NO_THROW(index.remove(0, true, {-1, 0}));
+    EXPECT_FALSE(index.needsVacuum());
+
+    reloadIndex();
+    for (int key = 0; key < numKeys; key++) {
+        int expected = (key % 3 == 0) + (key % 10 == 0);
+        EXPECT_EQ(index.findEq(key, false).size(), expected);
+    }
+
+    // Hash indexes are on a single INT or VARCHAR column.
+    Index other;
+    column.type = FLOAT;
+    EXPECT_THROW(other.create("tmp/other", {column}, /*hash=*/true),
+                 Internal::CreateIndexError);
+}
+
+TEST_F(IndexTest, TestHashIndexSingleHash) {
+    DisableLogGuard _;
+    ColumnMeta column;
+    column.type = INT;
+    ASSERT_NO_THROW(index.create(indexFile, {column}, /*hash=*/true));
+
+    auto singleHash = [&](int key) {
+        uint32_t hash = Index::hashKey((const char *)&key, sizeof(int));
+        int bucket =
+            index.directory[hash & ((1U << index.hashMeta.globalDepth) - 1)];
+        PageHandle handle = index.getHandle(bucket);
+        return bool(PF::loadRaw<Index::HashBucket *>(handle)->singleHash);
+    };
+
+    // A chain of a single key is marked, and kept across reopens.
+    const int numRecords = 3 * index.bucketCapacity;
+    for (int i = 0; i < numRecords; i++) {
+        ASSERT_NO_THROW(index.insert(7, false, {i, 0}));
+    }
+    EXPECT_TRUE(singleHash(7));
+    reloadIndex();
+    EXPECT_TRUE(singleHash(7));
+
+    // Another key of the bucket clears the mark, then splits the chain.
+    for (int key = 0; key < numRecords; key++) {
+        if (key != 7) {
+            ASSERT_NO_THROW(index.insert(key, false, {key, 1}));
+        }
+    }
+    EXPECT_FALSE(singleHash(7));
+    EXPECT_GT(index.hashMeta.globalDepth, 0);
+
+    EXPECT_EQ(index.findEq(7, false).size(), numRecords);
+    for (int key = 0; key < numRecords; key++) {
+        if (key != 7) {
+            EXPECT_EQ(index.findEq(key, false),
+                      std::vector<RecordID>({{key, 1}}));
+        }
+    }
+}
+
+TEST_F(IndexTest, TestHashIndexChains) {
+    DisableLogGuard _;
+    const int size = 80;
+    ColumnMeta column;
+    column.type = VARCHAR;
+    column.size = size;
+    ASSERT_NO_THROW(index.create(indexFile, {column}, /*hash=*/true));
+    EXPECT_TRUE(index.isTruncated());
+
+    // Values sharing their keys, which chain the pages of their bucket.
+    std::string prefix(INDEX_MAX_KEY_SIZE, 'a');
+    const int numRecords = 5 * index.bucketCapacity;
+    for (int i = 0; i < numRecords; i++) {
+        std::string value = prefix + std::to_string(i % 3);
+        ASSERT_NO_THROW(index.insert(Column(value.c_str(), size), {i, 0}));
+    }
+    ASSERT_NO_THROW(index.insert(Column("b", size), {-1, 0}));
+    int numNode = index.meta.numNode;
+    EXPECT_GT(numNode, 5);
+
+    EXPECT_EQ(index.findEq(Column(prefix.c_str(), size)).size(), numRecords);
+    EXPECT_EQ(index.findEq(Column("b", size)),
+              std::vector<RecordID>({{-1, 0}}));
+
+    // The pages emptied are reused.
+    for (int i = 0; i < numRecords; i += 2) {
+        ASSERT_NO_THROW(index.remove(Column(prefix.c_str(), size), {i, 0}));
+    }
+    EXPECT_LT(index.meta.numNode, numNode);
+    for (int i = 0; i < numRecords; i += 2) {
+        ASSERT_NO_THROW(index.insert(Column(prefix.c_str(), size), {i, 0}));
+    }
+    EXPECT_EQ(index.meta.numNode, numNode);
+
+    reloadIndex();
+    std::vector<RecordID> records = index.findEq(Column(prefix.c_str(), size));
+    std::sort(records.begin(), records.end(),
+              [](const RecordID &lhs, const RecordID &rhs) {
+                  return rhs > lhs;
+              });
+    ASSERT_EQ(records.size(), numRecords);
+    for (int i = 0; i < numRecords; i++) {
+        EXPECT_EQ(records[i].page, i);
+    }
+}
@@ -1,11 +1,15 @@
 #include <SimpleDB/SimpleDB.h>
 #include <SimpleDB/internal/Column.h>
 #include <SimpleDB/internal/IndexedTable.h>
+#include <SimpleDB/internal/QueryBuilder.h>
 #include <SimpleDB/internal/Table.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <climits>
 #include <memory>
+#include <numeric>
+#include <random>
 #include <tuple>
 #include <vector>
 
@@ -42,7 +46,7 @@ protected:
 
 TEST_F(IndexedTableTest, TestRangeCollapse) {
     using TestCase = std::tuple<std::vector<CompareValueCondition>,
-                                std::vector<Index::Range>>;
+                                std::vector<Index::IntRange>>;
 
     std::vector<TestCase> testCases = {
         {{cond(NE, 1), cond(GE, 0), cond(LE, 3)}, {{0, 0}, {2, 3}}},
@@ -70,8 +74,469 @@ TEST_F(IndexedTableTest, TestRangeCollapse) {
 
         ASSERT_EQ(t.ranges.size(), expected.size());
         for (size_t i = 0; i < t.ranges.size(); i++) {
-            EXPECT_EQ(t.ranges[i].first, expected[i].first);
-            EXPECT_EQ(t.ranges[i].second, expected[i].second);
+            EXPECT_EQ(Index::decodeIntKey(t.ranges[i].first),
+                      expected[i].first);
+            EXPECT_EQ(Index::decodeIntKey(t.ranges[i].second),
+                      expected[i].second);
         }
     }
-}
\ No newline at end of file
+}
+TEST_F(IndexedTableTest, TestCount) {
+    for (int i = 0; i < 100; i++) {
+        RecordID id = table.insert({Column(i)});
+        index->insert(i, /*isNull=*/false, id);
+    }
+
+    using TestCase = std::tuple<std::vector<CompareValueCondition>, int>;
+    std::vector<TestCase> testCases = {
+        {std::vector<CompareValueCondition>{}, 100},
+        {{cond(GE, 10)}, 90},
+        {{cond(GE, 10), cond(NE, 20), cond(LT, 50)}, 39},
+        {{cond(EQ, 1), cond(EQ, 2)}, 0},
+    };
+
+    for (const auto &testCase : testCases) {
+        auto &[conditions, expected] = testCase;
+        auto t = std::make_shared<IndexedTable>(
+            &table,
+            [&](const std::string &, const std::string &) { return index; });
+        QueryBuilder builder(t);
+        for (const auto &condition : conditions) {
+            builder.condition(condition);
+        }
+        builder.select({.type = QuerySelector::COUNT_STAR});
+
+        int count;
+        ASSERT_TRUE(t->count(count));
+        EXPECT_EQ(count, expected);
+
+        QueryBuilder::Result result;
+        ASSERT_NO_THROW(result = builder.execute());
+        ASSERT_EQ(result.size(), 1);
+        EXPECT_EQ(result[0].second[0].data.intValue, expected);
+    }
+
+    // Conditions not taken by the index must be checked on each record.
+    IndexedTable t(&table, [](const std::string &, const std::string &) {
+        return std::shared_ptr<Index>();
+    });
+    ASSERT_FALSE(t.acceptCondition(cond(GE, 10)));
+    int count;
+    EXPECT_FALSE(t.count(count));
+}
+
+TEST_F(IndexedTableTest, TestIndexOnlyScan) {
+    std::vector<RecordID> ids;
+    for (int i = 0; i < 100; i++) {
+        RecordID id = table.insert({Column(i)});
+        index->insert(i, /*isNull=*/false, id);
+        ids.push_back(id);
+    }
+    // The records can only be found in the index now, a scan reading them
+    // would fail.
+    for (RecordID id : ids) {
+        table.remove(id);
+    }
+
+    auto newBuilder = [&]() {
+        auto t = std::make_shared<IndexedTable>(
+            &table,
+            [&](const std::string &, const std::string &) { return index; });
+        QueryBuilder builder(t);
+        builder.condition(cond(GE, 10)).condition(cond(NE, 20));
+        return builder;
+    };
+
+    QueryBuilder::Result result;
+    ASSERT_NO_THROW(result = newBuilder().select(colName).execute());
+    ASSERT_EQ(result.size(), 89);
+    EXPECT_EQ(result[0].second[0].data.intValue, 10);
+    EXPECT_EQ(result[10].second[0].data.intValue, 21);
+
+    ASSERT_NO_THROW(result = newBuilder()
+                                 .select({.type = QuerySelector::MAX,
+                                          .column = {.columnName = colName}})
+                                 .execute());
+    ASSERT_EQ(result.size(), 1);
+    EXPECT_EQ(result[0].second[0].data.intValue, 99);
+
+    // The index covers the whole records, which are not in the table.
+    ASSERT_NO_THROW(result = newBuilder().execute());
+    EXPECT_EQ(result.size(), 89);
+    DisableLogGuard _;
+    EXPECT_ANY_THROW(table.get(result[0].first));
+}
+
+TEST_F(IndexedTableTest, TestFloatAndVarcharConditions) {
+    const int size = 16;
+    Table other;
+    other.create("tmp/other", "other",
+                 {{.type = FLOAT, .nullable = true, .name = "f"},
+                  {.type = VARCHAR, .size = size, .nullable = true,
+                   .name = "s"}});
+
+    auto floatIndex = std::make_shared<Index>();
+    auto varcharIndex = std::make_shared<Index>();
+    floatIndex->create("tmp/float_index", FLOAT, sizeof(float));
+    varcharIndex->create("tmp/varchar_index", VARCHAR, size);
+
+    for (int i = 0; i < 100; i++) {
+        std::string name = "name" + std::to_string(i);
+        Columns columns = {Column(i * 0.5F), Column(name.c_str(), size)};
+        RecordID id = other.insert(columns);
+        floatIndex->insert(columns[0], id);
+        varcharIndex->insert(columns[1], id);
+    }
+
+    auto floatCond = [](CompareOp op, float value) {
+        ColumnValue v;
+        v.floatValue = value;
+        return CompareValueCondition({.columnName = "f"}, op, v);
+    };
+    auto varcharCond = [](CompareOp op, const char *value) {
+        return CompareValueCondition({.columnName = "s"}, op, value);
+    };
+
+    // FLOAT values are equal within a precision, thus the records in the
+    // ranges are still checked.
+    using TestCase =
+        std::tuple<std::vector<CompareValueCondition>, bool, int>;
+    std::vector<TestCase> testCases = {
+        {{floatCond(EQ, 1.5)}, false, 1},
+        {{floatCond(GE, 10), floatCond(LT, 20)}, false, 20},
+        {{floatCond(LE, 0)}, false, 1},
+        {{varcharCond(EQ, "name3")}, true, 1},
+        {{varcharCond(LT, "name2"), varcharCond(NE, "name10")}, true, 11},
+        {{varcharCond(GT, "name98")}, true, 1},
+        {{varcharCond(GE, "name99"), varcharCond(LT, "name99")}, true, 0},
+    };
+
+    for (const auto &testCase : testCases) {
+        auto &[conditions, accepted, expected] = testCase;
+        auto getIndex = [&](const std::string &, const std::string &column) {
+            return column == "f" ? floatIndex : varcharIndex;
+        };
+        auto t = std::make_shared<IndexedTable>(&other, getIndex);
+        QueryBuilder builder(t);
+        for (const auto &condition : conditions) {
+            EXPECT_EQ(IndexedTable(&other, getIndex).acceptCondition(condition),
+                      accepted);
+            builder.condition(condition);
+        }
+
+        QueryBuilder::Result result;
+        ASSERT_NO_THROW(result = builder.execute());
+        EXPECT_EQ(result.size(), expected);
+    }
+
+    other.close();
+}
+
+TEST_F(IndexedTableTest, TestCompositeIndex) {
+    Table other;
+    other.create("tmp/other", "other",
+                 {{.type = INT, .nullable = false, .name = "a"},
+                  {.type = INT, .nullable = true, .name = "b"},
+                  {.type = INT, .nullable = false, .name = "c"}});
+
+    auto compositeIndex = std::make_shared<Index>();
+    compositeIndex->create(
+        "tmp/composite_index",
+        std::vector<ColumnMeta>(other.meta.columns, other.meta.columns + 2));
+
+    for (int i = 0; i < 100; i++) {
+        Columns columns = {Column(i % 10), Column(i), Column(i % 7)};
+        if (i % 10 == 9) {
+            columns[1] = Column::nullIntColumn();
+        }
+        RecordID id = other.insert(columns);
+        compositeIndex->insert(Columns{columns[0], columns[1]}, id);
+    }
+
+    const std::string name = IndexedTable::getIndexName({"a", "b"});
+    auto getIndex = [&](const std::string &, const std::string &column) {
+        return column == name ? compositeIndex : std::shared_ptr<Index>();
+    };
+    auto intCond = [](const char *column, CompareOp op, int value) {
+        ColumnValue v;
+        v.intValue = value;
+        return CompareValueCondition({.columnName = column}, op, v);
+    };
+
+    // The second column is taken only after an equality on the first one.
+    using TestCase =
+        std::tuple<std::vector<CompareValueCondition>, std::vector<bool>, int>;
+    std::vector<TestCase> testCases = {
+        {{intCond("a", EQ, 1)}, {true}, 10},
+        {{intCond("a", EQ, 1), intCond("b", GE, 50)}, {true, true}, 5},
+        {{intCond("b", GE, 50)}, {false}, 45},
+        {{intCond("a", GE, 8), intCond("b", LT, 20)}, {true, false}, 2},
+        {{intCond("a", EQ, 2), intCond("b", NE, 12), intCond("c", EQ, 1)},
+         {true, true, false},
+         2},
+        {{intCond("a", EQ, 9), intCond("b", GE, 0)}, {true, true}, 0},
+        {{intCond("a", EQ, 3), intCond("b", EQ, 3), intCond("b", EQ, 4)},
+         {true, true, true},
+         0},
+    };
+
+    for (const auto &testCase : testCases) {
+        auto &[conditions, accepted, expected] = testCase;
+        auto t = std::make_shared<IndexedTable>(&other, getIndex,
+                                                std::vector{name});
+        IndexedTable acceptor(&other, getIndex, {name});
+        QueryBuilder builder(t);
+        for (int i = 0; i < conditions.size(); i++) {
+            EXPECT_EQ(acceptor.acceptCondition(conditions[i]), accepted[i]);
+            builder.condition(conditions[i]);
+        }
+
+        QueryBuilder::Result result;
+        ASSERT_NO_THROW(result = builder.execute());
+        EXPECT_EQ(result.size(), expected);
+    }
+
+    other.close();
+}
+
+TEST_F(IndexedTableTest, TestHashIndex) {
+    auto hashIndex = std::make_shared<Index>();
+    hashIndex->create("tmp/hash", schema, /*hash=*/true);
+    for (int i = 0; i < 100; i++) {
+        RecordID id = table.insert({Column(i % 50)});
+        hashIndex->insert(i % 50, /*isNull=*/false, id);
+    }
+
+    auto newTable = [&]() {
+        return std::make_shared<IndexedTable>(
+            &table, [&](const std::string &, const std::string &) {
+                return hashIndex;
+            });
+    };
+
+    // Only equality conditions are taken by a hash index.
+    EXPECT_FALSE(newTable()->acceptCondition(cond(GE, 10)));
+    EXPECT_FALSE(newTable()->acceptCondition(cond(NE, 10)));
+
+    using TestCase = std::tuple<std::vector<CompareValueCondition>, int>;
+    std::vector<TestCase> testCases = {
+        {{cond(EQ, 7)}, 2},
+        {{cond(EQ, 20), cond(GE, 10)}, 2},
+        {{cond(EQ, 5), cond(GE, 10)}, 0},
+        {{cond(EQ, 30), cond(EQ, 40)}, 0},
+    };
+
+    for (const auto &testCase : testCases) {
+        auto &[conditions, expected] = testCase;
+        auto t = newTable();
+        QueryBuilder builder(t);
+        for (const auto &condition : conditions) {
+            builder.condition(condition);
+        }
+
+        QueryBuilder::Result result;
+        ASSERT_NO_THROW(result = builder.execute());
+        EXPECT_EQ(result.size(), expected);
+        EXPECT_TRUE(t->index == hashIndex || t->emptySet);
+    }
+}
+
+TEST_F(IndexedTableTest, TestBitmapScan) {
+    // Not covered by the index.
+    Table other;
+    other.create("tmp/other", "other",
+                 {schema[0], {.type = INT, .nullable = true, .name = "v"}});
+
+    // The keys are shuffled over the pages.
+    std::vector<int> keys(1000);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+    for (int key : keys) {
+        index->insert(key, /*isNull=*/false,
+                      other.insert({Column(key), Column(-key)}));
+    }
+
+    auto scan = [&](int threshold) {
+        IndexedTable t(&other, [&](const std::string &, const std::string &) {
+            return index;
+        });
+        t.setBitmapScanThreshold(threshold);
+        EXPECT_TRUE(t.acceptCondition(cond(GE, 100)));
+        EXPECT_TRUE(t.acceptCondition(cond(LT, 600)));
+        EXPECT_TRUE(t.acceptCondition(cond(NE, 300)));
+
+        std::vector<std::pair<RecordID, int>> records;
+        t.iterate([&](RecordID id, Columns &columns) {
+            records.push_back({id, columns[0].data.intValue});
+            return true;
+        });
+        return records;
+    };
+
+    // Found in the order of the keys.
+    auto records = scan(INT_MAX);
+    ASSERT_EQ(records.size(), 499);
+    EXPECT_EQ(records[0].second, 100);
+    EXPECT_EQ(records[200].second, 301);
+
+    // Fetched in the order of the locations.
+    auto bitmapRecords = scan(499);
+    ASSERT_EQ(bitmapRecords.size(), 499);
+    EXPECT_TRUE(std::is_sorted(
+        bitmapRecords.begin(), bitmapRecords.end(),
+        [](const auto &lhs, const auto &rhs) {
+            return lhs.first.page != rhs.first.page
+                       ? lhs.first.page < rhs.first.page
+                       : lhs.first.slot < rhs.first.slot;
+        }));
+
+    std::sort(bitmapRecords.begin(), bitmapRecords.end(),
+              [](const auto &lhs, const auto &rhs) {
+                  return lhs.second < rhs.second;
+              });
+    for (int i = 0; i < records.size(); i++) {
+        EXPECT_EQ(bitmapRecords[i].first, records[i].first);
+        EXPECT_EQ(bitmapRecords[i].second, records[i].second);
+    }
+
+    // Stopped by the callback.
+    IndexedTable t(&other, [&](const std::string &, const std::string &) {
+        return index;
+    });
+    t.setBitmapScanThreshold(1);
+    t.acceptCondition(cond(GE, 0));
+    int numRecords = 0;
+    t.iterate([&](RecordID, Columns &) { return ++numRecords < 10; });
+    EXPECT_EQ(numRecords, 10);
+
+    // Found and fetched in chunks, so that a scan stopped early only finds
+    // the records of the first chunk.
+    IndexedTable chunked(&other, [&](const std::string &, const std::string &) {
+        return index;
+    });
+    chunked.setBitmapScanThreshold(1, 100);
+    chunked.acceptCondition(cond(GE, 0));
+    std::vector<std::pair<RecordID, int>> chunkRecords;
+    chunked.iterate([&](RecordID id, Columns &columns) {
+        chunkRecords.push_back({id, columns[0].data.intValue});
+        return chunkRecords.size() < 150;
+    });
+    ASSERT_EQ(chunkRecords.size(), 150);
+    for (int i = 0; i < 150; i++) {
+        EXPECT_EQ(chunkRecords[i].second / 100, i / 100);
+        if (i % 100 > 0) {
+            EXPECT_TRUE(chunkRecords[i - 1].first.page <
+                            chunkRecords[i].first.page ||
+                        (chunkRecords[i - 1].first.page ==
+                             chunkRecords[i].first.page &&
+                         chunkRecords[i - 1].first.slot <
+                             chunkRecords[i].first.slot));
+        }
+    }
+}
+
+TEST_F(IndexedTableTest, TestIndexIntersection) {
+    Table other;
+    other.create("tmp/other", "other",
+                 {{.type = INT, .nullable = false, .name = "a"},
+                  {.type = INT, .nullable = false, .name = "b"},
+                  {.type = INT, .nullable = false, .name = "c"}});
+    auto indexA = std::make_shared<Index>();
+    auto indexB = std::make_shared<Index>();
+    indexA->create("tmp/index_a");
+    indexB->create("tmp/index_b");
+
+    std::vector<RecordID> ids;
+    for (int i = 0; i < 1000; i++) {
+        Columns columns = {Column(i % 10), Column(i % 7), Column(i)};
+        RecordID id = other.insert(columns);
+        indexA->insert(columns[0], id);
+        indexB->insert(columns[1], id);
+        ids.push_back(id);
+    }
+    // The records of a = 1 but b != 2 can only be found in the indexes now,
+    // reading them would fail.
+    for (int i = 0; i < 1000; i++) {
+        if (i % 10 == 1 && i % 7 != 2) {
+            other.remove(ids[i]);
+        }
+    }
+
+    auto newTable = [&]() {
+        return std::make_shared<IndexedTable>(
+            &other, [&](const std::string &, const std::string &column) {
+                return column == "a" ? indexA
+                                     : column == "b" ? indexB : nullptr;
+            });
+    };
+    auto condition = [&](const std::string &column, CompareOp op, int i) {
+        ColumnValue value;
+        value.intValue = i;
+        return CompareValueCondition({.columnName = column}, op, value);
+    };
+
+    auto t = newTable();
+    ASSERT_TRUE(t->acceptCondition(condition("a", EQ, 1)));
+    ASSERT_TRUE(t->acceptCondition(condition("b", EQ, 2)));
+    int count;
+    ASSERT_TRUE(t->count(count));
+    EXPECT_EQ(count, 14);
+    EXPECT_EQ(t->intersections.size(), 1);
+    EXPECT_TRUE(t->residualFilters.empty());
+
+    std::vector<int> values;
+    ASSERT_NO_THROW(t->iterate([&](RecordID, Columns &columns) {
+        values.push_back(columns[2].data.intValue);
+        return true;
+    }));
+    ASSERT_EQ(values.size(), 14);
+    for (int value : values) {
+        EXPECT_EQ(value % 10, 1);
+        EXPECT_EQ(value % 7, 2);
+    }
+
+    // Only with equality conditions.
+    t = newTable();
+    ASSERT_TRUE(t->acceptCondition(condition("a", EQ, 3)));
+    ASSERT_TRUE(t->acceptCondition(condition("b", GT, 4)));
+    t->collapseRanges();
+    EXPECT_TRUE(t->intersections.empty());
+    EXPECT_EQ(t->residualFilters.size(), 1);
+    values.clear();
+    t->iterate([&](RecordID, Columns &columns) {
+        values.push_back(columns[2].data.intValue);
+        return true;
+    });
+    EXPECT_EQ(values.size(), 29);
+
+    // Not when the chosen index finds few records, or the other one too many.
+    for (auto [minRecords, maxRecords] :
+         std::vector<std::pair<int, int>>{{200, INT_MAX}, {0, 100}}) {
+        t = newTable();
+        t->setIntersectionBounds(minRecords, maxRecords);
+        ASSERT_TRUE(t->acceptCondition(condition("a", EQ, 3)));
+        ASSERT_TRUE(t->acceptCondition(condition("b", EQ, 4)));
+        EXPECT_FALSE(t->count(count));
+        EXPECT_TRUE(t->intersections.empty());
+        EXPECT_EQ(t->residualFilters.size(), 1);
+        values.clear();
+        t->iterate([&](RecordID, Columns &columns) {
+            values.push_back(columns[2].data.intValue);
+            return true;
+        });
+        EXPECT_EQ(values.size(), 14);
+    }
+
+    // None in the intersection.
+    t = newTable();
+    ASSERT_TRUE(t->acceptCondition(condition("a", EQ, 1)));
+    ASSERT_TRUE(t->acceptCondition(condition("b", EQ, 100)));
+    ASSERT_TRUE(t->count(count));
+    EXPECT_EQ(count, 0);
+    values.clear();
+    t->iterate([&](RecordID, Columns &) {
+        values.push_back(0);
+        return true;
+    });
+    EXPECT_TRUE(values.empty());
+}
@@ -258,3 +258,117 @@ TEST_F(QueryConditionTest, TestNullValue) {
 //     EXPECT_THROW(auto result = builder.execute(),
 //                  Internal::InvalidOperatorError);
 // }
+
+TEST_F(QueryConditionTest, TestParallelScan) {
+    // Enough pages for several morsels.
+    int numRecords = (PARALLEL_SCAN_MIN_MORSELS + 1) *
+                     PARALLEL_SCAN_MORSEL_PAGES * table.numSlotPerPage();
+    for (int i = 0; i < numRecords; i++) {
+        Columns columns = {Column(i), Column(float(i % 7)),
+                           Column(testVarChar, 100),
+                           i % 3 == 0 ? Column::nullIntColumn() : Column(i)};
+        ASSERT_NO_THROW(table.insert(columns));
+    }
+    ASSERT_GE(table.numMorsels(), PARALLEL_SCAN_MIN_MORSELS);
+
+    auto buildQueries = [&](int numThreads) {
+        std::vector<QueryBuilder> builders(5, getBaseBuilder());
+        for (auto &builder : builders) {
+            builder.parallel(numThreads);
+        }
+        builders[0].condition("int_val", GE, numRecords / 3);
+        builders[1].condition("int_val", LT, numRecords / 2).select("int_val");
+        builders[2].limit(10).offset(numRecords / 2);
+        builders[3]
+            .condition("int_val", GE, 100)
+            .select({.type = QuerySelector::COUNT_STAR})
+            .select({.type = QuerySelector::COUNT_COL,
+                     .column = {.columnName = "int_val_nullable"}})
+            .select({.type = QuerySelector::SUM,
+                     .column = {.columnName = "int_val_nullable"}})
+            .select({.type = QuerySelector::MIN,
+                     .column = {.columnName = "int_val_nullable"}})
+            .select({.type = QuerySelector::MAX,
+                     .column = {.columnName = "float_val"}});
+        builders[4].nullCondition("int_val_nullable", true).limit(3);
+        return builders;
+    };
+
+    auto serialQueries = buildQueries(1);
+    auto parallelQueries = buildQueries(4);
+    for (int i = 0; i < serialQueries.size(); i++) {
+        QueryBuilder::Result expected, result;
+        ASSERT_NO_THROW(expected = serialQueries[i].execute());
+        ASSERT_NO_THROW(result = parallelQueries[i].execute());
+        ASSERT_EQ(result.size(), expected.size());
+        for (int j = 0; j < result.size(); j++) {
+            EXPECT_EQ(result[j].first, expected[j].first);
+            compareColumns(result[j].second, expected[j].second);
+        }
+    }
+}
+
+TEST_F(QueryConditionTest, TestBatchAggregation) {
+    Table paxTable;
+    ASSERT_NO_THROW(paxTable.create("tmp/pax", tableName, columnMetas, {}, {},
+                                    /*zoneMap=*/true, /*pax=*/true));
+
+    for (int i = 0; i < 10 * table.numSlotPerPage(); i++) {
+        Columns columns = {i % 5 == 0 ? Column::nullIntColumn() : Column(i),
+                           Column(float(i % 7) + 0.5F),
+                           Column(testVarChar, 100),
+                           i % 3 == 0 ? Column::nullIntColumn() : Column(-i)};
+        ASSERT_NO_THROW(table.insert(columns));
+        ASSERT_NO_THROW(paxTable.insert(columns));
+    }
+
+    auto buildQuery = [&](QueryBuilder builder, int query) {
+        builder.select({.type = QuerySelector::COUNT_STAR})
+            .select({.type = QuerySelector::COUNT_COL,
+                     .column = {.columnName = "int_val_nullable"}})
+            .select({.type = QuerySelector::SUM,
+                     .column = {.columnName = "int_val"}})
+            .select({.type = QuerySelector::AVG,
+                     .column = {.columnName = "float_val"}})
+            .select({.type = QuerySelector::MIN,
+                     .column = {.columnName = "int_val_nullable"}})
+            .select({.type = QuerySelector::MAX,
+                     .column = {.columnName = "float_val"}});
+        switch (query) {
+            case 1:
+                builder.condition("int_val", GE, 100);
+                break;
+            case 2:
+                builder.condition("int_val", LT, 200)
+                    .condition({.columnName = "float_val"}, GT,
+                               ColumnValue{.floatValue = 3.5F})
+                    .nullCondition("int_val_nullable", false);
+                break;
+            case 3:
+                builder.nullCondition("int_val", true);
+                break;
+            case 4:
+                // No record matches.
+                builder.condition("int_val", LT, -1);
+                break;
+            case 5:
+                // Conditions on VARCHAR columns are not run in batches.
+                builder.condition("varchar_val", EQ, testVarChar);
+                break;
+        }
+        return builder;
+    };
+
+    for (int query = 0; query <= 5; query++) {
+        QueryBuilder::Result expected, result;
+        QueryBuilder builder = buildQuery(getBaseBuilder(), query);
+        QueryBuilder paxBuilder = buildQuery(QueryBuilder(&paxTable), query);
+        ASSERT_NO_THROW(expected = builder.execute());
+        ASSERT_NO_THROW(result = paxBuilder.execute());
+        ASSERT_EQ(expected.size(), 1);
+        ASSERT_EQ(result.size(), 1);
+        compareColumns(result[0].second, expected[0].second);
+    }
+
+    paxTable.close();
+}
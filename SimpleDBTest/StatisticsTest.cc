@@ -0,0 +1,102 @@
+#ifndef TESTING
+#define TESTING 1
+#endif
+#include <SimpleDB/SimpleDB.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace SimpleDB;
+using namespace SimpleDB::Internal;
+
+TEST(StatisticsTest, TestIntColumn) {
+    ColumnStatisticsCollector collector(INT, 4);
+    for (int i = 100; i > 0; i--) {
+        collector.add(Column(i));
+        collector.add(Column(i));
+    }
+    collector.add(Column::nullIntColumn());
+    collector.add(Column::nullIntColumn());
+
+    ColumnStatistics stats = collector.finish();
+    EXPECT_EQ(stats.rowCount, 202);
+    EXPECT_EQ(stats.nullCount, 2);
+    EXPECT_FLOAT_EQ(stats.nullFraction(), 2.0 / 202);
+    EXPECT_EQ(stats.min.data.intValue, 1);
+    EXPECT_EQ(stats.max.data.intValue, 100);
+    EXPECT_EQ(stats.ndv, 100);
+    EXPECT_EQ(stats.histogram, std::vector<double>({25, 50, 75, 100}));
+    EXPECT_EQ(stats.histogramDesc(), "25,50,75,100");
+}
+
+TEST(StatisticsTest, TestFloatColumn) {
+    ColumnStatisticsCollector collector(FLOAT, 16);
+    collector.add(Column(1.5F));
+    collector.add(Column(-0.25F));
+
+    ColumnStatistics stats = collector.finish();
+    EXPECT_EQ(ColumnStatistics::valueDesc(stats.min), "-0.25");
+    EXPECT_EQ(ColumnStatistics::valueDesc(stats.max), "1.5");
+    EXPECT_EQ(stats.ndv, 2);
+    // Fewer values than buckets.
+    EXPECT_EQ(stats.histogramDesc(), "-0.25,1.5");
+}
+
+TEST(StatisticsTest, TestVarcharColumn) {
+    ColumnStatisticsCollector collector(VARCHAR, 16);
+    for (const char *value : {"banana", "apple", "cherry", "apple"}) {
+        collector.add(Column(value, 16));
+    }
+
+    ColumnStatistics stats = collector.finish();
+    EXPECT_STREQ(stats.min.raw(), "apple");
+    EXPECT_STREQ(stats.max.raw(), "cherry");
+    EXPECT_EQ(stats.ndv, 3);
+    EXPECT_TRUE(stats.histogram.empty());
+}
+
+TEST(StatisticsTest, TestEmptyColumn) {
+    ColumnStatisticsCollector collector(INT, 16);
+    collector.add(Column::nullIntColumn());
+
+    ColumnStatistics stats = collector.finish();
+    EXPECT_EQ(stats.rowCount, 1);
+    EXPECT_FLOAT_EQ(stats.nullFraction(), 1);
+    EXPECT_TRUE(stats.min.isNull);
+    EXPECT_TRUE(stats.max.isNull);
+    EXPECT_EQ(stats.ndv, 0);
+    EXPECT_TRUE(stats.histogram.empty());
+}
+
+TEST(StatisticsTest, TestNDVEstimate) {
+    const int numDistinct = 100000;
+    ColumnStatisticsCollector collector(INT, 16);
+    for (int i = 0; i < 2 * numDistinct; i++) {
+        collector.add(Column(i % numDistinct));
+    }
+
+    // The standard error of the sketch is about 1 / sqrt(K).
+    ColumnStatistics stats = collector.finish();
+    EXPECT_NEAR(stats.ndv, numDistinct, numDistinct * 0.1);
+}
+
+TEST(StatisticsTest, TestSampledHistogram) {
+    const int numValues = 1000000;
+    ColumnStatisticsCollector collector(INT, 4);
+    for (int i = 1; i <= numValues; i++) {
+        collector.add(Column(i));
+    }
+
+    // Only a bounded sample of the values is kept.
+    EXPECT_EQ(collector.values.size(),
+              size_t(ColumnStatisticsCollector::HISTOGRAM_SAMPLE_SIZE));
+
+    ColumnStatistics stats = collector.finish();
+    ASSERT_EQ(stats.histogram.size(), 4);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_NEAR(stats.histogram[i], (i + 1) * numValues / 4.0,
+                    numValues * 0.02);
+    }
+    EXPECT_EQ(stats.histogram[3], numValues);
+}
@@ -3,9 +3,17 @@
 #define TESTING 1
 #endif
 #include <SimpleDB/SimpleDB.h>
+#include <SimpleDB/internal/MemoryTable.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <map>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <vector>
 
 #include "Util.h"
 
@@ -76,6 +84,122 @@ TEST_F(TableTest, TestInitFromInvalidFile) {
     EXPECT_THROW(table.open(fileName), Internal::ReadTableError);
 }
 
+TEST_F(TableTest, TestInitFromUnsupportedVersion) {
+    initTable();
+    table.meta.version = TABLE_FORMAT_VERSION + 1;
+    table.flushMeta();
+    table.close();
+
+    DisableLogGuard _;
+    EXPECT_THROW(table.open("tmp/table"), Internal::ReadTableError);
+}
+
+TEST_F(TableTest, TestMigrateLegacyTable) {
+    DisableLogGuard _;
+
+    // Version 0: the data pages start at page 1, without the free-space map,
+    // the dictionary page and the record count.
+    struct LegacyColumnMeta {
+        DataType type;
+        ColumnSizeType size;
+        bool nullable;
+        char name[MAX_COLUMN_NAME_LEN];
+        bool hasDefault;
+        ColumnValue defaultValue;
+    };
+    struct LegacyMeta {
+        uint16_t headCanary;
+        char name[MAX_TABLE_NAME_LEN + 1];
+        uint32_t numColumn;
+        LegacyColumnMeta columns[MAX_COLUMNS];
+        int primaryKeyIndex;
+        alignas(ForeignKey) char foreignKeys[sizeof(ForeignKey) *
+                                             MAX_FOREIGN_KEYS];
+        uint16_t numUsedPages;
+        uint16_t firstFree;
+        int recordSize;
+        uint16_t tailCanary;
+    };
+
+    // The data pages are laid out as now.
+    initTable();
+    const int numRecords = 200;
+    for (int i = 0; i < numRecords; i++) {
+        ASSERT_NO_THROW(table.insert({Column(i), Column(i * 0.5F),
+                                      Column(testVarChar, 100),
+                                      Column::nullIntColumn()}));
+    }
+    int numDataPages = table.meta.numUsedPages - Table::FIRST_DATA_PAGE;
+    ASSERT_GE(numDataPages, 3);
+    int numSlots = table.numSlotPerPage() - 1;
+    int recordSize = table.meta.recordSize;
+    table.close();
+
+    std::vector<char> metaPage(PAGE_SIZE);
+    LegacyMeta *meta = (LegacyMeta *)metaPage.data();
+    meta->headCanary = meta->tailCanary = LEGACY_TABLE_META_CANARY;
+    strcpy(meta->name, tableName);
+    meta->numColumn = columnMetas.size();
+    for (int i = 0; i < columnMetas.size(); i++) {
+        meta->columns[i] = {columnMetas[i].type, columnMetas[i].size,
+                            columnMetas[i].nullable, {},
+                            columnMetas[i].hasDefault,
+                            columnMetas[i].defaultValue};
+        strcpy(meta->columns[i].name, columnMetas[i].name);
+    }
+    meta->primaryKeyIndex = -1;
+    meta->numUsedPages = numDataPages + 1;
+    meta->firstFree = numDataPages;
+    meta->recordSize = recordSize;
+
+    FileDescriptor fd = PF::open("tmp/table");
+    std::vector<char> page(PAGE_SIZE);
+    for (int i = 0; i < numDataPages; i++) {
+        memcpy(page.data(),
+               PF::loadRaw(PF::getHandle(fd, Table::FIRST_DATA_PAGE + i)),
+               PAGE_SIZE);
+        PageHandle handle = PF::getHandle(fd, 1 + i);
+        memcpy(PF::loadRaw(handle), page.data(), PAGE_SIZE);
+        PF::markDirty(handle);
+    }
+    PageHandle handle = PF::getHandle(fd, 0);
+    memcpy(PF::loadRaw(handle), metaPage.data(), PAGE_SIZE);
+    PF::markDirty(handle);
+    PF::close(fd);
+
+    // The records of the first two (full) pages are moved to the end.
+    std::vector<std::tuple<RecordID, RecordID, int>> moves;
+    ASSERT_NO_THROW(table.open(
+        "tmp/table", [&](RecordID from, RecordID to, const Columns &columns) {
+            moves.push_back({from, to, columns[0].data.intValue});
+        }));
+    EXPECT_EQ(table.meta.version, TABLE_FORMAT_VERSION);
+    EXPECT_EQ(table.meta.numRecords, numRecords);
+    EXPECT_EQ(table.meta.numUsedPages, numDataPages + Table::FIRST_DATA_PAGE);
+    ASSERT_EQ(moves.size(), numSlots * 2);
+    for (const auto &[from, to, value] : moves) {
+        EXPECT_LT(from.page, Table::FIRST_DATA_PAGE);
+        EXPECT_GE(to.page, numDataPages + 1);
+        EXPECT_EQ(to.slot, from.slot);
+        EXPECT_EQ(table.get(to)[0].data.intValue, value);
+    }
+
+    std::vector<bool> found(numRecords, false);
+    table.iterate([&](RecordID, Columns &columns) {
+        found[columns[0].data.intValue] = true;
+        return true;
+    });
+    EXPECT_EQ(std::count(found.begin(), found.end(), true), numRecords);
+
+    // The upgrade is persisted, and the free-space map rebuilt.
+    ASSERT_NO_THROW(table.insert(testColumns));
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    int count;
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, numRecords + 1);
+}
+
 TEST_F(TableTest, TestInitWithDuplicateColumnName) {
     std::vector<ColumnMeta> columnMetas = {
         {.type = INT, .size = 4, .name = "int_val"},
@@ -89,10 +213,12 @@ TEST_F(TableTest, TestInsertGet) {
     initTable();
 
     // Write a few pages.
-    for (int page = 1; page <= 3; page++) {
+    const int firstPage = Table::FIRST_DATA_PAGE;
+    for (int page = firstPage; page < firstPage + 3; page++) {
         for (int i = 0; i < table.numSlotPerPage() - 1; i++) {
             RecordID id;
             ASSERT_NO_THROW(id = table.insert(testColumns));
+            EXPECT_EQ(id.page, page);
 
             Columns readColumns;
             ASSERT_NO_THROW(readColumns = table.get(id));
@@ -103,10 +229,53 @@ TEST_F(TableTest, TestInsertGet) {
             EXPECT_TRUE(table.occupied(handle, id.slot));
         }
 
-        EXPECT_EQ(table.meta.firstFree, page + 1);
+        // All pages are full.
+        EXPECT_EQ(table.findFreePage(firstPage), -1);
     }
 }
 
+TEST_F(TableTest, TestInsertBatch) {
+    initTable();
+
+    // Leave a hole in the first page.
+    RecordID first, second;
+    ASSERT_NO_THROW(first = table.insert(testColumns));
+    ASSERT_NO_THROW(second = table.insert(testColumns));
+    ASSERT_NO_THROW(table.remove(first));
+
+    const int numSlot = table.numSlotPerPage() - 1;
+    std::vector<Columns> rows;
+    for (int i = 0; i < 2 * numSlot; i++) {
+        Columns columns = testColumns;
+        columns[0] = Column(i);
+        rows.push_back(columns);
+    }
+
+    std::vector<RecordID> ids;
+    ASSERT_NO_THROW(ids = table.insertBatch(rows));
+    ASSERT_EQ(ids.size(), rows.size());
+
+    // The hole is filled first.
+    EXPECT_EQ(ids[0], first);
+    for (int i = 0; i < rows.size(); i++) {
+        EXPECT_NE(ids[i], second);
+        Columns readColumns;
+        ASSERT_NO_THROW(readColumns = table.get(ids[i]));
+        compareColumns(rows[i], readColumns);
+    }
+
+    // 2 * numSlot + 1 records now take up three pages, only the last of
+    // which has empty slots.
+    const int firstPage = Table::FIRST_DATA_PAGE;
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 3);
+    EXPECT_EQ(table.findFreePage(firstPage), firstPage + 2);
+
+    // Nothing is inserted if any of the rows is invalid.
+    rows.push_back({Column(1)});
+    EXPECT_THROW(table.insertBatch(rows), IncorrectColumnNumError);
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 3);
+}
+
 TEST_F(TableTest, TestInsertIncompleteFields) {
     initTable();
     // The third column has default value.
@@ -156,18 +325,702 @@ TEST_F(TableTest, TestRemove) {
 TEST_F(TableTest, TestReleasePage) {
     initTable();
 
-    // Write two pages (1, 2).
+    // Write two pages.
+    const int firstPage = Table::FIRST_DATA_PAGE;
     for (int i = 0; i < 2 * (table.numSlotPerPage() - 1); i++) {
         ASSERT_NO_THROW(table.insert(testColumns));
     }
 
-    EXPECT_EQ(table.meta.firstFree, 3);
+    EXPECT_EQ(table.findFreePage(firstPage), -1);
+
+    // Release a slot from the second page.
+    ASSERT_NO_THROW(table.remove({firstPage + 1, 1}));
+
+    // The second page is free immediately.
+    ASSERT_EQ(table.findFreePage(firstPage), firstPage + 1);
+
+    // Release a slot from the first page.
+    ASSERT_NO_THROW(table.remove({firstPage, 2}));
+    ASSERT_EQ(table.findFreePage(firstPage), firstPage);
+    ASSERT_EQ(table.findFreePage(firstPage + 1), firstPage + 1);
+
+    // Both slots are reused before creating a new page.
+    EXPECT_EQ(table.insert(testColumns), RecordID({firstPage, 2}));
+    EXPECT_EQ(table.insert(testColumns), RecordID({firstPage + 1, 1}));
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 2);
+}
+
+TEST_F(TableTest, TestInsertStreams) {
+    initTable();
+
+    // Write eight full pages, then free one slot in each of them.
+    const int firstPage = Table::FIRST_DATA_PAGE;
+    const int numPages = 8;
+    for (int i = 0; i < numPages * (table.numSlotPerPage() - 1); i++) {
+        ASSERT_NO_THROW(table.insert(testColumns));
+    }
+    for (int page = firstPage; page < firstPage + numPages; page++) {
+        ASSERT_NO_THROW(table.remove({page, 1}));
+    }
+
+    // Different streams fill different free pages.
+    std::vector<int> pages;
+    for (int stream = 1; stream <= numPages; stream++) {
+        RecordID id;
+        ASSERT_NO_THROW(id = table.insert(testColumns, COLUMN_BITMAP_ALL,
+                                          stream));
+        EXPECT_EQ(id.slot, 1);
+        pages.push_back(id.page);
+    }
+    std::sort(pages.begin(), pages.end());
+    EXPECT_GT(std::unique(pages.begin(), pages.end()) - pages.begin(), 1);
+
+    // The streams wrap around to the remaining free pages before creating a
+    // new one.
+    while (table.findFreePage(firstPage) >= 0) {
+        ASSERT_NO_THROW(table.insert(testColumns, COLUMN_BITMAP_ALL, 1));
+    }
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + numPages);
+    EXPECT_EQ(table.meta.numRecords, numPages * (table.numSlotPerPage() - 1));
+
+    // A deleted slot is visible to the streams immediately.
+    ASSERT_NO_THROW(table.remove({firstPage, 5}));
+    EXPECT_EQ(table.insert(testColumns, COLUMN_BITMAP_ALL, 3),
+              RecordID({firstPage, 5}));
+}
+
+TEST_F(TableTest, TestFreeSpaceMapPersisted) {
+    initTable();
+
+    const int firstPage = Table::FIRST_DATA_PAGE;
+    for (int i = 0; i < 3 * (table.numSlotPerPage() - 1); i++) {
+        ASSERT_NO_THROW(table.insert(testColumns));
+    }
+    ASSERT_NO_THROW(table.remove({firstPage + 1, 3}));
+    table.close();
+
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    EXPECT_EQ(table.findFreePage(firstPage), firstPage + 1);
+    EXPECT_EQ(table.insert(testColumns), RecordID({firstPage + 1, 3}));
+}
+
+TEST_F(TableTest, TestCompact) {
+    initTable();
+
+    const int firstPage = Table::FIRST_DATA_PAGE;
+    const int numSlot = table.numSlotPerPage() - 1;
+    std::vector<RecordID> ids;
+    for (int i = 0; i < 4 * numSlot; i++) {
+        Columns columns = testColumns;
+        columns[0] = Column(i);
+        ASSERT_NO_THROW(ids.push_back(table.insert(columns)));
+    }
+    ASSERT_EQ(table.meta.numUsedPages, firstPage + 4);
+
+    // Leave one record in each of the last two pages.
+    std::map<int, RecordID> remaining;
+    for (int i = 0; i < ids.size(); i++) {
+        if (i < 2 * numSlot || i % numSlot == 0) {
+            remaining[i] = ids[i];
+        } else {
+            ASSERT_NO_THROW(table.remove(ids[i]));
+        }
+    }
+    // Make some holes in the leading pages.
+    ASSERT_NO_THROW(table.remove(ids[1]));
+    ASSERT_NO_THROW(table.remove(ids[numSlot + 1]));
+    remaining.erase(1);
+    remaining.erase(numSlot + 1);
+
+    auto callback = [&](RecordID from, RecordID to, const Columns &columns) {
+        int key = columns[0].data.intValue;
+        ASSERT_EQ(remaining[key], from);
+        EXPECT_LT(to.page, from.page);
+        remaining[key] = to;
+    };
 
-    // Release a slot from the first page (1).
-    ASSERT_NO_THROW(table.remove({1, 1}));
+    Table::CompactResult result;
+    ASSERT_NO_THROW(result = table.compact(1, callback));
+    EXPECT_EQ(result.numMovedRecords, 1);
+    EXPECT_EQ(result.numFreedPages, 1);
+    EXPECT_FALSE(result.done);
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 3);
 
-    // The first free page should be 1.
-    ASSERT_EQ(table.meta.firstFree, 1);
+    ASSERT_NO_THROW(result = table.compact(VACUUM_BATCH_SIZE, callback));
+    EXPECT_EQ(result.numMovedRecords, 1);
+    EXPECT_EQ(result.numFreedPages, 1);
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 2);
+    EXPECT_EQ(std::filesystem::file_size("tmp/table"),
+              (firstPage + 2) * PAGE_SIZE);
+
+    // The records are intact after reopening the table.
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 2);
+    for (const auto &[key, id] : remaining) {
+        Columns columns = testColumns;
+        columns[0] = Column(key);
+        compareColumns(table.get(id), columns);
+    }
+    int numRecords = 0;
+    table.iterate([&](RecordID, Columns &) {
+        numRecords++;
+        return true;
+    });
+    EXPECT_EQ(numRecords, remaining.size());
+
+    // The new pages are created after the truncated end.
+    for (int i = 0; i < numSlot; i++) {
+        ASSERT_NO_THROW(table.insert(testColumns));
+    }
+    EXPECT_EQ(table.meta.numUsedPages, firstPage + 3);
+}
+
+TEST_F(TableTest, TestCount) {
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, columnMetas));
+
+    int count;
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 0);
+
+    std::vector<RecordID> ids;
+    for (int i = 0; i < 10; i++) {
+        ASSERT_NO_THROW(ids.push_back(table.insert(testColumns)));
+    }
+    std::vector<Columns> rows(2 * table.numSlotPerPage(), testColumns);
+    ASSERT_NO_THROW(table.insertBatch(rows));
+    for (int i = 0; i < 5; i++) {
+        ASSERT_NO_THROW(table.remove(ids[i]));
+    }
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 5 + rows.size());
+
+    // Persisted in the table metadata.
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 5 + rows.size());
+
+    // Moving records does not change the count.
+    ASSERT_NO_THROW(
+        table.compact(rows.size(), [](RecordID, RecordID, const Columns &) {}));
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 5 + rows.size());
+}
+
+TEST_F(TableTest, TestPageHandleCache) {
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, columnMetas));
+
+    // More pages than the cache entries, so that some pages share an entry.
+    const int numPages = PAGE_HANDLE_CACHE_SIZE + 16;
+    std::vector<Columns> rows;
+    for (int i = 0; i < numPages * table.numSlotPerPage(); i++) {
+        Columns columns = testColumns;
+        columns[0] = Column(i);
+        rows.push_back(columns);
+    }
+    std::vector<RecordID> ids;
+    ASSERT_NO_THROW(ids = table.insertBatch(rows));
+
+    for (int i = 0; i < 10000; i++) {
+        int index = rand() % ids.size();
+        Columns columns;
+        ASSERT_NO_THROW(columns = table.get(ids[index]));
+        ASSERT_EQ(columns[0].data.intValue, index);
+    }
+    EXPECT_EQ(table.pageHandleCache.size(), PAGE_HANDLE_CACHE_SIZE);
+
+    // The pages sharing an entry.
+    int page = Table::FIRST_DATA_PAGE;
+    for (int i = 0; i < 2; i++) {
+        for (int p : {page, page + PAGE_HANDLE_CACHE_SIZE}) {
+            PageHandle handle = table.getHandle(p);
+            ASSERT_TRUE(handle.validate());
+            EXPECT_EQ(handle.cache->meta.page, p);
+        }
+    }
+}
+
+TEST_F(TableTest, TestDictionary) {
+    std::vector<ColumnMeta> dictionaryMetas = columnMetas;
+    dictionaryMetas[2].dictionary = true;
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, dictionaryMetas));
+    EXPECT_EQ(table.meta.recordSize, 4 + 4 + sizeof(Table::DictionaryCode) + 4);
+
+    const char *statuses[] = {"active", "inactive", "banned"};
+    std::vector<RecordID> ids;
+    for (int i = 0; i < 30; i++) {
+        Columns columns = testColumns;
+        columns[0] = Column(i);
+        columns[2] = Column(statuses[i % 3], 100);
+        ASSERT_NO_THROW(ids.push_back(table.insert(columns)));
+    }
+    // The default value is encoded as well.
+    Columns withoutVarchar = {Column(30), Column(1.1F),
+                              Column::nullIntColumn()};
+    ASSERT_NO_THROW(ids.push_back(table.insert(withoutVarchar, 0b1011)));
+    EXPECT_EQ(table.dictionaryValues[2].size(), 4);
+
+    auto check = [&]() {
+        for (int i = 0; i < 30; i++) {
+            EXPECT_STREQ(table.get(ids[i])[2].data.stringValue,
+                         statuses[i % 3]);
+        }
+        EXPECT_STREQ(table.get(ids[30])[2].data.stringValue, "HELLO");
+    };
+    check();
+
+    // The dictionary is persisted in the table.
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    check();
+
+    auto count = [&](CompareOp op, const char *value) {
+        int numRecords = 0;
+        table.iterate(
+            [&](RecordID, Columns &) {
+                numRecords++;
+                return true;
+            },
+            {CompareValueCondition({.columnName = "varchar_val"}, op, value)});
+        return numRecords;
+    };
+    // The scan only delivers the records with matching codes.
+    EXPECT_EQ(count(EQ, "banned"), 10);
+    EXPECT_EQ(count(NE, "banned"), 21);
+    EXPECT_EQ(count(EQ, "unknown"), 0);
+    EXPECT_EQ(count(NE, "unknown"), 31);
+    EXPECT_EQ(count(LT, "banned"), 31);
+
+    // Only VARCHAR columns can be dictionary-encoded.
+    Table invalidTable;
+    dictionaryMetas[0].dictionary = true;
+    EXPECT_THROW(invalidTable.create("tmp/invalid", tableName, dictionaryMetas),
+                 Internal::InvalidDictionaryColumnError);
+}
+
+TEST_F(TableTest, TestDictionaryFull) {
+    std::vector<ColumnMeta> metas = {{.type = VARCHAR,
+                                      .size = MAX_VARCHAR_LEN,
+                                      .nullable = false,
+                                      .name = "val",
+                                      .dictionary = true}};
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, metas));
+
+    // Each entry takes MAX_VARCHAR_LEN bytes and the header.
+    int maxValues = PAGE_SIZE / (MAX_VARCHAR_LEN + 2);
+    for (int i = 0; i < maxValues; i++) {
+        std::string value(MAX_VARCHAR_LEN, 'a' + i % 26);
+        value[0] = 'a' + i / 26;
+        ASSERT_NO_THROW(table.insert({Column(value.c_str(), MAX_VARCHAR_LEN)}));
+    }
+    std::string value(MAX_VARCHAR_LEN, 'z');
+    EXPECT_THROW(table.insert({Column(value.c_str(), MAX_VARCHAR_LEN)}),
+                 Internal::DictionaryFullError);
+    // The existing values can still be inserted.
+    std::string existing(MAX_VARCHAR_LEN, 'a');
+    EXPECT_NO_THROW(table.insert({Column(existing.c_str(), MAX_VARCHAR_LEN)}));
+}
+
+TEST_F(TableTest, TestZoneMap) {
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, columnMetas, {}, {},
+                                 /*zoneMap=*/true));
+
+    const int firstPage = Table::FIRST_DATA_PAGE;
+    const int firstSlot = table.numHeaderSlots();
+    const int numSlot = table.numSlotPerPage() - firstSlot;
+
+    // Ascending keys, so that each page holds a disjoint range.
+    std::vector<Columns> rows;
+    for (int i = 0; i < 4 * numSlot; i++) {
+        Columns columns = testColumns;
+        columns[0] = Column(i);
+        rows.push_back(columns);
+    }
+    ASSERT_NO_THROW(table.insertBatch(rows));
+    ASSERT_EQ(table.meta.numUsedPages, firstPage + 4);
+
+    auto count = [&](const std::vector<CompareValueCondition> &conditions) {
+        int numRecords = 0;
+        table.iterate(
+            [&](RecordID, Columns &) {
+                numRecords++;
+                return true;
+            },
+            conditions);
+        return numRecords;
+    };
+    auto intCondition = [](const char *column, CompareOp op, int value) {
+        return CompareValueCondition({.columnName = column}, op,
+                                     ColumnValue{.intValue = value});
+    };
+
+    EXPECT_EQ(count({}), 4 * numSlot);
+    EXPECT_EQ(count({intCondition("int_val", EQ, 2 * numSlot + 1)}), numSlot);
+    EXPECT_EQ(count({intCondition("int_val", GE, 3 * numSlot)}), numSlot);
+    EXPECT_EQ(count({intCondition("int_val", LT, numSlot),
+                     intCondition("int_val", GE, numSlot)}),
+              0);
+    EXPECT_EQ(count({intCondition("int_val", NE, 0)}), 4 * numSlot);
+    // Null values never match.
+    EXPECT_EQ(count({intCondition("int_val_nullable", EQ, 0)}), 0);
+    EXPECT_EQ(count({CompareValueCondition({.columnName = "float_val"}, GT,
+                                           ColumnValue{.floatValue = 2.0})}),
+              0);
+    // Conditions on other tables are ignored.
+    EXPECT_EQ(count({CompareValueCondition(
+                  {.tableName = "other", .columnName = "int_val"}, EQ,
+                  ColumnValue{.intValue = -1})}),
+              4 * numSlot);
+
+    // Updates widen the ranges.
+    ASSERT_NO_THROW(table.update({firstPage, firstSlot}, {Column(-1)}, 0b1));
+    EXPECT_EQ(count({intCondition("int_val", LT, 0)}), numSlot);
+
+    // The zone maps are persisted in the pages.
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    EXPECT_EQ(count({intCondition("int_val", LT, 0)}), numSlot);
+    EXPECT_EQ(count({intCondition("int_val", GE, 3 * numSlot)}), numSlot);
+
+    // The zone map is reset once the page is emptied.
+    for (int slot = firstSlot; slot < table.numSlotPerPage(); slot++) {
+        ASSERT_NO_THROW(table.remove({firstPage + 3, slot}));
+    }
+    EXPECT_EQ(count({intCondition("int_val", GE, 3 * numSlot)}), 0);
+    // The records of the unskipped pages are not filtered.
+    ASSERT_NO_THROW(table.insert(rows[0]));
+    EXPECT_EQ(count({intCondition("int_val", EQ, 0)}), numSlot + 1);
+}
+
+TEST_F(TableTest, TestPax) {
+    std::vector<ColumnMeta> metas = columnMetas;
+    metas[2].dictionary = true;
+    Table rowTable;
+    ASSERT_NO_THROW(rowTable.create("tmp/row", tableName, metas, {}, {},
+                                    /*zoneMap=*/true));
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, metas, {}, {},
+                                 /*zoneMap=*/true, /*pax=*/true));
+    // The slots are the same as in the row layout.
+    ASSERT_EQ(table.numSlotPerPage(), rowTable.numSlotPerPage());
+    ASSERT_EQ(table.numHeaderSlots(), rowTable.numHeaderSlots());
+
+    const char *statuses[] = {"active", "inactive", "banned"};
+    auto makeRow = [&](int i) {
+        return Columns{Column(i), Column(i * 0.5F),
+                       Column(statuses[i % 3], 100),
+                       i % 4 == 0 ? Column::nullIntColumn() : Column(-i)};
+    };
+    // Three full pages.
+    int numSlot = table.numSlotPerPage() - table.numHeaderSlots();
+    std::vector<Columns> rows;
+    for (int i = 0; i < 3 * numSlot; i++) {
+        rows.push_back(makeRow(i));
+    }
+    std::vector<RecordID> ids, rowIds;
+    ASSERT_NO_THROW(ids = table.insertBatch(rows));
+    ASSERT_NO_THROW(rowIds = rowTable.insertBatch(rows));
+    EXPECT_EQ(ids, rowIds);
+
+    ASSERT_NO_THROW(table.update(ids[5], {Column::nullIntColumn()}, 0b1000));
+    ASSERT_NO_THROW(table.update(ids[6], {Column(7.5F)}, 0b10));
+    rows[5][3] = Column::nullIntColumn();
+    rows[6][1] = Column(7.5F);
+    for (int i = 0; i < 10; i++) {
+        ASSERT_NO_THROW(table.remove(ids[i * 3]));
+        ASSERT_NO_THROW(rowTable.remove(rowIds[i * 3]));
+        ids[i * 3] = RecordID::NULL_RECORD;
+    }
+
+    auto check = [&]() {
+        int numRecords = 0;
+        table.iterate([&](RecordID id, Columns &columns) {
+            int i = std::find(ids.begin(), ids.end(), id) - ids.begin();
+            EXPECT_LT(i, ids.size());
+            compareColumns(columns, rows[i]);
+            numRecords++;
+            return true;
+        });
+        EXPECT_EQ(numRecords, rows.size() - 10);
+    };
+    check();
+
+    // Conditions are checked against the codes and the zone maps as well.
+    int numRecords = 0;
+    table.iterate(
+        [&](RecordID, Columns &columns) {
+            EXPECT_STREQ(columns[2].data.stringValue, "banned");
+            numRecords++;
+            return true;
+        },
+        {CompareValueCondition({.columnName = "varchar_val"}, EQ, "banned")});
+    EXPECT_EQ(numRecords, rows.size() / 3);
+
+    // The records are iterated in batches of pages.
+    int numBatches = 0;
+    long sum = 0;
+    EXPECT_TRUE(table.iterateBatches([&](const RecordBatch &batch) {
+        EXPECT_EQ(batch.size, numSlot);
+        for (int i = 0; i < batch.size; i++) {
+            if ((batch.mask >> i) & 1) {
+                int value;
+                memcpy(&value, batch.columns[0].data + i * 4, sizeof(int));
+                sum += value;
+            }
+        }
+        numBatches++;
+        return true;
+    }));
+    EXPECT_EQ(numBatches, 3);
+    long expectedSum = 0;
+    for (int i = 0; i < rows.size(); i++) {
+        expectedSum += i % 3 == 0 && i < 30 ? 0 : i;
+    }
+    EXPECT_EQ(sum, expectedSum);
+    EXPECT_FALSE(rowTable.iterateBatches(
+        [](const RecordBatch &) { return true; }));
+
+    // Records are moved by their columns.
+    ASSERT_NO_THROW(table.compact(1000, [&](RecordID from, RecordID to,
+                                            const Columns &columns) {
+        int i = std::find(ids.begin(), ids.end(), from) - ids.begin();
+        compareColumns(columns, rows[i]);
+        ids[i] = to;
+    }));
+    check();
+
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    check();
+    rowTable.close();
+}
+
+TEST_F(TableTest, TestClustered) {
+    EXPECT_THROW(table.create("tmp/table", tableName, columnMetas, {}, {},
+                              /*zoneMap=*/true, /*pax=*/false,
+                              /*clustered=*/true),
+                 InvalidPrimaryKeyError);
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, columnMetas,
+                                 "int_val", {}, /*zoneMap=*/true,
+                                 /*pax=*/false, /*clustered=*/true));
+
+    auto makeRow = [&](int key) {
+        return Columns{Column(key), Column(key * 0.5F),
+                       Column(testVarChar, 100), Column(-key)};
+    };
+    // Keys in ascending order, then keys falling between them, so that pages
+    // are split both ways.
+    int numSlot = table.numSlotPerPage() - table.numHeaderSlots();
+    int numKeys = 4 * numSlot;
+    std::vector<int> keys;
+    for (int i = 0; i < numKeys; i++) {
+        ASSERT_EQ(table.insert(makeRow(i * 2)), Table::clusterRecord(i * 2));
+        keys.push_back(i * 2);
+    }
+    std::vector<Columns> rows;
+    for (int i = numKeys - 1; i >= 0; i--) {
+        rows.push_back(makeRow(i * 2 + 1));
+        keys.push_back(i * 2 + 1);
+    }
+    ASSERT_NO_THROW(table.insertBatch(rows));
+    std::sort(keys.begin(), keys.end());
+    EXPECT_GT(table.clusterDirectory.size(), 4);
+
+    EXPECT_THROW(table.insert(makeRow(5)), DuplicateKeyError);
+    EXPECT_THROW(table.update(Table::clusterRecord(5), {Column(6)}, 0b1),
+                 ClusterKeyUpdateError);
+    ASSERT_NO_THROW(table.update(Table::clusterRecord(5), {Column(5)}, 0b1));
+    ASSERT_NO_THROW(
+        table.update(Table::clusterRecord(7), {Column(70.5F)}, 0b10));
+    EXPECT_EQ(table.get(Table::clusterRecord(7))[1].data.floatValue, 70.5F);
+    ASSERT_NO_THROW(table.remove(Table::clusterRecord(9)));
+    keys.erase(std::find(keys.begin(), keys.end(), 9));
+    EXPECT_THROW(table.get(Table::clusterRecord(9)), InvalidSlotError);
+
+    // The records are iterated in the order of the keys.
+    auto check = [&]() {
+        std::vector<int> iterated;
+        table.iterate([&](RecordID id, Columns &columns) {
+            EXPECT_EQ(id, Table::clusterRecord(columns[0].data.intValue));
+            EXPECT_EQ(columns[3].data.intValue, -columns[0].data.intValue);
+            iterated.push_back(columns[0].data.intValue);
+            return true;
+        });
+        EXPECT_EQ(iterated, keys);
+
+        iterated.clear();
+        table.iterateRange(100, 200, [&](RecordID, Columns &columns) {
+            iterated.push_back(columns[0].data.intValue);
+            return true;
+        });
+        EXPECT_EQ(iterated, std::vector<int>(keys.begin() + 99,
+                                             keys.begin() + 200));
+    };
+    check();
+
+    // Clustered tables are not compacted.
+    auto result = table.compact(1000, [](RecordID, RecordID, const Columns &) {
+        ADD_FAILURE();
+    });
+    EXPECT_TRUE(result.done);
+    EXPECT_THROW(table.dropPrimaryKey("int_val"), InvalidPrimaryKeyError);
+
+    // The directory is saved on close and loaded on open.
+    auto directory = table.clusterDirectory;
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    EXPECT_EQ(table.clusterDirectory, directory);
+    check();
+    EXPECT_TRUE(table.loadSavedClusterDirectory());
+
+    // Once a page is added, the saved directory is stale and the directory is
+    // rebuilt from the page metas.
+    for (int i = 0; i < numSlot; i++) {
+        ASSERT_NO_THROW(table.insert(makeRow(numKeys * 2 + i)));
+        keys.push_back(numKeys * 2 + i);
+    }
+    EXPECT_GT(table.clusterDirectory.size(), directory.size());
+    directory = table.clusterDirectory;
+    table.clusterDirectory.clear();
+    EXPECT_FALSE(table.loadSavedClusterDirectory());
+    table.loadClusterDirectory();
+    EXPECT_EQ(table.clusterDirectory, directory);
+    check();
+
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    EXPECT_EQ(table.clusterDirectory, directory);
+    check();
+}
+
+TEST_F(TableTest, TestClusteredLocate) {
+    ASSERT_NO_THROW(table.create("tmp/table", tableName, columnMetas,
+                                 "int_val", {}, /*zoneMap=*/false,
+                                 /*pax=*/false, /*clustered=*/true));
+
+    // Insert and remove keys in random order, splitting the pages.
+    const int numKeys = 8 * table.numSlotPerPage();
+    std::vector<int> keys(numKeys);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(0));
+    for (int key : keys) {
+        Columns columns = testColumns;
+        columns[0] = Column(key);
+        ASSERT_NO_THROW(table.insert(columns));
+    }
+    for (int i = 0; i < numKeys / 2; i++) {
+        ASSERT_NO_THROW(table.remove(Table::clusterRecord(keys[i])));
+    }
+
+    // The cached entries of each page match its records.
+    for (auto [lowKey, page] : table.clusterDirectory) {
+        auto cached = table.clusterEntries(page);
+        table.clearClusterEntries();
+        EXPECT_EQ(table.clusterEntries(page), cached);
+    }
+
+    for (int i = 0; i < numKeys; i++) {
+        RecordID id = Table::clusterRecord(keys[i]);
+        if (i < numKeys / 2) {
+            EXPECT_THROW(table.get(id), InvalidSlotError);
+        } else {
+            EXPECT_EQ(table.get(id)[0].data.intValue, keys[i]);
+        }
+    }
+}
+
+TEST_F(TableTest, TestMemory) {
+    MemoryTable table;
+    EXPECT_THROW(table.create("tmp/table", tableName, columnMetas, "int_val",
+                              {}, /*zoneMap=*/false, /*pax=*/true),
+                 InvalidMemoryTableError);
+    ASSERT_NO_THROW(
+        table.create("tmp/table", tableName, columnMetas, "int_val"));
+
+    auto makeRow = [&](int key) {
+        return Columns{Column(key), Column(key * 0.5F),
+                       Column(testVarChar, 100), Column(-key)};
+    };
+    std::vector<RecordID> ids;
+    for (int i = 0; i < 100; i++) {
+        ids.push_back(table.insert(makeRow(i)));
+    }
+    EXPECT_EQ(table.findKey(42), ids[42]);
+    compareColumns(table.get(ids[42]), makeRow(42));
+    EXPECT_EQ(table.findKey(100), RecordID::NULL_RECORD);
+    EXPECT_THROW(table.insert(makeRow(42)), DuplicateKeyError);
+
+    // The hash of the keys follows the updates and removals.
+    EXPECT_THROW(table.update(ids[42], {Column(43)}, 0b1), DuplicateKeyError);
+    ASSERT_NO_THROW(table.update(ids[42], {Column(142)}, 0b1));
+    EXPECT_EQ(table.findKey(42), RecordID::NULL_RECORD);
+    EXPECT_EQ(table.findKey(142), ids[42]);
+    ASSERT_NO_THROW(table.remove(ids[10]));
+    EXPECT_EQ(table.findKey(10), RecordID::NULL_RECORD);
+    EXPECT_THROW(table.get(ids[10]), InvalidSlotError);
+    // The freed row is reused.
+    EXPECT_EQ(table.insert(makeRow(10)), ids[10]);
+
+    int numRecords = 0;
+    table.iterate([&](RecordID id, Columns &columns) {
+        EXPECT_EQ(table.findKey(columns[0].data.intValue), id);
+        numRecords++;
+        return true;
+    });
+    EXPECT_EQ(numRecords, 100);
+    int count;
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 100);
+
+    numRecords = 0;
+    table.iterateRange(20, 29, [&](RecordID, Columns &columns) {
+        EXPECT_GE(columns[0].data.intValue, 20);
+        EXPECT_LE(columns[0].data.intValue, 29);
+        numRecords++;
+        return true;
+    });
+    EXPECT_EQ(numRecords, 10);
+
+    // Compaction moves the last rows to the freed ones, and releases the
+    // rows at the end.
+    for (int i = 50; i < 100; i += 2) {
+        ASSERT_NO_THROW(table.remove(table.findKey(i)));
+    }
+    std::map<int, RecordID> moved;
+    auto callback = [&](RecordID from, RecordID to, const Columns &columns) {
+        EXPECT_EQ(from.page, MemoryTable::MEMORY_RECORD_PAGE);
+        EXPECT_GT(from.slot, to.slot);
+        moved[columns[0].data.intValue] = to;
+    };
+    auto result = table.compact(1, callback);
+    EXPECT_EQ(result.numMovedRecords, 1);
+    EXPECT_FALSE(result.done);
+    result = table.compact(100, callback);
+    EXPECT_TRUE(result.done);
+    EXPECT_EQ(moved.size(), 13);
+    EXPECT_EQ(table.rowOccupied.size(), 75);
+    for (auto [key, id] : moved) {
+        EXPECT_EQ(table.findKey(key), id);
+        compareColumns(table.get(id), makeRow(key));
+    }
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 75);
+    EXPECT_EQ(table.insert(makeRow(50)).slot, 75);
+
+    // Nothing but the metadata is written to the file.
+    EXPECT_EQ(table.meta.numUsedPages, Table::FIRST_DATA_PAGE);
+    table.close();
+    ASSERT_NO_THROW(table.open("tmp/table"));
+    ASSERT_TRUE(table.count(count));
+    EXPECT_EQ(count, 0);
+    EXPECT_EQ(table.findKey(42), RecordID::NULL_RECORD);
+    table.close();
+
+    // Only the files of memory tables are opened as such.
+    initTable();
+    this->table.close();
+    EXPECT_THROW(table.open("tmp/table"), ReadTableError);
 }
 
 TEST_F(TableTest, TestColumnName) {
@@ -222,3 +1075,43 @@ TEST_F(TableTest, TestMaxVarcharSize) {
 
     EXPECT_EQ(strcmp(readColumns[0].data.stringValue, varchar), 0);
 }
+
+TEST_F(TableTest, TestColumnCopyMove) {
+    Column column(testVarChar, 100);
+
+    // Copies share their strings, which are copied when written.
+    Column copied = column;
+    EXPECT_EQ(copied.data.stringValue, column.data.stringValue);
+    EXPECT_STREQ(copied.data.stringValue, testVarChar);
+    copied.setString("other", 5);
+    EXPECT_NE(copied.data.stringValue, column.data.stringValue);
+    EXPECT_STREQ(copied.data.stringValue, "other");
+    EXPECT_STREQ(column.data.stringValue, testVarChar);
+
+    // An unshared string is written in place.
+    const char *buffer = copied.data.stringValue;
+    copied.setString("again", 5);
+    EXPECT_EQ(copied.data.stringValue, buffer);
+    EXPECT_STREQ(copied.data.stringValue, "again");
+
+    // Including from itself, and when assigned to itself.
+    copied.setString(copied.data.stringValue + 1, 3);
+    EXPECT_STREQ(copied.data.stringValue, "gai");
+    Column &self = copied;
+    copied = self;
+    EXPECT_STREQ(copied.data.stringValue, "gai");
+
+    copied = Column(42);
+    EXPECT_EQ(copied.type, INT);
+    EXPECT_EQ(copied.data.intValue, 42);
+    EXPECT_EQ(copied.data.stringValue, nullptr);
+
+    // Moves steal the string.
+    const char *string = column.data.stringValue;
+    Column moved = std::move(column);
+    EXPECT_EQ(moved.data.stringValue, string);
+    EXPECT_EQ(column.data.stringValue, nullptr);
+
+    // Scalar columns are kept small.
+    EXPECT_LT(sizeof(Column) * 10, sizeof(ColumnValue));
+}
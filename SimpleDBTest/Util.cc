@@ -15,13 +15,11 @@ void compareColumns(const SimpleDB::Internal::Columns &columns,
             EXPECT_FALSE(readColumns[i].isNull);
         }
         if (columns[i].type == SimpleDB::Internal::VARCHAR) {
-            EXPECT_EQ(memcmp(columns[i].data.stringValue,
-                             readColumns[i].data.stringValue,
-                             strlen(columns[i].data.stringValue)),
-                      0);
+            EXPECT_STREQ(columns[i].data.stringValue,
+                         readColumns[i].data.stringValue);
         } else {
-            EXPECT_EQ(memcmp(columns[i].data.stringValue,
-                             readColumns[i].data.stringValue, columns[i].size),
+            EXPECT_EQ(memcmp(&columns[i].data.intValue,
+                             &readColumns[i].data.intValue, columns[i].size),
                       0);
         }
     }